@@ -40,6 +40,7 @@
 
 #ifdef HAVE_OPENGL
 #include "OGL_Headers.h"
+#include "OGL_Setup.h"
 #endif
 
 #include "Movie.h"
@@ -66,10 +67,15 @@ void Movie::StopRecording() {}
 void Movie::AddFrame(FrameType ftype) {}
 
 bool Movie::Setup() { return false; }
+int Movie::ReserveFrame() { return 0; }
+void Movie::SubmitFrame() {}
+void Movie::FinishReadback() {}
+int Movie::Movie_ConvertThread(void *arg) { return 0; }
 int Movie::Movie_EncodeThread(void *arg) { return 0; }
+void Movie::ConvertThread() {}
 void Movie::EncodeThread() {}
-void Movie::EncodeVideo(bool last) {}
-void Movie::EncodeAudio(bool last) {}
+void Movie::EncodeVideo(movie_frame *frame) {}
+void Movie::EncodeAudio(movie_frame *frame) {}
 Movie::Movie() {}
 
 #else
@@ -130,10 +136,8 @@ struct libav_vars {
     uint8_t *audio_data;
     uint8_t *audio_data_conv;
     
-    AVFrame *video_frame;
     uint8_t *video_buf;
     int video_bufsize;
-    uint8_t *video_data;
     
     struct SwsContext *sws_ctx;
     AVFormatContext *fmt_ctx;
@@ -329,12 +333,19 @@ int ScaleQuality(int quality, int zeroLevel, int fiftyLevel, int hundredLevel)
 
 Movie::Movie() :
   moviefile(""),
-  temp_surface(NULL),
+  fill_index(0),
+  convert_index(0),
+  encode_index(0),
+  use_readback_buffers(false),
+  readback_index(0),
+  pending_frame(NONE),
+  pending_buffer(0),
   av(NULL),
+  convertThread(NULL),
   encodeThread(NULL),
+  convertReady(NULL),
   encodeReady(NULL),
-  fillReady(NULL),
-  stillEncoding(0)
+  fillReady(NULL)
 {
     av = new libav_vars_t;
     memset(av, 0, sizeof(libav_vars_t));
@@ -381,12 +392,6 @@ bool Movie::Setup()
 	view_rect.w *= scr->pixel_scale();
 	view_rect.h *= scr->pixel_scale();
 
-	temp_surface = SDL_CreateRGBSurface(SDL_SWSURFACE, view_rect.w, view_rect.h, 32,
-										0x00ff0000, 0x0000ff00, 0x000000ff,
-										0);
-	success = (temp_surface != NULL);
-	if (!success) err_msg = "Could not create SDL surface";
-
     Mixer *mx = Mixer::instance();
     
     av_register_all();
@@ -463,27 +468,6 @@ bool Movie::Setup()
         success = av->video_buf;
         if (!success) err_msg = "Could not allocate video buffer";
     }
-    if (success)
-    {
-#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(55,28,0)
-        av->video_frame = avcodec_alloc_frame();
-#else
-        av->video_frame = av_frame_alloc();
-#endif
-        success = av->video_frame;
-        if (!success) err_msg = "Could not allocate video frame";
-    }
-    if (success)
-    {
-        int numbytes = avpicture_get_size(video_stream->codec->pix_fmt, view_rect.w, view_rect.h);
-        av->video_data = static_cast<uint8_t *>(av_malloc(numbytes));
-        success = av->video_data;
-        if (!success) err_msg = "Could not allocate video data buffer";
-    }
-    if (success)
-    {
-        avpicture_fill(reinterpret_cast<AVPicture *>(av->video_frame), av->video_data, video_stream->codec->pix_fmt, view_rect.w, view_rect.h);
-    }
     
     // Open output audio stream
     AVCodec *audio_codec;
@@ -555,7 +539,7 @@ bool Movie::Setup()
     // initialize conversion context
     if (success)
     {
-        av->sws_ctx = sws_getContext(temp_surface->w, temp_surface->h, AV_PIX_FMT_RGB32,
+        av->sws_ctx = sws_getContext(view_rect.w, view_rect.h, AV_PIX_FMT_RGB32,
                                      video_stream->codec->width,
                                      video_stream->codec->height,
                                      video_stream->codec->pix_fmt,
@@ -576,23 +560,73 @@ bool Movie::Setup()
     // set up our threads and intermediate storage
     if (success)
     {
-        videobuf.resize(av->video_bufsize);
-        audiobuf.resize(2 * 2 * mx->obtained.freq / 30);
+        int numbytes = avpicture_get_size(video_stream->codec->pix_fmt, view_rect.w, view_rect.h);
+        frames.resize(FRAME_QUEUE_SIZE);
+        for (int i = 0; success && i < FRAME_QUEUE_SIZE; i++)
+        {
+            movie_frame& frame = frames[i];
+            frame.surface = SDL_CreateRGBSurface(SDL_SWSURFACE, view_rect.w, view_rect.h, 32,
+                                                 0x00ff0000, 0x0000ff00, 0x000000ff,
+                                                 0);
+            frame.bottom_up = false;
+            frame.audio.resize(2 * 2 * mx->obtained.freq / 30);
+            frame.last = false;
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(55,28,0)
+            frame.picture = avcodec_alloc_frame();
+#else
+            frame.picture = av_frame_alloc();
+#endif
+            uint8_t *picture_data = static_cast<uint8_t *>(av_malloc(numbytes));
+            success = frame.surface && frame.picture && picture_data;
+            if (success)
+                avpicture_fill(reinterpret_cast<AVPicture *>(frame.picture), picture_data, video_stream->codec->pix_fmt, view_rect.w, view_rect.h);
+            else
+                av_free(picture_data);
+        }
+        if (!success) err_msg = "Could not allocate movie frames";
 	}
 	if (success)
 	{
+		fillReady = SDL_CreateSemaphore(FRAME_QUEUE_SIZE);
+		convertReady = SDL_CreateSemaphore(0);
 		encodeReady = SDL_CreateSemaphore(0);
-		fillReady = SDL_CreateSemaphore(1);
-		stillEncoding = true;
-		success = encodeReady && fillReady;
+		fill_index = convert_index = encode_index = 0;
+		pending_frame = NONE;
+		success = fillReady && convertReady && encodeReady;
 		if (!success) err_msg = "Could not create movie thread semaphores";
 	}
 	if (success)
 	{
-		encodeThread = SDL_CreateThread(Movie_EncodeThread, "MovieSetup_encodeThread", this);
-		success = encodeThread;
-		if (!success) err_msg = "Could not create movie encoding thread";
+		convertThread = SDL_CreateThread(Movie_ConvertThread, "MovieSetup_convertThread", this);
+		success = convertThread;
+		if (success)
+		{
+			encodeThread = SDL_CreateThread(Movie_EncodeThread, "MovieSetup_encodeThread", this);
+			success = encodeThread;
+		}
+		if (!success) err_msg = "Could not create movie encoding threads";
 	}
+#ifdef HAVE_OPENGL
+	if (success && MainScreenIsOpenGL())
+	{
+		// read frames back without waiting for them, if we can
+		use_readback_buffers = OGL_CheckExtension("GL_ARB_pixel_buffer_object");
+		if (use_readback_buffers)
+		{
+			glGenBuffersARB(READBACK_BUFFERS, readback_buffers);
+			for (int i = 0; i < READBACK_BUFFERS; i++)
+			{
+				glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, readback_buffers[i]);
+				glBufferDataARB(GL_PIXEL_PACK_BUFFER_ARB, view_rect.w * view_rect.h * 4, NULL, GL_STREAM_READ_ARB);
+			}
+			glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, 0);
+		}
+		readback_index = 0;
+		
+		// the game keeps to the movie's clock now, not the display's
+		SDL_GL_SetSwapInterval(0);
+	}
+#endif
 	
 	if (!success)
 	{
@@ -607,28 +641,30 @@ bool Movie::Setup()
 	return success;
 }
 
+int Movie::Movie_ConvertThread(void *arg)
+{
+	reinterpret_cast<Movie *>(arg)->ConvertThread();
+	return 0;
+}
+
 int Movie::Movie_EncodeThread(void *arg)
 {
 	reinterpret_cast<Movie *>(arg)->EncodeThread();
 	return 0;
 }
 
-void Movie::EncodeVideo(bool last)
+void Movie::EncodeVideo(movie_frame *queued)
 {
-    // convert video
     AVStream *vstream = av->fmt_ctx->streams[av->video_stream_idx];
     AVCodecContext *vcodec = vstream->codec;
     
+    // no frame means flush the encoder
+    bool last = !queued;
     AVFrame *frame = NULL;
     if (!last)
     {
-        int pitch[] = { temp_surface->pitch, 0 };
-        const uint8_t *const pdata[] = { reinterpret_cast<uint8_t *>(temp_surface->pixels), NULL };
-    
-        sws_scale(av->sws_ctx, pdata, pitch, 0, temp_surface->h,
-                  av->video_frame->data, av->video_frame->linesize);
-        av->video_frame->pts = av->video_counter++;
-        frame = av->video_frame;
+        frame = queued->picture;
+        frame->pts = av->video_counter++;
     }
     
     bool done = false;
@@ -660,13 +696,15 @@ void Movie::EncodeVideo(bool last)
     }
 }
 
-void Movie::EncodeAudio(bool last)
+void Movie::EncodeAudio(movie_frame *queued)
 {
     AVStream *astream = av->fmt_ctx->streams[av->audio_stream_idx];
     AVCodecContext *acodec = astream->codec;
     
-    
-    av_fifo_generic_write(av->audio_fifo, &audiobuf[0], audiobuf.size(), NULL);
+    // no frame means flush the encoder
+    bool last = !queued;
+    if (!last)
+        av_fifo_generic_write(av->audio_fifo, &queued->audio[0], queued->audio.size(), NULL);
     
     // bps: bytes per sample
     int channels = acodec->channels;
@@ -768,6 +806,83 @@ void Movie::EncodeAudio(bool last)
     
 }
 
+// Frames pass through the queue in order: AddFrame() fills them, the
+// conversion thread turns them into the encoder's pixel format, and the
+// encoding thread compresses and writes them. So conversion of one frame
+// overlaps encoding of the one before, and the game only waits when every
+// slot is full.
+
+int Movie::ReserveFrame()
+{
+	SDL_SemWait(fillReady);
+	int index = fill_index;
+	fill_index = (fill_index + 1) % FRAME_QUEUE_SIZE;
+	frames[index].last = false;
+	return index;
+}
+
+void Movie::SubmitFrame()
+{
+	SDL_SemPost(convertReady);
+}
+
+// queue the frame whose pixels are being read back, once they've arrived
+void Movie::FinishReadback()
+{
+	if (pending_frame == NONE)
+		return;
+	
+#ifdef HAVE_OPENGL
+	movie_frame& frame = frames[pending_frame];
+	glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, readback_buffers[pending_buffer]);
+	const uint8 *pixels = static_cast<const uint8 *>(glMapBufferARB(GL_PIXEL_PACK_BUFFER_ARB, GL_READ_ONLY_ARB));
+	if (pixels)
+	{
+		int row_bytes = view_rect.w * 4;
+		for (int y = 0; y < view_rect.h; y++)
+			memcpy((uint8 *)frame.surface->pixels + frame.surface->pitch * y, pixels + row_bytes * y, row_bytes);
+		glUnmapBufferARB(GL_PIXEL_PACK_BUFFER_ARB);
+	}
+	glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, 0);
+	frame.bottom_up = true;
+#endif
+	
+	pending_frame = NONE;
+	SubmitFrame();
+}
+
+void Movie::ConvertThread()
+{
+	while (true)
+	{
+		SDL_SemWait(convertReady);
+		movie_frame& frame = frames[convert_index];
+		convert_index = (convert_index + 1) % FRAME_QUEUE_SIZE;
+		
+		bool last = frame.last;
+		if (!last)
+		{
+			// OpenGL's rows are upside-down; start from the bottom one
+			SDL_Surface *surface = frame.surface;
+			const uint8_t *pixels = reinterpret_cast<uint8_t *>(surface->pixels);
+			int pitch[] = { surface->pitch, 0 };
+			if (frame.bottom_up)
+			{
+				pixels += surface->pitch * (surface->h - 1);
+				pitch[0] = -surface->pitch;
+			}
+			const uint8_t *const pdata[] = { pixels, NULL };
+			
+			sws_scale(av->sws_ctx, pdata, pitch, 0, surface->h,
+					  frame.picture->data, frame.picture->linesize);
+		}
+		
+		SDL_SemPost(encodeReady);
+		if (last)
+			return;
+	}
+}
+
 void Movie::EncodeThread()
 {
 	av->video_counter = 0;
@@ -775,16 +890,14 @@ void Movie::EncodeThread()
 	while (true)
 	{
 		SDL_SemWait(encodeReady);
-		if (!stillEncoding)
-		{
-			// signal to quit
-			SDL_SemPost(fillReady);
+		movie_frame& frame = frames[encode_index];
+		encode_index = (encode_index + 1) % FRAME_QUEUE_SIZE;
+		if (frame.last)
 			return;
-		}
         
         // add video and audio
-        EncodeVideo(false);
-        EncodeAudio(false);
+        EncodeVideo(&frame);
+        EncodeAudio(&frame);
 		
 		SDL_SemPost(fillReady);
 	}
@@ -805,43 +918,72 @@ void Movie::AddFrame(FrameType ftype)
 	if (ftype == FRAME_FADE && get_keyboard_controller_status())
 		return;
 	
-	SDL_SemWait(fillReady);
+	int index = ReserveFrame();
+	movie_frame& frame = frames[index];
   	
 	if (!MainScreenIsOpenGL())
 	{
 		SDL_Surface *video = MainScreenSurface();
-		SDL_BlitSurface(video, &view_rect, temp_surface, NULL);
+		SDL_BlitSurface(video, &view_rect, frame.surface, NULL);
+		frame.bottom_up = false;
 	}
 #ifdef HAVE_OPENGL
+	else if (use_readback_buffers)
+	{
+		// Start reading this frame back, and queue the previous one, which
+		// has had a whole frame to arrive
+		glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, readback_buffers[readback_index]);
+		glReadPixels(view_rect.x, view_rect.y, view_rect.w, view_rect.h, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, 0);
+		glBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, 0);
+		FinishReadback();
+		pending_frame = index;
+		pending_buffer = readback_index;
+		readback_index = (readback_index + 1) % READBACK_BUFFERS;
+	}
 	else
 	{
-		// Read OpenGL frame buffer
-		glReadPixels(view_rect.x, view_rect.y, view_rect.w, view_rect.h, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, &videobuf.front());
-		
-		// Copy pixel buffer (which is upside-down) to surface
-		for (int y = 0; y < view_rect.h; y++)
-			memcpy((uint8 *)temp_surface->pixels + temp_surface->pitch * y, &videobuf.front() + view_rect.w * 4 * (view_rect.h - y - 1), view_rect.w * 4);
+		// Read OpenGL frame buffer (upside-down; the conversion flips it)
+		glPixelStorei(GL_PACK_ROW_LENGTH, frame.surface->pitch / 4);
+		glReadPixels(view_rect.x, view_rect.y, view_rect.w, view_rect.h, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, frame.surface->pixels);
+		glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+		frame.bottom_up = true;
 	}
 #endif
 	
-	int audio_bytes_per_frame = audiobuf.size();
+	int audio_bytes_per_frame = frame.audio.size();
 	Mixer *mx = Mixer::instance();
 	int old_vol = mx->main_volume;
 	mx->main_volume = 0x100;
-	mx->Mix(&audiobuf.front(), audio_bytes_per_frame / 4, true, true, true);
+	mx->Mix(&frame.audio.front(), audio_bytes_per_frame / 4, true, true, true);
 	mx->main_volume = old_vol;
 	
-	SDL_SemPost(encodeReady);
+	if (pending_frame != index)
+	{
+		FinishReadback();
+		SubmitFrame();
+	}
 }
 
 void Movie::StopRecording()
 {
-	if (encodeThread)
+	if (convertThread)
 	{
-		stillEncoding = false;
-		SDL_SemPost(encodeReady);
-		SDL_WaitThread(encodeThread, NULL);
-		encodeThread = NULL;
+		// let the queued frames through, then tell the threads to quit
+		FinishReadback();
+		frames[ReserveFrame()].last = true;
+		SubmitFrame();
+		SDL_WaitThread(convertThread, NULL);
+		convertThread = NULL;
+		if (encodeThread)
+		{
+			SDL_WaitThread(encodeThread, NULL);
+			encodeThread = NULL;
+		}
+	}
+	if (convertReady)
+	{
+		SDL_DestroySemaphore(convertReady);
+		convertReady = NULL;
 	}
 	if (encodeReady)
 	{
@@ -853,23 +995,41 @@ void Movie::StopRecording()
 		SDL_DestroySemaphore(fillReady);
 		fillReady = NULL;
 	}
-	if (temp_surface)
+	pending_frame = NONE;
+	
+#ifdef HAVE_OPENGL
+	if (use_readback_buffers)
 	{
-		SDL_FreeSurface(temp_surface);
-		temp_surface = NULL;
+		glDeleteBuffersARB(READBACK_BUFFERS, readback_buffers);
+		use_readback_buffers = false;
 	}
+	if (av->inited && MainScreenIsOpenGL())
+		SDL_GL_SetSwapInterval(Get_OGL_ConfigureData().WaitForVSync ? 1 : 0);
+#endif
     
     if (av->inited)
     {
         // flush video and audio
-        EncodeVideo(true);
-        EncodeAudio(true);
+        EncodeVideo(NULL);
+        EncodeAudio(NULL);
         avcodec_flush_buffers(av->fmt_ctx->streams[av->audio_stream_idx]->codec);
         avcodec_flush_buffers(av->fmt_ctx->streams[av->video_stream_idx]->codec);
         av_write_trailer(av->fmt_ctx);
         av->inited = false;
     }
     
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        if (frames[i].surface)
+            SDL_FreeSurface(frames[i].surface);
+        if (frames[i].picture)
+        {
+            av_free(frames[i].picture->data[0]);
+            av_free(frames[i].picture);
+        }
+    }
+    frames.clear();
+    
     if (av->audio_fifo)
     {
         av_fifo_free(av->audio_fifo);
@@ -891,16 +1051,6 @@ void Movie::StopRecording()
         av_free(av->video_buf);
         av->video_buf = NULL;
     }
-    if (av->video_data)
-    {
-        av_free(av->video_data);
-        av->video_data = NULL;
-    }
-    if (av->video_frame)
-    {
-        av_free(av->video_frame);
-        av->video_frame = NULL;
-    }
     
     if (av->sws_ctx)
     {
@@ -53,26 +53,52 @@ public:
 
 private:
   
+  // frames that may wait for the encoder before AddFrame() has to block
+  enum { FRAME_QUEUE_SIZE = 6, READBACK_BUFFERS = 2 };
+  
+  // a frame on its way from the screen to the movie file
+  struct movie_frame {
+    SDL_Surface *surface;
+    bool bottom_up;            // rows in OpenGL's order
+    std::vector<uint8> audio;
+    struct AVFrame *picture;   // surface converted for the encoder
+    bool last;                 // no more frames follow
+  };
+  
   std::string moviefile;
   SDL_Rect view_rect;
-  SDL_Surface *temp_surface;
   
-  std::vector<uint8> videobuf;
-  std::vector<uint8> audiobuf;
+  std::vector<movie_frame> frames;
+  int fill_index;
+  int convert_index;
+  int encode_index;
+  
+  // OpenGL frames are read back asynchronously, and queued a frame late
+  bool use_readback_buffers;
+  unsigned int readback_buffers[READBACK_BUFFERS];
+  int readback_index;
+  int pending_frame;
+  int pending_buffer;
   
   struct libav_vars *av;
   
+  SDL_Thread *convertThread;
   SDL_Thread *encodeThread;
+  SDL_sem *convertReady;
   SDL_sem *encodeReady;
   SDL_sem *fillReady;
-  bool stillEncoding;
   
   Movie();  
   bool Setup();
+  int ReserveFrame();
+  void SubmitFrame();
+  void FinishReadback();
+  static int Movie_ConvertThread(void *arg);
   static int Movie_EncodeThread(void *arg);
+  void ConvertThread();
   void EncodeThread();
-  void EncodeVideo(bool last);
-  void EncodeAudio(bool last);
+  void EncodeVideo(movie_frame *frame);
+  void EncodeAudio(movie_frame *frame);
 };
 	
 #endif
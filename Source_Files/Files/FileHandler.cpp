@@ -470,6 +470,19 @@ TimeType FileSpecifier::GetDate()
 	return st.st_mtime;
 }
 
+bool FileSpecifier::GetSizeAndDate(int32& Size, TimeType& Date)
+{
+	struct stat st;
+	err = 0;
+	if (stat(GetPath(), &st) < 0) {
+		err = errno;
+		return false;
+	}
+	Size = st.st_size;
+	Date = st.st_mtime;
+	return true;
+}
+
 static const char * alephone_extensions[] = {
 	".sceA",
 	".sgaA",
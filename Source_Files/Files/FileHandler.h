@@ -287,6 +287,9 @@ public:
 	// Gets the modification date
 	TimeType GetDate();
 	
+	// Gets the size and modification date together, for telling whether a file changed
+	bool GetSizeAndDate(int32& Size, TimeType& Date);
+
 	// Returns _typecode_unknown if the type could not be identified;
 	// the types returned are the _typecode_stuff in tags.h
 	Typecode GetType();
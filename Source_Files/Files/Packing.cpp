@@ -25,6 +25,13 @@
 #include "cseries.h"
 #include "Packing.h"
 
+// PACKING_NO_SSE2 leaves only the scalar loops, so that they can be tested on
+// SSE2 hosts too
+#if defined(__SSE2__) && !defined(PACKING_NO_SSE2)
+#define PACKING_SSE2
+#include <emmintrin.h>
+#endif
+
 //big endian
 
  void StreamToValueBE(uint8* &Stream, uint16 &Value)
@@ -146,3 +153,109 @@
     ValueToStreamLE(Stream,uint32(Value));
 }
 
+
+// runs of values, for the record schemas
+
+static void CopySwapped16(uint8* Dest, const uint8* Source, size_t Count)
+{
+    size_t k = 0;
+#ifdef PACKING_SSE2
+    for (; k + 8 <= Count; k += 8)
+    {
+        __m128i Values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Source + 2*k));
+        Values = _mm_or_si128(_mm_slli_epi16(Values, 8), _mm_srli_epi16(Values, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(Dest + 2*k), Values);
+    }
+#endif
+    for (; k < Count; k++)
+    {
+        uint8 Byte0 = Source[2*k];
+        Dest[2*k] = Source[2*k + 1];
+        Dest[2*k + 1] = Byte0;
+    }
+}
+
+static void CopySwapped32(uint8* Dest, const uint8* Source, size_t Count)
+{
+    size_t k = 0;
+#ifdef PACKING_SSE2
+    for (; k + 4 <= Count; k += 4)
+    {
+        // swap the bytes of each half, then the halves
+        __m128i Values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Source + 4*k));
+        Values = _mm_or_si128(_mm_slli_epi16(Values, 8), _mm_srli_epi16(Values, 8));
+        Values = _mm_shufflelo_epi16(Values, _MM_SHUFFLE(2,3,0,1));
+        Values = _mm_shufflehi_epi16(Values, _MM_SHUFFLE(2,3,0,1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(Dest + 4*k), Values);
+    }
+#endif
+    for (; k < Count; k++)
+    {
+        uint8 Byte0 = Source[4*k];
+        uint8 Byte1 = Source[4*k + 1];
+        Dest[4*k] = Source[4*k + 3];
+        Dest[4*k + 1] = Source[4*k + 2];
+        Dest[4*k + 2] = Byte1;
+        Dest[4*k + 3] = Byte0;
+    }
+}
+
+#ifdef ALEPHONE_LITTLE_ENDIAN
+#define COPY_BE16 CopySwapped16
+#define COPY_BE32 CopySwapped32
+#define COPY_LE16(Dest, Source, Count) memcpy(Dest, Source, 2*(Count))
+#define COPY_LE32(Dest, Source, Count) memcpy(Dest, Source, 4*(Count))
+#else
+#define COPY_BE16(Dest, Source, Count) memcpy(Dest, Source, 2*(Count))
+#define COPY_BE32(Dest, Source, Count) memcpy(Dest, Source, 4*(Count))
+#define COPY_LE16 CopySwapped16
+#define COPY_LE32 CopySwapped32
+#endif
+
+ void StreamToValues16BE(uint8* &Stream, void* Values, size_t Count)
+{
+    COPY_BE16(static_cast<uint8*>(Values), Stream, Count);
+    Stream += 2*Count;
+}
+
+ void StreamToValues32BE(uint8* &Stream, void* Values, size_t Count)
+{
+    COPY_BE32(static_cast<uint8*>(Values), Stream, Count);
+    Stream += 4*Count;
+}
+
+ void Values16ToStreamBE(uint8* &Stream, const void* Values, size_t Count)
+{
+    COPY_BE16(Stream, static_cast<const uint8*>(Values), Count);
+    Stream += 2*Count;
+}
+
+ void Values32ToStreamBE(uint8* &Stream, const void* Values, size_t Count)
+{
+    COPY_BE32(Stream, static_cast<const uint8*>(Values), Count);
+    Stream += 4*Count;
+}
+
+ void StreamToValues16LE(uint8* &Stream, void* Values, size_t Count)
+{
+    COPY_LE16(static_cast<uint8*>(Values), Stream, Count);
+    Stream += 2*Count;
+}
+
+ void StreamToValues32LE(uint8* &Stream, void* Values, size_t Count)
+{
+    COPY_LE32(static_cast<uint8*>(Values), Stream, Count);
+    Stream += 4*Count;
+}
+
+ void Values16ToStreamLE(uint8* &Stream, const void* Values, size_t Count)
+{
+    COPY_LE16(Stream, static_cast<const uint8*>(Values), Count);
+    Stream += 2*Count;
+}
+
+ void Values32ToStreamLE(uint8* &Stream, const void* Values, size_t Count)
+{
+    COPY_LE32(Stream, static_cast<const uint8*>(Values), Count);
+    Stream += 4*Count;
+}
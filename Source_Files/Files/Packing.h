@@ -50,6 +50,15 @@
 	
 	BytesToStream(uint8* &Stream, const void* Bytes, size_t Count)
 		packs a block of bytes into a stream
+	
+	StreamToValues16(uint8* &Stream, void* Values, size_t Count)
+	StreamToValues32(uint8* &Stream, void* Values, size_t Count)
+		unpacks a stream into a run of 16-bit or 32-bit values in one pass;
+		used by the record schemas in PackingSchema.h
+	
+	Values16ToStream(uint8* &Stream, const void* Values, size_t Count)
+	Values32ToStream(uint8* &Stream, const void* Values, size_t Count)
+		packs a run of 16-bit or 32-bit values into a stream in one pass
 
 Aug 27, 2002 (Alexander Strange):
 	Moved functions to Packing.cpp to get around inlining issues.
@@ -73,11 +82,19 @@ Aug 27, 2002 (Alexander Strange):
 #ifdef PACKED_DATA_IS_BIG_ENDIAN
 #define StreamToValue StreamToValueBE
 #define ValueToStream ValueToStreamBE
+#define StreamToValues16 StreamToValues16BE
+#define StreamToValues32 StreamToValues32BE
+#define Values16ToStream Values16ToStreamBE
+#define Values32ToStream Values32ToStreamBE
 #endif
 
 #ifdef PACKED_DATA_IS_LITTLE_ENDIAN
 #define StreamToValue StreamToValueLE
 #define ValueToStream ValueToStreamLE
+#define StreamToValues16 StreamToValues16LE
+#define StreamToValues32 StreamToValues32LE
+#define Values16ToStream Values16ToStreamLE
+#define Values32ToStream Values32ToStreamLE
 #endif
 
 extern void StreamToValue(uint8* &Stream, uint16 &Value);
@@ -89,6 +106,11 @@ extern void ValueToStream(uint8* &Stream, int16 Value);
 extern void ValueToStream(uint8* &Stream, uint32 Value);
 extern void ValueToStream(uint8* &Stream, int32 Value);
 
+extern void StreamToValues16(uint8* &Stream, void* Values, size_t Count);
+extern void StreamToValues32(uint8* &Stream, void* Values, size_t Count);
+extern void Values16ToStream(uint8* &Stream, const void* Values, size_t Count);
+extern void Values32ToStream(uint8* &Stream, const void* Values, size_t Count);
+
 #ifndef PACKING_INTERNAL
 template<class T> inline static void StreamToList(uint8* &Stream, T* List, size_t Count)
 {
@@ -0,0 +1,267 @@
+#ifndef _PACKING_SCHEMA_
+#define _PACKING_SCHEMA_
+
+/*
+	Copyright (C) 2026 and beyond by the "Aleph One" developers.
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This license is contained in the file "COPYING",
+	which is included with this source code; it is available online at
+	http://www.gnu.org/licenses/gpl.html
+
+	Table-driven packing of fixed-size records
+
+	A record's packed layout is written once, as a table of fields in stream
+	order, instead of as a pair of hand-written packing and unpacking loops:
+
+		static constexpr packed_field endpoint_fields[] = {
+			PACKED_FIELD(endpoint_data, flags),
+			...
+			PACKED_FIELD(endpoint_data, vertex.x),
+			...
+			PACKED_PADDING(2*2)
+		};
+		DEFINE_PACKING_SCHEMA(endpoint_schema, endpoint_data, endpoint_fields, SIZEOF_endpoint_data);
+
+	Members of nested structures and elements of arrays of structures are
+	named with the usual member designators (vertex.x, damage_taken[1].kills);
+	a sub-record is written out field by field, with a macro when it repeats.
+
+	Everything is worked out at compile time. The table must add up to the
+	packed size, or the schema doesn't compile. Fields that are the same width
+	and adjacent both in the stream and in memory are merged into runs, which
+	are converted a run at a time with StreamToValues16() and friends. A record
+	whose memory layout matches its packed layout is converted as one run
+	across the whole array.
+
+	Padding is skipped in both directions, as the hand-written routines did.
+	Include this after Packing.h's endianness has been chosen.
+*/
+
+#include "cstypes.h"
+#include "Packing.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <type_traits>
+#include <utility>
+
+struct packed_field
+{
+	size_t offset;	// in the unpacked record
+	size_t width;	// of each value, in bytes; 0 for padding
+	size_t count;	// of values, or of padding bytes
+};
+
+template<class T> struct packed_field_traits
+{
+	static_assert(std::is_integral<T>::value, "packed fields must be integers or arrays of integers");
+	static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4, "packed fields must be 1, 2 or 4 bytes wide");
+	static const size_t width = sizeof(T);
+	static const size_t count = 1;
+};
+
+template<class T, size_t N> struct packed_field_traits<T[N]>
+{
+	static const size_t width = packed_field_traits<T>::width;
+	static const size_t count = N * packed_field_traits<T>::count;
+};
+
+#define PACKED_FIELD_TRAITS(record, member) \
+	packed_field_traits<typename std::remove_reference<decltype(std::declval<record&>().member)>::type>
+
+#define PACKED_FIELD(record, member) \
+	{ offsetof(record, member), PACKED_FIELD_TRAITS(record, member)::width, PACKED_FIELD_TRAITS(record, member)::count }
+
+#define PACKED_PADDING(bytes) \
+	{ 0, 0, (bytes) }
+
+// Compile-time walks over a field table; C++11 constexpr functions are single
+// expressions, so these recurse along the table
+
+constexpr size_t packed_field_size(const packed_field& field)
+{
+	return field.width ? field.width * field.count : field.count;
+}
+
+template<size_t N>
+constexpr size_t packed_fields_size(const packed_field (&fields)[N], size_t i = 0)
+{
+	return i < N ? packed_field_size(fields[i]) + packed_fields_size(fields, i + 1) : 0;
+}
+
+// whether field i extends the run that the field before it is in
+template<size_t N>
+constexpr bool packed_field_continues_run(const packed_field (&fields)[N], size_t i)
+{
+	return i > 0 && i < N &&
+		((fields[i].width == 0 && fields[i - 1].width == 0) ||
+		 (fields[i].width != 0 && fields[i].width == fields[i - 1].width &&
+		  fields[i].offset == fields[i - 1].offset + fields[i - 1].width * fields[i - 1].count));
+}
+
+template<size_t N>
+constexpr size_t packed_run_count(const packed_field (&fields)[N], size_t i = 0)
+{
+	return i < N ? (packed_field_continues_run(fields, i) ? 0 : 1) + packed_run_count(fields, i + 1) : 0;
+}
+
+// the field that run k starts with, looking from field i on
+template<size_t N>
+constexpr size_t packed_run_start(const packed_field (&fields)[N], size_t k, size_t i = 0)
+{
+	return i >= N ? N :
+		packed_field_continues_run(fields, i) ? packed_run_start(fields, k, i + 1) :
+		k == 0 ? i : packed_run_start(fields, k - 1, i + 1);
+}
+
+// values (or padding bytes) from field i to the end of its run
+template<size_t N>
+constexpr size_t packed_run_length(const packed_field (&fields)[N], size_t i)
+{
+	return fields[i].count + (packed_field_continues_run(fields, i + 1) ? packed_run_length(fields, i + 1) : 0);
+}
+
+template<size_t N>
+constexpr packed_field packed_run_from(const packed_field (&fields)[N], size_t i)
+{
+	return packed_field{ fields[i].offset, fields[i].width, packed_run_length(fields, i) };
+}
+
+template<size_t N>
+constexpr packed_field packed_run(const packed_field (&fields)[N], size_t k)
+{
+	return packed_run_from(fields, packed_run_start(fields, k));
+}
+
+template<size_t... I> struct packed_run_indices {};
+
+template<size_t N, size_t... I> struct make_packed_run_indices : make_packed_run_indices<N - 1, N - 1, I...> {};
+
+template<size_t... I> struct make_packed_run_indices<0, I...>
+{
+	typedef packed_run_indices<I...> type;
+};
+
+template<class Record, size_t RunCount> class packing_schema
+{
+public:
+	template<size_t N, size_t... I>
+	constexpr packing_schema(const packed_field (&fields)[N], size_t packed_size, packed_run_indices<I...>) :
+		runs_{ packed_run(fields, I)... },
+		packed_size_(packed_size),
+		whole_record_(RunCount == 1 && fields[0].width != 0 && fields[0].offset == 0 &&
+			sizeof(Record) == packed_size)
+	{
+	}
+
+	uint8* unpack(uint8* Stream, Record* Objects, size_t Count) const
+	{
+		uint8* S = Stream;
+		if (whole_record_)
+		{
+			unpack_run(S, Objects, runs_[0].width, runs_[0].count * Count);
+		}
+		else
+		{
+			for (size_t k = 0; k < Count; k++)
+			{
+				uint8* Object = reinterpret_cast<uint8*>(Objects + k);
+				for (size_t i = 0; i < RunCount; ++i)
+				{
+					const packed_field& run = runs_[i];
+					if (run.width == 0)
+						S += run.count;
+					else
+						unpack_run(S, Object + run.offset, run.width, run.count);
+				}
+			}
+		}
+
+		assert((S - Stream) == static_cast<ptrdiff_t>(Count*packed_size_));
+		return S;
+	}
+
+	uint8* pack(uint8* Stream, const Record* Objects, size_t Count) const
+	{
+		uint8* S = Stream;
+		if (whole_record_)
+		{
+			pack_run(S, Objects, runs_[0].width, runs_[0].count * Count);
+		}
+		else
+		{
+			for (size_t k = 0; k < Count; k++)
+			{
+				const uint8* Object = reinterpret_cast<const uint8*>(Objects + k);
+				for (size_t i = 0; i < RunCount; ++i)
+				{
+					const packed_field& run = runs_[i];
+					if (run.width == 0)
+						S += run.count;
+					else
+						pack_run(S, Object + run.offset, run.width, run.count);
+				}
+			}
+		}
+
+		assert((S - Stream) == static_cast<ptrdiff_t>(Count*packed_size_));
+		return S;
+	}
+
+private:
+	static void unpack_run(uint8* &S, void* Values, size_t width, size_t count)
+	{
+		switch (width)
+		{
+		case 1:
+			StreamToBytes(S, Values, count);
+			break;
+		case 2:
+			StreamToValues16(S, Values, count);
+			break;
+		case 4:
+			StreamToValues32(S, Values, count);
+			break;
+		}
+	}
+
+	static void pack_run(uint8* &S, const void* Values, size_t width, size_t count)
+	{
+		switch (width)
+		{
+		case 1:
+			BytesToStream(S, Values, count);
+			break;
+		case 2:
+			Values16ToStream(S, Values, count);
+			break;
+		case 4:
+			Values32ToStream(S, Values, count);
+			break;
+		}
+	}
+
+	packed_field runs_[RunCount];
+	size_t packed_size_;
+	bool whole_record_;
+};
+
+// Defines a constexpr schema for a field table, checking that the table adds up
+// to the record's packed size
+#define DEFINE_PACKING_SCHEMA(name, record, fields, packed_size) \
+	static_assert(packed_fields_size(fields) == size_t(packed_size), \
+		#fields " doesn't add up to " #packed_size); \
+	static constexpr packing_schema<record, packed_run_count(fields)> name{ \
+		fields, size_t(packed_size), make_packed_run_indices<packed_run_count(fields)>::type() }
+
+#endif
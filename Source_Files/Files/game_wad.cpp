@@ -125,6 +125,12 @@ Feb 15, 2002 (Br'fin (Jeremy Parsons)):
 // For packing and unpacking some of the stuff
 #include "Packing.h"
 
+#include "QuickSave.h"
+
+#include <atomic>
+#include <list>
+#include <SDL_thread.h>
+
 #include "motion_sensor.h"	// ZZZ for reset_motion_sensor()
 
 #include "Music.h"
@@ -1162,6 +1168,9 @@ bool load_game_from_file(FileSpecifier& File, bool run_scripts, bool *was_map_fo
 {
 	bool success= false;
 
+	/* the file might still be on its way to the disk */
+	wait_for_pending_saves();
+
 	ResetPassedLua();
 	
 	/* Setup for a revert.. */
@@ -1283,6 +1292,131 @@ bool revert_game(
 	return successful;
 }
 
+/* Like loading a saved game, but the scenario stays the film's own, and the
+	player indexes stay whatever the viewer picked; takes over data */
+bool restore_film_keyframe(
+	void *data)
+{
+	struct wad_header header;
+	struct wad_data *wad;
+	bool success= false;
+	std::vector<uint8> paths_state;
+
+	leaving_map();
+
+	wad= inflate_flat_data(data, &header);
+	if (wad)
+	{
+		success= process_map_wad(wad, true, header.data_version);
+
+		size_t length;
+		uint8 *paths_data= (uint8 *) extract_type_from_wad(wad, PATHS_STATE_TAG, &length);
+		if (paths_data) paths_state.assign(paths_data, paths_data+length);
+		free_wad(wad);
+	}
+	else
+	{
+		free(data);
+	}
+
+	/* entering_map() starts every monster's path over and draws random numbers,
+		as it should for a new level; a film has to go on exactly where it was */
+	struct monster_path_state
+	{
+		short path;
+		bool needs_path;
+	};
+	std::vector<monster_path_state> monster_paths;
+	int16 last_monster_index_to_build_path= 0, mangler_cookie= 0, vanishing_cookie= 0;
+	if (success)
+	{
+		monster_paths.resize(MAXIMUM_MONSTERS_PER_MAP);
+		for (short monster_index= 0; monster_index<MAXIMUM_MONSTERS_PER_MAP; ++monster_index)
+		{
+			monster_paths[monster_index].path= monsters[monster_index].path;
+			monster_paths[monster_index].needs_path= MONSTER_NEEDS_PATH(monsters+monster_index);
+		}
+		last_monster_index_to_build_path= dynamic_world->last_monster_index_to_build_path;
+		mangler_cookie= dynamic_world->new_monster_mangler_cookie;
+		vanishing_cookie= dynamic_world->new_monster_vanishing_cookie;
+	}
+
+	if (success)
+	{
+		short SavedType, SavedError = get_game_error(&SavedType);
+		RunLevelScript(dynamic_world->current_level_number);
+		RunScriptChunks();
+		if (dynamic_world->player_count == 1)
+		{
+			LoadSoloLua();
+		}
+		else
+		{
+			LoadReplayNetLua();
+		}
+		LoadStatsLua();
+		set_game_error(SavedType,SavedError);
+
+		set_random_seed(dynamic_world->random_seed);
+		reset_intermediate_action_queues();
+
+		Music::instance()->PreloadLevelMusic();
+		RunLuaScript();
+		success= entering_map(true /*restoring game*/);
+	}
+
+	if (success)
+	{
+		/* if the paths don't fit (the path limit changed), the monsters look for new ones */
+		if (!paths_state.empty() && unpack_paths_state(&paths_state[0], paths_state.size()))
+		{
+			for (short monster_index= 0; monster_index<MAXIMUM_MONSTERS_PER_MAP; ++monster_index)
+			{
+				monsters[monster_index].path= monster_paths[monster_index].path;
+				SET_MONSTER_NEEDS_PATH_STATUS(monsters+monster_index, monster_paths[monster_index].needs_path);
+			}
+			dynamic_world->last_monster_index_to_build_path= last_monster_index_to_build_path;
+		}
+		dynamic_world->new_monster_mangler_cookie= mangler_cookie;
+		dynamic_world->new_monster_vanishing_cookie= vanishing_cookie;
+		set_random_seed(dynamic_world->random_seed);
+	}
+
+	if (success)
+	{
+		update_interface(NONE);
+		ChaseCam_Reset();
+		ResetFieldOfView();
+		reset_messages();
+		ReloadViewContext();
+	}
+
+	return success;
+}
+
+bool restart_film_game(
+	short number_of_players,
+	struct game_data *game_information,
+	struct player_start_data *player_start_information,
+	struct entry_point *entry_point)
+{
+	bool success;
+
+	leaving_map();
+	success= new_game(number_of_players, false, game_information, player_start_information, entry_point);
+
+	if (success)
+	{
+		update_interface(NONE);
+		ChaseCam_Reset();
+		ResetFieldOfView();
+		reset_messages();
+		ReloadViewContext();
+	}
+
+	return success;
+}
+
 bool export_level(FileSpecifier& File)
 {
 	struct wad_header header;
@@ -1371,31 +1505,27 @@ void get_current_saved_game_name(FileSpecifier& File)
 	File = revert_game_data.SavedGame;
 }
 
-/* The current mapfile should be set to the save game file... */
-bool save_game_file(FileSpecifier& File, const std::string& metadata, const std::string& imagedata)
+/* Writes a packed game out through a temporary file, so that a failed save never
+	clobbers an existing one; returns zero or the error */
+static short write_save_game_file(
+	FileSpecifier& File,
+	struct wad_header& header,
+	struct wad_data *wad,
+	int32 wad_length,
+	const std::string& metadata,
+	const std::string& imagedata)
 {
-	struct wad_header header;
 	short err = 0;
 	bool success= false;
-	int32 offset, wad_length;
+	int32 offset;
 	struct directory_entry entries[2];
-	struct wad_data *wad, *meta_wad;
-
-	/* Save off the random seed. */
-	dynamic_world->random_seed= get_random_seed();
-
-	/* Setup to revert the game properly */
-	revert_game_data.game_is_from_disk= true;
-	revert_game_data.SavedGame = File;
+	struct wad_data *meta_wad;
 
 	// LP: add a file here; use temporary file for a safe save.
 	// Write into the temporary file first
 	FileSpecifier TempFile;
 	TempFile.SetTempName(File);
 	
-	/* Fill in the default wad header (we are using File instead of TempFile to get the name right in the header) */
-	fill_default_wad_header(File, CURRENT_WADFILE_VERSION, EDITOR_MAP_VERSION, 2, 0, &header);
-		
 	/* Assume that we confirmed on save as... */
 	if (create_wadfile(TempFile,_typecode_savegame))
 	{
@@ -1407,45 +1537,38 @@ bool save_game_file(FileSpecifier& File, const std::string& metadata, const std:
 			{
 				offset= SIZEOF_wad_header;
 		
-				wad= build_save_game_wad(&header, &wad_length);
-				if (wad)
+				/* Set the entry data.. */
+				set_indexed_directory_offset_and_length(&header, 
+					entries, 0, offset, wad_length, 0);
+				
+				/* Save it.. */
+				if (write_wad(SaveFile, &header, wad, offset))
 				{
-					/* Set the entry data.. */
-					set_indexed_directory_offset_and_length(&header, 
-						entries, 0, offset, wad_length, 0);
+					/* Update the new header */
+					offset+= wad_length;
+					header.directory_offset= offset;
 					
-					/* Save it.. */
-					if (write_wad(SaveFile, &header, wad, offset))
+					/* Create metadata wad */
+					meta_wad = build_meta_game_wad(metadata, imagedata, &header, &wad_length);
+					if (meta_wad)
 					{
-						/* Update the new header */
-						offset+= wad_length;
-						header.directory_offset= offset;
-						header.parent_checksum= read_wad_file_checksum(MapFileSpec);
+						set_indexed_directory_offset_and_length(&header,
+							entries, 1, offset, wad_length, SAVE_GAME_METADATA_INDEX);
 						
-						/* Create metadata wad */
-						meta_wad = build_meta_game_wad(metadata, imagedata, &header, &wad_length);
-						if (meta_wad)
+						if (write_wad(SaveFile, &header, meta_wad, offset))
 						{
-							set_indexed_directory_offset_and_length(&header,
-								entries, 1, offset, wad_length, SAVE_GAME_METADATA_INDEX);
-							
-							if (write_wad(SaveFile, &header, meta_wad, offset))
+							offset+= wad_length;
+							header.directory_offset= offset;
+					
+							if (write_wad_header(SaveFile, &header) && write_directorys(SaveFile, &header, entries))
 							{
-								offset+= wad_length;
-								header.directory_offset= offset;
-						
-								if (write_wad_header(SaveFile, &header) && write_directorys(SaveFile, &header, entries))
-								{
-									/* We win. */
-									success= true;
-								}
+								/* We win. */
+								success= true;
 							}
-							
-							free_wad(meta_wad);
 						}
+						
+						free_wad(meta_wad);
 					}
-
-					free_wad(wad);
 				}
 			}
 
@@ -1453,6 +1576,11 @@ bool save_game_file(FileSpecifier& File, const std::string& metadata, const std:
 			close_wad_file(SaveFile);
 		}
 		
+		if (!success && !err)
+		{
+			err = TempFile.GetError() ? TempFile.GetError() : 1;
+		}
+		
 		if (!err)
 		{
 			if (!TempFile.Rename(File))
@@ -1460,17 +1588,289 @@ bool save_game_file(FileSpecifier& File, const std::string& metadata, const std:
 				err = 1;
 			}
 		}
+		else
+		{
+			TempFile.Delete();
+		}
+	}
+	else
+	{
+		err = TempFile.GetError() ? TempFile.GetError() : 1;
 	}
+
+	return err;
+}
+
+/* Packs the world and sets up the header; this is the only part of saving that
+	has to happen on the game thread */
+static struct wad_data *snapshot_game(
+	FileSpecifier& File,
+	struct wad_header& header,
+	int32 *wad_length)
+{
+	/* Save off the random seed. */
+	dynamic_world->random_seed= get_random_seed();
+
+	/* Setup to revert the game properly */
+	revert_game_data.game_is_from_disk= true;
+	revert_game_data.SavedGame = File;
+
+	/* Fill in the default wad header (we are using File instead of TempFile to get the name right in the header) */
+	fill_default_wad_header(File, CURRENT_WADFILE_VERSION, EDITOR_MAP_VERSION, 2, 0, &header);
+	header.parent_checksum= read_wad_file_checksum(MapFileSpec);
 	
-	if(err || error_pending())
+	return build_save_game_wad(&header, wad_length);
+}
+
+/* The current mapfile should be set to the save game file... */
+bool save_game_file(FileSpecifier& File, const std::string& metadata, const std::string& imagedata)
+{
+	struct wad_header header;
+	short err = 0;
+	int32 wad_length;
+	struct wad_data *wad;
+
+	wait_for_pending_saves();
+
+	wad= snapshot_game(File, header, &wad_length);
+	if (wad)
+	{
+		err= write_save_game_file(File, header, wad, wad_length, metadata, imagedata);
+		free_wad(wad);
+	}
+	
+	if(err || !wad || error_pending())
 	{
 		if(!err) err= get_game_error(NULL);
 		alert_user(infoError, strERRORS, fileError, err);
 		clear_game_error();
-		success= false;
+		return false;
 	}
 	
-	return success;
+	return true;
+}
+
+/* -------- background saves */
+
+/* Past this many, starting another save waits for the oldest one to finish */
+#define MAXIMUM_PENDING_SAVES 2
+
+struct pending_save
+{
+	FileSpecifier File;
+	struct wad_header header;
+	struct wad_data *wad;
+	int32 wad_length;
+	std::string metadata;
+	SDL_Surface *preview;
+	
+	save_game_callback callback;
+	void *callback_data;
+
+	/* film keyframes are handed over instead of written to File */
+	film_keyframe_proc keyframe_proc;
+	film_keyframe_callback keyframe_callback;
+
+	SDL_Thread *thread;
+	std::atomic<bool> finished;
+	short err;
+};
+
+static std::list<pending_save *> pending_saves;
+
+static void finish_save(pending_save *save);
+
+static void make_room_for_pending_save(
+	void)
+{
+	while (pending_saves.size()>=MAXIMUM_PENDING_SAVES)
+	{
+		pending_save *oldest= pending_saves.front();
+		pending_saves.pop_front();
+		finish_save(oldest);
+	}
+}
+
+static int save_game_thread(
+	void *data)
+{
+	pending_save *save= static_cast<pending_save *>(data);
+	
+	if (save->keyframe_proc)
+	{
+		void *flat_data= flatten_wad(&save->header, save->wad);
+		save->keyframe_proc(flat_data, flat_data ? get_flat_data_length(flat_data) : 0, save->callback_data);
+		save->finished= true;
+		return 0;
+	}
+	
+	std::string imagedata;
+	if (save->preview)
+	{
+		encode_save_preview(save->preview, imagedata);
+	}
+	
+	save->err= write_save_game_file(save->File, save->header, save->wad, save->wad_length, save->metadata, imagedata);
+	
+	/* game errors are per thread, so this thread's only get out through save->err */
+	if (!save->err && error_pending()) save->err= get_game_error(NULL);
+	clear_game_error();
+	save->finished= true;
+
+	return 0;
+}
+
+static void finish_save(
+	pending_save *save)
+{
+	if (save->thread) SDL_WaitThread(save->thread, NULL);
+
+	free_wad(save->wad);
+	if (save->preview) SDL_FreeSurface(save->preview);
+
+	if (save->keyframe_callback)
+	{
+		save->keyframe_callback(save->callback_data);
+	}
+	else if (save->err)
+	{
+		alert_user(infoError, strERRORS, fileError, save->err);
+	}
+	
+	if (save->callback)
+	{
+		save->callback(save->File, !save->err, save->callback_data);
+	}
+	
+	delete save;
+}
+
+bool save_game_file_in_background(
+	FileSpecifier& File,
+	const std::string& metadata,
+	SDL_Surface *preview,
+	save_game_callback callback,
+	void *callback_data)
+{
+	make_room_for_pending_save();
+
+	/* two writes to the same file would race each other to the rename */
+	for (std::list<pending_save *>::iterator it= pending_saves.begin(); it!=pending_saves.end(); )
+	{
+		if ((*it)->File==File)
+		{
+			finish_save(*it);
+			it= pending_saves.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	pending_save *save= new pending_save;
+	save->File= File;
+	save->metadata= metadata;
+	save->preview= preview;
+	save->callback= callback;
+	save->callback_data= callback_data;
+	save->keyframe_proc= NULL;
+	save->keyframe_callback= NULL;
+	save->finished= false;
+	save->err= 0;
+	
+	save->wad= snapshot_game(File, save->header, &save->wad_length);
+	if (!save->wad)
+	{
+		alert_user(infoError, strERRORS, fileError, error_pending() ? get_game_error(NULL) : 1);
+		clear_game_error();
+		if (preview) SDL_FreeSurface(preview);
+		delete save;
+		return false;
+	}
+	
+	save->thread= SDL_CreateThread(save_game_thread, "save_game_file", save);
+	if (!save->thread)
+	{
+		/* no thread to be had; save right here instead */
+		save_game_thread(save);
+	}
+
+	pending_saves.push_back(save);
+	return true;
+}
+
+bool build_film_keyframe_in_background(
+	film_keyframe_proc process,
+	film_keyframe_callback finish,
+	void *keyframe_data)
+{
+	make_room_for_pending_save();
+
+	pending_save *save= new pending_save;
+	save->preview= NULL;
+	save->callback= NULL;
+	save->callback_data= keyframe_data;
+	save->keyframe_proc= process;
+	save->keyframe_callback= finish;
+	save->finished= false;
+	save->err= 0;
+
+	dynamic_world->random_seed= get_random_seed();
+
+	fill_default_wad_header(MapFileSpec, CURRENT_WADFILE_VERSION, EDITOR_MAP_VERSION, 1, 0, &save->header);
+	save->wad= build_save_game_wad(&save->header, &save->wad_length);
+	if (save->wad)
+	{
+		size_t size= get_paths_state_size();
+		uint8 *paths_state= new uint8[size];
+		pack_paths_state(paths_state);
+		save->wad= append_data_to_wad(save->wad, PATHS_STATE_TAG, paths_state, size, 0);
+		delete []paths_state;
+	}
+	if (!save->wad)
+	{
+		delete save;
+		return false;
+	}
+
+	save->thread= SDL_CreateThread(save_game_thread, "film_keyframe", save);
+	if (!save->thread)
+	{
+		save_game_thread(save);
+	}
+
+	pending_saves.push_back(save);
+	return true;
+}
+
+void process_finished_saves(
+	void)
+{
+	for (std::list<pending_save *>::iterator it= pending_saves.begin(); it!=pending_saves.end(); )
+	{
+		if ((*it)->finished)
+		{
+			pending_save *save= *it;
+			it= pending_saves.erase(it);
+			finish_save(save);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+void wait_for_pending_saves(
+	void)
+{
+	while (!pending_saves.empty())
+	{
+		pending_save *save= pending_saves.front();
+		pending_saves.pop_front();
+		finish_save(save);
+	}
 }
 
 /* -------- static functions */
@@ -1848,6 +2248,7 @@ bool process_map_wad(
 		vassert(count <= MAXIMUM_PROJECTILES_PER_MAP,
 			csprintf(temporary,"Number of projectiles %zu > limit %u",count,MAXIMUM_PROJECTILES_PER_MAP));
 		unpack_projectile_data(data,projectiles,count);
+		invalidate_slot_allocators();
 		
 		data= (uint8 *)extract_type_from_wad(wad, PLATFORM_STRUCTURE_TAG, &data_length);
 		count= data_length/SIZEOF_platform_data;
@@ -2364,6 +2765,7 @@ static uint8 *tag_to_global_array_and_size(
 			pack_polygon_data(array,map_polygons,count);
 			break;
 		case LIGHTSOURCE_TAG:
+			synchronize_light_phases();
 			pack_light_data(array,lights,count);
 			break;
 		case ANNOTATION_TAG:
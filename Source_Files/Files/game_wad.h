@@ -37,12 +37,37 @@ Aug 12, 2000 (Loren Petrich):
 #include <string>
 
 class FileSpecifier;
+struct SDL_Surface;
 
 bool save_game_file(FileSpecifier& File, const std::string& metadata, const std::string& imagedata);
+
+// Saves without stalling the game: the world is packed right away, and the preview
+// is encoded and the file written on another thread. Takes over preview, which may
+// be NULL. Errors are reported, and the callback (if any) run, from
+// process_finished_saves() or wait_for_pending_saves(), on the main thread.
+typedef void (*save_game_callback)(FileSpecifier& File, bool success, void *data);
+bool save_game_file_in_background(FileSpecifier& File, const std::string& metadata, SDL_Surface *preview,
+	save_game_callback callback, void *callback_data);
+void process_finished_saves(void);
+void wait_for_pending_saves(void);
 struct wad_data *build_meta_game_wad(const std::string& metadata, const std::string& imagedata, struct wad_header *header, int32 *length);
 
 bool export_level(FileSpecifier& File);
 
+// Film keyframes: the whole game state, in the save game format, plus the paths
+// the monsters are following. Like a background save, the world is packed right
+// away; on the save thread the keyframe is flattened and handed to process, which
+// takes the data over (NULL if there was no memory for it), and then finish runs
+// from process_finished_saves() or wait_for_pending_saves(), on the main thread.
+typedef void (*film_keyframe_proc)(void *data, int32 length, void *keyframe_data);
+typedef void (*film_keyframe_callback)(void *keyframe_data);
+bool build_film_keyframe_in_background(film_keyframe_proc process, film_keyframe_callback finish, void *keyframe_data);
+// restore takes the flat data over and replaces the running level
+bool restore_film_keyframe(void *data);
+// starts a film's game over from its first tick, as revert_game() does a recording's
+bool restart_film_game(short number_of_players, struct game_data *game_information,
+	struct player_start_data *player_start_information, struct entry_point *entry_point);
+
 /* -------------- New functions */
 void pause_game(void);
 void resume_game(void);
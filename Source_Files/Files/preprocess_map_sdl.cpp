@@ -120,6 +120,8 @@ bool get_default_theme_spec(FileSpecifier &file)
 
 bool choose_saved_game_to_load(FileSpecifier &saved_game)
 {
+	// list the save that's still being written, too
+	wait_for_pending_saves();
 	return load_quick_save_dialog(saved_game);
 }
 
@@ -131,11 +133,10 @@ bool choose_saved_game_to_load(FileSpecifier &saved_game)
 bool save_game(void)
 {
 	pause_game();
-    bool success = create_quick_save();
-    if (success)
-        screen_printf("Game saved");
-    else
-        screen_printf("Save failed");
+	// the outcome is reported when the write finishes
+	bool success = create_quick_save();
+	if (!success)
+		screen_printf("Save failed");
 	resume_game();
 
 	return success;
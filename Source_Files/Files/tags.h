@@ -146,6 +146,7 @@ void set_typecode(Typecode which, uint32 _type);
 #define WEAPON_STATE_TAG FOUR_CHARS_TO_INT('w','e','a','p')
 #define TERMINAL_STATE_TAG FOUR_CHARS_TO_INT('c','i','n','t')
 #define LUA_STATE_TAG FOUR_CHARS_TO_INT('s','l','u','a')
+#define PATHS_STATE_TAG FOUR_CHARS_TO_INT('p','a','t','h') // film keyframes only
 
 /* Save metadata tags */
 #define SAVE_META_TAG FOUR_CHARS_TO_INT('S', 'M', 'E', 'T')
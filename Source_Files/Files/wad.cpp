@@ -861,6 +861,48 @@ void *get_flat_data(
 	return data;
 }
 
+/* Flattens a wad that was built in memory, e.g. a save game wad */
+void *flatten_wad(
+	struct wad_header *header,
+	struct wad_data *wad)
+{
+	short entry_header_length= get_entry_header_length(header);
+	int32 length= calculate_wad_length(header, wad);
+	uint8 *data;
+
+	assert(entry_header_length==SIZEOF_entry_header);
+
+	data= (uint8 *)malloc(length+SIZEOF_encapsulated_wad_data);
+	if(data)
+	{
+		uint8 *S = data;
+		ValueToStream(S,uint32(CURRENT_FLAT_MAGIC_COOKIE));
+		ValueToStream(S,int32(length + SIZEOF_encapsulated_wad_data));
+		S = pack_wad_header(S,header,1);
+		assert((S - data) == SIZEOF_encapsulated_wad_data);
+
+		/* Same layout as write_wad() */
+		int32 running_offset= 0;
+		for(short index= 0; index<wad->tag_count; ++index)
+		{
+			struct entry_header entry;
+			entry.tag= wad->tag_data[index].tag;
+			entry.length= wad->tag_data[index].length;
+			entry.offset= 0;
+
+			running_offset+= entry.length+entry_header_length;
+			entry.next_offset= (index==wad->tag_count-1) ? 0 : running_offset;
+
+			S = pack_entry_header(S,&entry,1);
+			memcpy(S, wad->tag_data[index].data, entry.length);
+			S += entry.length;
+		}
+		assert((S - data) == length+SIZEOF_encapsulated_wad_data);
+	}
+
+	return data;
+}
+
 int32 get_flat_data_length(
 	void *data)
 {
@@ -189,6 +189,9 @@ bool find_file_with_modification_date(FileSpecifier& File,
 void *get_flat_data(FileSpecifier& File, bool use_union, short wad_index);
 int32 get_flat_data_length(void *data);
 
+/* Same format as get_flat_data(); the header must be for the current wadfile version */
+void *flatten_wad(struct wad_header *header, struct wad_data *wad);
+
 /* This is how you dispose of it-> you inflate it, then use free_wad() */
 struct wad_data *inflate_flat_data(void *data, struct wad_header *header);
 
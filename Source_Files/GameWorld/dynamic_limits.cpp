@@ -127,6 +127,7 @@ void parse_mml_dynamic_limits(const InfoTree& root)
 	ObjectList.resize(MAXIMUM_OBJECTS_PER_MAP);
 	MonsterList.resize(MAXIMUM_MONSTERS_PER_MAP);
 	ProjectileList.resize(MAXIMUM_PROJECTILES_PER_MAP);
+	invalidate_slot_allocators();
 
 	// Resize the array of paths also
 	allocate_pathfinding_memory();
@@ -43,6 +43,8 @@ Aug 30, 2000 (Loren Petrich):
 #include "lua_script.h"
 
 #include "Packing.h"
+#include "PackingSchema.h"
+#include "slot_allocator.h"
 
 /*
 ryan reports get_object_data() failing on effect->data after a teleport effect terminates
@@ -63,6 +65,8 @@ ryan reports get_object_data() failing on effect->data after a teleport effect t
 
 // struct effect_data *effects = NULL;
 
+static slot_allocator<effect_data> EffectSlots(EffectList);
+
 static effect_definition *get_effect_definition(const short type);
 
 /* ---------- code */
@@ -111,37 +115,35 @@ short new_effect(
 		}
 		else
 		{
-			for (effect_index= 0,effect= effects; effect_index<MAXIMUM_EFFECTS_PER_MAP; ++effect_index, ++effect)
+			effect_index= EffectSlots.find_free();
+			if (effect_index!=NONE)
 			{
-				if (SLOT_IS_FREE(effect))
+				effect= effects + effect_index;
+				
+				short object_index= new_map_object3d(origin, polygon_index, BUILD_DESCRIPTOR(definition->collection, definition->shape), facing);
+				
+				if (object_index!=NONE)
 				{
-					short object_index= new_map_object3d(origin, polygon_index, BUILD_DESCRIPTOR(definition->collection, definition->shape), facing);
+					struct object_data *object= get_object_data(object_index);
 					
-					if (object_index!=NONE)
-					{
-						struct object_data *object= get_object_data(object_index);
-						
-						effect->type= type;
-						effect->flags= 0;
-						effect->object_index= object_index;
-						effect->data= 0;
-						effect->delay= definition->delay ? global_random()%definition->delay : 0;
-						MARK_SLOT_AS_USED(effect);
-						
-						SET_OBJECT_OWNER(object, _object_is_effect);
-						object->sound_pitch= definition->sound_pitch;
-						if (effect->delay) SET_OBJECT_INVISIBILITY(object, true);
-						if (definition->flags&_media_effect) SET_OBJECT_IS_MEDIA_EFFECT(object);
-					}
-					else
-					{
-						effect_index= NONE;
-					}
+					effect->type= type;
+					effect->flags= 0;
+					effect->object_index= object_index;
+					effect->data= 0;
+					effect->delay= definition->delay ? global_random()%definition->delay : 0;
+					MARK_SLOT_AS_USED(effect);
+					EffectSlots.mark_used(effect_index);
 					
-					break;
+					SET_OBJECT_OWNER(object, _object_is_effect);
+					object->sound_pitch= definition->sound_pitch;
+					if (effect->delay) SET_OBJECT_INVISIBILITY(object, true);
+					if (definition->flags&_media_effect) SET_OBJECT_IS_MEDIA_EFFECT(object);
+				}
+				else
+				{
+					effect_index= NONE;
 				}
 			}
-			if (effect_index==MAXIMUM_EFFECTS_PER_MAP) effect_index= NONE;
 		}
 	}
 	
@@ -206,6 +208,7 @@ void remove_effect(
 	remove_map_object(effect->object_index);
 	L_Invalidate_Effect(effect_index);
 	MARK_SLOT_AS_FREE(effect);
+	EffectSlots.mark_free(effect_index);
 }
 
 void remove_all_nonpersistent_effects(
@@ -320,48 +323,27 @@ void teleport_object_in(
 /* ---------- private code */
 
 
-uint8 *unpack_effect_data(uint8 *Stream, effect_data* Objects, size_t Count)
-{
-	uint8* S = Stream;
-	effect_data* ObjPtr = Objects;
+static constexpr packed_field effect_fields[] = {
+	PACKED_FIELD(effect_data, type),
+	PACKED_FIELD(effect_data, object_index),
 	
-	for (size_t k = 0; k < Count; k++, ObjPtr++)
-	{
-		StreamToValue(S,ObjPtr->type);
-		StreamToValue(S,ObjPtr->object_index);
-		
-		StreamToValue(S,ObjPtr->flags);
-		
-		StreamToValue(S,ObjPtr->data);
-		StreamToValue(S,ObjPtr->delay);
-		
-		S += 11*2;
-	}
+	PACKED_FIELD(effect_data, flags),
 	
-	assert((S - Stream) == static_cast<ptrdiff_t>(Count*SIZEOF_effect_data));
-	return S;
+	PACKED_FIELD(effect_data, data),
+	PACKED_FIELD(effect_data, delay),
+	
+	PACKED_PADDING(11*2)
+};
+DEFINE_PACKING_SCHEMA(effect_schema, effect_data, effect_fields, SIZEOF_effect_data);
+
+uint8 *unpack_effect_data(uint8 *Stream, effect_data* Objects, size_t Count)
+{
+	return effect_schema.unpack(Stream, Objects, Count);
 }
 
 uint8 *pack_effect_data(uint8 *Stream, effect_data* Objects, size_t Count)
 {
-	uint8* S = Stream;
-	effect_data* ObjPtr = Objects;
-	
-	for (size_t k = 0; k < Count; k++, ObjPtr++)
-	{
-		ValueToStream(S,ObjPtr->type);
-		ValueToStream(S,ObjPtr->object_index);
-		
-		ValueToStream(S,ObjPtr->flags);
-		
-		ValueToStream(S,ObjPtr->data);
-		ValueToStream(S,ObjPtr->delay);
-		
-		S += 11*2;
-	}
-	
-	assert((S - Stream) == static_cast<ptrdiff_t>(Count*SIZEOF_effect_data));
-	return S;
+	return effect_schema.pack(Stream, Objects, Count);
 }
 
 
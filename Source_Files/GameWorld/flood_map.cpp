@@ -71,15 +71,21 @@ struct node_data /* 16 bytes */
 	int32 user_flags;
 };
 
+struct flood_map_state
+{
+	short node_count, last_node_index_expanded;
+	struct node_data *nodes;
+	short *visited_polygons; /* node index for each polygon, or UNVISITED */
+};
+
 /* ---------- globals */
 
-static short node_count= 0, last_node_index_expanded= NONE;
-static struct node_data *nodes = NULL;
-static short *visited_polygons = NULL;
+static struct flood_map_state default_state= {0, NONE, NULL, NULL};
 
 /* ---------- private prototypes */
 
-static void add_node(short parent_node_index, short polygon_index, short depth, int32 cost, int32 user_flags);
+static void allocate_flood_map_state(struct flood_map_state *state);
+static void add_node(struct flood_map_state *state, short parent_node_index, short polygon_index, short depth, int32 cost, int32 user_flags);
 
 /* ---------- code */
 
@@ -87,11 +93,30 @@ void allocate_flood_map_memory(
 	void)
 {
 	// Made reentrant because this must be called every time a map is loaded
-	if (nodes) delete []nodes;
-	nodes= new node_data[MAXIMUM_FLOOD_NODES];
-	if (visited_polygons) delete []visited_polygons;
-	visited_polygons= new short[MAXIMUM_POLYGONS_PER_MAP];
-	assert(nodes&&visited_polygons);
+	allocate_flood_map_state(&default_state);
+}
+
+struct flood_map_state *new_flood_map_state(
+	void)
+{
+	struct flood_map_state *state= new flood_map_state;
+
+	state->nodes= NULL;
+	state->visited_polygons= NULL;
+	allocate_flood_map_state(state);
+
+	return state;
+}
+
+void delete_flood_map_state(
+	struct flood_map_state *state)
+{
+	if (state)
+	{
+		delete []state->nodes;
+		delete []state->visited_polygons;
+		delete state;
+	}
 }
 
 /* returns next polygon index or NONE if there are no more polygons left cheaper than maximum_cost */
@@ -101,6 +126,17 @@ short flood_map(
 	cost_proc_ptr cost_proc,
 	short flood_mode,
 	void *caller_data)
+{
+	return flood_map(&default_state, first_polygon_index, maximum_cost, cost_proc, flood_mode, caller_data);
+}
+
+short flood_map(
+	struct flood_map_state *state,
+	short first_polygon_index,
+	int32 maximum_cost,
+	cost_proc_ptr cost_proc,
+	short flood_mode,
+	void *caller_data)
 {
 	short lowest_cost_node_index, node_index;
 	struct node_data *node;
@@ -110,12 +146,16 @@ short flood_map(
 	/* initialize ourselves if first_polygon_index!=NONE */
 	if (first_polygon_index!=NONE)
 	{
-		/* clear the visited polygon array */
-		objlist_set(visited_polygons, NONE, MAXIMUM_POLYGONS_PER_MAP);
+		/* clear the visited polygon array; only the last flood's polygons can be marked,
+			which is much cheaper than clearing the whole thing on big maps */
+		for (node_index= 0; node_index<state->node_count; ++node_index)
+		{
+			state->visited_polygons[state->nodes[node_index].polygon_index]= UNVISITED;
+		}
 		
-		node_count= 0;
-		last_node_index_expanded= NONE;
-		add_node(NONE, first_polygon_index, 0, 0, (flood_mode==_flagged_breadth_first) ? *((int32*)caller_data) : 0);
+		state->node_count= 0;
+		state->last_node_index_expanded= NONE;
+		add_node(state, NONE, first_polygon_index, 0, 0, (flood_mode==_flagged_breadth_first) ? *((int32*)caller_data) : 0);
 	}
 	
 	switch (flood_mode)
@@ -123,7 +163,7 @@ short flood_map(
 		case _best_first:
 			/* find the unexpanded node with the lowest cost */
 			lowest_cost= maximum_cost, lowest_cost_node_index= NONE;
-			for (node= nodes, node_index= 0; node_index<node_count; ++node_index, ++node)
+			for (node= state->nodes, node_index= 0; node_index<state->node_count; ++node_index, ++node)
 			{
 				if (NODE_IS_UNEXPANDED(node)&&node->cost<lowest_cost)
 				{
@@ -136,12 +176,12 @@ short flood_map(
 		case _breadth_first:
 		case _flagged_breadth_first:
 			/* find the next unexpanded node in the list under maximum_cost */
-			node_index= (last_node_index_expanded==NONE) ? 0 : (last_node_index_expanded+1);
-			for (node= nodes+node_index; node_index<node_count; ++node_index, ++node)
+			node_index= (state->last_node_index_expanded==NONE) ? 0 : (state->last_node_index_expanded+1);
+			for (node= state->nodes+node_index; node_index<state->node_count; ++node_index, ++node)
 			{
 				if (node->cost<maximum_cost) break;
 			}
-			if (node_index==node_count)
+			if (node_index==state->node_count)
 			{
 				lowest_cost_node_index= NONE;
 				lowest_cost= maximum_cost;
@@ -170,11 +210,11 @@ short flood_map(
 		short i;
 		
 		/* for flood_depth() and reverse_flood_map(), remember which node we successfully expanded last */
-		last_node_index_expanded= lowest_cost_node_index;
+		state->last_node_index_expanded= lowest_cost_node_index;
 
 		/* get pointer to lowest cost node */
-		assert(lowest_cost_node_index>=0&&lowest_cost_node_index<node_count);
-		node= nodes+lowest_cost_node_index;
+		assert(lowest_cost_node_index>=0&&lowest_cost_node_index<state->node_count);
+		node= state->nodes+lowest_cost_node_index;
 
 		polygon= get_polygon_data(node->polygon_index);
 		assert(!POLYGON_IS_DETACHED(polygon));
@@ -187,13 +227,13 @@ short flood_map(
 			short destination_polygon_index= polygon->adjacent_polygon_indexes[i];
 			
 			if (destination_polygon_index!=NONE &&
-				(maximum_cost!=INT32_MAX || visited_polygons[destination_polygon_index]==UNVISITED))
+				(maximum_cost!=INT32_MAX || state->visited_polygons[destination_polygon_index]==UNVISITED))
 			{
 				int32 new_user_flags= node->user_flags;
 				int32 cost= cost_proc ? cost_proc(node->polygon_index, polygon->line_indexes[i], destination_polygon_index, (flood_mode==_flagged_breadth_first) ? &new_user_flags : caller_data) : polygon->area;
 				
 				/* polygons with zero or negative costs are not added to the node list */
-				if (cost>0) add_node(lowest_cost_node_index, destination_polygon_index, node->depth+1, lowest_cost+cost, new_user_flags);
+				if (cost>0) add_node(state, lowest_cost_node_index, destination_polygon_index, node->depth+1, lowest_cost+cost, new_user_flags);
 			}
 		}
 		
@@ -215,16 +255,17 @@ short flood_map(
 short reverse_flood_map(
 	void)
 {
+	struct flood_map_state *state= &default_state;
 	short polygon_index= NONE;
 	
-	if (last_node_index_expanded!=NONE)
+	if (state->last_node_index_expanded!=NONE)
 	{
 		struct node_data *node;
 		
-		assert(last_node_index_expanded>=0&&last_node_index_expanded<node_count);
-		node= nodes+last_node_index_expanded;
+		assert(state->last_node_index_expanded>=0&&state->last_node_index_expanded<state->node_count);
+		node= state->nodes+state->last_node_index_expanded;
 
-		last_node_index_expanded= node->parent_node_index;
+		state->last_node_index_expanded= node->parent_node_index;
 		polygon_index= node->polygon_index;
 	}
 	
@@ -235,9 +276,10 @@ short reverse_flood_map(
 short flood_depth(
 	void)
 {
-	assert(last_node_index_expanded>=0&&last_node_index_expanded<node_count);
+	struct flood_map_state *state= &default_state;
+	assert(state->last_node_index_expanded>=0&&state->last_node_index_expanded<state->node_count);
 
-	return last_node_index_expanded==NONE ? 0 : nodes[last_node_index_expanded].depth;
+	return state->last_node_index_expanded==NONE ? 0 : state->nodes[state->last_node_index_expanded].depth;
 }
 
 #define MAXIMUM_BIASED_RETRIES 10
@@ -247,12 +289,13 @@ short flood_depth(
 void choose_random_flood_node(
 	world_vector2d *bias)
 {
+	struct flood_map_state *state= &default_state;
 	world_point2d origin;
 	
-	assert(node_count>=1);
-	find_center_of_polygon(nodes[0].polygon_index, &origin);
+	assert(state->node_count>=1);
+	find_center_of_polygon(state->nodes[0].polygon_index, &origin);
 	
-	if (node_count>1)
+	if (state->node_count>1)
 	{
 		bool suitable;
 		short retries= MAXIMUM_BIASED_RETRIES;
@@ -261,9 +304,9 @@ void choose_random_flood_node(
 		{
 			do
 			{
-				last_node_index_expanded= global_random()%node_count;
+				state->last_node_index_expanded= global_random()%state->node_count;
 			}
-			while (NODE_IS_UNEXPANDED(nodes+last_node_index_expanded));
+			while (NODE_IS_UNEXPANDED(state->nodes+state->last_node_index_expanded));
 
 			/* if we have no bias, this node is automatically suitable if it has been expanded;
 				if we have a bias, this node is only suitable if it is in the same general
@@ -271,7 +314,7 @@ void choose_random_flood_node(
 			suitable= true;
 			if (bias && (retries-= 1)>=0)
 			{
-				struct node_data *node= nodes+last_node_index_expanded;
+				struct node_data *node= state->nodes+state->last_node_index_expanded;
 				world_point2d destination;
 				
 				find_center_of_polygon(node->polygon_index, &destination);
@@ -284,43 +327,58 @@ void choose_random_flood_node(
 
 /* ---------- private code */
 
+static void allocate_flood_map_state(
+	struct flood_map_state *state)
+{
+	if (state->nodes) delete []state->nodes;
+	state->nodes= new node_data[MAXIMUM_FLOOD_NODES];
+	if (state->visited_polygons) delete []state->visited_polygons;
+	state->visited_polygons= new short[MAXIMUM_POLYGONS_PER_MAP];
+	assert(state->nodes&&state->visited_polygons);
+
+	objlist_set(state->visited_polygons, UNVISITED, MAXIMUM_POLYGONS_PER_MAP);
+	state->node_count= 0;
+	state->last_node_index_expanded= NONE;
+}
+
 /* checks to see if the given node is already in the node list */
 static void add_node(
+	struct flood_map_state *state,
 	short parent_node_index,
 	short polygon_index,
 	short depth,
 	int32 cost,
 	int32 user_flags)
 {
-	if (node_count<MAXIMUM_FLOOD_NODES)
+	if (state->node_count<MAXIMUM_FLOOD_NODES)
 	{
 		struct node_data *node;
 		short node_index;
 		
 		/* see if this polygon already exists in the node list anywhere */
 		assert(polygon_index>=0&&polygon_index<dynamic_world->polygon_count);
-		if ((node_index= visited_polygons[polygon_index])!=UNVISITED)
+		if ((node_index= state->visited_polygons[polygon_index])!=UNVISITED)
 		{
 			/* there is already a node referencing this polygon; if it has a higher cost
 				than the cost we are attempting to add, replace it (because we are doing
 				a best-first search, we are guarenteed never to find a better path to an
 				expanded node, and in fact if we find a path to a node we have already
 				expanded were backtracking and can ignore the node) */
-			assert(node_index>=0&&node_index<node_count);
-			node= nodes+node_index;
+			assert(node_index>=0&&node_index<state->node_count);
+			node= state->nodes+node_index;
 			if (NODE_IS_EXPANDED(node)||node->cost<=cost) node= (struct node_data *) NULL;
 		}
 		else
 		{
-			node_index= node_count;
-			node= nodes + node_index;
+			node_index= state->node_count;
+			node= state->nodes + node_index;
 		}
 		
 		if (node)
 		{
-			if (node_index==node_count)
+			if (node_index==state->node_count)
 			{
-				node_count+= 1;
+				state->node_count+= 1;
 			}
 			
 			node->flags= 0;
@@ -331,9 +389,9 @@ static void add_node(
 			node->user_flags= user_flags;
 			
 			assert(polygon_index>=0&&polygon_index<dynamic_world->polygon_count);
-			visited_polygons[polygon_index]= node_index;
+			state->visited_polygons[polygon_index]= node_index;
 			
-//			dprintf("added polygon #%d to node #%d (nodes=%p,visited=%p)", polygon_index, node_index, nodes, visited_polygons);
+//			dprintf("added polygon #%d to node #%d (nodes=%p,visited=%p)", polygon_index, node_index, state->nodes, state->visited_polygons);
 		}
 	}
 }
@@ -51,13 +51,25 @@ short new_path(world_point2d *source_point, short source_polygon_index,
 bool move_along_path(short path_index, world_point2d *p);
 void delete_path(short path_index);
 
+/* film keyframes carry the paths monsters are following, which saved games leave out */
+size_t get_paths_state_size(void);
+uint8 *pack_paths_state(uint8 *Stream);
+bool unpack_paths_state(uint8 *Stream, size_t length);
+
 /* ---------- prototypes/FLOOD_MAP.C */
 
 void allocate_flood_map_memory(void);
 
+/* an independent flood, for running floods on other threads; the functions without
+	a state all share one */
+struct flood_map_state;
+struct flood_map_state *new_flood_map_state(void);
+void delete_flood_map_state(struct flood_map_state *state);
+
 /* default cost_proc, NULL, is the area of the destination polygon and is significantly faster
 	than supplying a user procedure */
 short flood_map(short first_polygon_index, int32 maximum_cost, cost_proc_ptr cost_proc, short flood_mode, void *caller_data);
+short flood_map(struct flood_map_state *state, short first_polygon_index, int32 maximum_cost, cost_proc_ptr cost_proc, short flood_mode, void *caller_data);
 short reverse_flood_map(void);
 short flood_depth(void);
 
@@ -0,0 +1,345 @@
+/*
+	Copyright (C) 2026 and beyond by the "Aleph One" developers.
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This license is contained in the file "COPYING",
+	which is included with this source code; it is available online at
+	http://www.gnu.org/licenses/gpl.html
+
+	Display-rate interpolation between world ticks
+*/
+
+#include "cseries.h"
+#include "interpolated_world.h"
+
+#include "map.h"
+#include "player.h"
+#include "media.h"
+#include "lightsource.h"
+#include "ViewControl.h"
+#include "Movie.h"
+
+#include <vector>
+
+// Anything that moves farther than this in one tick teleported; don't slide it
+#define MAXIMUM_INTERPOLATED_DISTANCE WORLD_ONE
+
+// Light changes bigger than this per tick are flickers and strobes; keep them sharp
+#define MAXIMUM_INTERPOLATED_INTENSITY_CHANGE (FIXED_ONE/8)
+
+struct object_snapshot
+{
+	bool used;
+	int16 polygon;
+	world_point3d location;
+	angle facing;
+};
+
+struct player_snapshot
+{
+	int16 camera_polygon_index;
+	world_point3d camera_location;
+	angle facing, elevation;
+};
+
+struct polygon_snapshot
+{
+	world_distance floor_height, ceiling_height;
+};
+
+struct line_snapshot
+{
+	world_distance highest_adjacent_floor, lowest_adjacent_ceiling;
+};
+
+struct world_snapshot
+{
+	bool valid;
+	int32 tick_count;
+	int16 level_number;
+	uint32 time;
+
+	std::vector<object_snapshot> object_states;
+	std::vector<player_snapshot> player_states;
+	std::vector<polygon_snapshot> polygon_states;
+	std::vector<line_snapshot> line_states;
+	std::vector<world_distance> media_heights;
+	std::vector<_fixed> light_intensities;
+};
+
+// the last two updates; the world itself is always at the current one
+static world_snapshot previous_snapshot, current_snapshot;
+
+// the real values, while interpolated ones are in place
+static world_snapshot saved_world;
+static bool world_is_interpolated = false;
+
+static float last_drawn_fraction = -1;
+
+static void capture_world(world_snapshot& snapshot)
+{
+	snapshot.valid = true;
+	snapshot.tick_count = dynamic_world->tick_count;
+	snapshot.level_number = dynamic_world->current_level_number;
+	snapshot.time = machine_tick_count();
+
+	snapshot.object_states.resize(ObjectList.size());
+	for (size_t i = 0; i < ObjectList.size(); ++i)
+	{
+		object_data& object = ObjectList[i];
+		object_snapshot& s = snapshot.object_states[i];
+		s.used = SLOT_IS_USED(&object);
+		s.polygon = object.polygon;
+		s.location = object.location;
+		s.facing = object.facing;
+	}
+
+	snapshot.player_states.resize(dynamic_world->player_count);
+	for (int i = 0; i < dynamic_world->player_count; ++i)
+	{
+		player_data& player = players[i];
+		player_snapshot& s = snapshot.player_states[i];
+		s.camera_polygon_index = player.camera_polygon_index;
+		s.camera_location = player.camera_location;
+		s.facing = player.facing;
+		s.elevation = player.elevation;
+	}
+
+	snapshot.polygon_states.resize(dynamic_world->polygon_count);
+	for (int i = 0; i < dynamic_world->polygon_count; ++i)
+	{
+		snapshot.polygon_states[i].floor_height = map_polygons[i].floor_height;
+		snapshot.polygon_states[i].ceiling_height = map_polygons[i].ceiling_height;
+	}
+
+	snapshot.line_states.resize(dynamic_world->line_count);
+	for (int i = 0; i < dynamic_world->line_count; ++i)
+	{
+		snapshot.line_states[i].highest_adjacent_floor = map_lines[i].highest_adjacent_floor;
+		snapshot.line_states[i].lowest_adjacent_ceiling = map_lines[i].lowest_adjacent_ceiling;
+	}
+
+	snapshot.media_heights.resize(MediaList.size());
+	for (size_t i = 0; i < MediaList.size(); ++i)
+		snapshot.media_heights[i] = MediaList[i].height;
+
+	snapshot.light_intensities.resize(LightList.size());
+	for (size_t i = 0; i < LightList.size(); ++i)
+		snapshot.light_intensities[i] = LightList[i].intensity;
+}
+
+static void restore_world(const world_snapshot& snapshot)
+{
+	for (size_t i = 0; i < snapshot.object_states.size(); ++i)
+	{
+		ObjectList[i].location = snapshot.object_states[i].location;
+		ObjectList[i].facing = snapshot.object_states[i].facing;
+	}
+
+	for (size_t i = 0; i < snapshot.player_states.size(); ++i)
+	{
+		const player_snapshot& s = snapshot.player_states[i];
+		players[i].camera_polygon_index = s.camera_polygon_index;
+		players[i].camera_location = s.camera_location;
+		players[i].facing = s.facing;
+		players[i].elevation = s.elevation;
+	}
+
+	for (size_t i = 0; i < snapshot.polygon_states.size(); ++i)
+	{
+		map_polygons[i].floor_height = snapshot.polygon_states[i].floor_height;
+		map_polygons[i].ceiling_height = snapshot.polygon_states[i].ceiling_height;
+	}
+
+	for (size_t i = 0; i < snapshot.line_states.size(); ++i)
+	{
+		map_lines[i].highest_adjacent_floor = snapshot.line_states[i].highest_adjacent_floor;
+		map_lines[i].lowest_adjacent_ceiling = snapshot.line_states[i].lowest_adjacent_ceiling;
+	}
+
+	for (size_t i = 0; i < snapshot.media_heights.size(); ++i)
+		MediaList[i].height = snapshot.media_heights[i];
+
+	for (size_t i = 0; i < snapshot.light_intensities.size(); ++i)
+		LightList[i].intensity = snapshot.light_intensities[i];
+}
+
+static inline int16 lerp(int16 from, int16 to, float fraction)
+{
+	return static_cast<int16>(from + static_cast<int32>((to - from) * fraction));
+}
+
+static inline angle lerp_angle(angle from, angle to, float fraction)
+{
+	int16 delta = NORMALIZE_ANGLE(to - from);
+	if (delta >= HALF_CIRCLE) delta -= FULL_CIRCLE;
+	return NORMALIZE_ANGLE(from + static_cast<int16>(delta * fraction));
+}
+
+static bool close_enough(const world_point3d& a, const world_point3d& b)
+{
+	return ABS(a.x - b.x) <= MAXIMUM_INTERPOLATED_DISTANCE &&
+		ABS(a.y - b.y) <= MAXIMUM_INTERPOLATED_DISTANCE &&
+		ABS(a.z - b.z) <= MAXIMUM_INTERPOLATED_DISTANCE;
+}
+
+static inline world_point3d lerp_point(const world_point3d& from, const world_point3d& to, float fraction)
+{
+	world_point3d point;
+	point.x = lerp(from.x, to.x, fraction);
+	point.y = lerp(from.y, to.y, fraction);
+	point.z = lerp(from.z, to.z, fraction);
+	return point;
+}
+
+// How far from the previous update to the current one the next frame should be drawn
+static float heartbeat_fraction()
+{
+	float elapsed = static_cast<float>(machine_tick_count() - current_snapshot.time);
+	float fraction = elapsed * TICKS_PER_SECOND / MACHINE_TICKS_PER_SECOND;
+	return PIN(fraction, 0.0f, 1.0f);
+}
+
+void reset_interpolated_world()
+{
+	previous_snapshot.valid = false;
+	current_snapshot.valid = false;
+	last_drawn_fraction = -1;
+}
+
+void update_interpolated_world()
+{
+	assert(!world_is_interpolated);
+
+	if (!View_InterpolateWorld())
+	{
+		reset_interpolated_world();
+		return;
+	}
+
+	std::swap(previous_snapshot, current_snapshot);
+	capture_world(current_snapshot);
+	last_drawn_fraction = -1;
+
+	// a level change, a revert, or a long stall; start over from here
+	int32 ticks = current_snapshot.tick_count - previous_snapshot.tick_count;
+	if (!previous_snapshot.valid ||
+		previous_snapshot.level_number != current_snapshot.level_number ||
+		ticks < 0 || ticks > 2 ||
+		previous_snapshot.object_states.size() != current_snapshot.object_states.size() ||
+		previous_snapshot.player_states.size() != current_snapshot.player_states.size() ||
+		previous_snapshot.polygon_states.size() != current_snapshot.polygon_states.size() ||
+		previous_snapshot.line_states.size() != current_snapshot.line_states.size() ||
+		previous_snapshot.media_heights.size() != current_snapshot.media_heights.size() ||
+		previous_snapshot.light_intensities.size() != current_snapshot.light_intensities.size())
+	{
+		previous_snapshot.valid = false;
+	}
+}
+
+bool interpolated_world_is_active()
+{
+	// movies are recorded a tick at a time
+	return View_InterpolateWorld() && previous_snapshot.valid && current_snapshot.valid &&
+		!Movie::instance()->IsRecording();
+}
+
+bool interpolated_world_wants_frame()
+{
+	return interpolated_world_is_active() && heartbeat_fraction() != last_drawn_fraction;
+}
+
+void enter_interpolated_world()
+{
+	if (!interpolated_world_is_active() || world_is_interpolated)
+		return;
+
+	float fraction = heartbeat_fraction();
+	last_drawn_fraction = fraction;
+	if (fraction >= 1.0f)
+		return;
+
+	capture_world(saved_world);
+	world_is_interpolated = true;
+
+	const world_snapshot& from = previous_snapshot;
+	const world_snapshot& to = current_snapshot;
+
+	// objects that changed polygons stay where they are, since they are
+	// linked into their polygon's object list
+	for (size_t i = 0; i < to.object_states.size(); ++i)
+	{
+		const object_snapshot& a = from.object_states[i];
+		const object_snapshot& b = to.object_states[i];
+		if (!a.used || !b.used || a.polygon != b.polygon || !close_enough(a.location, b.location))
+			continue;
+
+		ObjectList[i].location = lerp_point(a.location, b.location, fraction);
+		ObjectList[i].facing = lerp_angle(a.facing, b.facing, fraction);
+	}
+
+	for (size_t i = 0; i < to.player_states.size(); ++i)
+	{
+		const player_snapshot& a = from.player_states[i];
+		const player_snapshot& b = to.player_states[i];
+		player_data& player = players[i];
+
+		player.facing = lerp_angle(a.facing, b.facing, fraction);
+		player.elevation = lerp_angle(a.elevation, b.elevation, fraction);
+
+		if (!close_enough(a.camera_location, b.camera_location))
+			continue;
+
+		// the view has to start inside its polygon
+		world_point3d location = lerp_point(a.camera_location, b.camera_location, fraction);
+		int16 polygon_index = b.camera_polygon_index;
+		if (a.camera_polygon_index != b.camera_polygon_index)
+			polygon_index = find_new_object_polygon((world_point2d *) &b.camera_location,
+				(world_point2d *) &location, b.camera_polygon_index);
+		if (polygon_index == NONE)
+			continue;
+
+		player.camera_location = location;
+		player.camera_polygon_index = polygon_index;
+	}
+
+	for (size_t i = 0; i < to.polygon_states.size(); ++i)
+	{
+		map_polygons[i].floor_height = lerp(from.polygon_states[i].floor_height, to.polygon_states[i].floor_height, fraction);
+		map_polygons[i].ceiling_height = lerp(from.polygon_states[i].ceiling_height, to.polygon_states[i].ceiling_height, fraction);
+	}
+
+	for (size_t i = 0; i < to.line_states.size(); ++i)
+	{
+		map_lines[i].highest_adjacent_floor = lerp(from.line_states[i].highest_adjacent_floor, to.line_states[i].highest_adjacent_floor, fraction);
+		map_lines[i].lowest_adjacent_ceiling = lerp(from.line_states[i].lowest_adjacent_ceiling, to.line_states[i].lowest_adjacent_ceiling, fraction);
+	}
+
+	for (size_t i = 0; i < to.media_heights.size(); ++i)
+		MediaList[i].height = lerp(from.media_heights[i], to.media_heights[i], fraction);
+
+	for (size_t i = 0; i < to.light_intensities.size(); ++i)
+	{
+		_fixed a = from.light_intensities[i], b = to.light_intensities[i];
+		if (ABS(b - a) <= MAXIMUM_INTERPOLATED_INTENSITY_CHANGE)
+			LightList[i].intensity = a + static_cast<_fixed>((b - a) * fraction);
+	}
+}
+
+void exit_interpolated_world()
+{
+	if (!world_is_interpolated)
+		return;
+
+	restore_world(saved_world);
+	world_is_interpolated = false;
+}
@@ -0,0 +1,48 @@
+#ifndef INTERPOLATED_WORLD_H
+#define INTERPOLATED_WORLD_H
+
+/*
+	Copyright (C) 2026 and beyond by the "Aleph One" developers.
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This license is contained in the file "COPYING",
+	which is included with this source code; it is available online at
+	http://www.gnu.org/licenses/gpl.html
+
+	Display-rate interpolation between world ticks
+
+	The world still advances 30 times a second. After each update, the
+	renderable state (view, object positions, platform and media heights,
+	light intensities) is snapshotted; frames drawn between updates show
+	the world part of the way from the previous snapshot to the current one.
+	The interpolated values are only in place between enter and exit, so
+	the simulation never sees them.
+*/
+
+// Snapshot the world; call after an update that advanced or predicted the world
+void update_interpolated_world();
+
+// Forget the snapshots, e.g. on entering a level
+void reset_interpolated_world();
+
+// Whether interpolation is on and there is anything to interpolate
+bool interpolated_world_is_active();
+
+// Whether the interpolated view would differ from the last one drawn
+bool interpolated_world_wants_frame();
+
+// Put interpolated values in place for drawing a frame, and put the real ones back;
+// the world must not be updated in between
+void enter_interpolated_world();
+void exit_interpolated_world();
+
+#endif
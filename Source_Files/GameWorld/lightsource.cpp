@@ -48,10 +48,16 @@ Jul 3, 2002 (Loren Petrich):
 #include "map.h"
 #include "lightsource.h"
 #include "Packing.h"
+#include "slot_allocator.h"
 
 //MH: Lua scripting
 #include "lua_script.h"
 
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <vector>
+
 /* ---------- globals */
 
 // Turned the list of lights into a variable array;
@@ -72,6 +78,9 @@ static struct lighting_function_specification *get_lighting_function_specificati
 static _fixed lighting_function_dispatch(short function_index, _fixed initial_intensity,
 	_fixed final_intensity, short phase, short period);
 
+static void validate_light_sleep();
+static void materialize_light_phase(size_t light_index);
+
 /* ---------- structures */
 
 struct light_definition
@@ -141,6 +150,32 @@ struct light_definition light_definitions[NUMBER_OF_LIGHT_TYPES]=
 static light_definition *get_light_definition(
 	const short type);
 
+/* ---------- sleeping lights */
+
+// A light holding a constant intensity has nothing to do until its period runs
+// out, so instead of counting its phase up every tick it sleeps until the update
+// in which its state would change; its phase is worked out from the update count
+// whenever anyone needs it. Awake lights are still updated in index order, so
+// global_random() is drawn exactly as before.
+
+struct light_sleep_data
+{
+	int32 sleep_tick;	// the first update slept through, or NONE
+	int32 wake_tick;	// the update in which the state changes
+	int16 sleep_phase;	// the phase before sleep_tick
+	bool listed;		// in awake_lights or woken_lights
+};
+
+typedef std::pair<int32, int16> light_alarm;
+typedef std::priority_queue<light_alarm, std::vector<light_alarm>, std::greater<light_alarm> > light_alarm_queue;
+
+static std::vector<light_sleep_data> light_sleep;
+static std::vector<int16> awake_lights, woken_lights;
+static light_alarm_queue light_alarms;
+static int32 light_update_count = 0;
+static uint32 light_sleep_generation = 0;
+static bool light_sleep_valid = false;
+
 /* ---------- code */
 
 
@@ -210,22 +245,121 @@ struct static_light_data *get_defaults_for_light_type(
 void update_lights(
 	void)
 {
-	int light_index;
-	struct light_data *light;
-	
-	for (light_index= 0, light= lights; light_index<short(MAXIMUM_LIGHTS_PER_MAP); ++light_index, ++light)
+	validate_light_sleep();
+
+	/* wake the lights whose state changes this update */
+	while (!light_alarms.empty() && light_alarms.top().first<=light_update_count)
+	{
+		light_alarm alarm= light_alarms.top();
+		light_alarms.pop();
+
+		light_sleep_data& sleep= light_sleep[alarm.second];
+		if (sleep.sleep_tick!=NONE && sleep.wake_tick==alarm.first)
+		{
+			materialize_light_phase(alarm.second);
+			sleep.listed= true;
+			woken_lights.push_back(alarm.second);
+		}
+	}
+	if (!woken_lights.empty())
+	{
+		awake_lights.insert(awake_lights.end(), woken_lights.begin(), woken_lights.end());
+		woken_lights.clear();
+		std::sort(awake_lights.begin(), awake_lights.end());
+	}
+
+	size_t still_awake= 0;
+	for (size_t i= 0; i<awake_lights.size(); ++i)
 	{
+		short light_index= awake_lights[i];
+		struct light_data *light= lights + light_index;
+		light_sleep_data& sleep= light_sleep[light_index];
+
 		if (SLOT_IS_USED(light))
 		{
 			/* update light phase; if weve overflowed our period change to the next state */
 			light->phase+= 1;
 			rephase_light(light_index);
-			
+
 			/* calculate and remember intensity for this ii, fi, phase, period */
-			light->intensity= lighting_function_dispatch(get_lighting_function_specification(&light->static_data, light->state)->function,
+			short function= get_lighting_function_specification(&light->static_data, light->state)->function;
+			light->intensity= lighting_function_dispatch(function,
 				light->initial_intensity, light->final_intensity, light->phase, light->period);
+
+			/* nothing changes until the update that overflows the period */
+			int32 idle_updates= light->period - light->phase - 1;
+			if (function==_constant_lighting_function && idle_updates>0)
+			{
+				sleep.listed= false;
+				sleep.sleep_tick= light_update_count + 1;
+				sleep.sleep_phase= light->phase;
+				sleep.wake_tick= sleep.sleep_tick + idle_updates;
+				light_alarms.push(light_alarm(sleep.wake_tick, light_index));
+				continue;
+			}
+
+			awake_lights[still_awake++]= light_index;
+		}
+		else
+		{
+			sleep.listed= false;
 		}
 	}
+	awake_lights.resize(still_awake);
+
+	light_update_count+= 1;
+}
+
+static bool light_sleep_is_current(
+	void)
+{
+	return light_sleep_valid && light_sleep_generation==slot_allocator_generation &&
+		light_sleep.size()==MAXIMUM_LIGHTS_PER_MAP;
+}
+
+void wake_light(
+	size_t light_index)
+{
+	// an out-of-date list is rebuilt with every light awake on the next update
+	if (!light_sleep_is_current() || light_index>=light_sleep.size()) return;
+
+	light_sleep_data& sleep= light_sleep[light_index];
+	if (sleep.listed) return;
+
+	materialize_light_phase(light_index);
+	sleep.listed= true;
+	woken_lights.push_back(static_cast<int16>(light_index));
+}
+
+/* bring sleeping lights' phases up to date, e.g. before saving them */
+void synchronize_light_phases(
+	void)
+{
+	if (!light_sleep_is_current()) return;
+
+	for (size_t light_index= 0; light_index<light_sleep.size(); ++light_index)
+	{
+		light_sleep_data& sleep= light_sleep[light_index];
+		if (sleep.sleep_tick!=NONE)
+		{
+			/* still the same sleep, so the media lit by it needn't notice */
+			int32 sleep_tick= sleep.sleep_tick;
+			int16 sleep_phase= sleep.sleep_phase;
+			materialize_light_phase(light_index);
+			sleep.sleep_tick= sleep_tick;
+			sleep.sleep_phase= sleep_phase;
+		}
+	}
+}
+
+/* the update a light fell asleep before, which stays the same until it wakes;
+	NONE if it is awake */
+int32 get_light_sleep_episode(
+	size_t light_index)
+{
+	if (!light_sleep_is_current() || light_index>=light_sleep.size()) return NONE;
+
+	return light_sleep[light_index].sleep_tick;
 }
 
 bool get_light_status(
@@ -333,7 +467,8 @@ void change_light_state(
 	// LP change: idiot-proofing
 	if (!light) return;
 	struct lighting_function_specification *function= get_lighting_function_specification(&light->static_data, new_state);
-	
+
+	wake_light(light_index);
 	light->phase= 0;
 	light->period= function->period + global_random()%(function->delta_period+1);
 	
@@ -392,7 +527,49 @@ static void rephase_light(
 	}
 	light->phase= phase;
 }
-				
+
+static void materialize_light_phase(
+	size_t light_index)
+{
+	light_sleep_data& sleep= light_sleep[light_index];
+	if (sleep.sleep_tick==NONE) return;
+
+	lights[light_index].phase= sleep.sleep_phase + (light_update_count - sleep.sleep_tick);
+	sleep.sleep_tick= NONE;
+}
+
+static void validate_light_sleep(
+	void)
+{
+	if (light_sleep_is_current()) return;
+
+	if (light_sleep_valid && light_sleep_generation==slot_allocator_generation)
+	{
+		/* Lua added a light; the others are still where they were */
+		for (size_t light_index= 0; light_index<light_sleep.size(); ++light_index)
+			materialize_light_phase(light_index);
+	}
+
+	/* otherwise a new level or a loaded game replaced the lights; either way start with all of them awake */
+	light_sleep_data awake= { NONE, 0, 0, false };
+	light_sleep.assign(MAXIMUM_LIGHTS_PER_MAP, awake);
+	awake_lights.clear();
+	woken_lights.clear();
+	light_alarms= light_alarm_queue();
+
+	for (size_t light_index= 0; light_index<MAXIMUM_LIGHTS_PER_MAP; ++light_index)
+	{
+		if (SLOT_IS_USED(lights + light_index))
+		{
+			light_sleep[light_index].listed= true;
+			awake_lights.push_back(static_cast<int16>(light_index));
+		}
+	}
+
+	light_sleep_generation= slot_allocator_generation;
+	light_sleep_valid= true;
+}
+
 /* ---------- lighting functions */
 
 static _fixed constant_lighting_proc(_fixed initial_intensity, _fixed final_intensity, short phase, short period);
@@ -190,6 +190,11 @@ bool set_tagged_light_statuses(short tag, bool new_status);
 
 _fixed get_light_intensity(size_t light_index);
 
+// Lights holding a constant intensity sleep until their state changes (see lightsource.cpp)
+void wake_light(size_t light_index);
+void synchronize_light_phases(void);
+int32 get_light_sleep_episode(size_t light_index);
+
 light_data *get_light_data(
 	const size_t light_index);
 
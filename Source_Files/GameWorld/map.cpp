@@ -117,11 +117,13 @@ find_line_crossed leaving polygon could be sped up considerable by reversing the
 #include "SoundManager.h"
 #include "Console.h"
 #include "InfoTree.h"
+#include "slot_allocator.h"
 
 #include <string.h>
 #include <stdlib.h>
 #include <limits.h>
 
+#include <algorithm>
 #include <list>
 
 /* ---------- structures */
@@ -184,6 +186,22 @@ vector<effect_data> EffectList(MAXIMUM_EFFECTS_PER_MAP);
 vector<object_data> ObjectList(MAXIMUM_OBJECTS_PER_MAP);
 vector<monster_data> MonsterList(MAXIMUM_MONSTERS_PER_MAP);
 vector<projectile_data> ProjectileList(MAXIMUM_PROJECTILES_PER_MAP);
+
+uint32 slot_allocator_generation = 0;
+static slot_allocator<object_data> ObjectSlots(ObjectList);
+
+// Each polygon's possibly-solid objects, so collision checks in a crowded polygon
+// don't walk past all of its projectiles, effects and items; rebuilt whenever the
+// polygon's object list changes
+struct polygon_solid_objects
+{
+	bool valid;
+	vector<short> object_indexes;
+};
+static vector<polygon_solid_objects> PolygonSolidObjects;
+static uint32 solid_object_generation = 0;
+
+static void polygon_object_list_changed(short polygon_index);
 // struct object_data *objects = NULL;
 // struct monster_data *monsters = NULL;
 // struct projectile_data *projectiles = NULL;
@@ -420,6 +438,7 @@ void initialize_map_for_new_level(
 	objlist_clear(projectiles,  ProjectileList.size());
 	objlist_clear(monsters,  MonsterList.size());
 	objlist_clear(objects,  ObjectList.size());
+	invalidate_slot_allocators();
 
 	/* Note that these pointers just point into a larger structure, so this is not a bad thing */
 	// map_polygons= NULL;
@@ -651,6 +670,8 @@ void reconnect_map_object_list(
 			polygon->first_object= i;
 		}
 	}
+	
+	PolygonSolidObjects.clear();
 }
 
 bool valid_point2d(
@@ -736,6 +757,7 @@ short new_map_object3d(
 		/* insert at head of linked list */
 		object->next_object= polygon->first_object;
 		polygon->first_object= object_index;
+		polygon_object_list_changed(polygon_index);
 	}
 	
 	return object_index;
@@ -801,6 +823,7 @@ void remove_parasitic_object(
 	struct object_data *host= get_object_data(host_index);
 	struct object_data *parasite= get_object_data(host->parasitic_object);
 
+	ObjectSlots.mark_free(host->parasitic_object);
 	host->parasitic_object= NONE;
 	MARK_SLOT_AS_FREE(parasite);
 }
@@ -821,12 +844,15 @@ void remove_map_object(
 		struct object_data *parasite= get_object_data(object->parasitic_object);
 		
 		MARK_SLOT_AS_FREE(parasite);
+		ObjectSlots.mark_free(object->parasitic_object);
 	}
 
 	SoundManager::instance()->OrphanSound(object_index);
 	L_Invalidate_Object(object_index);
 	*next_object= object->next_object;
+	polygon_object_list_changed(object->polygon);
 	MARK_SLOT_AS_FREE(object);
+	ObjectSlots.mark_free(object_index);
 }
 
 
@@ -849,6 +875,7 @@ remove_object_from_polygon_object_list(short object_index, short polygon_index)
 	}
 
 	*next_object= object->next_object;
+	polygon_object_list_changed(polygon_index);
 
 	object->polygon= NONE;
 }
@@ -870,10 +897,57 @@ add_object_to_polygon_object_list(short object_index, short polygon_index)
 
 	object->next_object= polygon->first_object;
 	polygon->first_object= object_index;
+	polygon_object_list_changed(polygon_index);
 
 	object->polygon= polygon_index;
 }
 
+static void polygon_object_list_changed(short polygon_index)
+{
+	if (polygon_index>=0 && static_cast<size_t>(polygon_index)<PolygonSolidObjects.size())
+		PolygonSolidObjects[polygon_index].valid= false;
+}
+
+const vector<short>& get_polygon_solid_object_candidates(short polygon_index)
+{
+	if (solid_object_generation!=slot_allocator_generation ||
+		PolygonSolidObjects.size()!=static_cast<size_t>(dynamic_world->polygon_count))
+	{
+		PolygonSolidObjects.clear();
+		PolygonSolidObjects.resize(dynamic_world->polygon_count);
+		solid_object_generation= slot_allocator_generation;
+	}
+	
+	polygon_solid_objects& solid_objects= PolygonSolidObjects[polygon_index];
+	if (!solid_objects.valid)
+	{
+		/* an object's owner is set once, just after it's created, so anything else never
+			becomes a monster or scenery while it stays in this list */
+		solid_objects.object_indexes.clear();
+		for (short object_index= get_polygon_data(polygon_index)->first_object; object_index!=NONE; )
+		{
+			struct object_data *object= get_object_data(object_index);
+			
+			switch (GET_OBJECT_OWNER(object))
+			{
+				case _object_is_projectile:
+				case _object_is_effect:
+				case _object_is_item:
+				case _object_is_garbage:
+					break;
+				
+				default:
+					solid_objects.object_indexes.push_back(object_index);
+					break;
+			}
+			object_index= object->next_object;
+		}
+		solid_objects.valid= true;
+	}
+	
+	return solid_objects.object_indexes;
+}
+
 typedef std::pair<short, short>	DeferredObjectListInsertion;
 typedef std::list<DeferredObjectListInsertion> DeferredObjectListInsertionList;
 static DeferredObjectListInsertionList sDeferredObjectListInsertions;
@@ -912,6 +986,7 @@ perform_deferred_polygon_object_list_manipulations()
 				{
 					object->next_object = *next_object_index_p;
 					*next_object_index_p = object_to_insert_index;
+					polygon_object_list_changed(object->polygon);
 					inserted = true;
 				}
 
@@ -2239,6 +2314,114 @@ bool line_is_obstructed(
 	return obstructed;
 }
 
+/* ---------- spatial queries */
+
+/* whether the polygon's bounding box comes within radius of the center; a box rather than the
+	polygon itself keeps the test in integers, so every machine finds the same polygons */
+static bool polygon_is_within_radius(
+	short polygon_index,
+	world_point2d *center,
+	int32 radius)
+{
+	struct polygon_data *polygon= get_polygon_data(polygon_index);
+	int32 x0= INT32_MAX, y0= INT32_MAX, x1= INT32_MIN, y1= INT32_MIN;
+
+	for (short i= 0; i<polygon->vertex_count; ++i)
+	{
+		world_point2d *vertex= &get_endpoint_data(polygon->endpoint_indexes[i])->vertex;
+		x0= MIN(x0, vertex->x);
+		x1= MAX(x1, vertex->x);
+		y0= MIN(y0, vertex->y);
+		y1= MAX(y1, vertex->y);
+	}
+
+	Sint64 dx= center->x<x0 ? x0-center->x : (center->x>x1 ? center->x-x1 : 0);
+	Sint64 dy= center->y<y0 ? y0-center->y : (center->y>y1 ? center->y-y1 : 0);
+	return dx*dx + dy*dy <= Sint64(radius)*radius;
+}
+
+/* the polygons reachable from polygon_index without leaving the circle, breadth first */
+void find_polygons_within_radius(
+	short polygon_index,
+	world_point2d *center,
+	int32 radius,
+	vector<short>& polygons)
+{
+	static vector<bool> visited;
+	if (visited.size()!=PolygonList.size()) visited.assign(PolygonList.size(), false);
+
+	polygons.clear();
+	polygons.push_back(polygon_index);
+	visited[polygon_index]= true;
+	for (size_t i= 0; i<polygons.size(); ++i)
+	{
+		struct polygon_data *polygon= get_polygon_data(polygons[i]);
+
+		for (short j= 0; j<polygon->vertex_count; ++j)
+		{
+			short adjacent_polygon_index= polygon->adjacent_polygon_indexes[j];
+
+			if (adjacent_polygon_index!=NONE && !visited[adjacent_polygon_index] &&
+				polygon_is_within_radius(adjacent_polygon_index, center, radius))
+			{
+				visited[adjacent_polygon_index]= true;
+				polygons.push_back(adjacent_polygon_index);
+			}
+		}
+	}
+
+	for (size_t i= 0; i<polygons.size(); ++i) visited[polygons[i]]= false;
+}
+
+/* objects with the given owner (any, if NONE) in those polygons and within radius of the center,
+	nearest first and then by index, so that every player gets the same list; if unobstructed,
+	only those with a clear line from the center */
+void find_objects_within_radius(
+	short polygon_index,
+	world_point3d *center,
+	int32 radius,
+	short owner,
+	bool unobstructed,
+	vector<short>& object_indexes)
+{
+	static vector<short> polygons;
+	static vector<std::pair<Sint64, short> > found;
+	Sint64 radius_squared= Sint64(radius)*radius;
+
+	find_polygons_within_radius(polygon_index, (world_point2d *) center, radius, polygons);
+
+	found.clear();
+	for (size_t i= 0; i<polygons.size(); ++i)
+	{
+		short object_index= get_polygon_data(polygons[i])->first_object;
+
+		while (object_index!=NONE)
+		{
+			struct object_data *object= get_object_data(object_index);
+
+			if (owner==NONE || GET_OBJECT_OWNER(object)==owner)
+			{
+				Sint64 dx= object->location.x - center->x;
+				Sint64 dy= object->location.y - center->y;
+				Sint64 dz= object->location.z - center->z;
+				Sint64 distance_squared= dx*dx + dy*dy + dz*dz;
+
+				if (distance_squared<=radius_squared && (!unobstructed ||
+					!line_is_obstructed(polygon_index, (world_point2d *) center, object->polygon, (world_point2d *) &object->location)))
+				{
+					found.push_back(std::make_pair(distance_squared, object_index));
+				}
+			}
+
+			object_index= object->next_object;
+		}
+	}
+
+	std::sort(found.begin(), found.end());
+	object_indexes.clear();
+	for (size_t i= 0; i<found.size(); ++i) object_indexes.push_back(found[i].second);
+}
+
 #define MAXIMUM_GARBAGE_OBJECTS_PER_MAP 256
 #define MAXIMUM_GARBAGE_OBJECTS_PER_POLYGON 10
 
@@ -2360,6 +2543,11 @@ short _find_line_crossed_leaving_polygon(
 	return intersected_line_index;
 }
 
+void invalidate_slot_allocators()
+{
+	++slot_allocator_generation;
+}
+
 static short _new_map_object(
 	shape_descriptor shape,
 	angle facing)
@@ -2367,36 +2555,34 @@ static short _new_map_object(
 	struct object_data *object;
 	short object_index;
 	
-	for (object_index=0,object=objects;object_index<MAXIMUM_OBJECTS_PER_MAP;++object_index,++object)
+	object_index= ObjectSlots.find_free();
+	if (object_index!=NONE)
 	{
-		if (SLOT_IS_FREE(object))
-		{
-			/* initialize the object_data structure.  the defaults result in a normal (i.e., scenery),
-				non-solid object.  the rendered, animated and status flags are initially clear. */
-			object->polygon= NONE;
-			object->shape= shape;
-			object->facing= facing;
-			object->transfer_mode= NONE;
-			object->transfer_phase= 0;
-			object->permutation= 0;
-			object->sequence= 0;
-			object->flags= 0;
-			object->next_object= NONE;
-			object->parasitic_object= NONE;
-			object->sound_pitch= FIXED_ONE;
+		object= objects + object_index;
+		
+		/* initialize the object_data structure.  the defaults result in a normal (i.e., scenery),
+			non-solid object.  the rendered, animated and status flags are initially clear. */
+		object->polygon= NONE;
+		object->shape= shape;
+		object->facing= facing;
+		object->transfer_mode= NONE;
+		object->transfer_phase= 0;
+		object->permutation= 0;
+		object->sequence= 0;
+		object->flags= 0;
+		object->next_object= NONE;
+		object->parasitic_object= NONE;
+		object->sound_pitch= FIXED_ONE;
+		
+		MARK_SLOT_AS_USED(object);
+		ObjectSlots.mark_used(object_index);
 			
-			MARK_SLOT_AS_USED(object);
-				
-			/* Objects with a shape of UNONE are invisible. */
-			if(shape==UNONE)
-			{
-				SET_OBJECT_INVISIBILITY(object, true);
-			}
-	
-			break;
+		/* Objects with a shape of UNONE are invisible. */
+		if(shape==UNONE)
+		{
+			SET_OBJECT_INVISIBILITY(object, true);
 		}
 	}
-	if (object_index==MAXIMUM_OBJECTS_PER_MAP) object_index= NONE;
 	
 	return object_index;
 }
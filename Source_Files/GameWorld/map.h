@@ -994,6 +994,11 @@ extern struct dynamic_data *dynamic_world;
 extern vector<object_data> ObjectList;
 #define objects (ObjectList.data())
 
+// call after the object, monster, projectile or effect lists have been
+// cleared or loaded, so their free-slot lookups (and the polygons' solid
+// object candidates) get rebuilt
+void invalidate_slot_allocators();
+
 // extern struct object_data *objects;
 
 extern vector<endpoint_data> EndpointList;
@@ -1117,6 +1122,10 @@ bool translate_map_object(short object_index, world_point3d *new_location, short
 short find_new_object_polygon(world_point2d *parent_location, world_point2d *child_location, short parent_polygon_index);
 void remove_map_object(short index);
 
+// the objects in a polygon that might block movement (monsters and scenery, and
+// objects not yet given an owner), in the order of the polygon's object list
+const vector<short>& get_polygon_solid_object_candidates(short polygon_index);
+
 
 // ZZZ additions in support of prediction:
 // removes the object at object_index from the polygon with index in object's 'polygon' field
@@ -1206,6 +1215,9 @@ bool change_polygon_height(short polygon_index, world_distance new_floor_height,
 	world_distance new_ceiling_height, struct damage_definition *damage);
 
 bool line_is_obstructed(short polygon_index1, world_point2d *p1, short polygon_index2, world_point2d *p2);
+void find_polygons_within_radius(short polygon_index, world_point2d *center, int32 radius, vector<short>& polygons);
+void find_objects_within_radius(short polygon_index, world_point3d *center, int32 radius, short owner,
+	bool unobstructed, vector<short>& object_indexes);
 bool point_is_player_visible(short max_players, short polygon_index, world_point2d *p, int32 *distance);
 bool point_is_monster_visible(short polygon_index, world_point2d *p, int32 *distance);
 
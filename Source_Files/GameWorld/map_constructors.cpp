@@ -54,9 +54,16 @@ const bool DoIncorrectCountVWarn = true;
 #include "flood_map.h"
 #include "platforms.h"
 #include "Packing.h"
+#include "PackingSchema.h"
+#include "FileHandler.h"
+#include "crc.h"
+#include "Logging.h"
 
 #include <limits.h>
 #include <vector>
+#include <atomic>
+
+#include <SDL_thread.h>
 
 /*
 maps of one polygon dont have their impassability information computed
@@ -73,17 +80,10 @@ maps of one polygon don
 
 struct intersecting_flood_data
 {
-	// This stuff now global:
-	/*
-	short *line_indexes;
-	short line_count;
-	
-	short *endpoint_indexes;
-	short endpoint_count;
-	
-	short *polygon_indexes;
-	short polygon_count;
-	*/
+	// Per-flood scratch lists, so that floods can run on several threads
+	vector<short> *line_indexes;
+	vector<short> *endpoint_indexes;
+	vector<short> *polygon_indexes;
 	
 	short original_polygon_index;
 	world_point2d center;
@@ -91,15 +91,38 @@ struct intersecting_flood_data
 	int32 minimum_separation_squared;
 };
 
+// Nearby endpoints, lines and polygons found by one flood
+struct intersecting_indexes
+{
+	vector<short> lines;
+	vector<short> endpoints;
+	vector<short> polygons;
+};
+
+// Polygons are precalculated in runs of this many, each run by whichever thread gets to it
+#define POLYGONS_PER_PRECALCULATION_CHUNK 64
+#define MAXIMUM_PRECALCULATION_THREADS 8
+
+// What one run of polygons contributes to the map index list, in list order
+struct precalculation_chunk
+{
+	short first_polygon_index, polygon_count;
+
+	vector<short> exclusion_indexes; /* lines, then endpoints, then neighbors, for each polygon */
+	vector<short> line_counts, endpoint_counts, neighbor_counts;
+
+	vector<short> sound_source_indexes; /* terminated by NONE for each polygon */
+};
+
+struct precalculation_job
+{
+	vector<precalculation_chunk> chunks;
+	std::atomic<int> next_chunk;
+};
+
 /* ---------- globals */
 static int32 map_index_buffer_count= 0l; /* Added due to the dynamic nature of maps */
 
-// LP: Temporary areas for nearby endpoint/line/polygon finding;
-// OK for this to be global since they replace only single instances.
-static vector<short> LineIndices(MAXIMUM_INTERSECTING_INDEXES);
-static vector<short> EndpointIndices(MAXIMUM_INTERSECTING_INDEXES);
-static vector<short> PolygonIndices(MAXIMUM_INTERSECTING_INDEXES);
-
 
 /* ---------- private prototypes */
 
@@ -109,11 +132,19 @@ static void calculate_adjacent_sides(short polygon_index, short *side_indexes);
 static int32 calculate_polygon_area(short polygon_index);
 
 static void add_map_index(short index, short *count);
-static void find_intersecting_endpoints_and_lines(short polygon_index, world_distance minimum_separation);
+static void find_intersecting_endpoints_and_lines(struct flood_map_state *state, short polygon_index,
+	world_distance minimum_separation, struct intersecting_indexes& indexes);
 static int32 intersecting_flood_proc(short source_polygon_index, short line_index,
 	short destination_polygon_index, void *data);
 
-static void precalculate_polygon_sound_sources(void);
+static int precalculation_thread(void *data);
+static void precalculate_chunk(struct flood_map_state *state, struct intersecting_indexes& indexes,
+	struct precalculation_chunk& chunk);
+static void precalculate_polygon_sound_sources(short polygon_index, vector<short>& sound_source_indexes);
+
+static void calculate_map_index_cache_key(vector<uint8>& key);
+static bool load_map_index_cache(const vector<uint8>& key);
+static void save_map_index_cache(const vector<uint8>& key);
 
 /* ---------- code */
 
@@ -611,68 +642,152 @@ static int32 calculate_polygon_area(
 void precalculate_map_indexes(
 	void)
 {
-	short polygon_index = 0;
-	struct polygon_data *polygon = map_polygons;
+	vector<uint8> cache_key;
+	calculate_map_index_cache_key(cache_key);
+	if (load_map_index_cache(cache_key)) return;
+
+	/* the flooding dominates level loading on big maps, and each polygon floods on its own,
+		so spread the polygons over several threads; the results are put together in
+		polygon order afterward, so they come out exactly as if done one at a time */
+	precalculation_job job;
+	job.next_chunk= 0;
+	for (int first_polygon_index= 0; first_polygon_index<dynamic_world->polygon_count; first_polygon_index+= POLYGONS_PER_PRECALCULATION_CHUNK)
+	{
+		precalculation_chunk chunk;
+		chunk.first_polygon_index= static_cast<short>(first_polygon_index);
+		chunk.polygon_count= MIN(POLYGONS_PER_PRECALCULATION_CHUNK, dynamic_world->polygon_count-first_polygon_index);
+		job.chunks.push_back(chunk);
+	}
+
+	int thread_count= PIN(SDL_GetCPUCount(), 1, MAXIMUM_PRECALCULATION_THREADS);
+	thread_count= MIN(thread_count, static_cast<int>(job.chunks.size()));
 	
-	for (;polygon_index< dynamic_world->polygon_count;++polygon,++polygon_index)
+	vector<SDL_Thread *> threads;
+	for (int i= 1; i<thread_count; ++i)
 	{
-		if (!POLYGON_IS_DETACHED(polygon)) /* well handle detached polygons during the second pass */
+		SDL_Thread *thread= SDL_CreateThread(precalculation_thread, "precalculate_map_indexes", &job);
+		if (thread) threads.push_back(thread);
+	}
+	precalculation_thread(&job);
+	for (size_t i= 0; i<threads.size(); ++i)
+	{
+		SDL_WaitThread(threads[i], NULL);
+	}
+
+	for (size_t i= 0; i<job.chunks.size(); ++i)
+	{
+		precalculation_chunk& chunk= job.chunks[i];
+		size_t next_index= 0;
+		
+		for (short j= 0; j<chunk.polygon_count; ++j)
 		{
-			// short line_indexes[MAXIMUM_INTERSECTING_INDEXES], endpoint_indexes[MAXIMUM_INTERSECTING_INDEXES],
-			// 	polygon_indexes[MAXIMUM_INTERSECTING_INDEXES];
-			// short line_count, endpoint_count, polygon_count;
-	
-//			if (polygon_index==17) dprintf("polygon #%d at %p", polygon_index, polygon);
-						
+			struct polygon_data *polygon= get_polygon_data(chunk.first_polygon_index+j);
+			if (POLYGON_IS_DETACHED(polygon)) continue; /* well handle detached polygons during the second pass */
+
 			polygon->first_exclusion_zone_index= dynamic_world->map_index_count;
 			polygon->line_exclusion_zone_count= polygon->point_exclusion_zone_count= 0;
-			find_intersecting_endpoints_and_lines(polygon_index, MINIMUM_SEPARATION_FROM_WALL);
-			//	line_indexes, &line_count, endpoint_indexes, &endpoint_count, polygon_indexes,
-			//	&polygon_count);
-			
-			size_t line_count = LineIndices.size();
-			size_t endpoint_count = EndpointIndices.size();
-			
-			for (size_t i=0;i<line_count;++i)	
+			for (short k= 0; k<chunk.line_counts[j]; ++k)
 			{
-				add_map_index(LineIndices[i], &polygon->line_exclusion_zone_count);
+				add_map_index(chunk.exclusion_indexes[next_index++], &polygon->line_exclusion_zone_count);
 			}
-			
-			for (size_t i=0;i<endpoint_count;++i)
+			for (short k= 0; k<chunk.endpoint_counts[j]; ++k)
 			{
-				add_map_index(EndpointIndices[i], &polygon->point_exclusion_zone_count);
+				add_map_index(chunk.exclusion_indexes[next_index++], &polygon->point_exclusion_zone_count);
 			}
 			
 			polygon->first_neighbor_index= dynamic_world->map_index_count;
 			polygon->neighbor_count= 0;
-			find_intersecting_endpoints_and_lines(polygon_index, MINIMUM_SEPARATION_FROM_PROJECTILE);
-			//	line_indexes, &line_count, endpoint_indexes, &endpoint_count, polygon_indexes,
-			//	&polygon_count);
-			
-//			if (polygon_index==155) dprintf("polygon index #%d has %d neighbors:;dm %x %x;", polygon_index, polygon_count, polygon_indexes, sizeof(short)*polygon_count);
-			
-			size_t polygon_count = PolygonIndices.size();
+			for (short k= 0; k<chunk.neighbor_counts[j]; ++k)
+			{
+				add_map_index(chunk.exclusion_indexes[next_index++], &polygon->neighbor_count);
+			}
+		}
+	}
+
+	for (size_t i= 0; i<job.chunks.size(); ++i)
+	{
+		precalculation_chunk& chunk= job.chunks[i];
+		size_t next_index= 0;
 
-			for (size_t i=0;i<polygon_count;++i)
+		for (short j= 0; j<chunk.polygon_count; ++j)
+		{
+			struct polygon_data *polygon= get_polygon_data(chunk.first_polygon_index+j);
+			short sound_sources= 0;
+			
+			polygon->sound_source_indexes= dynamic_world->map_index_count;
+			do
 			{
-				add_map_index(PolygonIndices[i], &polygon->neighbor_count);
+				add_map_index(chunk.sound_source_indexes[next_index], &sound_sources);
 			}
+			while (chunk.sound_source_indexes[next_index++]!=NONE);
 		}
 	}
 
-	precalculate_polygon_sound_sources();
+	save_map_index_cache(cache_key);
+}
+
+static int precalculation_thread(
+	void *data)
+{
+	precalculation_job *job= static_cast<precalculation_job *>(data);
+	struct flood_map_state *state= new_flood_map_state();
+	intersecting_indexes indexes;
+	
+	for (int chunk_index= job->next_chunk++; chunk_index<static_cast<int>(job->chunks.size()); chunk_index= job->next_chunk++)
+	{
+		precalculate_chunk(state, indexes, job->chunks[chunk_index]);
+	}
+
+	delete_flood_map_state(state);
+	return 0;
+}
+
+static void precalculate_chunk(
+	struct flood_map_state *state,
+	struct intersecting_indexes& indexes,
+	struct precalculation_chunk& chunk)
+{
+	chunk.line_counts.assign(chunk.polygon_count, 0);
+	chunk.endpoint_counts.assign(chunk.polygon_count, 0);
+	chunk.neighbor_counts.assign(chunk.polygon_count, 0);
+	
+	for (short j= 0; j<chunk.polygon_count; ++j)
+	{
+		short polygon_index= chunk.first_polygon_index+j;
+		struct polygon_data *polygon= get_polygon_data(polygon_index);
+
+		if (!POLYGON_IS_DETACHED(polygon))
+		{
+			find_intersecting_endpoints_and_lines(state, polygon_index, MINIMUM_SEPARATION_FROM_WALL, indexes);
+			chunk.exclusion_indexes.insert(chunk.exclusion_indexes.end(), indexes.lines.begin(), indexes.lines.end());
+			chunk.exclusion_indexes.insert(chunk.exclusion_indexes.end(), indexes.endpoints.begin(), indexes.endpoints.end());
+			chunk.line_counts[j]= static_cast<short>(indexes.lines.size());
+			chunk.endpoint_counts[j]= static_cast<short>(indexes.endpoints.size());
+			
+			find_intersecting_endpoints_and_lines(state, polygon_index, MINIMUM_SEPARATION_FROM_PROJECTILE, indexes);
+			chunk.exclusion_indexes.insert(chunk.exclusion_indexes.end(), indexes.polygons.begin(), indexes.polygons.end());
+			chunk.neighbor_counts[j]= static_cast<short>(indexes.polygons.size());
+		}
+
+		precalculate_polygon_sound_sources(polygon_index, chunk.sound_source_indexes);
+	}
 }
 
 static void find_intersecting_endpoints_and_lines(
+	struct flood_map_state *state,
 	short polygon_index,
-	world_distance minimum_separation)
+	world_distance minimum_separation,
+	struct intersecting_indexes& indexes)
 {
 	struct intersecting_flood_data data;
 
 	data.original_polygon_index= polygon_index;
-	LineIndices.clear();
-	EndpointIndices.clear();
-	PolygonIndices.clear();
+	indexes.lines.clear();
+	indexes.endpoints.clear();
+	indexes.polygons.clear();
+	data.line_indexes= &indexes.lines;
+	data.endpoint_indexes= &indexes.endpoints;
+	data.polygon_indexes= &indexes.polygons;
 
 	data.minimum_separation_squared= minimum_separation*minimum_separation;
 	find_center_of_polygon(polygon_index, &data.center);
@@ -685,15 +800,15 @@ static void find_intersecting_endpoints_and_lines(
 			short adjacent_polygon_index = find_adjacent_polygon(polygon_index, polygon->line_indexes[i]);
 			if (adjacent_polygon_index != NONE)
 			{
-				PolygonIndices.push_back(adjacent_polygon_index);
+				indexes.polygons.push_back(adjacent_polygon_index);
 			}
 		}
 	}
 
-	polygon_index= flood_map(polygon_index, INT32_MAX, intersecting_flood_proc, _breadth_first, &data);
+	polygon_index= flood_map(state, polygon_index, INT32_MAX, intersecting_flood_proc, _breadth_first, &data);
 	while (polygon_index!=NONE)
 	{
-		polygon_index= flood_map(NONE, INT32_MAX, intersecting_flood_proc, _breadth_first, &data);
+		polygon_index= flood_map(state, NONE, INT32_MAX, intersecting_flood_proc, _breadth_first, &data);
 	}
 }
 
@@ -868,6 +983,9 @@ static int32 intersecting_flood_proc(
 	struct intersecting_flood_data *data=(struct intersecting_flood_data *)vdata;
 	struct polygon_data *polygon= get_polygon_data(source_polygon_index);
 	struct polygon_data *original_polygon= get_polygon_data(data->original_polygon_index);
+	vector<short>& LineIndices= *data->line_indexes;
+	vector<short>& EndpointIndices= *data->endpoint_indexes;
+	vector<short>& PolygonIndices= *data->polygon_indexes;
 	bool keep_searching= false; /* dont flood any deeper unless we find something close enough */
 	unsigned short i, j;
 	(void) (line_index);
@@ -1133,394 +1251,439 @@ static void add_map_index(
 #define ZERO_VOLUME_DISTANCE (10*WORLD_ONE)
 
 static void precalculate_polygon_sound_sources(
-	void)
+	short polygon_index,
+	vector<short>& sound_source_indexes)
 {
-	short polygon_index;
-	struct polygon_data *polygon;
+	struct polygon_data *polygon= get_polygon_data(polygon_index);
+	short object_index;
+	struct map_object *object;
 	
-	for (polygon_index= 0, polygon= map_polygons; polygon_index<dynamic_world->polygon_count; ++polygon_index, ++polygon)
+	for (object_index= 0, object= saved_objects; object_index<dynamic_world->initial_objects_count; ++object, ++object_index)
 	{
-		short object_index;
-		struct map_object *object;
-		short sound_sources= 0;
-		
-		polygon->sound_source_indexes= dynamic_world->map_index_count;
-		
-		for (object_index= 0, object= saved_objects; object_index<dynamic_world->initial_objects_count; ++object, ++object_index)
+		if (object->type==_saved_sound_source)
 		{
-			if (object->type==_saved_sound_source)
+			short i;
+			bool close= false;
+			
+			for (i= 0; i<polygon->vertex_count; ++i)
 			{
-				short i;
-				bool close= false;
+				struct endpoint_data *endpoint= get_endpoint_data(polygon->endpoint_indexes[i]);
+				struct line_data *line= get_line_data(polygon->line_indexes[i]);
 				
-				for (i= 0; i<polygon->vertex_count; ++i)
+				if (guess_distance2d((world_point2d *)&object->location, &endpoint->vertex)<ZERO_VOLUME_DISTANCE ||
+					point_to_line_segment_distance_squared((world_point2d *)&object->location,
+						&get_endpoint_data(line->endpoint_indexes[0])->vertex,
+						&get_endpoint_data(line->endpoint_indexes[1])->vertex)<ZERO_VOLUME_DISTANCE)
 				{
-					struct endpoint_data *endpoint= get_endpoint_data(polygon->endpoint_indexes[i]);
-					struct line_data *line= get_line_data(polygon->line_indexes[i]);
-					
-					if (guess_distance2d((world_point2d *)&object->location, &endpoint->vertex)<ZERO_VOLUME_DISTANCE ||
-						point_to_line_segment_distance_squared((world_point2d *)&object->location,
-							&get_endpoint_data(line->endpoint_indexes[0])->vertex,
-							&get_endpoint_data(line->endpoint_indexes[1])->vertex)<ZERO_VOLUME_DISTANCE)
-					{
-						close= true;
-						break;
-					}
+					close= true;
+					break;
 				}
-				
-				if (close) add_map_index(object_index, &sound_sources);
 			}
+			
+			if (close) sound_source_indexes.push_back(object_index);
 		}
-		
-		add_map_index(NONE, &sound_sources);
 	}
+	
+	sound_source_indexes.push_back(NONE);
 }
 
-uint8 *unpack_endpoint_data(uint8 *Stream, endpoint_data *Objects, size_t Count)
+/* ---------- map index cache */
+
+/* Bump this whenever the precalculation changes what it produces */
+#define MAP_INDEX_CACHE_VERSION 2
+#define MAP_INDEX_CACHE_HEADER_SIZE 16
+#define SIZEOF_cached_polygon_indexes 12
+
+/* The cache is keyed by everything the precalculation reads, so an edited level
+	(or the same level in another map file) can never pick up stale indexes; the whole
+	key is stored in the cache and compared, its checksum only names the file */
+static void calculate_map_index_cache_key(
+	vector<uint8>& buffer)
 {
-	uint8* S = Stream;
-	endpoint_data* ObjPtr = Objects;
-     
-     for (size_t k = 0; k < Count; k++, ObjPtr++)
+	buffer.clear();
+	buffer.reserve(dynamic_world->polygon_count*64 + dynamic_world->line_count*14 +
+		dynamic_world->endpoint_count*4 + dynamic_world->initial_objects_count*6 + 8);
+	uint8 value[4];
+	
+#define APPEND_TO_KEY(x) do { uint8 *S= value; ValueToStream(S, (x)); buffer.insert(buffer.end(), value, S); } while (0)
+	APPEND_TO_KEY(static_cast<int16>(MAP_INDEX_CACHE_VERSION));
+	APPEND_TO_KEY(static_cast<int16>(film_profile.adjacent_polygons_always_intersect));
+
+	for (short i= 0; i<dynamic_world->polygon_count; ++i)
 	{
-		StreamToValue(S,ObjPtr->flags);
-		StreamToValue(S,ObjPtr->highest_adjacent_floor_height);
-		StreamToValue(S,ObjPtr->lowest_adjacent_ceiling_height);
-		
-		StreamToValue(S,ObjPtr->vertex.x);
-		StreamToValue(S,ObjPtr->vertex.y);
-		StreamToValue(S,ObjPtr->transformed.x);
-		StreamToValue(S,ObjPtr->transformed.y);
-		
-		StreamToValue(S,ObjPtr->supporting_polygon_index);
+		struct polygon_data *polygon= get_polygon_data(i);
+		APPEND_TO_KEY(polygon->type);
+		APPEND_TO_KEY(polygon->flags);
+		APPEND_TO_KEY(polygon->floor_height);
+		APPEND_TO_KEY(polygon->ceiling_height);
+		APPEND_TO_KEY(polygon->vertex_count);
+		APPEND_TO_KEY(polygon->center.x);
+		APPEND_TO_KEY(polygon->center.y);
+		for (short j= 0; j<polygon->vertex_count; ++j)
+		{
+			APPEND_TO_KEY(polygon->endpoint_indexes[j]);
+			APPEND_TO_KEY(polygon->line_indexes[j]);
+			APPEND_TO_KEY(polygon->adjacent_polygon_indexes[j]);
+		}
 	}
 	
-	assert((S - Stream) == static_cast<ptrdiff_t>(Count*SIZEOF_endpoint_data));
-	return S;
+	for (short i= 0; i<dynamic_world->line_count; ++i)
+	{
+		struct line_data *line= get_line_data(i);
+		APPEND_TO_KEY(line->endpoint_indexes[0]);
+		APPEND_TO_KEY(line->endpoint_indexes[1]);
+		APPEND_TO_KEY(line->flags);
+		APPEND_TO_KEY(line->highest_adjacent_floor);
+		APPEND_TO_KEY(line->lowest_adjacent_ceiling);
+		APPEND_TO_KEY(line->clockwise_polygon_owner);
+		APPEND_TO_KEY(line->counterclockwise_polygon_owner);
+	}
+
+	for (short i= 0; i<dynamic_world->endpoint_count; ++i)
+	{
+		struct endpoint_data *endpoint= get_endpoint_data(i);
+		APPEND_TO_KEY(endpoint->vertex.x);
+		APPEND_TO_KEY(endpoint->vertex.y);
+	}
+
+	for (short i= 0; i<dynamic_world->initial_objects_count; ++i)
+	{
+		struct map_object *object= saved_objects+i;
+		APPEND_TO_KEY(object->type);
+		APPEND_TO_KEY(object->location.x);
+		APPEND_TO_KEY(object->location.y);
+	}
+#undef APPEND_TO_KEY
 }
 
-uint8 *pack_endpoint_data(uint8 *Stream, endpoint_data *Objects, size_t Count)
+static uint32 get_map_index_cache_checksum(
+	const vector<uint8>& key)
 {
-	uint8* S = Stream;
-	endpoint_data* ObjPtr = Objects;
+	return calculate_data_crc(const_cast<uint8 *>(key.data()), static_cast<int32>(key.size()));
+}
+
+static void get_map_index_cache_file(
+	FileSpecifier& file,
+	const vector<uint8>& key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%08x.idx", get_map_index_cache_checksum(key));
 	
-	for (size_t k = 0; k < Count; k++, ObjPtr++)
+	file.SetToLocalDataDir();
+	file += "Map Index Cache";
+	file += name;
+}
+
+static bool load_map_index_cache(
+	const vector<uint8>& key)
+{
+	if (dynamic_world->map_index_count!=0) return false;
+
+	FileSpecifier file;
+	get_map_index_cache_file(file, key);
+
+	OpenedFile cache;
+	if (!file.Open(cache)) return false;
+
+	int32 length;
+	if (!cache.GetLength(length) || length<MAP_INDEX_CACHE_HEADER_SIZE) return false;
+
+	vector<uint8> buffer(length);
+	if (!cache.Read(length, buffer.data())) return false;
+
+	uint8 *S= buffer.data();
+	int16 version, polygon_count, map_index_count, unused;
+	uint32 stored_checksum, key_length;
+	StreamToValue(S, version);
+	StreamToValue(S, stored_checksum);
+	StreamToValue(S, polygon_count);
+	StreamToValue(S, map_index_count);
+	StreamToValue(S, unused);
+	StreamToValue(S, key_length);
+	
+	if (version!=MAP_INDEX_CACHE_VERSION || key_length!=key.size() ||
+		polygon_count!=dynamic_world->polygon_count || map_index_count<0 ||
+		length!=int32(MAP_INDEX_CACHE_HEADER_SIZE + key_length + polygon_count*SIZEOF_cached_polygon_indexes + map_index_count*2))
 	{
-		ValueToStream(S,ObjPtr->flags);
-		ValueToStream(S,ObjPtr->highest_adjacent_floor_height);
-		ValueToStream(S,ObjPtr->lowest_adjacent_ceiling_height);
-		
-		ValueToStream(S,ObjPtr->vertex.x);
-		ValueToStream(S,ObjPtr->vertex.y);
-		ValueToStream(S,ObjPtr->transformed.x);
-		ValueToStream(S,ObjPtr->transformed.y);
-		
-		ValueToStream(S,ObjPtr->supporting_polygon_index);
+		logWarning("ignoring unusable map index cache %s", file.GetPath());
+		return false;
 	}
 	
-	assert((S - Stream) == static_cast<ptrdiff_t>(Count*SIZEOF_endpoint_data));
-	return S;
-}
-
+	/* a checksum names the file, but two levels can share one; only the same level matches its key */
+	if (memcmp(S, key.data(), key_length)!=0) return false;
+	S+= key_length;
 
-uint8 *unpack_line_data(uint8 *Stream, line_data *Objects, size_t Count)
-{
-	uint8* S = Stream;
-	line_data* ObjPtr = Objects;
+	/* check everything before touching the map, so a damaged cache just gets recalculated */
+	uint8 *polygon_stream= S;
+	for (short i= 0; i<polygon_count; ++i)
+	{
+		int16 first_exclusion_zone_index, line_exclusion_zone_count, point_exclusion_zone_count;
+		int16 first_neighbor_index, neighbor_count, sound_source_indexes;
+		StreamToValue(S, first_exclusion_zone_index);
+		StreamToValue(S, line_exclusion_zone_count);
+		StreamToValue(S, point_exclusion_zone_count);
+		StreamToValue(S, first_neighbor_index);
+		StreamToValue(S, neighbor_count);
+		StreamToValue(S, sound_source_indexes);
+
+		if (!POLYGON_IS_DETACHED(get_polygon_data(i)) &&
+			(first_exclusion_zone_index<0 || line_exclusion_zone_count<0 || point_exclusion_zone_count<0 ||
+			first_exclusion_zone_index+line_exclusion_zone_count+point_exclusion_zone_count>map_index_count ||
+			first_neighbor_index<0 || neighbor_count<0 || first_neighbor_index+neighbor_count>map_index_count ||
+			sound_source_indexes<0 || sound_source_indexes>=map_index_count))
+		{
+			logWarning("ignoring damaged map index cache %s", file.GetPath());
+			return false;
+		}
+	}
 	
-	for (size_t k = 0; k < Count; k++, ObjPtr++)
+	S= polygon_stream;
+	for (short i= 0; i<polygon_count; ++i)
 	{
-		StreamToList(S,ObjPtr->endpoint_indexes,2);
-		StreamToValue(S,ObjPtr->flags);
-		
-		StreamToValue(S,ObjPtr->length);
-		StreamToValue(S,ObjPtr->highest_adjacent_floor);
-		StreamToValue(S,ObjPtr->lowest_adjacent_ceiling);
-		
-		StreamToValue(S,ObjPtr->clockwise_polygon_side_index);
-		StreamToValue(S,ObjPtr->counterclockwise_polygon_side_index);
-		
-		StreamToValue(S,ObjPtr->clockwise_polygon_owner);
-		StreamToValue(S,ObjPtr->counterclockwise_polygon_owner);
-		
-		S += 6*2;
+		struct polygon_data *polygon= get_polygon_data(i);
+		StreamToValue(S, polygon->first_exclusion_zone_index);
+		StreamToValue(S, polygon->line_exclusion_zone_count);
+		StreamToValue(S, polygon->point_exclusion_zone_count);
+		StreamToValue(S, polygon->first_neighbor_index);
+		StreamToValue(S, polygon->neighbor_count);
+		StreamToValue(S, polygon->sound_source_indexes);
 	}
 	
-	assert((S - Stream) == static_cast<ptrdiff_t>(Count*SIZEOF_line_data));
-	return S;
+	MapIndexList.resize(map_index_count);
+	StreamToList(S, map_indexes, map_index_count);
+	dynamic_world->map_index_count= map_index_count;
+
+	return true;
 }
 
-uint8 *pack_line_data(uint8 *Stream, line_data *Objects, size_t Count)
+static void save_map_index_cache(
+	const vector<uint8>& key)
 {
-	uint8* S = Stream;
-	line_data* ObjPtr = Objects;
-	
-	for (size_t k = 0; k < Count; k++, ObjPtr++)
+	int32 length= MAP_INDEX_CACHE_HEADER_SIZE + static_cast<int32>(key.size()) +
+		dynamic_world->polygon_count*SIZEOF_cached_polygon_indexes + dynamic_world->map_index_count*2;
+	vector<uint8> buffer(length);
+	
+	uint8 *S= buffer.data();
+	ValueToStream(S, static_cast<int16>(MAP_INDEX_CACHE_VERSION));
+	ValueToStream(S, get_map_index_cache_checksum(key));
+	ValueToStream(S, dynamic_world->polygon_count);
+	ValueToStream(S, dynamic_world->map_index_count);
+	ValueToStream(S, static_cast<int16>(0));
+	ValueToStream(S, static_cast<uint32>(key.size()));
+	memcpy(S, key.data(), key.size());
+	S+= key.size();
+
+	for (short i= 0; i<dynamic_world->polygon_count; ++i)
 	{
-		ListToStream(S,ObjPtr->endpoint_indexes,2);
-		ValueToStream(S,ObjPtr->flags);
-		
-		ValueToStream(S,ObjPtr->length);
-		ValueToStream(S,ObjPtr->highest_adjacent_floor);
-		ValueToStream(S,ObjPtr->lowest_adjacent_ceiling);
-		
-		ValueToStream(S,ObjPtr->clockwise_polygon_side_index);
-		ValueToStream(S,ObjPtr->counterclockwise_polygon_side_index);
-		
-		ValueToStream(S,ObjPtr->clockwise_polygon_owner);
-		ValueToStream(S,ObjPtr->counterclockwise_polygon_owner);
-		
-		S += 6*2;
+		struct polygon_data *polygon= get_polygon_data(i);
+		ValueToStream(S, polygon->first_exclusion_zone_index);
+		ValueToStream(S, polygon->line_exclusion_zone_count);
+		ValueToStream(S, polygon->point_exclusion_zone_count);
+		ValueToStream(S, polygon->first_neighbor_index);
+		ValueToStream(S, polygon->neighbor_count);
+		ValueToStream(S, polygon->sound_source_indexes);
+	}
+
+	ListToStream(S, map_indexes, dynamic_world->map_index_count);
+	assert(S - buffer.data() == length);
+
+	FileSpecifier directory;
+	directory.SetToLocalDataDir();
+	directory += "Map Index Cache";
+	directory.CreateDirectory();
+
+	/* write to a temporary file first, so a half-written cache is never picked up */
+	FileSpecifier file, temporary_file;
+	get_map_index_cache_file(file, key);
+	temporary_file.SetTempName(file);
+
+	OpenedFile cache;
+	if (!temporary_file.Create(_typecode_unknown) || !temporary_file.Open(cache, true))
+	{
+		logWarning("unable to write map index cache %s", file.GetPath());
+		return;
 	}
 	
-	assert((S - Stream) == static_cast<ptrdiff_t>(Count*SIZEOF_line_data));
-	return S;
+	bool written= cache.Write(length, buffer.data());
+	cache.Close();
+	if (!written || !temporary_file.Rename(file))
+	{
+		logWarning("unable to write map index cache %s", file.GetPath());
+		temporary_file.Delete();
+	}
 }
 
+static constexpr packed_field endpoint_fields[] = {
+	PACKED_FIELD(endpoint_data, flags),
+	PACKED_FIELD(endpoint_data, highest_adjacent_floor_height),
+	PACKED_FIELD(endpoint_data, lowest_adjacent_ceiling_height),
+	
+	PACKED_FIELD(endpoint_data, vertex.x),
+	PACKED_FIELD(endpoint_data, vertex.y),
+	PACKED_FIELD(endpoint_data, transformed.x),
+	PACKED_FIELD(endpoint_data, transformed.y),
+	
+	PACKED_FIELD(endpoint_data, supporting_polygon_index)
+};
+DEFINE_PACKING_SCHEMA(endpoint_schema, endpoint_data, endpoint_fields, SIZEOF_endpoint_data);
 
-inline void StreamToSideTxtr(uint8* &S, side_texture_definition& Object)
+uint8 *unpack_endpoint_data(uint8 *Stream, endpoint_data *Objects, size_t Count)
 {
-	StreamToValue(S,Object.x0);
-	StreamToValue(S,Object.y0);
-	StreamToValue(S,Object.texture);
+	return endpoint_schema.unpack(Stream, Objects, Count);
 }
 
-inline void SideTxtrToStream(uint8* &S, side_texture_definition& Object)
+uint8 *pack_endpoint_data(uint8 *Stream, endpoint_data *Objects, size_t Count)
 {
-	ValueToStream(S,Object.x0);
-	ValueToStream(S,Object.y0);
-	ValueToStream(S,Object.texture);	
+	return endpoint_schema.pack(Stream, Objects, Count);
 }
 
 
-void StreamToSideExclZone(uint8* &S, side_exclusion_zone& Object)
+static constexpr packed_field line_fields[] = {
+	PACKED_FIELD(line_data, endpoint_indexes),
+	PACKED_FIELD(line_data, flags),
+	
+	PACKED_FIELD(line_data, length),
+	PACKED_FIELD(line_data, highest_adjacent_floor),
+	PACKED_FIELD(line_data, lowest_adjacent_ceiling),
+	
+	PACKED_FIELD(line_data, clockwise_polygon_side_index),
+	PACKED_FIELD(line_data, counterclockwise_polygon_side_index),
+	
+	PACKED_FIELD(line_data, clockwise_polygon_owner),
+	PACKED_FIELD(line_data, counterclockwise_polygon_owner),
+	
+	PACKED_PADDING(6*2)
+};
+DEFINE_PACKING_SCHEMA(line_schema, line_data, line_fields, SIZEOF_line_data);
+
+uint8 *unpack_line_data(uint8 *Stream, line_data *Objects, size_t Count)
 {
-	StreamToValue(S,Object.e0.x);
-	StreamToValue(S,Object.e0.y);
-	StreamToValue(S,Object.e1.x);
-	StreamToValue(S,Object.e1.y);
-	StreamToValue(S,Object.e2.x);
-	StreamToValue(S,Object.e2.y);
-	StreamToValue(S,Object.e3.x);
-	StreamToValue(S,Object.e3.y);
+	return line_schema.unpack(Stream, Objects, Count);
 }
 
-void SideExclZoneToStream(uint8* &S, side_exclusion_zone& Object)
+uint8 *pack_line_data(uint8 *Stream, line_data *Objects, size_t Count)
 {
-	ValueToStream(S,Object.e0.x);
-	ValueToStream(S,Object.e0.y);
-	ValueToStream(S,Object.e1.x);
-	ValueToStream(S,Object.e1.y);
-	ValueToStream(S,Object.e2.x);
-	ValueToStream(S,Object.e2.y);
-	ValueToStream(S,Object.e3.x);
-	ValueToStream(S,Object.e3.y);
+	return line_schema.pack(Stream, Objects, Count);
 }
 
 
-uint8 *unpack_side_data(uint8 *Stream, side_data *Objects, size_t Count)
-{
-	uint8* S = Stream;
-	side_data* ObjPtr = Objects;
+#define SIDE_TEXTURE_FIELDS(side_texture) \
+	PACKED_FIELD(side_data, side_texture.x0), \
+	PACKED_FIELD(side_data, side_texture.y0), \
+	PACKED_FIELD(side_data, side_texture.texture)
+
+static constexpr packed_field side_fields[] = {
+	PACKED_FIELD(side_data, type),
+	PACKED_FIELD(side_data, flags),
 	
-	for (size_t k = 0; k < Count; k++, ObjPtr++)
-	{
-		StreamToValue(S,ObjPtr->type);
-		StreamToValue(S,ObjPtr->flags);
-		
-		StreamToSideTxtr(S,ObjPtr->primary_texture);
-		StreamToSideTxtr(S,ObjPtr->secondary_texture);
-		StreamToSideTxtr(S,ObjPtr->transparent_texture);
-		
-		StreamToSideExclZone(S,ObjPtr->exclusion_zone);
-		
-		StreamToValue(S,ObjPtr->control_panel_type);
-		StreamToValue(S,ObjPtr->control_panel_permutation);
-		
-		StreamToValue(S,ObjPtr->primary_transfer_mode);
-		StreamToValue(S,ObjPtr->secondary_transfer_mode);
-		StreamToValue(S,ObjPtr->transparent_transfer_mode);
-		
-		StreamToValue(S,ObjPtr->polygon_index);
-		StreamToValue(S,ObjPtr->line_index);
-		
-		StreamToValue(S,ObjPtr->primary_lightsource_index);
-		StreamToValue(S,ObjPtr->secondary_lightsource_index);
-		StreamToValue(S,ObjPtr->transparent_lightsource_index);
-		
-		StreamToValue(S,ObjPtr->ambient_delta);
-		
-		S += 1*2;
-	}
+	SIDE_TEXTURE_FIELDS(primary_texture),
+	SIDE_TEXTURE_FIELDS(secondary_texture),
+	SIDE_TEXTURE_FIELDS(transparent_texture),
 	
-	assert((S - Stream) == static_cast<ptrdiff_t>(Count*SIZEOF_side_data));
-	return S;
+	PACKED_FIELD(side_data, exclusion_zone.e0.x),
+	PACKED_FIELD(side_data, exclusion_zone.e0.y),
+	PACKED_FIELD(side_data, exclusion_zone.e1.x),
+	PACKED_FIELD(side_data, exclusion_zone.e1.y),
+	PACKED_FIELD(side_data, exclusion_zone.e2.x),
+	PACKED_FIELD(side_data, exclusion_zone.e2.y),
+	PACKED_FIELD(side_data, exclusion_zone.e3.x),
+	PACKED_FIELD(side_data, exclusion_zone.e3.y),
+	
+	PACKED_FIELD(side_data, control_panel_type),
+	PACKED_FIELD(side_data, control_panel_permutation),
+	
+	PACKED_FIELD(side_data, primary_transfer_mode),
+	PACKED_FIELD(side_data, secondary_transfer_mode),
+	PACKED_FIELD(side_data, transparent_transfer_mode),
+	
+	PACKED_FIELD(side_data, polygon_index),
+	PACKED_FIELD(side_data, line_index),
+	
+	PACKED_FIELD(side_data, primary_lightsource_index),
+	PACKED_FIELD(side_data, secondary_lightsource_index),
+	PACKED_FIELD(side_data, transparent_lightsource_index),
+	
+	PACKED_FIELD(side_data, ambient_delta),
+	
+	PACKED_PADDING(1*2)
+};
+DEFINE_PACKING_SCHEMA(side_schema, side_data, side_fields, SIZEOF_side_data);
+
+#undef SIDE_TEXTURE_FIELDS
+
+uint8 *unpack_side_data(uint8 *Stream, side_data *Objects, size_t Count)
+{
+	return side_schema.unpack(Stream, Objects, Count);
 }
 
 uint8 *pack_side_data(uint8 *Stream, side_data *Objects, size_t Count)
 {
-	uint8* S = Stream;
-	side_data* ObjPtr = Objects;
-	
-	for (size_t k = 0; k < Count; k++, ObjPtr++)
-	{
-		ValueToStream(S,ObjPtr->type);
-		ValueToStream(S,ObjPtr->flags);
-		
-		SideTxtrToStream(S,ObjPtr->primary_texture);
-		SideTxtrToStream(S,ObjPtr->secondary_texture);
-		SideTxtrToStream(S,ObjPtr->transparent_texture);
-		
-		SideExclZoneToStream(S,ObjPtr->exclusion_zone);
-		
-		ValueToStream(S,ObjPtr->control_panel_type);
-		ValueToStream(S,ObjPtr->control_panel_permutation);
-		
-		ValueToStream(S,ObjPtr->primary_transfer_mode);
-		ValueToStream(S,ObjPtr->secondary_transfer_mode);
-		ValueToStream(S,ObjPtr->transparent_transfer_mode);
-		
-		ValueToStream(S,ObjPtr->polygon_index);
-		ValueToStream(S,ObjPtr->line_index);
-		
-		ValueToStream(S,ObjPtr->primary_lightsource_index);
-		ValueToStream(S,ObjPtr->secondary_lightsource_index);
-		ValueToStream(S,ObjPtr->transparent_lightsource_index);
-		
-		ValueToStream(S,ObjPtr->ambient_delta);
-		
-		S += 1*2;
-	}
-	
-	assert((S - Stream) == static_cast<ptrdiff_t>(Count*SIZEOF_side_data));
-	return S;
+	return side_schema.pack(Stream, Objects, Count);
 }
 
 
-uint8 *unpack_polygon_data(uint8 *Stream, polygon_data *Objects, size_t Count)
-{
-	uint8* S = Stream;
-	polygon_data* ObjPtr = Objects;
+static constexpr packed_field polygon_fields[] = {
+	PACKED_FIELD(polygon_data, type),
+	PACKED_FIELD(polygon_data, flags),
+	PACKED_FIELD(polygon_data, permutation),
 	
-	for (size_t k = 0; k < Count; k++, ObjPtr++)
-	{
-		StreamToValue(S,ObjPtr->type);
-		StreamToValue(S,ObjPtr->flags);
-		StreamToValue(S,ObjPtr->permutation);
-		
-		StreamToValue(S,ObjPtr->vertex_count);
-		StreamToList(S,ObjPtr->endpoint_indexes,MAXIMUM_VERTICES_PER_POLYGON);
-		StreamToList(S,ObjPtr->line_indexes,MAXIMUM_VERTICES_PER_POLYGON);
-		
-		StreamToValue(S,ObjPtr->floor_texture);
-		StreamToValue(S,ObjPtr->ceiling_texture);
-		StreamToValue(S,ObjPtr->floor_height);
-		StreamToValue(S,ObjPtr->ceiling_height);
-		StreamToValue(S,ObjPtr->floor_lightsource_index);
-		StreamToValue(S,ObjPtr->ceiling_lightsource_index);
-		
-		StreamToValue(S,ObjPtr->area);
-		
-		StreamToValue(S,ObjPtr->first_object);
-		
-		StreamToValue(S,ObjPtr->first_exclusion_zone_index);
-		StreamToValue(S,ObjPtr->line_exclusion_zone_count);
-		StreamToValue(S,ObjPtr->point_exclusion_zone_count);
-		
-		StreamToValue(S,ObjPtr->floor_transfer_mode);
-		StreamToValue(S,ObjPtr->ceiling_transfer_mode);
-		
-		StreamToList(S,ObjPtr->adjacent_polygon_indexes,MAXIMUM_VERTICES_PER_POLYGON);
-		
-		StreamToValue(S,ObjPtr->first_neighbor_index);
-		StreamToValue(S,ObjPtr->neighbor_count);
-		
-		StreamToValue(S,ObjPtr->center.x);
-		StreamToValue(S,ObjPtr->center.y);
-		
-		StreamToList(S,ObjPtr->side_indexes,MAXIMUM_VERTICES_PER_POLYGON);
-		
-		StreamToValue(S,ObjPtr->floor_origin.x);
-		StreamToValue(S,ObjPtr->floor_origin.y);
-		StreamToValue(S,ObjPtr->ceiling_origin.x);
-		StreamToValue(S,ObjPtr->ceiling_origin.y);
-		
-		StreamToValue(S,ObjPtr->media_index);
-		StreamToValue(S,ObjPtr->media_lightsource_index);
-		
-		StreamToValue(S,ObjPtr->sound_source_indexes);
-		
-		StreamToValue(S,ObjPtr->ambient_sound_image_index);
-		StreamToValue(S,ObjPtr->random_sound_image_index);
-		
-		S += 1*2;
-	}
+	PACKED_FIELD(polygon_data, vertex_count),
+	PACKED_FIELD(polygon_data, endpoint_indexes),
+	PACKED_FIELD(polygon_data, line_indexes),
 	
-	assert((S - Stream) == static_cast<ptrdiff_t>(Count*SIZEOF_polygon_data));
-	return S;
+	PACKED_FIELD(polygon_data, floor_texture),
+	PACKED_FIELD(polygon_data, ceiling_texture),
+	PACKED_FIELD(polygon_data, floor_height),
+	PACKED_FIELD(polygon_data, ceiling_height),
+	PACKED_FIELD(polygon_data, floor_lightsource_index),
+	PACKED_FIELD(polygon_data, ceiling_lightsource_index),
+	
+	PACKED_FIELD(polygon_data, area),
+	
+	PACKED_FIELD(polygon_data, first_object),
+	
+	PACKED_FIELD(polygon_data, first_exclusion_zone_index),
+	PACKED_FIELD(polygon_data, line_exclusion_zone_count),
+	PACKED_FIELD(polygon_data, point_exclusion_zone_count),
+	
+	PACKED_FIELD(polygon_data, floor_transfer_mode),
+	PACKED_FIELD(polygon_data, ceiling_transfer_mode),
+	
+	PACKED_FIELD(polygon_data, adjacent_polygon_indexes),
+	
+	PACKED_FIELD(polygon_data, first_neighbor_index),
+	PACKED_FIELD(polygon_data, neighbor_count),
+	
+	PACKED_FIELD(polygon_data, center.x),
+	PACKED_FIELD(polygon_data, center.y),
+	
+	PACKED_FIELD(polygon_data, side_indexes),
+	
+	PACKED_FIELD(polygon_data, floor_origin.x),
+	PACKED_FIELD(polygon_data, floor_origin.y),
+	PACKED_FIELD(polygon_data, ceiling_origin.x),
+	PACKED_FIELD(polygon_data, ceiling_origin.y),
+	
+	PACKED_FIELD(polygon_data, media_index),
+	PACKED_FIELD(polygon_data, media_lightsource_index),
+	
+	PACKED_FIELD(polygon_data, sound_source_indexes),
+	
+	PACKED_FIELD(polygon_data, ambient_sound_image_index),
+	PACKED_FIELD(polygon_data, random_sound_image_index),
+	
+	PACKED_PADDING(1*2)
+};
+DEFINE_PACKING_SCHEMA(polygon_schema, polygon_data, polygon_fields, SIZEOF_polygon_data);
+
+uint8 *unpack_polygon_data(uint8 *Stream, polygon_data *Objects, size_t Count)
+{
+	return polygon_schema.unpack(Stream, Objects, Count);
 }
 
 uint8 *pack_polygon_data(uint8 *Stream, polygon_data *Objects, size_t Count)
 {
-	uint8* S = Stream;
-	polygon_data* ObjPtr = Objects;
-	
-	for (size_t k = 0; k < Count; k++, ObjPtr++)
-	{
-		ValueToStream(S,ObjPtr->type);
-		ValueToStream(S,ObjPtr->flags);
-		ValueToStream(S,ObjPtr->permutation);
-		
-		ValueToStream(S,ObjPtr->vertex_count);
-		ListToStream(S,ObjPtr->endpoint_indexes,MAXIMUM_VERTICES_PER_POLYGON);
-		ListToStream(S,ObjPtr->line_indexes,MAXIMUM_VERTICES_PER_POLYGON);
-		
-		ValueToStream(S,ObjPtr->floor_texture);
-		ValueToStream(S,ObjPtr->ceiling_texture);
-		ValueToStream(S,ObjPtr->floor_height);
-		ValueToStream(S,ObjPtr->ceiling_height);
-		ValueToStream(S,ObjPtr->floor_lightsource_index);
-		ValueToStream(S,ObjPtr->ceiling_lightsource_index);
-		
-		ValueToStream(S,ObjPtr->area);
-		
-		ValueToStream(S,ObjPtr->first_object);
-		
-		ValueToStream(S,ObjPtr->first_exclusion_zone_index);
-		ValueToStream(S,ObjPtr->line_exclusion_zone_count);
-		ValueToStream(S,ObjPtr->point_exclusion_zone_count);
-		
-		ValueToStream(S,ObjPtr->floor_transfer_mode);
-		ValueToStream(S,ObjPtr->ceiling_transfer_mode);
-		
-		ListToStream(S,ObjPtr->adjacent_polygon_indexes,MAXIMUM_VERTICES_PER_POLYGON);
-		
-		ValueToStream(S,ObjPtr->first_neighbor_index);
-		ValueToStream(S,ObjPtr->neighbor_count);
-		
-		ValueToStream(S,ObjPtr->center.x);
-		ValueToStream(S,ObjPtr->center.y);
-		
-		ListToStream(S,ObjPtr->side_indexes,MAXIMUM_VERTICES_PER_POLYGON);
-		
-		ValueToStream(S,ObjPtr->floor_origin.x);
-		ValueToStream(S,ObjPtr->floor_origin.y);
-		ValueToStream(S,ObjPtr->ceiling_origin.x);
-		ValueToStream(S,ObjPtr->ceiling_origin.y);
-		
-		ValueToStream(S,ObjPtr->media_index);
-		ValueToStream(S,ObjPtr->media_lightsource_index);
-		
-		ValueToStream(S,ObjPtr->sound_source_indexes);
-		
-		ValueToStream(S,ObjPtr->ambient_sound_image_index);
-		ValueToStream(S,ObjPtr->random_sound_image_index);
-		
-		S += 1*2;
-	}
-	
-	assert((S - Stream) == static_cast<ptrdiff_t>(Count*SIZEOF_polygon_data));
-	return S;
+	return polygon_schema.pack(Stream, Objects, Count);
 }
 
 
@@ -1565,48 +1728,27 @@ uint8 *pack_map_annotation(uint8 *Stream, map_annotation* Objects, size_t Count)
 }
 
 
+static constexpr packed_field map_object_fields[] = {
+	PACKED_FIELD(map_object, type),
+	PACKED_FIELD(map_object, index),
+	PACKED_FIELD(map_object, facing),
+	PACKED_FIELD(map_object, polygon_index),
+	PACKED_FIELD(map_object, location.x),
+	PACKED_FIELD(map_object, location.y),
+	PACKED_FIELD(map_object, location.z),
+	
+	PACKED_FIELD(map_object, flags)
+};
+DEFINE_PACKING_SCHEMA(map_object_schema, map_object, map_object_fields, SIZEOF_map_object);
+
 uint8 *unpack_map_object(uint8 *Stream, map_object* Objects, size_t Count)
 {
-	uint8* S = Stream;
-	map_object* ObjPtr = Objects;
-	
-	for (size_t k = 0; k < Count; k++, ObjPtr++)
-	{
-		StreamToValue(S,ObjPtr->type);
-		StreamToValue(S,ObjPtr->index);
-		StreamToValue(S,ObjPtr->facing);
-		StreamToValue(S,ObjPtr->polygon_index);
-		StreamToValue(S,ObjPtr->location.x);
-		StreamToValue(S,ObjPtr->location.y);
-		StreamToValue(S,ObjPtr->location.z);
-		
-		StreamToValue(S,ObjPtr->flags);
-	}
-	
-	assert((S - Stream) == static_cast<ptrdiff_t>(Count*SIZEOF_map_object));
-	return S;
+	return map_object_schema.unpack(Stream, Objects, Count);
 }
 
 uint8 *pack_map_object(uint8 *Stream, map_object* Objects, size_t Count)
 {
-	uint8* S = Stream;
-	map_object* ObjPtr = Objects;
-	
-	for (size_t k = 0; k < Count; k++, ObjPtr++)
-	{
-		ValueToStream(S,ObjPtr->type);
-		ValueToStream(S,ObjPtr->index);
-		ValueToStream(S,ObjPtr->facing);
-		ValueToStream(S,ObjPtr->polygon_index);
-		ValueToStream(S,ObjPtr->location.x);
-		ValueToStream(S,ObjPtr->location.y);
-		ValueToStream(S,ObjPtr->location.z);
-		
-		ValueToStream(S,ObjPtr->flags);
-	}
-	
-	assert((S - Stream) == static_cast<ptrdiff_t>(Count*SIZEOF_map_object));
-	return S;
+	return map_object_schema.pack(Stream, Objects, Count);
 }
 
 
@@ -1962,70 +2104,38 @@ uint8 *pack_dynamic_data(uint8 *Stream, dynamic_data* Objects, size_t Count)
 }
 
 
-uint8 *unpack_object_data(uint8 *Stream, object_data* Objects, size_t Count)
-{
-	uint8* S = Stream;
-	object_data* ObjPtr = Objects;
+static constexpr packed_field object_fields[] = {
+	PACKED_FIELD(object_data, location.x),
+	PACKED_FIELD(object_data, location.y),
+	PACKED_FIELD(object_data, location.z),
+	PACKED_FIELD(object_data, polygon),
 	
-	for (size_t k = 0; k < Count; k++, ObjPtr++)
-	{
-		StreamToValue(S,ObjPtr->location.x);
-		StreamToValue(S,ObjPtr->location.y);
-		StreamToValue(S,ObjPtr->location.z);
-		StreamToValue(S,ObjPtr->polygon);
-		
-		StreamToValue(S,ObjPtr->facing);
-		
-		StreamToValue(S,ObjPtr->shape);
-		
-		StreamToValue(S,ObjPtr->sequence);
-		StreamToValue(S,ObjPtr->flags);
-		StreamToValue(S,ObjPtr->transfer_mode);
-		StreamToValue(S,ObjPtr->transfer_period);
-		StreamToValue(S,ObjPtr->transfer_phase);
-		StreamToValue(S,ObjPtr->permutation);
-		
-		StreamToValue(S,ObjPtr->next_object);
-		StreamToValue(S,ObjPtr->parasitic_object);
-		
-		StreamToValue(S,ObjPtr->sound_pitch);
-	}
+	PACKED_FIELD(object_data, facing),
 	
-	assert((S - Stream) == static_cast<ptrdiff_t>(Count*SIZEOF_object_data));
-	return S;
+	PACKED_FIELD(object_data, shape),
+	
+	PACKED_FIELD(object_data, sequence),
+	PACKED_FIELD(object_data, flags),
+	PACKED_FIELD(object_data, transfer_mode),
+	PACKED_FIELD(object_data, transfer_period),
+	PACKED_FIELD(object_data, transfer_phase),
+	PACKED_FIELD(object_data, permutation),
+	
+	PACKED_FIELD(object_data, next_object),
+	PACKED_FIELD(object_data, parasitic_object),
+	
+	PACKED_FIELD(object_data, sound_pitch)
+};
+DEFINE_PACKING_SCHEMA(object_schema, object_data, object_fields, SIZEOF_object_data);
+
+uint8 *unpack_object_data(uint8 *Stream, object_data* Objects, size_t Count)
+{
+	return object_schema.unpack(Stream, Objects, Count);
 }
 
 uint8 *pack_object_data(uint8 *Stream, object_data* Objects, size_t Count)
 {
-	uint8* S = Stream;
-	object_data* ObjPtr = Objects;
-	
-	for (size_t k = 0; k < Count; k++, ObjPtr++)
-	{
-		ValueToStream(S,ObjPtr->location.x);
-		ValueToStream(S,ObjPtr->location.y);
-		ValueToStream(S,ObjPtr->location.z);
-		ValueToStream(S,ObjPtr->polygon);
-		
-		ValueToStream(S,ObjPtr->facing);
-		
-		ValueToStream(S,ObjPtr->shape);
-		
-		ValueToStream(S,ObjPtr->sequence);
-		ValueToStream(S,ObjPtr->flags);
-		ValueToStream(S,ObjPtr->transfer_mode);
-		ValueToStream(S,ObjPtr->transfer_period);
-		ValueToStream(S,ObjPtr->transfer_phase);
-		ValueToStream(S,ObjPtr->permutation);
-		
-		ValueToStream(S,ObjPtr->next_object);
-		ValueToStream(S,ObjPtr->parasitic_object);
-		
-		ValueToStream(S,ObjPtr->sound_pitch);
-	}
-	
-	assert((S - Stream) == static_cast<ptrdiff_t>(Count*SIZEOF_object_data));
-	return S;
+	return object_schema.pack(Stream, Objects, Count);
 }
 
 
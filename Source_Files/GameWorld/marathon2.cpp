@@ -118,6 +118,8 @@ Feb 8, 2003 (Woody Zenfell):
 #include "Console.h"
 #include "Movie.h"
 #include "Statistics.h"
+#include "Profiler.h"
+#include "interpolated_world.h"
 
 #include "motion_sensor.h"
 
@@ -395,7 +397,10 @@ update_world_elements_one_tick(bool& call_postidle)
 	} 
 	else
 	{
-		L_Call_Idle();
+		{
+			PROFILE_ZONE("lua");
+			L_Call_Idle();
+		}
 		call_postidle = true;
 		
 		update_lights();
@@ -404,8 +409,14 @@ update_world_elements_one_tick(bool& call_postidle)
 		
 		update_control_panels(); // don't put after update_players
 		update_players(GameQueue, false);
-		move_projectiles();
-		move_monsters();
+		{
+			PROFILE_ZONE("projectiles");
+			move_projectiles();
+		}
+		{
+			PROFILE_ZONE("monsters");
+			move_monsters();
+		}
 		update_effects();
 		recreate_objects();
 		
@@ -424,6 +435,7 @@ update_world_elements_one_tick(bool& call_postidle)
 		check_m1_exploration();
 		
 #if !defined(DISABLE_NETWORKING)
+		PROFILE_ZONE("network");
 		update_net_game();
 #endif // !defined(DISABLE_NETWORKING)
 	}
@@ -460,7 +472,10 @@ update_world()
 
 #ifndef DISABLE_NETWORKING
 	if (game_is_networked)
+	{
+		PROFILE_ZONE("network");
 		NetProcessMessagesInGame();
+	}
 #endif
         
         while(canUpdate)
@@ -506,8 +521,13 @@ update_world()
                 theElapsedTime++;
 
                 if (call_postidle)
+                {
+                        PROFILE_ZONE("lua");
                         L_Call_PostIdle();
-                if(theUpdateResult != kUpdateNormalCompletion || Movie::instance()->IsRecording())
+                }
+                // after a seek, a replay gets checked at a particular tick
+                if(theUpdateResult != kUpdateNormalCompletion || Movie::instance()->IsRecording() ||
+                   dynamic_world->tick_count == get_replay_check_tick())
                 {
                         canUpdate = false;
                 }
@@ -632,6 +652,9 @@ bool entering_map(bool restoring_saved)
 
 	/* and since no monsters have paths, we should make sure no paths think they have monsters */
 	reset_paths();
+
+	/* don't slide anything over from the last level */
+	reset_interpolated_world();
 	
 	/* mark our shape collections for loading and load them */
 	mark_environment_collections(static_world->environment_code, true);
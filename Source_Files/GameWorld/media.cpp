@@ -51,8 +51,10 @@ Feb 8, 2001 (Loren Petrich):
 #include "InfoTree.h"
 
 #include "Packing.h"
+#include "slot_allocator.h"
 
 #include <string.h>
+#include <vector>
 
 /* ---------- macros */
 
@@ -67,6 +69,11 @@ vector<media_data> MediaList;
 
 // struct media_data *medias;
 
+// A medium's height only changes with its light's intensity, which doesn't change
+// while the light sleeps; remember which sleep each medium was last updated in
+static std::vector<int32> media_light_episodes;
+static uint32 media_light_episode_generation = 0;
+
 /* ---------- private prototypes */
 
 void update_one_media(size_t media_index, bool force_update);
@@ -258,14 +265,23 @@ void update_one_media(
 	struct media_definition *definition= get_media_definition(media->type);
 	if (!definition) return;
 
+	if (media_light_episode_generation!=slot_allocator_generation || media_light_episodes.size()!=MAXIMUM_MEDIAS_PER_MAP)
+	{
+		media_light_episodes.assign(MAXIMUM_MEDIAS_PER_MAP, NONE);
+		media_light_episode_generation= slot_allocator_generation;
+	}
+	
+	/* nothing has changed since the last update */
+	int32 episode= get_light_sleep_episode(media->light_index);
+	if (!force_update && episode!=NONE && episode==media_light_episodes[media_index]) return;
+	media_light_episodes[media_index]= episode;
+
 	/* update height */
 	media->height= (media->low + FIXED_INTEGERAL_PART((media->high-media->low)*get_light_intensity(media->light_index)));
 
 	/* update texture */	
 	media->texture= BUILD_DESCRIPTOR(definition->collection, definition->shape);
 	media->transfer_mode= definition->transfer_mode;
-
-	(void)force_update;
 }
 
 // LP addition: count number of media types used,
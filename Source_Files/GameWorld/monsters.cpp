@@ -111,9 +111,11 @@ Jan 12, 2003 (Loren Petrich)
 #include "items.h"
 #include "media.h"
 #include "Packing.h"
+#include "PackingSchema.h"
 #include "lua_script.h"
 #include "Logging.h"
 #include "InfoTree.h"
+#include "slot_allocator.h"
 
 
 /*
@@ -156,6 +158,9 @@ Jan 12, 2003 (Loren Petrich)
 
 #define MINIMUM_DYING_EXTERNAL_VELOCITY (WORLD_ONE/8)
 
+// with a think budget, monsters without paths get one on every fourth tick, by index
+#define MONSTER_PATH_BUCKET_MASK 3
+
 #define CIVILIANS_KILLED_BY_PLAYER_THRESHHOLD 3
 #define CIVILIANS_KILLED_DECREMENT_MASK 0x1ff
 
@@ -240,6 +245,8 @@ struct damage_kick_definition damage_kick_definitions[NUMBER_OF_DAMAGE_TYPES] =
 // LP addition: growable list of intersected objects
 static vector<short> IntersectedObjects;
 
+static slot_allocator<monster_data> MonsterSlots(MonsterList);
+
 /* ---------- private prototypes */
 
 static monster_definition *get_monster_definition(
@@ -391,60 +398,58 @@ short new_monster(
 			}
 		}
 		
-		for (monster_index=0,monster=monsters;monster_index<MAXIMUM_MONSTERS_PER_MAP;++monster_index,++monster)
+		monster_index= MonsterSlots.find_free();
+		if (monster_index!=NONE)
 		{
-			if (SLOT_IS_FREE(monster))
+			monster= monsters + monster_index;
+			
+			short object_index= new_map_object(location, BUILD_DESCRIPTOR(definition->collection, definition->stationary_shape));
+			
+			if (object_index!=NONE)
 			{
-				short object_index= new_map_object(location, BUILD_DESCRIPTOR(definition->collection, definition->stationary_shape));
-				
-				if (object_index!=NONE)
-				{
-					struct object_data *object= get_object_data(object_index);
+				struct object_data *object= get_object_data(object_index);
 
-					/* not doing this in !DEBUG resulted in sync errors; mmm... random data, so tasty */
-					obj_set(*monster, 0x80);
-	
-					if (location->flags&_map_object_is_blind) flags|= _monster_is_blind;
-					if (location->flags&_map_object_is_deaf) flags|= _monster_is_deaf;
-					if (location->flags&_map_object_floats) flags|= _monster_teleports_out_when_deactivated;
-				
-					/* initialize the monster_data structure; we dont touch most of the fields here
-						because the monster is initially inactive (and they will be initialized when the
-						monster is activated) */
-					monster->type= monster_type;
-					monster->activation_bias= DECODE_ACTIVATION_BIAS(location->flags);
-					monster->vitality= NONE; /* if a monster is activated with vitality==NONE, it will be properly initialized */
-					monster->object_index= object_index;
-					monster->flags= flags;
-					monster->goal_polygon_index= monster->activation_bias==_activate_on_goal ?
-						nearest_goal_polygon_index(location->polygon_index) : NONE;
-					monster->sound_polygon_index= object->polygon;
-					monster->sound_location= object->location;
-					MARK_SLOT_AS_USED(monster);
-					
-					/* initialize the monsters object */
-					if (definition->flags&_monster_is_invisible) object->transfer_mode= _xfer_invisibility;
-					if (definition->flags&_monster_is_subtly_invisible) object->transfer_mode= _xfer_subtle_invisibility;
-					if (definition->flags&_monster_is_enlarged) object->flags|= _object_is_enlarged;
-					if (definition->flags&_monster_is_tiny) object->flags|= _object_is_tiny;
-					SET_OBJECT_SOLIDITY(object, true);
-					SET_OBJECT_OWNER(object, _object_is_monster);
-					object->permutation= monster_index;
-					object->sound_pitch= definition->sound_pitch;
-
-					/* make sure the object frequency stuff keeps track of how many monsters are
-						on the map */
-					object_was_just_added(_object_is_monster, original_monster_type);
-				}
-				else
-				{
-					monster_index= NONE;
-				}
+				/* not doing this in !DEBUG resulted in sync errors; mmm... random data, so tasty */
+				obj_set(*monster, 0x80);
+
+				if (location->flags&_map_object_is_blind) flags|= _monster_is_blind;
+				if (location->flags&_map_object_is_deaf) flags|= _monster_is_deaf;
+				if (location->flags&_map_object_floats) flags|= _monster_teleports_out_when_deactivated;
+			
+				/* initialize the monster_data structure; we dont touch most of the fields here
+					because the monster is initially inactive (and they will be initialized when the
+					monster is activated) */
+				monster->type= monster_type;
+				monster->activation_bias= DECODE_ACTIVATION_BIAS(location->flags);
+				monster->vitality= NONE; /* if a monster is activated with vitality==NONE, it will be properly initialized */
+				monster->object_index= object_index;
+				monster->flags= flags;
+				monster->goal_polygon_index= monster->activation_bias==_activate_on_goal ?
+					nearest_goal_polygon_index(location->polygon_index) : NONE;
+				monster->sound_polygon_index= object->polygon;
+				monster->sound_location= object->location;
+				MARK_SLOT_AS_USED(monster);
+				MonsterSlots.mark_used(monster_index);
 				
-				break;
+				/* initialize the monsters object */
+				if (definition->flags&_monster_is_invisible) object->transfer_mode= _xfer_invisibility;
+				if (definition->flags&_monster_is_subtly_invisible) object->transfer_mode= _xfer_subtle_invisibility;
+				if (definition->flags&_monster_is_enlarged) object->flags|= _object_is_enlarged;
+				if (definition->flags&_monster_is_tiny) object->flags|= _object_is_tiny;
+				SET_OBJECT_SOLIDITY(object, true);
+				SET_OBJECT_OWNER(object, _object_is_monster);
+				object->permutation= monster_index;
+				object->sound_pitch= definition->sound_pitch;
+
+				/* make sure the object frequency stuff keeps track of how many monsters are
+					on the map */
+				object_was_just_added(_object_is_monster, original_monster_type);
+			}
+			else
+			{
+				monster_index= NONE;
 			}
 		}
-		if (monster_index==MAXIMUM_MONSTERS_PER_MAP) monster_index= NONE;
 	}
 
 	/* keep track of how many civilians we drop on this level */
@@ -463,9 +468,18 @@ void move_monsters(
 	void)
 {
 	struct monster_data *monster;
-	bool monster_got_time= false;
-	bool monster_built_path= (dynamic_world->tick_count&3) ? true : false;
 	short monster_index;
+	
+	/* originally one monster got time to look for a target each tick, and one monster built a
+		path every fourth tick (plus every monster without a path, whenever it needed one); with
+		a think budget, up to that many of each happen every tick, and monsters without paths
+		wait for their turn.  the budget is part of the game information so films and network
+		games stay in sync */
+	short think_budget= dynamic_world->game_information.parameters[_monster_think_budget_parameter];
+	bool scheduled= think_budget>0;
+	short time_budget= scheduled ? think_budget : 1;
+	short path_budget= scheduled ? think_budget : ((dynamic_world->tick_count&3) ? 0 : 1);
+	short monsters_given_time= 0, paths_built= 0;
 
 	for (monster_index= 0, monster= monsters; monster_index<MAXIMUM_MONSTERS_PER_MAP; ++monster_index, ++monster)
 	{
@@ -499,8 +513,10 @@ void move_monsters(
 					animation_flags= GET_OBJECT_ANIMATION_FLAGS(object);
 		
 					/* give this monster time, if we can and he needs it */
-					if (!monster_got_time && monster_index>dynamic_world->last_monster_index_to_get_time && !MONSTER_IS_DYING(monster))
+					if (monsters_given_time<time_budget && monster_index>dynamic_world->last_monster_index_to_get_time && !MONSTER_IS_DYING(monster))
 					{
+						bool monster_got_time= false;
+						
 						switch (monster->mode)
 						{
 							case _monster_unlocked:
@@ -523,20 +539,36 @@ void move_monsters(
 						}
 						
 						/* if we gave this guy time, make room for the next guy */
-						if (monster_got_time) dynamic_world->last_monster_index_to_get_time= monster_index;
+						if (monster_got_time)
+						{
+							monsters_given_time+= 1;
+							dynamic_world->last_monster_index_to_get_time= monster_index;
+						}
 					}
 		
 					/* if this monster needs a path, generate one (unless weve already generated a
 						path this frame in which case well wait until next frame, UNLESS the monster
 						has no path in which case it needs one regardless) */
-					if (MONSTER_NEEDS_PATH(monster) && !MONSTER_IS_DYING(monster) && !MONSTER_IS_ATTACKING(monster) &&
-						((!monster_built_path && monster_index>dynamic_world->last_monster_index_to_build_path) || monster->path==NONE))
+					if (MONSTER_NEEDS_PATH(monster) && !MONSTER_IS_DYING(monster) && !MONSTER_IS_ATTACKING(monster))
 					{
-						generate_new_path_for_monster(monster_index);
-						if (!monster_built_path)
+						bool may_build_path= paths_built<path_budget && monster_index>dynamic_world->last_monster_index_to_build_path;
+						
+						if (monster->path==NONE)
 						{
-							monster_built_path= true;
-							dynamic_world->last_monster_index_to_build_path= monster_index;
+							if (!scheduled)
+								may_build_path= true;
+							else if (paths_built<path_budget && (monster_index&MONSTER_PATH_BUCKET_MASK)==(dynamic_world->tick_count&MONSTER_PATH_BUCKET_MASK))
+								may_build_path= true;
+						}
+						
+						if (may_build_path)
+						{
+							generate_new_path_for_monster(monster_index);
+							if (paths_built<path_budget)
+							{
+								paths_built+= 1;
+								dynamic_world->last_monster_index_to_build_path= monster_index;
+							}
 						}
 					}
 					
@@ -590,6 +622,7 @@ void move_monsters(
 									remove_map_object(monster->object_index);
 									L_Invalidate_Monster(monster_index);
 									MARK_SLOT_AS_FREE(monster);
+									MonsterSlots.mark_free(monster_index);
 								}
 								break;
 							
@@ -639,12 +672,12 @@ void move_monsters(
 			else
 			{
 				/* all inactive monsters get time to scan for targets */
-				if (!monster_got_time && !MONSTER_IS_BLIND(monster) && monster_index>dynamic_world->last_monster_index_to_get_time)
+				if (monsters_given_time<time_budget && !MONSTER_IS_BLIND(monster) && monster_index>dynamic_world->last_monster_index_to_get_time)
 				{
 					change_monster_target(monster_index, find_closest_appropriate_target(monster_index, false));
 					if (MONSTER_HAS_VALID_TARGET(monster)) activate_nearby_monsters(monster->target_index, monster_index, _pass_one_zone_border, MONSTER_ALERT_ACTIVATION_RANGE);
 					
-					monster_got_time= true;
+					monsters_given_time+= 1;
 					dynamic_world->last_monster_index_to_get_time= monster_index;
 				}
 			}
@@ -657,8 +690,8 @@ void move_monsters(
 	
 	/* either there are no unlocked monsters or dynamic_world->last_monster_index_to_get_time is higher than
 		all of them (so we reset it to zero) ... same for paths */
-	if (!monster_got_time) dynamic_world->last_monster_index_to_get_time= -1;
-	if (!monster_built_path) dynamic_world->last_monster_index_to_build_path= -1;
+	if (monsters_given_time<time_budget) dynamic_world->last_monster_index_to_get_time= -1;
+	if (paths_built<path_budget) dynamic_world->last_monster_index_to_build_path= -1;
 
 	if (dynamic_world->civilians_killed_by_players)
 	{
@@ -986,6 +1019,14 @@ static int32 monster_activation_flood_proc(
 
 static std::vector<bool> monster_must_be_exterminated(NUMBER_OF_MONSTER_TYPES, false);
 
+// from MML; copied into the game information when a game starts
+static int16 monster_think_budget= 0;
+
+int16 get_monster_think_budget()
+{
+	return monster_think_budget;
+}
+
 bool live_aliens_on_map(
 	void)
 {
@@ -1139,6 +1180,50 @@ void deactivate_monster(
 	}
 }
 
+// from MML; the results are the same either way, so this can differ between network players
+static bool use_solid_object_candidates= true;
+
+// which objects are already in the list being built by possible_intersecting_monsters()
+static vector<bool> IntersectedObjectMarks;
+
+/* visible monsters that aren't dying or teleporting, and solid scenery if asked for */
+static bool possible_intersecting_object(
+	short object_index,
+	bool include_scenery)
+{
+	struct object_data *object= get_object_data(object_index);
+	
+	if (OBJECT_IS_INVISIBLE(object)) return false;
+	
+	switch (GET_OBJECT_OWNER(object))
+	{
+		case _object_is_monster:
+		{
+			struct monster_data *monster= get_monster_data(object->permutation);
+			
+			return !MONSTER_IS_DYING(monster) && !MONSTER_IS_TELEPORTING(monster);
+		}
+		
+		case _object_is_scenery:
+			return include_scenery && OBJECT_IS_SOLID(object);
+	}
+	
+	return false;
+}
+
+static void add_intersecting_object(
+	vector<short> *IntersectedObjectsPtr,
+	unsigned maximum_object_count,
+	short object_index)
+{
+	/* do we have enough space to add it?  only add it if it's not already in the list */
+	if (IntersectedObjectsPtr && IntersectedObjectsPtr->size()<maximum_object_count && !IntersectedObjectMarks[object_index])
+	{
+		IntersectedObjectsPtr->push_back(object_index);
+		IntersectedObjectMarks[object_index]= true;
+	}
+}
+
 /* returns a list of object indexes of all monsters in or adjacent to the given polygon,
 	up to maximum_object_count. */
 // LP change: called with growable list
@@ -1155,64 +1240,60 @@ bool possible_intersecting_monsters(
 	// Skip this step if neighbor indexes were not found
 	if (!neighbor_indexes) return found_solid_object;
 
+	/* mark what's already in the list, instead of searching it for every object we add */
+	if (IntersectedObjectsPtr)
+	{
+		if (IntersectedObjectMarks.size()!=ObjectList.size()) IntersectedObjectMarks.assign(ObjectList.size(), false);
+		for (unsigned j=0; j<IntersectedObjectsPtr->size(); ++j)
+			IntersectedObjectMarks[(*IntersectedObjectsPtr)[j]]= true;
+	}
+
 	for (short i=0;i<polygon->neighbor_count;++i)
 	{
-		struct polygon_data *neighboring_polygon= get_polygon_data(*neighbor_indexes++);
+		short neighbor_index= *neighbor_indexes++;
+		struct polygon_data *neighboring_polygon= get_polygon_data(neighbor_index);
 		
 		if (!POLYGON_IS_DETACHED(neighboring_polygon))
 		{
-			short object_index= neighboring_polygon->first_object;
-			
-			while (object_index!=NONE)
+			/* only monsters and scenery can be solid; skip the polygon's projectiles, effects
+				and items without looking at them.  the candidates are in object list order, so
+				the result is the same either way */
+			if (use_solid_object_candidates)
 			{
-				struct object_data *object= get_object_data(object_index);
-				bool solid_object= false;
-				
-				if (!OBJECT_IS_INVISIBLE(object))
+				const vector<short>& candidates= get_polygon_solid_object_candidates(neighbor_index);
+				for (size_t k=0; k<candidates.size(); ++k)
 				{
-					switch (GET_OBJECT_OWNER(object))
+					if (possible_intersecting_object(candidates[k], include_scenery))
 					{
-						case _object_is_monster:
-						{
-							struct monster_data *monster= get_monster_data(object->permutation);
-						
-							if (!MONSTER_IS_DYING(monster) && !MONSTER_IS_TELEPORTING(monster))
-							{
-								solid_object= true;
-							}
-							
-							break;
-						}
-						
-						case _object_is_scenery:
-							if (include_scenery && OBJECT_IS_SOLID(object)) solid_object= true;
-							break;
+						found_solid_object= true;
+						add_intersecting_object(IntersectedObjectsPtr, maximum_object_count, candidates[k]);
 					}
-					
-					if (solid_object)
+				}
+			}
+			else
+			{
+				short object_index= neighboring_polygon->first_object;
+				
+				while (object_index!=NONE)
+				{
+					if (possible_intersecting_object(object_index, include_scenery))
 					{
 						found_solid_object= true;
-						
-						// LP change:
-						if (IntersectedObjectsPtr && IntersectedObjectsPtr->size()<maximum_object_count) /* do we have enough space to add it? */
-						{
-							unsigned j;
-							
-							/* only add this object_index if it's not already in the list */
-							vector<short>& IntersectedObjects = *IntersectedObjectsPtr;
-							for (j=0; j<IntersectedObjects.size() && IntersectedObjects[j]!=object_index; ++j)
-								;
-							if (j==IntersectedObjects.size())
-								IntersectedObjects.push_back(object_index);
-						}
+						add_intersecting_object(IntersectedObjectsPtr, maximum_object_count, object_index);
 					}
+					
+					object_index= get_object_data(object_index)->next_object;
 				}
-				
-				object_index= object->next_object;
 			}
 		}
 	}
 
+	if (IntersectedObjectsPtr)
+	{
+		for (unsigned j=0; j<IntersectedObjectsPtr->size(); ++j)
+			IntersectedObjectMarks[(*IntersectedObjectsPtr)[j]]= false;
+	}
+
 	return found_solid_object;
 }
 
@@ -2716,6 +2797,7 @@ static void kill_monster(
 
 	L_Invalidate_Monster(monster_index);
 	MARK_SLOT_AS_FREE(monster);
+	MonsterSlots.mark_free(monster_index);
 }
 		
 /* move the monster along his current heading; if he reaches the center of his destination square,
@@ -3539,100 +3621,53 @@ void SetPlayerViewAttribs(int16 half_visual_arc, int16 half_vertical_visual_arc,
 }
 
 
-uint8 *unpack_monster_data(uint8 *Stream, monster_data *Objects, size_t Count)
-{
-	uint8* S = Stream;
-	monster_data* ObjPtr = Objects;
+static constexpr packed_field monster_fields[] = {
+	PACKED_FIELD(monster_data, type),
+	PACKED_FIELD(monster_data, vitality),
+	PACKED_FIELD(monster_data, flags),
 	
-	for (size_t k = 0; k < Count; k++, ObjPtr++)
-	{
-		StreamToValue(S,ObjPtr->type);
-		StreamToValue(S,ObjPtr->vitality);
-		StreamToValue(S,ObjPtr->flags);
-		
-		StreamToValue(S,ObjPtr->path);
-		StreamToValue(S,ObjPtr->path_segment_length);
-		StreamToValue(S,ObjPtr->desired_height);
-		
-		StreamToValue(S,ObjPtr->mode);
-		StreamToValue(S,ObjPtr->action);
-		StreamToValue(S,ObjPtr->target_index);
-		StreamToValue(S,ObjPtr->external_velocity);
-		StreamToValue(S,ObjPtr->vertical_velocity);
-		StreamToValue(S,ObjPtr->ticks_since_attack);
-		StreamToValue(S,ObjPtr->attack_repetitions);
-		StreamToValue(S,ObjPtr->changes_until_lock_lost);
-		
-		StreamToValue(S,ObjPtr->elevation);
-		
-		StreamToValue(S,ObjPtr->object_index);
-		
-		StreamToValue(S,ObjPtr->ticks_since_last_activation);
-		
-		StreamToValue(S,ObjPtr->activation_bias);
-		
-		StreamToValue(S,ObjPtr->goal_polygon_index);
-		
-		StreamToValue(S,ObjPtr->sound_location.x);
-		StreamToValue(S,ObjPtr->sound_location.y);
-		StreamToValue(S,ObjPtr->sound_location.z);
-		StreamToValue(S,ObjPtr->sound_polygon_index);
-		
-		StreamToValue(S,ObjPtr->random_desired_height);
-		
-		S += 7*2;
-	}
+	PACKED_FIELD(monster_data, path),
+	PACKED_FIELD(monster_data, path_segment_length),
+	PACKED_FIELD(monster_data, desired_height),
 	
-	assert((S - Stream) == static_cast<ptrdiff_t>(Count*SIZEOF_monster_data));
-	return S;
+	PACKED_FIELD(monster_data, mode),
+	PACKED_FIELD(monster_data, action),
+	PACKED_FIELD(monster_data, target_index),
+	PACKED_FIELD(monster_data, external_velocity),
+	PACKED_FIELD(monster_data, vertical_velocity),
+	PACKED_FIELD(monster_data, ticks_since_attack),
+	PACKED_FIELD(monster_data, attack_repetitions),
+	PACKED_FIELD(monster_data, changes_until_lock_lost),
+	
+	PACKED_FIELD(monster_data, elevation),
+	
+	PACKED_FIELD(monster_data, object_index),
+	
+	PACKED_FIELD(monster_data, ticks_since_last_activation),
+	
+	PACKED_FIELD(monster_data, activation_bias),
+	
+	PACKED_FIELD(monster_data, goal_polygon_index),
+	
+	PACKED_FIELD(monster_data, sound_location.x),
+	PACKED_FIELD(monster_data, sound_location.y),
+	PACKED_FIELD(monster_data, sound_location.z),
+	PACKED_FIELD(monster_data, sound_polygon_index),
+	
+	PACKED_FIELD(monster_data, random_desired_height),
+	
+	PACKED_PADDING(7*2)
+};
+DEFINE_PACKING_SCHEMA(monster_schema, monster_data, monster_fields, SIZEOF_monster_data);
+
+uint8 *unpack_monster_data(uint8 *Stream, monster_data *Objects, size_t Count)
+{
+	return monster_schema.unpack(Stream, Objects, Count);
 }
 
 uint8 *pack_monster_data(uint8 *Stream, monster_data *Objects, size_t Count)
 {
-	uint8* S = Stream;
-	monster_data* ObjPtr = Objects;
-	
-	for (size_t k = 0; k < Count; k++, ObjPtr++)
-	{
-		ValueToStream(S,ObjPtr->type);
-		ValueToStream(S,ObjPtr->vitality);
-		ValueToStream(S,ObjPtr->flags);
-		
-		ValueToStream(S,ObjPtr->path);
-		ValueToStream(S,ObjPtr->path_segment_length);
-		ValueToStream(S,ObjPtr->desired_height);
-		
-		ValueToStream(S,ObjPtr->mode);
-		ValueToStream(S,ObjPtr->action);
-		ValueToStream(S,ObjPtr->target_index);
-		ValueToStream(S,ObjPtr->external_velocity);
-		ValueToStream(S,ObjPtr->vertical_velocity);
-		ValueToStream(S,ObjPtr->ticks_since_attack);
-		ValueToStream(S,ObjPtr->attack_repetitions);
-		ValueToStream(S,ObjPtr->changes_until_lock_lost);
-		
-		ValueToStream(S,ObjPtr->elevation);
-		
-		ValueToStream(S,ObjPtr->object_index);
-		
-		ValueToStream(S,ObjPtr->ticks_since_last_activation);
-		
-		ValueToStream(S,ObjPtr->activation_bias);
-		
-		ValueToStream(S,ObjPtr->goal_polygon_index);
-		
-		ValueToStream(S,ObjPtr->sound_location.x);
-		ValueToStream(S,ObjPtr->sound_location.y);
-		ValueToStream(S,ObjPtr->sound_location.z);
-		ValueToStream(S,ObjPtr->sound_polygon_index);
-		
-		ValueToStream(S,ObjPtr->random_desired_height);
-		
-		S += 7*2;
-	}
-	
-	assert((S - Stream) == static_cast<ptrdiff_t>(Count*SIZEOF_monster_data));
-	return S;
+	return monster_schema.pack(Stream, Objects, Count);
 }
 
 
@@ -3945,10 +3980,15 @@ void reset_mml_monsters()
 {
 	monster_must_be_exterminated.clear();
 	monster_must_be_exterminated.resize(NUMBER_OF_MONSTER_TYPES, false);
+	monster_think_budget= 0;
+	use_solid_object_candidates= true;
 }
 
 void parse_mml_monsters(const InfoTree& root)
 {
+	root.read_attr_bounded<int16>("think_budget", monster_think_budget, 0, MAXIMUM_MONSTERS_PER_MAP);
+	root.read_attr("solid_object_cache", use_solid_object_candidates);
+	
 	BOOST_FOREACH(InfoTree monster, root.children_named("monster"))
 	{
 		int16 index;
@@ -343,6 +343,15 @@ uint8 *pack_monster_definition(uint8 *Stream, size_t Count);
 uint8* unpack_m1_monster_definition(uint8* Stream, size_t Count);
 void init_monster_definitions();
 
+// Slot in game_data.parameters[] holding the number of monsters that may look for targets
+// and the number that may build paths each tick; zero is the original one-at-a-time scheduling
+enum {
+	_monster_think_budget_parameter= 1
+};
+
+// The think budget MML asks for; new games record it in their game information
+int16 get_monster_think_budget();
+
 class InfoTree;
 void parse_mml_damage_kicks(const InfoTree& root);
 void reset_mml_damage_kicks();
@@ -44,6 +44,7 @@ Feb 10, 2000 (Loren Petrich):
 #include "map.h"
 #include "flood_map.h"
 #include "dynamic_limits.h"
+#include "Packing.h"
 
 #ifdef DEBUG
 //#define VALIDATE_PATH_SPACE
@@ -324,6 +325,65 @@ void delete_path(
 	paths[path_index].step_count= NONE;
 }
 
+#define SIZEOF_path_definition (2*sizeof(int16)+MAXIMUM_POINTS_PER_PATH*2*sizeof(int16))
+
+size_t get_paths_state_size(
+	void)
+{
+	return sizeof(int16)+MAXIMUM_PATHS*SIZEOF_path_definition;
+}
+
+uint8 *pack_paths_state(
+	uint8 *Stream)
+{
+	uint8 *S= Stream;
+	
+	ValueToStream(S,int16(MAXIMUM_PATHS));
+	for (short path_index=0;path_index<MAXIMUM_PATHS;++path_index)
+	{
+		struct path_definition *path= paths+path_index;
+		
+		ValueToStream(S,path->current_step);
+		ValueToStream(S,path->step_count);
+		for (short i=0;i<MAXIMUM_POINTS_PER_PATH;++i)
+		{
+			ValueToStream(S,path->points[i].x);
+			ValueToStream(S,path->points[i].y);
+		}
+	}
+	
+	assert(size_t(S - Stream) == get_paths_state_size());
+	return S;
+}
+
+/* Leaves the paths alone if they don't fit */
+bool unpack_paths_state(
+	uint8 *Stream,
+	size_t length)
+{
+	uint8 *S= Stream;
+	int16 path_count;
+	
+	if (length!=get_paths_state_size()) return false;
+	StreamToValue(S,path_count);
+	if (path_count!=MAXIMUM_PATHS) return false;
+	
+	for (short path_index=0;path_index<MAXIMUM_PATHS;++path_index)
+	{
+		struct path_definition *path= paths+path_index;
+		
+		StreamToValue(S,path->current_step);
+		StreamToValue(S,path->step_count);
+		for (short i=0;i<MAXIMUM_POINTS_PER_PATH;++i)
+		{
+			StreamToValue(S,path->points[i].x);
+			StreamToValue(S,path->points[i].y);
+		}
+	}
+	
+	return true;
+}
+
 /* ---------- private code */
 
 static void calculate_midpoint_of_shared_line(
@@ -76,6 +76,7 @@ Jun 30, 2002 (tiennou):
 // LP addition: XML parser for damage
 #include "items.h"
 #include "Packing.h"
+#include "slot_allocator.h"
 
 //MH: Lua scripting
 #include "lua_script.h"
@@ -84,6 +85,8 @@ Jun 30, 2002 (tiennou):
 
 #include "editor.h" // MARATHON_ONE_DATA_VERSION
 
+#include <vector>
+
 /*
 //opening sounds made by closed platforms are sometimes obscured
 */
@@ -96,6 +99,16 @@ Jun 30, 2002 (tiennou):
 
 #include "platform_definitions.h"
 
+// Only active platforms, and those whose state just changed, have anything to do
+// in update_platforms(); a bitset of them lets the rest of a level's platforms
+// (nearly all of them, most of the time) be skipped. The platforms' own flags
+// remain the authority, and the bitset is rebuilt from them whenever the
+// platform list is replaced.
+static std::vector<Uint64> awake_platforms;
+static short awake_platform_count = 0;
+static uint32 awake_platform_generation = 0;
+static bool awake_platforms_valid = false;
+
 /* ---------- private prototypes */
 
 static short polygon_index_to_platform_index(short polygon_index);
@@ -112,6 +125,10 @@ static void play_platform_sound(short platform_index, short sound_code);
 
 static platform_definition *get_platform_definition(const short type);
 
+static void wake_platform(short platform_index);
+static void validate_awake_platforms();
+static short next_awake_platform(short platform_index);
+
 /* ---------- code */
 
 platform_data *get_platform_data(
@@ -254,11 +271,15 @@ void update_platforms(
 {
 	short platform_index;
 	struct platform_data *platform;
-	
-	for (platform_index= 0, platform= platforms; platform_index<dynamic_world->platform_count; ++platform_index, ++platform)
+
+	validate_awake_platforms();
+
+	/* platforms activated by one earlier in the list are still reached this tick */
+	for (platform_index= next_awake_platform(0); platform_index!=NONE; platform_index= next_awake_platform(platform_index+1))
 	{
+		platform= platforms+platform_index;
 		CLEAR_PLATFORM_WAS_JUST_ACTIVATED_OR_DEACTIVATED(platform);
-		
+
 		if (PLATFORM_IS_ACTIVE(platform))
 		{
 			struct polygon_data *polygon= get_polygon_data(platform->polygon_index);
@@ -696,6 +717,75 @@ static short polygon_index_to_platform_index(
 	return platform_index;
 }
 
+static bool platform_is_awake(
+	struct platform_data *platform)
+{
+	return PLATFORM_IS_ACTIVE(platform) || PLATFORM_WAS_JUST_ACTIVATED_OR_DEACTIVATED(platform);
+}
+
+static bool awake_platforms_are_current(
+	void)
+{
+	return awake_platforms_valid && awake_platform_generation==slot_allocator_generation &&
+		awake_platform_count==dynamic_world->platform_count;
+}
+
+static void wake_platform(
+	short platform_index)
+{
+	// an out-of-date bitset is rebuilt from the flags on the next update
+	if (!awake_platforms_are_current()) return;
+	
+	awake_platforms[platform_index/64]|= Uint64(1)<<(platform_index%64);
+}
+
+static void validate_awake_platforms(
+	void)
+{
+	if (awake_platforms_are_current()) return;
+	
+	awake_platform_count= dynamic_world->platform_count;
+	awake_platforms.assign((awake_platform_count+63)/64, 0);
+	for (short platform_index= 0; platform_index<awake_platform_count; ++platform_index)
+	{
+		if (platform_is_awake(platforms+platform_index))
+			awake_platforms[platform_index/64]|= Uint64(1)<<(platform_index%64);
+	}
+	
+	awake_platform_generation= slot_allocator_generation;
+	awake_platforms_valid= true;
+}
+
+/* the first awake platform at or after platform_index, or NONE; platforms that have
+	settled since they were woken are dropped on the way, since updating them would
+	do nothing */
+static short next_awake_platform(
+	short platform_index)
+{
+	for (size_t word_index= platform_index/64; word_index<awake_platforms.size(); ++word_index)
+	{
+		Uint64 word= awake_platforms[word_index];
+		if (word_index==size_t(platform_index/64)) word&= ~Uint64(0)<<(platform_index%64);
+		
+		while (word)
+		{
+#ifdef __GNUC__
+			int bit= __builtin_ctzll(word);
+#else
+			int bit= 0;
+			while (!(word&(Uint64(1)<<bit))) ++bit;
+#endif
+			word&= ~(Uint64(1)<<bit);
+			
+			short index= static_cast<short>(word_index*64+bit);
+			if (platform_is_awake(platforms+index)) return index;
+			awake_platforms[word_index]&= ~(Uint64(1)<<bit);
+		}
+	}
+	
+	return NONE;
+}
+
 bool set_platform_state(
 	short platform_index,
 	bool state,
@@ -715,7 +805,8 @@ bool set_platform_state(
 				
 				/* the state of this platform cannot be changed again this tick */
 				SET_PLATFORM_WAS_JUST_ACTIVATED_OR_DEACTIVATED(platform);
-				
+				wake_platform(platform_index);
+
 				if (state)
 				{
 					SET_PLATFORM_HAS_BEEN_ACTIVATED(platform);
@@ -96,8 +96,10 @@ Oct 13, 2000 (Loren Petrich)
 // LP additions
 #include "dynamic_limits.h"
 #include "Packing.h"
+#include "PackingSchema.h"
 
 #include "lua_script.h"
+#include "slot_allocator.h"
 
 /*
 //translate_projectile() must set _projectile_hit_landscape bit
@@ -143,6 +145,8 @@ short human_projectile_override= NONE;
 // LP addition: growable list of intersected objects
 static vector<short> IntersectedObjects;
 
+static slot_allocator<projectile_data> ProjectileSlots(ProjectileList);
+
 /* ---------- private prototypes */
 
 static short adjust_projectile_type(world_point3d *origin, short polygon_index, short type,
@@ -261,57 +265,54 @@ short new_projectile(
 	type= adjust_projectile_type(origin, polygon_index, type, owner_index, owner_type, intended_target_index, damage_scale);
 	definition= get_projectile_definition(type);
 
-	for (projectile_index= 0, projectile= projectiles; projectile_index<MAXIMUM_PROJECTILES_PER_MAP;
-		++projectile_index, ++projectile)
+	projectile_index= ProjectileSlots.find_free();
+	if (projectile_index!=NONE)
 	{
-		if (SLOT_IS_FREE(projectile))
-		{
-			angle facing, elevation;
-			short object_index;
-			struct object_data *object;
+		projectile= projectiles + projectile_index;
+		
+		angle facing, elevation;
+		short object_index;
+		struct object_data *object;
 
-			facing= arctangent(_vector->x, _vector->y);
-			elevation= arctangent(isqrt(_vector->x*_vector->x+_vector->y*_vector->y), _vector->z);
-			if (delta_theta)
-			{
-				if (!(definition->flags&_no_horizontal_error)) facing= normalize_angle(facing+global_random()%(2*delta_theta)-delta_theta);
-				if (!(definition->flags&_no_vertical_error)) elevation= (definition->flags&_positive_vertical_error) ? normalize_angle(elevation+global_random()%delta_theta) :
-					normalize_angle(elevation+global_random()%(2*delta_theta)-delta_theta);
-			}
-			
-			object_index= new_map_object3d(origin, polygon_index, definition->collection==NONE ? NONE : BUILD_DESCRIPTOR(definition->collection, definition->shape), facing);
-			if (object_index!=NONE)
-			{
-				object= get_object_data(object_index);
-				
-				projectile->type= (definition->flags&_alien_projectile) ?
-					(alien_projectile_override==NONE ? type : alien_projectile_override) :
-					(human_projectile_override==NONE ? type : human_projectile_override);
-				projectile->object_index= object_index;
-				projectile->owner_index= owner_index;
-				projectile->target_index= intended_target_index;
-				projectile->owner_type= owner_type;
-				projectile->flags= 0;
-				projectile->gravity= 0;
-				projectile->ticks_since_last_contrail= projectile->contrail_count= 0;
-				projectile->elevation= elevation;
-				projectile->distance_travelled= 0;
-				projectile->damage_scale= damage_scale;
-				MARK_SLOT_AS_USED(projectile);
-
-				SET_OBJECT_OWNER(object, _object_is_projectile);
-				object->sound_pitch= definition->sound_pitch;
-				L_Call_Projectile_Created(projectile_index);
-			}
-			else
-			{
-				projectile_index= NONE;
-			}
+		facing= arctangent(_vector->x, _vector->y);
+		elevation= arctangent(isqrt(_vector->x*_vector->x+_vector->y*_vector->y), _vector->z);
+		if (delta_theta)
+		{
+			if (!(definition->flags&_no_horizontal_error)) facing= normalize_angle(facing+global_random()%(2*delta_theta)-delta_theta);
+			if (!(definition->flags&_no_vertical_error)) elevation= (definition->flags&_positive_vertical_error) ? normalize_angle(elevation+global_random()%delta_theta) :
+				normalize_angle(elevation+global_random()%(2*delta_theta)-delta_theta);
+		}
+		
+		object_index= new_map_object3d(origin, polygon_index, definition->collection==NONE ? NONE : BUILD_DESCRIPTOR(definition->collection, definition->shape), facing);
+		if (object_index!=NONE)
+		{
+			object= get_object_data(object_index);
 			
-			break;
+			projectile->type= (definition->flags&_alien_projectile) ?
+				(alien_projectile_override==NONE ? type : alien_projectile_override) :
+				(human_projectile_override==NONE ? type : human_projectile_override);
+			projectile->object_index= object_index;
+			projectile->owner_index= owner_index;
+			projectile->target_index= intended_target_index;
+			projectile->owner_type= owner_type;
+			projectile->flags= 0;
+			projectile->gravity= 0;
+			projectile->ticks_since_last_contrail= projectile->contrail_count= 0;
+			projectile->elevation= elevation;
+			projectile->distance_travelled= 0;
+			projectile->damage_scale= damage_scale;
+			MARK_SLOT_AS_USED(projectile);
+			ProjectileSlots.mark_used(projectile_index);
+
+			SET_OBJECT_OWNER(object, _object_is_projectile);
+			object->sound_pitch= definition->sound_pitch;
+			L_Call_Projectile_Created(projectile_index);
+		}
+		else
+		{
+			projectile_index= NONE;
 		}
 	}
-	if (projectile_index==MAXIMUM_PROJECTILES_PER_MAP) projectile_index= NONE;
 	
 	return projectile_index;
 }
@@ -583,6 +584,7 @@ void remove_projectile(
 	L_Invalidate_Projectile(projectile_index);
 	remove_map_object(projectile->object_index);
 	MARK_SLOT_AS_FREE(projectile);
+	ProjectileSlots.mark_free(projectile_index);
 }
 
 void remove_all_projectiles(
@@ -1072,78 +1074,42 @@ bool ProjectileIsGuided(short Type)
 }
 
 
-uint8 *unpack_projectile_data(uint8 *Stream, projectile_data* Objects, size_t Count)
-{
-	uint8* S = Stream;
-	projectile_data* ObjPtr = Objects;
+static constexpr packed_field projectile_fields[] = {
+	PACKED_FIELD(projectile_data, type),
 	
-	for (size_t k = 0; k < Count; k++, ObjPtr++)
-	{
-		StreamToValue(S,ObjPtr->type);
-		
-		StreamToValue(S,ObjPtr->object_index);
-		
-		StreamToValue(S,ObjPtr->target_index);
-		
-		StreamToValue(S,ObjPtr->elevation);
-		
-		StreamToValue(S,ObjPtr->owner_index);
-		StreamToValue(S,ObjPtr->owner_type);
-		StreamToValue(S,ObjPtr->flags);
-		
-		StreamToValue(S,ObjPtr->ticks_since_last_contrail);
-		StreamToValue(S,ObjPtr->contrail_count);
-		
-		StreamToValue(S,ObjPtr->distance_travelled);
-		
-		StreamToValue(S,ObjPtr->gravity);
-		
-		StreamToValue(S,ObjPtr->damage_scale);
-		
-		StreamToValue(S,ObjPtr->permutation);
-		
-		S += 2*2;
-	}
+	PACKED_FIELD(projectile_data, object_index),
 	
-	assert((S - Stream) == static_cast<ptrdiff_t>(Count*SIZEOF_projectile_data));
-	return S;
+	PACKED_FIELD(projectile_data, target_index),
+	
+	PACKED_FIELD(projectile_data, elevation),
+	
+	PACKED_FIELD(projectile_data, owner_index),
+	PACKED_FIELD(projectile_data, owner_type),
+	PACKED_FIELD(projectile_data, flags),
+	
+	PACKED_FIELD(projectile_data, ticks_since_last_contrail),
+	PACKED_FIELD(projectile_data, contrail_count),
+	
+	PACKED_FIELD(projectile_data, distance_travelled),
+	
+	PACKED_FIELD(projectile_data, gravity),
+	
+	PACKED_FIELD(projectile_data, damage_scale),
+	
+	PACKED_FIELD(projectile_data, permutation),
+	
+	PACKED_PADDING(2*2)
+};
+DEFINE_PACKING_SCHEMA(projectile_schema, projectile_data, projectile_fields, SIZEOF_projectile_data);
+
+uint8 *unpack_projectile_data(uint8 *Stream, projectile_data* Objects, size_t Count)
+{
+	return projectile_schema.unpack(Stream, Objects, Count);
 }
 
 uint8 *pack_projectile_data(uint8 *Stream, projectile_data* Objects, size_t Count)
 {
-	uint8* S = Stream;
-	projectile_data* ObjPtr = Objects;
-	
-	for (size_t k = 0; k < Count; k++, ObjPtr++)
-	{
-		ValueToStream(S,ObjPtr->type);
-		
-		ValueToStream(S,ObjPtr->object_index);
-		
-		ValueToStream(S,ObjPtr->target_index);
-		
-		ValueToStream(S,ObjPtr->elevation);
-		
-		ValueToStream(S,ObjPtr->owner_index);
-		ValueToStream(S,ObjPtr->owner_type);
-		ValueToStream(S,ObjPtr->flags);
-		
-		ValueToStream(S,ObjPtr->ticks_since_last_contrail);
-		ValueToStream(S,ObjPtr->contrail_count);
-		
-		ValueToStream(S,ObjPtr->distance_travelled);
-		
-		ValueToStream(S,ObjPtr->gravity);
-		
-		ValueToStream(S,ObjPtr->damage_scale);
-		
-		ValueToStream(S,ObjPtr->permutation);
-		
-		S += 2*2;
-	}
-	
-	assert((S - Stream) == static_cast<ptrdiff_t>(Count*SIZEOF_projectile_data));
-	return S;
+	return projectile_schema.pack(Stream, Objects, Count);
 }
 
 
@@ -0,0 +1,166 @@
+#ifndef SLOT_ALLOCATOR_H
+#define SLOT_ALLOCATOR_H
+
+/*
+	Copyright (C) 2026 and beyond by the "Aleph One" developers.
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This license is contained in the file "COPYING",
+	which is included with this source code; it is available online at
+	http://www.gnu.org/licenses/gpl.html
+
+	Lowest-free-slot lookup for the object, monster, projectile and effect lists
+
+	The slot lists mark their entries with SLOT_IS_USED(); finding room for a new
+	entry used to mean scanning for the first free one. A slot_allocator keeps a
+	hierarchical bitset of the free slots beside the list, so that the same slot
+	(always the lowest free one, which films and network games depend on) is
+	found with a find-first-set per level instead.
+
+	Whoever marks a slot used or free tells the allocator. When a list is
+	replaced wholesale (a new level, a loaded game), invalidate_slot_allocators()
+	makes every allocator rebuild itself from the slot flags on next use.
+*/
+
+#include "map.h"
+
+#include <vector>
+
+// bumped by invalidate_slot_allocators()
+extern uint32 slot_allocator_generation;
+
+template<class T> class slot_allocator
+{
+public:
+	explicit slot_allocator(std::vector<T>& list) :
+		list_(list),
+		size_(0),
+		generation_(slot_allocator_generation - 1)
+	{
+	}
+
+	// the lowest free slot, or NONE
+	int16 find_free()
+	{
+		validate();
+
+		for (;;)
+		{
+			int32 index = lowest_candidate();
+			if (index == NONE)
+				return NONE;
+
+			// someone marked it used behind our back; don't offer it again
+			if (SLOT_IS_FREE(&list_[index]))
+				return static_cast<int16>(index);
+			set_bit(index, false);
+		}
+	}
+
+	void mark_used(int16 index)
+	{
+		if (is_valid())
+			set_bit(index, false);
+	}
+
+	void mark_free(int16 index)
+	{
+		if (is_valid())
+			set_bit(index, true);
+	}
+
+private:
+	typedef Uint64 word;
+	enum { kBitsPerWord = 64 };
+
+	bool is_valid() const
+	{
+		return generation_ == slot_allocator_generation && size_ == list_.size();
+	}
+
+	void validate()
+	{
+		if (is_valid())
+			return;
+
+		size_ = list_.size();
+		levels_.clear();
+		size_t count = size_;
+		do
+		{
+			count = (count + kBitsPerWord - 1) / kBitsPerWord;
+			levels_.push_back(std::vector<word>(count, 0));
+		}
+		while (count > 1);
+
+		for (size_t i = 0; i < size_; ++i)
+		{
+			if (SLOT_IS_FREE(&list_[i]))
+				set_bit(i, true);
+		}
+
+		generation_ = slot_allocator_generation;
+	}
+
+	// each level's bit is set if any bit in the word below it is
+	void set_bit(size_t index, bool value)
+	{
+		for (size_t level = 0; level < levels_.size(); ++level)
+		{
+			word& w = levels_[level][index / kBitsPerWord];
+			word bit = word(1) << (index % kBitsPerWord);
+			bool was_empty = !w;
+			if (value)
+				w |= bit;
+			else
+				w &= ~bit;
+
+			// the summary above only changes when this word becomes empty or stops being so
+			if (was_empty == !w)
+				break;
+			index /= kBitsPerWord;
+		}
+	}
+
+	int32 lowest_candidate() const
+	{
+		if (levels_.back().empty() || !levels_.back()[0])
+			return NONE;
+
+		size_t index = 0;
+		for (size_t level = levels_.size(); level-- > 0; )
+			index = index * kBitsPerWord + first_set_bit(levels_[level][index]);
+		return static_cast<int32>(index);
+	}
+
+	static int first_set_bit(word w)
+	{
+#ifdef __GNUC__
+		return __builtin_ctzll(w);
+#else
+		int bit = 0;
+		while (!(w & 1))
+		{
+			w >>= 1;
+			++bit;
+		}
+		return bit;
+#endif
+	}
+
+	std::vector<T>& list_;
+	std::vector<std::vector<word> > levels_;
+	size_t size_;
+	uint32 generation_;
+};
+
+#endif
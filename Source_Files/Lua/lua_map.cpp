@@ -27,6 +27,7 @@ LUA_MAP.CPP
 #include "lua_map.h"
 #include "lua_monsters.h"
 #include "lua_objects.h"
+#include "lua_projectiles.h"
 #include "lua_templates.h"
 #include "lightsource.h"
 #include "map.h"
@@ -1224,6 +1225,55 @@ int Lua_Polygon_Monsters(lua_State *L)
 	return 1;
 }
 
+// objects(): the monsters, items, scenery, projectiles and effects in this
+// polygon, in the order the polygon lists them
+int Lua_Polygon_Objects(lua_State *L)
+{
+	polygon_data *polygon = get_polygon_data(Lua_Polygon::Index(L, 1));
+	
+	int table_index = 1;
+	short object_index = polygon->first_object;
+
+	lua_pushnumber(L, 1);
+	lua_newtable(L);
+	while (object_index != NONE)
+	{
+		object_data *object = get_object_data(object_index);
+		bool pushed = true;
+		switch (GET_OBJECT_OWNER(object))
+		{
+		case _object_is_monster:
+			Lua_Monster::Push(L, object->permutation);
+			break;
+		case _object_is_item:
+			Lua_Item::Push(L, object_index);
+			break;
+		case _object_is_scenery:
+			Lua_Scenery::Push(L, object_index);
+			break;
+		case _object_is_projectile:
+			Lua_Projectile::Push(L, object->permutation);
+			break;
+		case _object_is_effect:
+			Lua_Effect::Push(L, object->permutation);
+			break;
+		default:
+			// players' legs and other parts, and objects on their way out
+			pushed = false;
+			break;
+		}
+		if (pushed)
+		{
+			lua_rawseti(L, -2, table_index++);
+		}
+
+		object_index = object->next_object;
+	}
+	
+	lua_pushcclosure(L, Lua_Polygon_Monsters_Iterator, 2);
+	return 1;
+}
+
 // play_sound(sound) or play_sound(x, y, z, sound, [pitch])
 int Lua_Polygon_Play_Sound(lua_State *L)
 {
@@ -1449,6 +1499,7 @@ const luaL_Reg Lua_Polygon_Get[] = {
 	{"lines", Lua_Polygon_Get_Lines},
 	{"media", Lua_Polygon_Get_Media},
 	{"monsters", L_TableFunction<Lua_Polygon_Monsters>},
+	{"objects", L_TableFunction<Lua_Polygon_Objects>},
 	{"permutation", Lua_Polygon_Get_Permutation},
 	{"platform", Lua_Polygon_Get_Platform},
 	{"play_sound", L_TableFunction<Lua_Polygon_Play_Sound>},
@@ -1475,6 +1526,120 @@ int16 Lua_Polygons_Length() {
 	return dynamic_world->polygon_count;
 }
 
+// Polygons.along_line(polygon, x1, y1, x2, y2)
+// the polygons a line from (x1, y1) crosses until it ends or meets a solid
+// line, and that line (or nil)
+int Lua_Polygons_Along_Line(lua_State *L)
+{
+	short polygon_index;
+	if (lua_isnumber(L, 1))
+	{
+		polygon_index = static_cast<short>(lua_tonumber(L, 1));
+		if (!Lua_Polygon::Valid(polygon_index))
+			return luaL_error(L, "along_line: invalid polygon index");
+	}
+	else if (Lua_Polygon::Is(L, 1))
+	{
+		polygon_index = Lua_Polygon::Index(L, 1);
+	}
+	else
+		return luaL_error(L, "along_line: incorrect argument type");
+
+	if (!lua_isnumber(L, 2) || !lua_isnumber(L, 3) || !lua_isnumber(L, 4) || !lua_isnumber(L, 5))
+		return luaL_error(L, "along_line: incorrect argument type");
+
+	world_point2d origin;
+	origin.x = static_cast<world_distance>(lua_tonumber(L, 2) * WORLD_ONE);
+	origin.y = static_cast<world_distance>(lua_tonumber(L, 3) * WORLD_ONE);
+
+	world_point2d destination;
+	destination.x = static_cast<world_distance>(lua_tonumber(L, 4) * WORLD_ONE);
+	destination.y = static_cast<world_distance>(lua_tonumber(L, 5) * WORLD_ONE);
+
+	static std::vector<short> polygons;
+	polygons.clear();
+	short solid_line_index = NONE;
+	for (;;)
+	{
+		polygons.push_back(polygon_index);
+
+		short line_index = find_line_crossed_leaving_polygon(polygon_index, &origin, &destination);
+		if (line_index == NONE)
+			break;
+
+		// a line can't cross more polygons than there are, but bad geometry can loop
+		short adjacent_polygon_index = find_adjacent_polygon(polygon_index, line_index);
+		if (LINE_IS_SOLID(get_line_data(line_index)) || adjacent_polygon_index == NONE ||
+			polygons.size() >= static_cast<size_t>(dynamic_world->polygon_count))
+		{
+			solid_line_index = line_index;
+			break;
+		}
+
+		polygon_index = adjacent_polygon_index;
+	}
+
+	lua_createtable(L, polygons.size(), 0);
+	for (size_t i = 0; i < polygons.size(); ++i)
+	{
+		Lua_Polygon::Push(L, polygons[i]);
+		lua_rawseti(L, -2, i + 1);
+	}
+
+	if (solid_line_index != NONE)
+		Lua_Line::Push(L, solid_line_index);
+	else
+		lua_pushnil(L);
+
+	return 2;
+}
+
+const luaL_Reg Lua_Polygons_Methods[] = {
+	{"along_line", L_TableFunction<Lua_Polygons_Along_Line>},
+	{0, 0}
+};
+
+// reads (x, y, z, polygon) from index on, as Monsters.new() does
+void Lua_To_Location(lua_State *L, int index, const char *name, world_point3d& point, short& polygon_index)
+{
+	if (!lua_isnumber(L, index) || !lua_isnumber(L, index + 1) || !lua_isnumber(L, index + 2))
+		luaL_error(L, "%s: incorrect argument type", name);
+
+	if (lua_isnumber(L, index + 3))
+	{
+		polygon_index = static_cast<short>(lua_tonumber(L, index + 3));
+		if (!Lua_Polygon::Valid(polygon_index))
+			luaL_error(L, "%s: invalid polygon index", name);
+	}
+	else if (Lua_Polygon::Is(L, index + 3))
+	{
+		polygon_index = Lua_Polygon::Index(L, index + 3);
+	}
+	else
+		luaL_error(L, "%s: incorrect argument type", name);
+
+	point.x = static_cast<world_distance>(lua_tonumber(L, index) * WORLD_ONE);
+	point.y = static_cast<world_distance>(lua_tonumber(L, index + 1) * WORLD_ONE);
+	point.z = static_cast<world_distance>(lua_tonumber(L, index + 2) * WORLD_ONE);
+}
+
+// in_radius(x, y, z, polygon, radius, [unobstructed])
+void Lua_Find_Objects_In_Radius(lua_State *L, short owner, std::vector<short>& object_indexes)
+{
+	world_point3d center;
+	short polygon_index;
+	Lua_To_Location(L, 1, "in_radius", center, polygon_index);
+
+	if (!lua_isnumber(L, 5))
+		luaL_error(L, "in_radius: incorrect argument type");
+	int32 radius = static_cast<int32>(lua_tonumber(L, 5) * WORLD_ONE);
+	if (radius < 0)
+		luaL_error(L, "in_radius: radius must not be negative");
+	bool unobstructed = lua_toboolean(L, 6);
+
+	find_objects_within_radius(polygon_index, &center, radius, owner, unobstructed, object_indexes);
+}
+
 char Lua_Side_ControlPanel_Name[] = "side_control_panel";
 typedef L_Class<Lua_Side_ControlPanel_Name> Lua_Side_ControlPanel;
 
@@ -2331,8 +2496,11 @@ static int Lua_Light_State_Set_Delta_Period(lua_State* L)
 static int Lua_Light_State_Set_Function(lua_State* L)
 {
 	int16 function = Lua_LightFunction::ToIndex(L, 2);
-	lighting_function_specification* spec = get_light_function_spec(Lua_Light_State::LightIndex(L, 1), Lua_Light_State::Index(L, 1));
+	int light_index = Lua_Light_State::LightIndex(L, 1);
+	lighting_function_specification* spec = get_light_function_spec(light_index, Lua_Light_State::Index(L, 1));
 	spec->function = function;
+	// a constant light may be asleep
+	wake_light(light_index);
 	return 1;
 }
 
@@ -3317,7 +3485,7 @@ int Lua_Map_register(lua_State *L)
 	Lua_Polygon::Register(L, Lua_Polygon_Get, Lua_Polygon_Set);
 	Lua_Polygon::Valid = Lua_Polygon_Valid;
 
-	Lua_Polygons::Register(L);
+	Lua_Polygons::Register(L, Lua_Polygons_Methods);
 	Lua_Polygons::Length = Lua_Polygons_Length;
 
 	Lua_Side_ControlPanel::Register(L, Lua_Side_ControlPanel_Get, Lua_Side_ControlPanel_Set);
@@ -140,6 +140,11 @@ typedef L_Class<Lua_Media_Name> Lua_Media;
 extern char Lua_Medias_Name[]; // "Media"
 typedef L_Container<Lua_Medias_Name, Lua_Media> Lua_Medias;
 
+// spatial queries share their arguments: (x, y, z, polygon) from index on,
+// and in_radius's (x, y, z, polygon, radius, [unobstructed])
+void Lua_To_Location(lua_State *L, int index, const char *name, world_point3d& point, short& polygon_index);
+void Lua_Find_Objects_In_Radius(lua_State *L, short owner, std::vector<short>& object_indexes);
+
 int Lua_Map_register (lua_State *L);
 
 #endif
@@ -1007,7 +1007,24 @@ int Lua_Monsters_New(lua_State *L)
 	return 1;
 }
 
+// Monsters.in_radius(x, y, z, polygon, radius, [unobstructed])
+// the monsters within radius of the point, nearest first
+int Lua_Monsters_In_Radius(lua_State *L)
+{
+	static std::vector<short> object_indexes;
+	Lua_Find_Objects_In_Radius(L, _object_is_monster, object_indexes);
+
+	lua_createtable(L, object_indexes.size(), 0);
+	for (size_t i = 0; i < object_indexes.size(); ++i)
+	{
+		Lua_Monster::Push(L, get_object_data(object_indexes[i])->permutation);
+		lua_rawseti(L, -2, i + 1);
+	}
+	return 1;
+}
+
 const luaL_Reg Lua_Monsters_Methods[] = {
+	{"in_radius", L_TableFunction<Lua_Monsters_In_Radius>},
 	{"new", L_TableFunction<Lua_Monsters_New>},
 	{0, 0}
 };
@@ -417,7 +417,24 @@ int Lua_Items_New(lua_State *L)
 	return 1;
 }
 
+// Items.in_radius(x, y, z, polygon, radius, [unobstructed])
+// the items within radius of the point, nearest first
+int Lua_Items_In_Radius(lua_State *L)
+{
+	static std::vector<short> object_indexes;
+	Lua_Find_Objects_In_Radius(L, _object_is_item, object_indexes);
+
+	lua_createtable(L, object_indexes.size(), 0);
+	for (size_t i = 0; i < object_indexes.size(); ++i)
+	{
+		Lua_Item::Push(L, object_indexes[i]);
+		lua_rawseti(L, -2, i + 1);
+	}
+	return 1;
+}
+
 const luaL_Reg Lua_Items_Methods[] = {
+	{"in_radius", L_TableFunction<Lua_Items_In_Radius>},
 	{"new", L_TableFunction<Lua_Items_New>},
 	{0, 0}
 };
@@ -2278,8 +2278,48 @@ int Lua_Players_Get_Local_Player(lua_State *L)
 	return 1;
 }
 
+// Players.nearest(x, y, z, polygon, [unobstructed])
+// the nearest living player, the lowest index winning ties, or nil
+int Lua_Players_Nearest(lua_State *L)
+{
+	world_point3d point;
+	short polygon_index;
+	Lua_To_Location(L, 1, "nearest", point, polygon_index);
+	bool unobstructed = lua_toboolean(L, 5);
+
+	short nearest_player_index = NONE;
+	Sint64 nearest_distance = 0;
+	for (short player_index = 0; player_index < dynamic_world->player_count; ++player_index)
+	{
+		player_data *player = get_player_data(player_index);
+		if (PLAYER_IS_DEAD(player))
+			continue;
+
+		object_data *object = get_object_data(player->object_index);
+		Sint64 dx = object->location.x - point.x;
+		Sint64 dy = object->location.y - point.y;
+		Sint64 dz = object->location.z - point.z;
+		Sint64 distance = dx * dx + dy * dy + dz * dz;
+		if (nearest_player_index != NONE && distance >= nearest_distance)
+			continue;
+
+		if (unobstructed && line_is_obstructed(polygon_index, (world_point2d *) &point, object->polygon, (world_point2d *) &object->location))
+			continue;
+
+		nearest_player_index = player_index;
+		nearest_distance = distance;
+	}
+
+	if (nearest_player_index == NONE)
+		lua_pushnil(L);
+	else
+		Lua_Player::Push(L, nearest_player_index);
+	return 1;
+}
+
 const luaL_Reg Lua_Players_Get[] = {
 	{"local_player", Lua_Players_Get_Local_Player},
+	{"nearest", L_TableFunction<Lua_Players_Nearest>},
 	{"print", L_TableFunction<Lua_Players_Print>},
 	{0, 0}
 };
@@ -23,11 +23,40 @@ LUA_SERIALIZE.CPP
 
 #include "lua_serialize.h"
 #include "Logging.h"
+#include "Profiler.h"
 
 #include "BStream.h"
 
+#include <cmath>
+#include <string.h>
+#include <unordered_map>
+#include <vector>
+
 const static int SAVED_REFERENCE_PSEUDOTYPE = -2;
-const uint16 kVersion = 1;
+const uint16 kVersion = 2;
+
+// Version 1 tagged every value with its Lua type, wrote numbers as doubles
+// and strings in full, and is still read. Version 2 is written as a stream
+// of these tags; tables and userdata, and separately strings, are numbered
+// in the order they first appear, and later appearances refer back to them.
+const uint16 kFirstCompactVersion = 2;
+
+enum {
+	_tag_nil,
+	_tag_false,
+	_tag_true,
+	_tag_integer,		// zigzag varint
+	_tag_number,		// big-endian double
+	_tag_string,		// varint length, then the bytes
+	_tag_string_reference,	// varint string number
+	_tag_table,		// key, value, key, value... then _tag_end
+	_tag_end,
+	_tag_userdata,		// type name (a string), then varint index
+	_tag_reference		// varint table or userdata number
+};
+
+// doubles hold every integer up to this exactly
+const static double kMaxExactInteger = 9007199254740992.0;
 
 static bool valid_key(int type)
 {
@@ -38,120 +67,225 @@ static bool valid_key(int type)
 		type == LUA_TUSERDATA);
 }
 
-static void save(lua_State *L, BOStreamBE& s, uint32& counter)
+// a string Lua is holding on to while we save
+struct saved_string
 {
-	// if the object has already been written, write a reference to it
+	const char *s;
+	size_t length;
 
-	lua_pushvalue(L, -1);
-	lua_rawget(L, 1);
-	if (!lua_isnil(L, -1))
+	bool operator==(const saved_string& other) const
 	{
-		s << static_cast<int8>(SAVED_REFERENCE_PSEUDOTYPE)
-		  << static_cast<uint32>(lua_tonumber(L, -1));
-		lua_pop(L, 1);
-		return;
+		return length == other.length && memcmp(s, other.s, length) == 0;
 	}
-	lua_pop(L, 1);
+};
 
-	s << static_cast<int8>(lua_type(L, -1));
-	switch (lua_type(L, -1))
+struct saved_string_hash
+{
+	size_t operator()(const saved_string& string) const
 	{
-		case LUA_TNIL:
-			break;
-		case LUA_TNUMBER:
-			{
-				s << static_cast<double>(lua_tonumber(L, -1));
-			}
-			break;
-		case LUA_TBOOLEAN:
-			s << static_cast<uint8>(lua_toboolean(L, -1) ? 1 : 0);
-			break;
-		case LUA_TSTRING: 
+		// FNV-1a
+		uint32 hash = 2166136261u;
+		for (size_t i = 0; i < string.length; i++)
+			hash = (hash ^ static_cast<uint8>(string.s[i])) * 16777619u;
+		return hash;
+	}
+};
+
+class compact_writer
+{
+public:
+	compact_writer(lua_State *L, std::vector<uint8>& buffer) : L(L), m_buffer(buffer) { }
+
+	void put_byte(uint8 value) { m_buffer.push_back(value); }
+
+	void put_varint(Uint64 value)
+	{
+		while (value >= 0x80)
+		{
+			put_byte(static_cast<uint8>(value) | 0x80);
+			value >>= 7;
+		}
+		put_byte(static_cast<uint8>(value));
+	}
+
+	void put_number(lua_Number number)
+	{
+		double d = number;
+		if (d >= -kMaxExactInteger && d <= kMaxExactInteger && d == std::floor(d) && !(d == 0 && std::signbit(d)))
+		{
+			Sint64 i = static_cast<Sint64>(d);
+			put_byte(_tag_integer);
+			put_varint((static_cast<Uint64>(i) << 1) ^ static_cast<Uint64>(i >> 63));
+		}
+		else
+		{
+			Uint64 bits;
+			memcpy(&bits, &d, sizeof(bits));
+			put_byte(_tag_number);
+			for (int shift = 56; shift >= 0; shift -= 8)
+				put_byte(static_cast<uint8>(bits >> shift));
+		}
+	}
+
+	// every string is written once; the saved data keeps them all alive
+	// until we're done, so we needn't copy them
+	void put_string(const char *s, size_t length)
+	{
+		saved_string string = { s, length };
+		std::pair<std::unordered_map<saved_string, uint32, saved_string_hash>::iterator, bool> found =
+			m_strings.insert(std::make_pair(string, static_cast<uint32>(m_strings.size() + 1)));
+		if (!found.second)
+		{
+			put_byte(_tag_string_reference);
+			put_varint(found.first->second);
+			return;
+		}
+		put_byte(_tag_string);
+		put_varint(length);
+		m_buffer.insert(m_buffer.end(), s, s + length);
+	}
+
+	// writes the value on top of the stack, and pops it; but a table seen
+	// for the first time stays, with a nil key for lua_next() above it,
+	// and true is returned: its pairs are to be written, then _tag_end
+	bool begin_value()
+	{
+		int type = lua_type(L, -1);
+		if (type == LUA_TTABLE || type == LUA_TUSERDATA)
+		{
+			// if the object has already been written, write a reference to it
+			std::pair<std::unordered_map<const void *, uint32>::iterator, bool> found =
+				m_references.insert(std::make_pair(lua_topointer(L, -1), static_cast<uint32>(m_references.size() + 1)));
+			if (!found.second)
 			{
-				s << static_cast<uint32>(lua_rawlen(L, -1));
-				s.write(lua_tostring(L, -1), lua_rawlen(L, -1));
+				put_byte(_tag_reference);
+				put_varint(found.first->second);
+				lua_pop(L, 1);
+				return false;
 			}
-			break;
-		case LUA_TTABLE:
-			{
-				// add to the reference table
-				lua_pushvalue(L, -1);
-				lua_pushnumber(L, static_cast<lua_Number>(++counter));
-				lua_rawset(L, 1);
-
-				// write the reference
-				s << counter;
+		}
 
-				// write all k/v pairs
+		switch (type)
+		{
+			case LUA_TNUMBER:
+				put_number(lua_tonumber(L, -1));
+				break;
+			case LUA_TBOOLEAN:
+				put_byte(lua_toboolean(L, -1) ? _tag_true : _tag_false);
+				break;
+			case LUA_TSTRING:
+				{
+					size_t length;
+					const char *s = lua_tolstring(L, -1, &length);
+					put_string(s, length);
+				}
+				break;
+			case LUA_TTABLE:
+				if (!lua_checkstack(L, 4))
+					throw basic_bstream::failure("Lua tables nested too deeply");
+				put_byte(_tag_table);
 				lua_pushnil(L);
-				while (lua_next(L, -2)) 
+				return true;
+			case LUA_TUSERDATA:
 				{
-					if (valid_key(lua_type(L, -2))) {
-						// another key
-						lua_pushvalue(L, -2);
-						
-						save(L, s, counter);
-						lua_pop(L, 1);
-						
-						save(L, s, counter);
-						lua_pop(L, 1);
-					} else {
-						lua_pop(L, 1);
-					}
+					put_byte(_tag_userdata);
+
+					// assume that this is one of our userdata
+					if (!lua_getmetatable(L, -1))
+						lua_pushnil(L);
+					lua_rawget(L, LUA_REGISTRYINDEX);
+					size_t length = 0;
+					const char *name = lua_isstring(L, -1) ? lua_tolstring(L, -1, &length) : "";
+					put_string(name, length);
+					lua_pop(L, 1);
+
+					lua_getfield(L, -1, "index");
+					put_varint(static_cast<uint32>(lua_tonumber(L, -1)));
+					lua_pop(L, 1);
 				}
+				break;
+			default:
+				// nil, and we silently ignore other types
+				put_byte(_tag_nil);
+				break;
+		}
 
-				lua_pushnil(L);
-				save(L, s, counter);
-				lua_pop(L, 1);
-			}
-			break;
-		case LUA_TUSERDATA:
-			{
-				// add to the reference table
-				lua_pushvalue(L, -1);
-				lua_pushnumber(L, static_cast<lua_Number>(++counter));
-				lua_rawset(L, 1);
+		lua_pop(L, 1);
+		return false;
+	}
 
-				// write the reference
-				s << counter;
+private:
+	lua_State *L;
+	std::vector<uint8>& m_buffer;
+	std::unordered_map<const void *, uint32> m_references;
+	std::unordered_map<saved_string, uint32, saved_string_hash> m_strings;
+};
 
-				// assume that this is one of our userdata
-				lua_getmetatable(L, -1);
-				lua_gettable(L, LUA_REGISTRYINDEX);
+// walks the tables with a stack of its own, rather than recursing
+static void save_compact(lua_State *L, compact_writer& w)
+{
+	enum { _next_pair, _write_value };
 
-				s << static_cast<uint8>(lua_rawlen(L, -1));
-				s.write(lua_tostring(L, -1), lua_rawlen(L, -1));
-				lua_pop(L, 1);
+	// for each table being written, innermost last: what to do next
+	std::vector<int> tables;
 
-				lua_getfield(L, -1, "index");
-				
-				s << static_cast<uint32>(lua_tonumber(L, -1));
+	lua_pushvalue(L, -1);
+	if (w.begin_value())
+		tables.push_back(_next_pair);
+
+	while (!tables.empty())
+	{
+		if (tables.back() == _write_value)
+		{
+			// stack: table key value
+			tables.back() = _next_pair;
+			if (w.begin_value())
+				tables.push_back(_next_pair);
+		}
+		else if (lua_next(L, -2))
+		{
+			// stack: table key value
+			if (!valid_key(lua_type(L, -2)))
+			{
 				lua_pop(L, 1);
+				continue;
 			}
-			break;
-		
-		default:
-			// we silently ignore other types
-			break;
+
+			// write the key, then the value
+			tables.back() = _write_value;
+			lua_pushvalue(L, -2);
+			if (w.begin_value())
+				tables.push_back(_next_pair);
+		}
+		else
+		{
+			// stack: table
+			w.put_byte(_tag_end);
+			lua_pop(L, 1);
+			tables.pop_back();
+		}
 	}
 }
 
 bool lua_save(lua_State *L, std::streambuf* sb)
 {
+	PROFILE_ZONE("lua_save");
 	lua_assert(lua_gettop(L) == 1);
 
-	// create a references table
-	lua_newtable(L);
+	// kept between saves, so that big ones needn't grow it from nothing
+	static std::vector<uint8> buffer;
+	buffer.clear();
 
-	// put it at the bottom of the stack
-	lua_insert(L, 1);
-	
-	uint32 counter = 0;
-	BOStreamBE s(sb);
 	try 
 	{
-		s << kVersion;
-		save(L, s, counter);
+		compact_writer w(L, buffer);
+		w.put_byte(static_cast<uint8>(kVersion >> 8));
+		w.put_byte(static_cast<uint8>(kVersion));
+		save_compact(L, w);
+
+		std::streamsize size = static_cast<std::streamsize>(buffer.size());
+		if (sb->sputn(reinterpret_cast<const char *>(&buffer[0]), size) != size)
+			throw basic_bstream::failure("serialization bound check failed");
 	}
 	catch (const basic_bstream::failure& e)
 	{
@@ -160,8 +294,6 @@ bool lua_save(lua_State *L, std::streambuf* sb)
 		return false;
 	}
 
-	// remove the reference table
-	lua_remove(L, 1);
 	return true;
 }
 
@@ -275,8 +407,198 @@ static int restore(lua_State *L, BIStreamBE& s)
 	return type;
 }
 
+class compact_reader
+{
+public:
+	compact_reader(const std::vector<uint8>& data) : m_data(data), m_pos(0) { }
+
+	uint8 get_byte()
+	{
+		if (m_pos == m_data.size())
+			throw basic_bstream::failure("serialization bound check failed");
+		return m_data[m_pos++];
+	}
+
+	Uint64 get_varint()
+	{
+		Uint64 value = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			uint8 b = get_byte();
+			value |= static_cast<Uint64>(b & 0x7f) << shift;
+			if (!(b & 0x80))
+				return value;
+		}
+		throw basic_bstream::failure("bad Lua data");
+	}
+
+	double get_double()
+	{
+		Uint64 bits = 0;
+		for (int i = 0; i < 8; i++)
+			bits = (bits << 8) | get_byte();
+		double d;
+		memcpy(&d, &bits, sizeof(d));
+		return d;
+	}
+
+	const char *get_bytes(size_t length)
+	{
+		if (m_data.size() - m_pos < length)
+			throw basic_bstream::failure("serialization bound check failed");
+		const char *bytes = reinterpret_cast<const char *>(&m_data[m_pos]);
+		m_pos += length;
+		return bytes;
+	}
+
+private:
+	const std::vector<uint8>& m_data;
+	size_t m_pos;
+};
+
+// pushes the value for any tag but _tag_table and _tag_end
+static void restore_compact_value(lua_State *L, compact_reader& r, uint8 tag, int strings, int& string_count, int& reference_count)
+{
+	switch (tag)
+	{
+		case _tag_nil:
+			lua_pushnil(L);
+			break;
+		case _tag_false:
+		case _tag_true:
+			lua_pushboolean(L, tag == _tag_true);
+			break;
+		case _tag_integer:
+			{
+				Uint64 v = r.get_varint();
+				Sint64 i = static_cast<Sint64>(v >> 1) ^ -static_cast<Sint64>(v & 1);
+				lua_pushnumber(L, static_cast<lua_Number>(i));
+			}
+			break;
+		case _tag_number:
+			lua_pushnumber(L, static_cast<lua_Number>(r.get_double()));
+			break;
+		case _tag_string:
+			{
+				size_t length = static_cast<size_t>(r.get_varint());
+				lua_pushlstring(L, r.get_bytes(length), length);
+				lua_pushvalue(L, -1);
+				lua_rawseti(L, strings, ++string_count);
+			}
+			break;
+		case _tag_string_reference:
+			{
+				Uint64 index = r.get_varint();
+				if (index == 0 || index > static_cast<Uint64>(string_count))
+					throw basic_bstream::failure("bad Lua data");
+				lua_rawgeti(L, strings, static_cast<int>(index));
+			}
+			break;
+		case _tag_userdata:
+			{
+				restore_compact_value(L, r, r.get_byte(), strings, string_count, reference_count);
+				if (lua_type(L, -1) != LUA_TSTRING)
+					throw basic_bstream::failure("bad Lua data");
+				uint32 index = static_cast<uint32>(r.get_varint());
+
+				// get the metatable
+				lua_gettable(L, LUA_REGISTRYINDEX);
+				// get the accessor we added
+				lua_getfield(L, -1, "__new");
+				if (lua_isfunction(L, -1))
+				{
+					lua_pushnumber(L, static_cast<lua_Number>(index));
+					lua_call(L, 1, 1);
+				}
+
+				lua_remove(L, -2);
+
+				// add to the reference table
+				lua_pushvalue(L, -1);
+				lua_rawseti(L, 1, ++reference_count);
+			}
+			break;
+		case _tag_reference:
+			{
+				Uint64 index = r.get_varint();
+				if (index == 0 || index > static_cast<Uint64>(reference_count))
+					throw basic_bstream::failure("bad Lua data");
+				lua_rawgeti(L, 1, static_cast<int>(index));
+			}
+			break;
+		default:
+			throw basic_bstream::failure("bad Lua data");
+	}
+}
+
+static void restore_compact(lua_State *L, compact_reader& r)
+{
+	// the strings read so far, by number
+	lua_newtable(L);
+	int strings = lua_gettop(L);
+	int string_count = 0;
+	int reference_count = 0;
+
+	// for each table being read, innermost last: whether a key comes next
+	std::vector<bool> tables;
+
+	while (true)
+	{
+		uint8 tag = r.get_byte();
+		if (tag == _tag_table)
+		{
+			if (!lua_checkstack(L, 4))
+				throw basic_bstream::failure("Lua tables nested too deeply");
+
+			// add to the reference table
+			lua_newtable(L);
+			lua_pushvalue(L, -1);
+			lua_rawseti(L, 1, ++reference_count);
+			tables.push_back(true);
+			continue;
+		}
+		else if (tag == _tag_end)
+		{
+			// the finished table is the value on top
+			if (tables.empty() || !tables.back())
+				throw basic_bstream::failure("bad Lua data");
+			tables.pop_back();
+		}
+		else
+		{
+			restore_compact_value(L, r, tag, strings, string_count, reference_count);
+		}
+
+		// a value is complete; it is the root, a key, or goes with one
+		if (tables.empty())
+			break;
+		if (tables.back())
+		{
+			tables.back() = false;
+		}
+		else
+		{
+			// stack: table key value
+			if (lua_isnil(L, -2))
+			{
+				// maybe an invalid userdata?
+				lua_pop(L, 2);
+			}
+			else
+			{
+				lua_rawset(L, -3);
+			}
+			tables.back() = true;
+		}
+	}
+
+	lua_remove(L, strings);
+}
+
 bool lua_restore(lua_State *L, std::streambuf* sb)
 {
+	PROFILE_ZONE("lua_restore");
+
 	// create a reference table
 	lua_newtable(L);
 
@@ -293,7 +615,18 @@ bool lua_restore(lua_State *L, std::streambuf* sb)
 			return false;
 		}
 
-		restore(L, s);
+		if (version < kFirstCompactVersion)
+		{
+			restore(L, s);
+		}
+		else
+		{
+			std::vector<uint8> data(static_cast<size_t>(s.maxg() - s.tellg()));
+			if (!data.empty())
+				s.read(reinterpret_cast<char *>(&data[0]), data.size());
+			compact_reader r(data);
+			restore_compact(L, r);
+		}
 	}
 	catch (const basic_bstream::failure& e)
 	{
@@ -22,17 +22,24 @@
 	Jan. 16, 2003 (Woody Zenfell): Created.
 
 	May 21, 2003 (Woody Zenfell): being a little more defensive about NULL file pointer.
+
+	Oct 16, 2026: Messages are now queued in a lock-free ring buffer and written by a
+	background thread; added JSON lines output, per-domain rate limiting, and a crash
+	handler that dumps the most recent messages.
 */
 
 #include "Logging.h"
 #include "cseries.h"
 #include "shell.h"
 
+#include <atomic>
 #include <fstream>
 #include <string>
 #include <vector>
 #include <time.h>	// apparently is in C std library, used here to print time/date log section started.
 #include <stdio.h>
+#include <signal.h>
+#include <SDL_thread.h>
 #include "FileHandler.h"
 #include "InfoTree.h"
 
@@ -41,19 +48,384 @@ using std::vector;
 using std::string;
 #endif
 
-enum { kStringBufferSize = 1024 };
+enum {
+	kStringBufferSize = 1024,
+	kRecordSize = 2048,		// one formatted log entry, including context lines
+	kRingBufferSize = 256,		// must be a power of two
+	kMaxRateLimitedDomains = 16,
+	kWriterWakeInterval = 250	// ms
+};
 
 static Logger*	sCurrentLogger	= NULL;
 static FILE*	sOutputFile	= NULL;
 static int	sLoggingThreshhold = logNoteLevel;	// log messages at or above this level will be squelched
 static bool	sShowLocations	= true;			// should filenames and line numbers be printed as well?
 static bool	sFlushOutput	= false;		// flush output after every log-write?  (good if crash expected)
+static bool	sStructuredOutput = false;		// write JSON lines instead of indented text?
+static int	sCrashHistorySize = 32;			// messages to dump from the crash handler
 const char*	logDomain	= "global";
 
 
 static void InitializeLogging();
 
 
+// Formatted entries are queued in a bounded multi-producer ring buffer (after Vyukov), so
+// that logging threads never block on the file; a single background writer drains it.
+// Entries stay in their slots after being written, which is what lets the crash handler
+// dump the most recent messages even if they were still sitting in stdio buffers.
+struct LogRecord {
+	std::atomic<size_t> mSequence;
+	char mText[kRecordSize];
+};
+
+static LogRecord	sRing[kRingBufferSize];
+static std::atomic<size_t>	sEnqueuePos(0);
+static size_t	sDequeuePos = 0;			// guarded by sDrainLock
+static std::atomic<unsigned>	sDroppedMessages(0);
+
+static SDL_mutex*	sDrainLock	= NULL;
+static SDL_sem*	sWriterWakeup	= NULL;
+static SDL_Thread*	sWriterThread	= NULL;
+static std::atomic<bool>	sWriterQuit(false);
+static bool	sAsynchronous	= true;
+
+static bool
+EnqueueLogRecord(const char* inText) {
+	size_t thePos = sEnqueuePos.load(std::memory_order_relaxed);
+	LogRecord* theRecord;
+	for(;;) {
+		theRecord = &sRing[thePos & (kRingBufferSize - 1)];
+		size_t theSequence = theRecord->mSequence.load(std::memory_order_acquire);
+		intptr_t theDifference = (intptr_t)theSequence - (intptr_t)thePos;
+		if(theDifference == 0) {
+			if(sEnqueuePos.compare_exchange_weak(thePos, thePos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if(theDifference < 0)
+			return false;	// full
+		else
+			thePos = sEnqueuePos.load(std::memory_order_relaxed);
+	}
+
+	// Entries too long for a record keep their ending, so the next one starts on its own line
+	static const char kTruncated[] = " [truncated]\n";
+	size_t theLength = strlen(inText);
+	if(theLength < kRecordSize)
+		memcpy(theRecord->mText, inText, theLength + 1);
+	else {
+		const size_t theKept = kRecordSize - sizeof(kTruncated);
+		memcpy(theRecord->mText, inText, theKept);
+		memcpy(theRecord->mText + theKept, kTruncated, sizeof(kTruncated));
+	}
+	theRecord->mSequence.store(thePos + 1, std::memory_order_release);
+	return true;
+}
+
+// Writes out everything queued so far; safe to call from any thread.
+static void
+DrainLogRecords() {
+	if(sDrainLock)
+		SDL_LockMutex(sDrainLock);
+
+	bool wroteSomething = false;
+	unsigned theDroppedCount = sDroppedMessages.exchange(0);
+	if(theDroppedCount > 0 && sOutputFile) {
+		fprintf(sOutputFile, "(%u log messages dropped; logging buffer full)\n", theDroppedCount);
+		wroteSomething = true;
+	}
+
+	for(;;) {
+		LogRecord* theRecord = &sRing[sDequeuePos & (kRingBufferSize - 1)];
+		if(theRecord->mSequence.load(std::memory_order_acquire) != sDequeuePos + 1)
+			break;
+
+		if(sOutputFile)
+			fputs(theRecord->mText, sOutputFile);
+		fputs(theRecord->mText, stderr);
+		wroteSomething = true;
+
+		theRecord->mSequence.store(sDequeuePos + kRingBufferSize, std::memory_order_release);
+		sDequeuePos++;
+	}
+
+	if(wroteSomething && sFlushOutput && sOutputFile)
+		fflush(sOutputFile);
+
+	if(sDrainLock)
+		SDL_UnlockMutex(sDrainLock);
+}
+
+static int
+LogWriterThread(void*) {
+	while(!sWriterQuit.load()) {
+		SDL_SemWaitTimeout(sWriterWakeup, kWriterWakeInterval);
+		DrainLogRecords();
+	}
+	return 0;
+}
+
+static void
+SubmitLogRecord(int inLevel, const char* inText) {
+	bool queued = EnqueueLogRecord(inText);
+
+	// Serious messages are worth a stall; chatter is not
+	if(!queued && inLevel <= logErrorLevel) {
+		DrainLogRecords();
+		queued = EnqueueLogRecord(inText);
+	}
+
+	// With flushing on, the message is in the file before we return, as it was
+	// before there was a writer thread
+	if(!queued)
+		sDroppedMessages++;
+	else if(sWriterThread && !sFlushOutput)
+		SDL_SemPost(sWriterWakeup);
+	else
+		DrainLogRecords();
+}
+
+static void
+StartLogWriter() {
+	if(sWriterThread || !sAsynchronous)
+		return;
+
+	if(!sWriterWakeup)
+		sWriterWakeup = SDL_CreateSemaphore(0);
+	if(!sWriterWakeup)
+		return;
+
+	sWriterQuit = false;
+	sWriterThread = SDL_CreateThread(LogWriterThread, "Logging_writerThread", NULL);
+}
+
+static void
+StopLogWriter() {
+	if(sWriterThread) {
+		sWriterQuit = true;
+		SDL_SemPost(sWriterWakeup);
+		SDL_WaitThread(sWriterThread, NULL);
+		sWriterThread = NULL;
+	}
+	DrainLogRecords();
+}
+
+static void
+ShutdownLogging() {
+	StopLogWriter();
+	if(sOutputFile)
+		fflush(sOutputFile);
+}
+
+
+// Crash handler: the ring still holds the text of the most recent entries, written or not.
+// Only async-signal-safe calls from here on.
+#if defined(__WIN32__)
+#include <io.h>
+#define crash_write _write
+#else
+#include <unistd.h>
+#define crash_write write
+#endif
+
+static const int	kCrashSignals[] = {
+	SIGSEGV, SIGABRT, SIGFPE, SIGILL,
+#ifdef SIGBUS
+	SIGBUS,
+#endif
+};
+enum { kCrashSignalCount = sizeof(kCrashSignals) / sizeof(kCrashSignals[0]) };
+
+// Whatever was installed before us, to be passed the signal once we've dumped the log
+#if defined(__WIN32__)
+typedef void (*CrashHandlerFunction)(int);
+static CrashHandlerFunction	sPreviousCrashHandlers[kCrashSignalCount];
+#else
+static struct sigaction	sPreviousCrashActions[kCrashSignalCount];
+#endif
+
+static int	sCrashOutputFD = -1;
+static volatile sig_atomic_t	sCrashDumped = 0;
+
+static void
+CrashWrite(int inFD, const char* inText) {
+	if(inFD >= 0)
+		crash_write(inFD, inText, strlen(inText));
+}
+
+static void
+DumpCrashHistory() {
+	// Once only, in case the dump itself faults or another signal follows
+	if(sCrashDumped)
+		return;
+	sCrashDumped = 1;
+
+	const char* theHeader = "\n-------------------- most recent log messages before crash\n";
+	CrashWrite(sCrashOutputFD, theHeader);
+	CrashWrite(2, theHeader);
+
+	size_t theEnd = sEnqueuePos.load();
+	size_t theCount = static_cast<size_t>(sCrashHistorySize);
+	if(theCount > theEnd)
+		theCount = theEnd;
+	for(size_t thePos = theEnd - theCount; thePos != theEnd; thePos++) {
+		LogRecord& theRecord = sRing[thePos & (kRingBufferSize - 1)];
+
+		// Complete entries are either waiting to be written (thePos + 1) or written
+		// (thePos + kRingBufferSize); anything else was claimed and is still being copied
+		size_t theSequence = theRecord.mSequence.load(std::memory_order_acquire);
+		if(theSequence != thePos + 1 && theSequence != thePos + kRingBufferSize)
+			continue;
+
+		CrashWrite(sCrashOutputFD, theRecord.mText);
+		CrashWrite(2, theRecord.mText);
+	}
+}
+
+static int
+CrashSignalIndex(int inSignal) {
+	for(int i = 0; i < kCrashSignalCount; i++) {
+		if(kCrashSignals[i] == inSignal)
+			return i;
+	}
+	return -1;
+}
+
+#if defined(__WIN32__)
+static void
+LoggingCrashHandler(int inSignal) {
+	DumpCrashHistory();
+
+	int theIndex = CrashSignalIndex(inSignal);
+	CrashHandlerFunction thePrevious = theIndex >= 0 ? sPreviousCrashHandlers[theIndex] : SIG_DFL;
+	signal(inSignal, thePrevious == SIG_ERR ? SIG_DFL : thePrevious);
+	if(thePrevious != SIG_DFL && thePrevious != SIG_IGN && thePrevious != SIG_ERR)
+		thePrevious(inSignal);
+	else
+		raise(inSignal);
+}
+
+static void
+InstallLoggingCrashHandler() {
+	if(sOutputFile)
+		sCrashOutputFD = fileno(sOutputFile);
+
+	for(int i = 0; i < kCrashSignalCount; i++)
+		sPreviousCrashHandlers[i] = signal(kCrashSignals[i], LoggingCrashHandler);
+}
+#else
+static void
+LoggingCrashHandler(int inSignal, siginfo_t* inInfo, void* inContext) {
+	DumpCrashHistory();
+
+	int theIndex = CrashSignalIndex(inSignal);
+	if(theIndex < 0)
+		return;
+
+	// Hand the signal on as if we had never been installed
+	struct sigaction& thePrevious = sPreviousCrashActions[theIndex];
+	sigaction(inSignal, &thePrevious, NULL);
+	if(thePrevious.sa_flags & SA_SIGINFO) {
+		if(thePrevious.sa_sigaction)
+			thePrevious.sa_sigaction(inSignal, inInfo, inContext);
+	}
+	else if(thePrevious.sa_handler == SIG_IGN)
+		return;
+	else if(thePrevious.sa_handler != SIG_DFL)
+		thePrevious.sa_handler(inSignal);
+	else
+		raise(inSignal);	// delivered with the default action once we return
+}
+
+static void
+InstallLoggingCrashHandler() {
+	if(sOutputFile)
+		sCrashOutputFD = fileno(sOutputFile);
+
+	struct sigaction theAction;
+	memset(&theAction, 0, sizeof(theAction));
+	theAction.sa_sigaction = LoggingCrashHandler;
+	theAction.sa_flags = SA_SIGINFO;
+	sigemptyset(&theAction.sa_mask);
+
+	for(int i = 0; i < kCrashSignalCount; i++)
+		sigaction(kCrashSignals[i], &theAction, &sPreviousCrashActions[i]);
+}
+#endif
+
+
+// Per-domain rate limiting: at most mMessagesPerSecond messages per one-second window;
+// the rest are counted and reported when the next window opens.  Lock-free, since any
+// thread may log; the limits themselves only change while parsing MML.
+struct DomainRateLimit {
+	char mDomain[32];
+	int mMessagesPerSecond;
+	std::atomic<uint32> mWindowStart;
+	std::atomic<int> mWindowCount;
+	std::atomic<int> mSuppressed;
+};
+
+static DomainRateLimit	sRateLimits[kMaxRateLimitedDomains];
+static std::atomic<int>	sRateLimitCount(0);
+
+static DomainRateLimit*
+FindRateLimit(const char* inDomain) {
+	int theCount = sRateLimitCount.load(std::memory_order_acquire);
+	for(int i = 0; i < theCount; i++) {
+		if(strcmp(sRateLimits[i].mDomain, inDomain) == 0)
+			return &sRateLimits[i];
+	}
+	return NULL;
+}
+
+// Returns false if the message should be squelched; otherwise, outSuppressed gets the
+// number of messages squelched since the last one let through.
+static bool
+PassesRateLimit(const char* inDomain, int& outSuppressed) {
+	outSuppressed = 0;
+	DomainRateLimit* theLimit = FindRateLimit(inDomain);
+	if(theLimit == NULL || theLimit->mMessagesPerSecond <= 0)
+		return true;
+
+	uint32 theNow = machine_tick_count();
+	uint32 theWindowStart = theLimit->mWindowStart.load();
+	if(theNow - theWindowStart >= 1000 && theLimit->mWindowStart.compare_exchange_strong(theWindowStart, theNow)) {
+		theLimit->mWindowCount = 0;
+		outSuppressed = theLimit->mSuppressed.exchange(0);
+	}
+
+	if(theLimit->mWindowCount++ >= theLimit->mMessagesPerSecond) {
+		theLimit->mSuppressed++;
+		return false;
+	}
+	return true;
+}
+
+
+static void
+AppendJSONString(string& ioString, const char* inText) {
+	ioString += '"';
+	for(const char* p = inText; *p; p++) {
+		unsigned char c = static_cast<unsigned char>(*p);
+		switch(c) {
+		case '"':	ioString += "\\\""; break;
+		case '\\':	ioString += "\\\\"; break;
+		case '\n':	ioString += "\\n"; break;
+		case '\r':	ioString += "\\r"; break;
+		case '\t':	ioString += "\\t"; break;
+		default:
+			if(c < 0x20) {
+				char theEscape[8];
+				snprintf(theEscape, sizeof(theEscape), "\\u%04x", c);
+				ioString += theEscape;
+			}
+			else
+				ioString += *p;
+		}
+	}
+	ioString += '"';
+}
+
+
 Logger*
 GetCurrentLogger() {
     if(sCurrentLogger == NULL)
@@ -149,8 +521,51 @@ void
 TopLevelLogger::logMessageV(const char* inDomain, int inLevel, const char* inFile, int inLine, const char* inMessage, va_list inArgs) {
     // Obviously eventually this will be settable more dynamically...
     // Also eventually some logged messages could be posted in a dialog in addition to appended to the file.
-    if(sOutputFile != NULL && inLevel < sLoggingThreshhold) {
-        char	stringBuffer[kStringBufferSize];
+    if(sOutputFile == NULL || inLevel >= sLoggingThreshhold)
+        return;
+
+    int theSuppressedCount;
+    if(!PassesRateLimit(inDomain, theSuppressedCount))
+        return;
+
+    char	stringBuffer[kStringBufferSize];
+    vsnprintf(stringBuffer, kStringBufferSize, inMessage, inArgs);
+
+    string	theString;
+
+    if(sStructuredOutput) {
+        theString = "{\"time\":";
+        theString += std::to_string(static_cast<long long>(time(NULL)));
+        theString += ",\"ticks\":";
+        theString += std::to_string(static_cast<unsigned long long>(machine_tick_count()));
+        theString += ",\"domain\":";
+        AppendJSONString(theString, inDomain);
+        theString += ",\"level\":";
+        theString += std::to_string(inLevel);
+        if(sShowLocations) {
+            theString += ",\"file\":";
+            AppendJSONString(theString, inFile);
+            theString += ",\"line\":";
+            theString += std::to_string(inLine);
+        }
+        if(!mContextStack.empty()) {
+            theString += ",\"context\":[";
+            for(size_t depth = 0; depth < mContextStack.size(); depth++) {
+                if(depth > 0)
+                    theString += ',';
+                AppendJSONString(theString, mContextStack[depth].c_str());
+            }
+            theString += ']';
+        }
+        if(theSuppressedCount > 0) {
+            theString += ",\"suppressed\":";
+            theString += std::to_string(theSuppressedCount);
+        }
+        theString += ",\"message\":";
+        AppendJSONString(theString, stringBuffer);
+        theString += "}\n";
+    }
+    else {
         size_t firstDepthToPrint = mMostRecentCommonStackDepth;
     /*
         // This was designed to give a little context when coming back from deep stacks, but it seems
@@ -159,42 +574,38 @@ TopLevelLogger::logMessageV(const char* inDomain, int inLevel, const char* inFil
         if(mMostRecentlyPrintedStackDepth != mMostRecentCommonStackDepth && firstDepthToPrint > 0)
             firstDepthToPrint--;
     */
+        if(theSuppressedCount > 0) {
+            theString.append(mContextStack.size() * 2, ' ');
+            theString += "(" + std::to_string(theSuppressedCount) + " messages in domain " + inDomain + " suppressed by rate limit)\n";
+        }
+
         for(size_t depth = firstDepthToPrint; depth < mContextStack.size(); depth++) {
-            string	theString(depth * 2, ' ');
-    
+            theString.append(depth * 2, ' ');
             theString += "while ";
             theString += mContextStack[depth];
-            
-            fprintf(sOutputFile, "%s\n", theString.c_str());
-			fprintf(stderr, "%s\n", theString.c_str());
+            theString += '\n';
         }
-        
-        vsnprintf(stringBuffer, kStringBufferSize, inMessage, inArgs);
-    
-        string	theString(mContextStack.size() * 2, ' ');
-        
+
+        theString.append(mContextStack.size() * 2, ' ');
         theString += stringBuffer;
-        
+
         if(sShowLocations) {
             snprintf(stringBuffer, kStringBufferSize, " (%s:%d)\n", inFile, inLine);
             theString += stringBuffer;
         }
         else
             theString += "\n";
-        
-        fprintf(sOutputFile, "%s", theString.c_str());
-		fprintf(stderr, "%s", theString.c_str());
-        
-        if(sFlushOutput)
-                fflush(sOutputFile);
-        
-        mMostRecentCommonStackDepth = mContextStack.size();
-        mMostRecentlyPrintedStackDepth = mContextStack.size();
     }
+
+    SubmitLogRecord(inLevel, theString.c_str());
+
+    mMostRecentCommonStackDepth = mContextStack.size();
+    mMostRecentlyPrintedStackDepth = mContextStack.size();
 }
 
 void TopLevelLogger::flush()
 {
+	DrainLogRecords();
 	if (sOutputFile)
 	{
 		fflush(sOutputFile);
@@ -230,6 +641,10 @@ InitializeLogging() {
 
     sOutputFile = fopen(fs.GetPath(), "a");
 
+    for(size_t i = 0; i < kRingBufferSize; i++)
+	    sRing[i].mSequence.store(i, std::memory_order_relaxed);
+    sDrainLock = SDL_CreateMutex();
+
     sCurrentLogger = new TopLevelLogger;
     if(sOutputFile != NULL)
     {
@@ -237,6 +652,10 @@ InitializeLogging() {
 	    const char* theTimeString = ctime(&theTime);
 	    fprintf(sOutputFile, "\n-------------------- %s\n\n", theTimeString == NULL ? "(timestamp unavailable)" : theTimeString);
     }
+
+    StartLogWriter();
+    InstallLoggingCrashHandler();
+    atexit(ShutdownLogging);
 }
 
 
@@ -258,8 +677,57 @@ setFlushLoggingOutput(const char* inDomain, bool inFlushOutput) {
         sFlushOutput = inFlushOutput;
 
         // Flush now for good measure
-        if(sFlushOutput && sOutputFile != NULL)
+        if(sFlushOutput && sOutputFile != NULL) {
+                DrainLogRecords();
                 fflush(sOutputFile);
+        }
+}
+
+
+void
+setLoggingRateLimit(const char* inDomain, int inMessagesPerSecond) {
+        DomainRateLimit* theLimit = FindRateLimit(inDomain);
+        if(theLimit == NULL) {
+                int theCount = sRateLimitCount.load();
+                if(theCount >= kMaxRateLimitedDomains)
+                        return;
+
+                theLimit = &sRateLimits[theCount];
+                strncpy(theLimit->mDomain, inDomain, sizeof(theLimit->mDomain) - 1);
+                theLimit->mDomain[sizeof(theLimit->mDomain) - 1] = '\0';
+                theLimit->mWindowStart = machine_tick_count();
+                theLimit->mWindowCount = 0;
+                theLimit->mSuppressed = 0;
+                theLimit->mMessagesPerSecond = inMessagesPerSecond;
+                sRateLimitCount.store(theCount + 1, std::memory_order_release);
+        }
+        else
+                theLimit->mMessagesPerSecond = inMessagesPerSecond;
+}
+
+
+void
+setStructuredLoggingOutput(bool inStructured) {
+        sStructuredOutput = inStructured;
+}
+
+
+void
+setAsynchronousLogging(bool inAsynchronous) {
+        sAsynchronous = inAsynchronous;
+        if(sCurrentLogger == NULL)
+                return;
+
+        if(sAsynchronous)
+                StartLogWriter();
+        else
+                StopLogWriter();
+}
+
+
+void
+setLoggingCrashHistory(int inMessageCount) {
+        sCrashHistorySize = PIN(inMessageCount, 0, kRingBufferSize);
 }
 
 
@@ -270,6 +738,16 @@ void reset_mml_logging()
 
 void parse_mml_logging(const InfoTree& root)
 {
+	bool async;
+	if (root.read_attr("async", async))
+		setAsynchronousLogging(async);
+	std::string format;
+	if (root.read_attr("format", format))
+		setStructuredLoggingOutput(format == "json");
+	int16 crash_history;
+	if (root.read_attr("crash_history", crash_history))
+		setLoggingCrashHistory(crash_history);
+
 	BOOST_FOREACH(InfoTree dtree, root.children_named("logging_domain"))
 	{
 		std::string domain;
@@ -285,5 +763,8 @@ void parse_mml_logging(const InfoTree& root)
 		bool flush;
 		if (dtree.read_attr("flush", flush))
 			setFlushLoggingOutput(domain.c_str(), flush);
+		int16 rate_limit;
+		if (dtree.read_attr("rate_limit", rate_limit))
+			setLoggingRateLimit(domain.c_str(), rate_limit);
 	}
 }
@@ -66,6 +66,10 @@ Logger* GetCurrentLogger();
 void setLoggingThreshhold(const char* inDomain, short inThreshhold); // message appears if its level < inThreshhold
 void setShowLoggingLocations(const char* inDomain, bool inShowLocations);	// show file and line?
 void setFlushLoggingOutput(const char* inDomain, bool inFlushOutput);	// flush output file after every log message?
+void setLoggingRateLimit(const char* inDomain, int inMessagesPerSecond);	// 0 means unlimited
+void setStructuredLoggingOutput(bool inStructured);	// JSON lines instead of indented text?
+void setAsynchronousLogging(bool inAsynchronous);	// write from a background thread?
+void setLoggingCrashHistory(int inMessageCount);	// messages dumped by the crash handler
 
 
 class InfoTree;
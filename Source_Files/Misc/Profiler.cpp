@@ -0,0 +1,327 @@
+/*
+	Copyright (C) 2026 and beyond by the "Aleph One" developers.
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This license is contained in the file "COPYING",
+	which is included with this source code; it is available online at
+	http://www.gnu.org/licenses/gpl.html
+
+	Hierarchical scoped-zone frame profiler
+*/
+
+#include "cseries.h"
+#include "Profiler.h"
+#include "Console.h"
+#include "FileHandler.h"
+#include "InfoTree.h"
+#include "Logging.h"
+#include "shell.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+bool profiler_enabled = false;
+
+// weight of the newest frame in the displayed averages
+static const float kSmoothing = 0.1f;
+
+// keep runaway captures from eating all memory
+static const size_t kMaximumTraceEvents = 1 << 20;
+
+Profiler::Profiler() :
+	trace_frames_remaining_(0),
+	trace_start_(0),
+	frames_(0),
+	enabled_at_(0),
+	frequency_(SDL_GetPerformanceFrequency()),
+	show_overlay_(true)
+{
+	// node 0 is the root; it is never timed
+	Node root = { -1, -1, -1, 0, 0, 0.0f, std::vector<int>() };
+	nodes_.push_back(root);
+}
+
+int Profiler::Zone(const char* name)
+{
+	for (size_t i = 0; i < zone_names_.size(); ++i)
+	{
+		if (zone_names_[i] == name)
+			return static_cast<int>(i);
+	}
+
+	zone_names_.push_back(name);
+	return static_cast<int>(zone_names_.size() - 1);
+}
+
+int Profiler::Counter(const char* name)
+{
+	for (size_t i = 0; i < counters_.size(); ++i)
+	{
+		if (counters_[i].name == name)
+			return static_cast<int>(i);
+	}
+
+	CounterData counter = { name, 0, 0 };
+	counters_.push_back(counter);
+	return static_cast<int>(counters_.size() - 1);
+}
+
+int Profiler::FindChild(int parent, int zone)
+{
+	std::vector<int>& children = nodes_[parent].children;
+	for (size_t i = 0; i < children.size(); ++i)
+	{
+		if (nodes_[children[i]].zone == zone)
+			return children[i];
+	}
+
+	Node node = { zone, parent, nodes_[parent].depth + 1, 0, 0, 0.0f, std::vector<int>() };
+	nodes_.push_back(node);
+	int index = static_cast<int>(nodes_.size() - 1);
+	nodes_[parent].children.push_back(index);
+	return index;
+}
+
+void Profiler::Begin(int zone)
+{
+	int parent = stack_.empty() ? 0 : stack_.back().node;
+	OpenZone open = { FindChild(parent, zone), SDL_GetPerformanceCounter() };
+	stack_.push_back(open);
+}
+
+void Profiler::End()
+{
+	if (stack_.empty())
+		return;
+
+	Uint64 now = SDL_GetPerformanceCounter();
+	OpenZone& open = stack_.back();
+	Node& node = nodes_[open.node];
+	node.frame_ticks += now - open.start;
+
+	if (trace_frames_remaining_ > 0 && trace_.size() < kMaximumTraceEvents)
+	{
+		TraceEvent event = { node.zone, node.depth, open.start, now - open.start };
+		trace_.push_back(event);
+	}
+
+	stack_.pop_back();
+}
+
+void Profiler::EndFrame()
+{
+	if (!profiler_enabled)
+		return;
+
+	const float ms_per_tick = 1000.0f / frequency_;
+	for (size_t i = 1; i < nodes_.size(); ++i)
+	{
+		Node& node = nodes_[i];
+		float frame_ms = node.frame_ticks * ms_per_tick;
+		node.average_ms += kSmoothing * (frame_ms - node.average_ms);
+		node.total_ticks += node.frame_ticks;
+		node.frame_ticks = 0;
+	}
+	++frames_;
+
+	for (size_t i = 0; i < counters_.size(); ++i)
+	{
+		counters_[i].last_count = counters_[i].frame_count;
+		counters_[i].frame_count = 0;
+	}
+
+	if (trace_frames_remaining_ > 0 && --trace_frames_remaining_ == 0)
+		WriteTrace();
+}
+
+void Profiler::Enable(bool enable)
+{
+	if (enable == profiler_enabled)
+		return;
+
+	profiler_enabled = enable;
+	stack_.clear();
+	for (size_t i = 1; i < nodes_.size(); ++i)
+	{
+		nodes_[i].frame_ticks = 0;
+		nodes_[i].total_ticks = 0;
+		nodes_[i].average_ms = 0.0f;
+	}
+	frames_ = 0;
+	enabled_at_ = SDL_GetPerformanceCounter();
+	for (size_t i = 0; i < counters_.size(); ++i)
+	{
+		counters_[i].frame_count = 0;
+		counters_[i].last_count = 0;
+	}
+
+	if (!enable)
+	{
+		trace_frames_remaining_ = 0;
+		trace_.clear();
+	}
+}
+
+void Profiler::CaptureTrace(int frame_count)
+{
+	Enable(true);
+	trace_.clear();
+	trace_start_ = SDL_GetPerformanceCounter();
+	trace_frames_remaining_ = frame_count;
+}
+
+void Profiler::ReportNode(int index, bool mean, std::vector<ReportLine>& lines)
+{
+	const Node& node = nodes_[index];
+	if (index != 0)
+	{
+		float milliseconds = node.average_ms;
+		if (mean)
+			milliseconds = frames_ ? node.total_ticks * 1000.0f / frequency_ / frames_ : 0.0f;
+
+		ReportLine line = { zone_names_[node.zone].c_str(), node.depth, milliseconds };
+		lines.push_back(line);
+	}
+
+	for (size_t i = 0; i < node.children.size(); ++i)
+		ReportNode(node.children[i], mean, lines);
+}
+
+void Profiler::Report(std::vector<ReportLine>& lines)
+{
+	lines.clear();
+	ReportNode(0, false, lines);
+}
+
+void Profiler::Summarize(std::vector<ReportLine>& lines)
+{
+	lines.clear();
+	ReportNode(0, true, lines);
+}
+
+float Profiler::Seconds()
+{
+	return profiler_enabled ? float(SDL_GetPerformanceCounter() - enabled_at_) / frequency_ : 0.0f;
+}
+
+void Profiler::ReportCounters(std::vector<CounterLine>& lines)
+{
+	lines.clear();
+	for (size_t i = 0; i < counters_.size(); ++i)
+	{
+		CounterLine line = { counters_[i].name.c_str(), counters_[i].last_count };
+		lines.push_back(line);
+	}
+}
+
+// Chrome's about:tracing and Perfetto both read this
+void Profiler::WriteTrace()
+{
+	char name[64];
+	snprintf(name, sizeof(name), "Profile %lu.json", static_cast<unsigned long>(time(NULL)));
+
+	FileSpecifier file;
+	file.SetToLocalDataDir();
+	file += name;
+
+	FILE* f = fopen(file.GetPath(), "w");
+	if (!f)
+	{
+		logError("unable to write profiler trace %s", file.GetPath());
+		screen_printf("Unable to write profiler trace");
+		trace_.clear();
+		return;
+	}
+
+	const double us_per_tick = 1000000.0 / frequency_;
+	fprintf(f, "{\"traceEvents\":[\n");
+	for (size_t i = 0; i < trace_.size(); ++i)
+	{
+		const TraceEvent& event = trace_[i];
+		fprintf(f, "{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+			zone_names_[event.zone].c_str(),
+			(event.start - trace_start_) * us_per_tick,
+			event.duration * us_per_tick,
+			i + 1 < trace_.size() ? "," : "");
+	}
+	fprintf(f, "],\"displayTimeUnit\":\"ms\"}\n");
+	fclose(f);
+
+	screen_printf("Wrote %s", utf8_to_mac_roman(file.GetPath()).c_str());
+	trace_.clear();
+}
+
+struct profile_on
+{
+	void operator() (const std::string&) const {
+		Profiler::instance()->Enable(true);
+		screen_printf("Profiler on");
+	}
+};
+
+struct profile_off
+{
+	void operator() (const std::string&) const {
+		Profiler::instance()->Enable(false);
+		screen_printf("Profiler off");
+	}
+};
+
+struct profile_overlay
+{
+	void operator() (const std::string& arg) const {
+		Profiler::instance()->ShowOverlay(arg != "off");
+	}
+};
+
+struct profile_trace
+{
+	void operator() (const std::string& arg) const {
+		int frames = atoi(arg.c_str());
+		if (frames <= 0)
+			frames = 300;
+
+		Profiler::instance()->CaptureTrace(frames);
+		screen_printf("Capturing %d frames", frames);
+	}
+};
+
+void Profiler::RegisterConsoleCommands()
+{
+	CommandParser profileParser;
+	profileParser.register_command("on", profile_on());
+	profileParser.register_command("off", profile_off());
+	profileParser.register_command("overlay", profile_overlay());
+	profileParser.register_command("trace", profile_trace());
+	Console::instance()->register_command("profile", profileParser);
+}
+
+void reset_mml_profiler()
+{
+	// no reset; don't turn off a profiler the player switched on from the console
+}
+
+void parse_mml_profiler(const InfoTree& root)
+{
+	bool enabled;
+	if (root.read_attr("enabled", enabled))
+		Profiler::instance()->Enable(enabled);
+
+	bool overlay;
+	if (root.read_attr("overlay", overlay))
+		Profiler::instance()->ShowOverlay(overlay);
+
+	int16 trace_frames;
+	if (root.read_attr("trace_frames", trace_frames) && trace_frames > 0)
+		Profiler::instance()->CaptureTrace(trace_frames);
+}
@@ -0,0 +1,183 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+/*
+	Copyright (C) 2026 and beyond by the "Aleph One" developers.
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This license is contained in the file "COPYING",
+	which is included with this source code; it is available online at
+	http://www.gnu.org/licenses/gpl.html
+
+	Hierarchical scoped-zone frame profiler
+
+	Wrap a block in PROFILE_ZONE("name"); nested zones show up as children.
+	Zones are only recorded on the main thread. When the profiler is off,
+	a zone costs one test of a global flag.
+
+	PROFILE_COUNT("name", n) adds n to a per-frame counter, such as the
+	number of draw calls; the overlay shows each counter's last frame.
+*/
+
+#include "cstypes.h"
+
+#include <string>
+#include <vector>
+
+extern bool profiler_enabled;
+
+class Profiler {
+public:
+	static Profiler* instance() {
+		static Profiler *instance_ = nullptr;
+		if (!instance_)
+			instance_ = new Profiler();
+		return instance_;
+	}
+
+	// registers a zone name; call once per call site
+	int Zone(const char* name);
+
+	void Begin(int zone);
+	void End();
+
+	// registers a counter name; call once per call site
+	int Counter(const char* name);
+
+	void Count(int counter, int amount) { counters_[counter].frame_count += amount; }
+
+	// accumulates this frame's timings and finishes any trace capture
+	void EndFrame();
+
+	void Enable(bool enable);
+	bool Enabled() { return profiler_enabled; }
+
+	void ShowOverlay(bool show) { show_overlay_ = show; }
+	bool OverlayVisible() { return profiler_enabled && show_overlay_; }
+
+	// records the next frame_count frames as a Chrome trace-event JSON file
+	// in the local data directory
+	void CaptureTrace(int frame_count);
+
+	struct ReportLine {
+		const char* name;
+		int depth;
+		float milliseconds;
+	};
+
+	// smoothed per-frame time of every zone seen, in tree order
+	void Report(std::vector<ReportLine>& lines);
+
+	// mean per-frame time of every zone seen since the profiler was turned on,
+	// in tree order; for timing a whole film
+	void Summarize(std::vector<ReportLine>& lines);
+
+	// frames finished, and seconds passed, since the profiler was turned on
+	int Frames() { return frames_; }
+	float Seconds();
+
+	struct CounterLine {
+		const char* name;
+		int count;
+	};
+
+	// last frame's total of every counter seen
+	void ReportCounters(std::vector<CounterLine>& lines);
+
+	void RegisterConsoleCommands();
+
+private:
+	Profiler();
+
+	struct Node {
+		int zone;
+		int parent;
+		int depth;
+		Uint64 frame_ticks;
+		Uint64 total_ticks;
+		float average_ms;
+		std::vector<int> children;
+	};
+
+	struct TraceEvent {
+		int zone;
+		int depth;
+		Uint64 start;
+		Uint64 duration;
+	};
+
+	struct OpenZone {
+		int node;
+		Uint64 start;
+	};
+
+	struct CounterData {
+		std::string name;
+		int frame_count;
+		int last_count;
+	};
+
+	int FindChild(int parent, int zone);
+	void ReportNode(int node, bool mean, std::vector<ReportLine>& lines);
+	void WriteTrace();
+
+	std::vector<std::string> zone_names_;
+	std::vector<Node> nodes_;
+	std::vector<OpenZone> stack_;
+	std::vector<CounterData> counters_;
+
+	std::vector<TraceEvent> trace_;
+	int trace_frames_remaining_;
+	Uint64 trace_start_;
+
+	int frames_;
+	Uint64 enabled_at_;
+
+	Uint64 frequency_;
+	bool show_overlay_;
+};
+
+class ProfileZone {
+public:
+	explicit ProfileZone(int zone) : active_(profiler_enabled) {
+		if (active_)
+			Profiler::instance()->Begin(zone);
+	}
+
+	~ProfileZone() {
+		if (active_)
+			Profiler::instance()->End();
+	}
+
+private:
+	bool active_;
+};
+
+#define PROFILE_ZONE_CONCAT2(a, b) a ## b
+#define PROFILE_ZONE_CONCAT(a, b) PROFILE_ZONE_CONCAT2(a, b)
+
+#define PROFILE_ZONE(name) \
+	static const int PROFILE_ZONE_CONCAT(_profile_zone_id_, __LINE__) = Profiler::instance()->Zone(name); \
+	ProfileZone PROFILE_ZONE_CONCAT(_profile_zone_, __LINE__)(PROFILE_ZONE_CONCAT(_profile_zone_id_, __LINE__))
+
+#define PROFILE_COUNT(name, amount) \
+	do { \
+		static const int _profile_counter_id = Profiler::instance()->Counter(name); \
+		if (profiler_enabled) \
+			Profiler::instance()->Count(_profile_counter_id, (amount)); \
+	} while (0)
+
+class InfoTree;
+void parse_mml_profiler(const InfoTree& root);
+void reset_mml_profiler();
+
+#endif
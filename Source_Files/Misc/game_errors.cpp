@@ -25,8 +25,10 @@
 #include "cseries.h"
 #include "game_errors.h"
 
-static short last_type= systemError;
-static short last_error= 0;
+// each thread has its own, so a save written in the background can't report
+// its errors into whatever the main thread is doing
+static thread_local short last_type= systemError;
+static thread_local short last_error= 0;
 
 void set_game_error(
 	short type, 
@@ -125,6 +125,7 @@ extern TP2PerfGlobals perf_globals;
 #include "shell.h"
 #include "interface.h"
 #include "player.h"
+#include "monsters.h"
 #include "network.h"
 #include "screen_drawing.h"
 #include "SoundManager.h"
@@ -171,10 +172,11 @@ enum recording_version {
 	RECORDING_VERSION_ALEPH_ONE_PRE_PIN = 6,
 	RECORDING_VERSION_ALEPH_ONE_1_0 = 7,
 	RECORDING_VERSION_ALEPH_ONE_1_1 = 8,
-	RECORDING_VERSION_ALEPH_ONE_1_2 = 9
+	RECORDING_VERSION_ALEPH_ONE_1_2 = 9,
+	RECORDING_VERSION_ALEPH_ONE_SEEKABLE = 10 // 1.2 films in the seekable container
 };
 const short default_recording_version = RECORDING_VERSION_ALEPH_ONE_1_2;
-const short max_handled_recording= RECORDING_VERSION_ALEPH_ONE_1_2;
+const short max_handled_recording= RECORDING_VERSION_ALEPH_ONE_SEEKABLE;
 
 #include "screen_definitions.h"
 #include "interface_menus.h"
@@ -200,6 +202,8 @@ const short max_handled_recording= RECORDING_VERSION_ALEPH_ONE_1_2;
 #include "motion_sensor.h" // for reset_motion_sensor()
 
 #include "lua_hud_script.h"
+#include "Profiler.h"
+#include "interpolated_world.h"
 
 using alephone::Screen;
 
@@ -1196,16 +1200,32 @@ bool idle_game_state(uint32 time)
 	{
 		// ZZZ change: update_world() whether or not get_keyboard_controller_status() is true
 		// This way we won't fill up queues and stall netgames if one player switches out for a bit.
-		std::pair<bool, int16> theUpdateResult= update_world();
+		std::pair<bool, int16> theUpdateResult;
+		{
+			PROFILE_ZONE("update_world");
+			theUpdateResult= update_world();
+		}
 		short ticks_elapsed= theUpdateResult.second;
 
+		if (theUpdateResult.first)
+			update_interpolated_world();
+
 		if (get_keyboard_controller_status())
 		{
 			// ZZZ: I don't know for sure that render_screen works best with the number of _real_
 			// ticks elapsed rather than the number of (potentially predictive) ticks elapsed.
 			// This is a guess.
-			if (theUpdateResult.first)
-				render_screen(ticks_elapsed);
+			// In-between frames show the world part of the way from the last tick to this one
+			if (theUpdateResult.first || interpolated_world_wants_frame())
+			{
+				{
+					PROFILE_ZONE("render_screen");
+					enter_interpolated_world();
+					render_screen(ticks_elapsed);
+					exit_interpolated_world();
+				}
+				Profiler::instance()->EndFrame();
+			}
 		}
 		
 		return theUpdateResult.first;
@@ -1999,6 +2019,7 @@ static bool begin_game(
 				}
 				game_information.cheat_flags = network_game_info->cheat_flags;
 				std::fill_n(game_information.parameters, 2, 0);
+				game_information.parameters[_monster_think_budget_parameter] = network_game_info->monster_think_budget;
 
 				is_networked= true;
 				record_game= true;
@@ -2093,6 +2114,7 @@ static bool begin_game(
 						load_film_profile(FILM_PROFILE_ALEPH_ONE_1_1);
 						break;
 					case RECORDING_VERSION_ALEPH_ONE_1_2:
+					case RECORDING_VERSION_ALEPH_ONE_SEEKABLE:
 						load_film_profile(FILM_PROFILE_DEFAULT);
 						break;
 					default:
@@ -2136,6 +2158,7 @@ static bool begin_game(
 			game_information.initial_random_seed= machine_tick_count();
 			game_information.difficulty_level= get_difficulty_level();
 			std::fill_n(game_information.parameters, 2, 0);
+			game_information.parameters[_monster_think_budget_parameter]= get_monster_think_budget();
 				
                         // ZZZ: until film files store player behavior flags, we must require
                         // that all films recorded be made with standard behavior.
@@ -2161,7 +2184,8 @@ static bool begin_game(
 			else
 			{
 				set_recording_header_data(number_of_players, entry.level_number, (user == _network_player) ? parent_checksum : get_current_map_checksum(), 
-					default_recording_version, starts, &game_information);
+					recording_seekable_films() ? RECORDING_VERSION_ALEPH_ONE_SEEKABLE : default_recording_version,
+					starts, &game_information);
 				start_recording();
 			}
 		}
@@ -379,6 +379,9 @@ void check_recording_replaying(void);
 bool has_recording_file(void);
 void increment_replay_speed(void);
 void decrement_replay_speed(void);
+bool seek_replay(int32 tick);
+bool recording_seekable_films(void);
+int32 get_replay_check_tick(void); // NONE, or a tick update_world() has to stop at
 void reset_recording_and_playback_queues(void);
 uint32 parse_keymap(void);
 
@@ -984,6 +984,13 @@ static const char* term_scale_labels[] = {
 "Normal", "Double", "Largest", NULL
 };
 
+static const char* frame_time_target_labels[] = {
+	"Off", "Hold 60 FPS", "Hold 45 FPS", "Hold 30 FPS", NULL
+};
+static const short frame_time_target_values[] = {
+	0, 16, 22, 33
+};
+
 static const char* mouse_accel_labels[] = {
 	"Off", "Classic", NULL
 };
@@ -1186,6 +1193,15 @@ static void graphics_dialog(void *arg)
 	table->dual_add(gamma_w->label("Brightness"), d);
 	table->dual_add(gamma_w, d);
 
+	w_select_popup *frame_time_w = new w_select_popup();
+	frame_time_w->set_labels(build_stringvector_from_cstring_array(frame_time_target_labels));
+	for (int i = 0; frame_time_target_labels[i] != NULL; ++i) {
+		if (frame_time_target_values[i] == graphics_preferences->screen_mode.frame_time_target)
+			frame_time_w->set_selection(i);
+	}
+	table->dual_add(frame_time_w->label("Dynamic Resolution"), d);
+	table->dual_add(frame_time_w, d);
+
 	table->add_row(new w_spacer(), true);
 
 	w_toggle *fullscreen_w = new w_toggle(!graphics_preferences->screen_mode.fullscreen);
@@ -1283,6 +1299,12 @@ static void graphics_dialog(void *arg)
 		    graphics_preferences->screen_mode.gamma_level = gamma;
 		    changed = true;
 	    }
+
+	    short frame_time_target = frame_time_target_values[frame_time_w->get_selection()];
+	    if (frame_time_target != graphics_preferences->screen_mode.frame_time_target) {
+		    graphics_preferences->screen_mode.frame_time_target = frame_time_target;
+		    changed = true;
+	    }
         
         bool fix_h_not_v = fixh_w->get_selection() == 0;
         if (fix_h_not_v != graphics_preferences->screen_mode.fix_h_not_v) {
@@ -3088,6 +3110,7 @@ InfoTree graphics_preferences_tree()
 	root.put_attr("scmode_term_scale", graphics_preferences->screen_mode.term_scale_level);
 	root.put_attr("scmode_translucent_map", graphics_preferences->screen_mode.translucent_map);
 	root.put_attr("scmode_camera_bob", graphics_preferences->screen_mode.camera_bob);
+	root.put_attr("scmode_frame_time_target", graphics_preferences->screen_mode.frame_time_target);
 	root.put_attr("scmode_accel", graphics_preferences->screen_mode.acceleration);
 	root.put_attr("scmode_highres", graphics_preferences->screen_mode.high_resolution);
 	root.put_attr("scmode_fullscreen", graphics_preferences->screen_mode.fullscreen);
@@ -3101,6 +3124,7 @@ InfoTree graphics_preferences_tree()
 	root.put_attr("multisamples", graphics_preferences->OGL_Configure.Multisamples);
 	root.put_attr("geforce_fix", graphics_preferences->OGL_Configure.GeForceFix);
 	root.put_attr("wait_for_vsync", graphics_preferences->OGL_Configure.WaitForVSync);
+	root.put_attr("texture_budget", graphics_preferences->OGL_Configure.TextureBudget);
 	root.put_attr("gamma_corrected_blending", graphics_preferences->OGL_Configure.Use_sRGB);
 	root.put_attr("use_npot", graphics_preferences->OGL_Configure.Use_NPOT);
 	root.put_attr("double_corpse_limit", graphics_preferences->double_corpse_limit);
@@ -3505,6 +3529,7 @@ static void default_graphics_preferences(graphics_preferences_data *preferences)
 	preferences->screen_mode.fullscreen = true;
 	preferences->screen_mode.fix_h_not_v = true;
 	preferences->screen_mode.camera_bob = true;
+	preferences->screen_mode.frame_time_target = 0;
 	preferences->screen_mode.bit_depth = 32;
 	
 	preferences->screen_mode.draw_every_other_line= false;
@@ -3965,6 +3990,7 @@ void parse_graphics_preferences(InfoTree root, std::string version)
 	root.read_attr("scmode_term_scale", graphics_preferences->screen_mode.term_scale_level);
 	root.read_attr("scmode_translucent_map", graphics_preferences->screen_mode.translucent_map);
 	root.read_attr("scmode_camera_bob", graphics_preferences->screen_mode.camera_bob);
+	root.read_attr_bounded<int16>("scmode_frame_time_target", graphics_preferences->screen_mode.frame_time_target, 0, 1000);
 	root.read_attr("scmode_accel", graphics_preferences->screen_mode.acceleration);
 	root.read_attr("scmode_highres", graphics_preferences->screen_mode.high_resolution);
 	root.read_attr("scmode_fullscreen", graphics_preferences->screen_mode.fullscreen);
@@ -3979,6 +4005,7 @@ void parse_graphics_preferences(InfoTree root, std::string version)
 	root.read_attr("multisamples", graphics_preferences->OGL_Configure.Multisamples);
 	root.read_attr("geforce_fix", graphics_preferences->OGL_Configure.GeForceFix);
 	root.read_attr("wait_for_vsync", graphics_preferences->OGL_Configure.WaitForVSync);
+	root.read_attr_bounded<int16>("texture_budget", graphics_preferences->OGL_Configure.TextureBudget, 0, INT16_MAX);
 	root.read_attr("gamma_corrected_blending", graphics_preferences->OGL_Configure.Use_sRGB);
 	root.read_attr("use_npot", graphics_preferences->OGL_Configure.Use_NPOT);
 	root.read_attr("double_corpse_limit", graphics_preferences->double_corpse_limit);
@@ -81,6 +81,7 @@ Feb 20, 2002 (Woody Zenfell):
 #include <stdlib.h>
 
 #include "map.h"
+#include "monsters.h"
 #include "interface.h"
 #include "shell.h"
 #include "preferences.h"
@@ -98,6 +99,12 @@ Feb 20, 2002 (Woody Zenfell):
 #include "joystick.h"
 #include "Movie.h"
 #include "InfoTree.h"
+#include "game_wad.h"
+#include "SoundManager.h"
+
+#include <algorithm>
+#include <vector>
+#include <zlib.h>
 
 /* ---------- constants */
 
@@ -109,6 +116,29 @@ Feb 20, 2002 (Woody Zenfell):
 #define MAXIMUM_REPLAY_SPEED         5
 #define MINIMUM_REPLAY_SPEED        -5
 
+/* Seekable films: after the recording header comes a container header, then blocks of
+	compressed action flags (RECORD_CHUNK_SIZE per player, XOR-delta coded, then deflated),
+	keyframes (deflated save game wads) every so often and at every level, and, once the
+	recording is stopped, an index of where all of them are. A legacy film starts with a
+	run length no bigger than END_OF_RECORDING_INDICATOR, so it can't look like the magic;
+	seekable films also get their own recording version, so older builds turn them down. */
+#define FILM_CONTAINER_MAGIC         FOUR_CHARS_TO_INT('a', 'f', 'l', 'm')
+#define FILM_CONTAINER_VERSION       1
+#define SIZEOF_film_container_header 12
+#define SIZEOF_film_block_header     8
+#define FLAG_BLOCK_TAG               FOUR_CHARS_TO_INT('f', 'l', 'a', 'g')
+#define KEYFRAME_BLOCK_TAG           FOUR_CHARS_TO_INT('k', 'e', 'y', 'f')
+#define INDEX_BLOCK_TAG              FOUR_CHARS_TO_INT('i', 'n', 'd', 'x')
+#define SIZEOF_keyframe_block_header 20
+#define DEFAULT_KEYFRAME_INTERVAL    (30*TICKS_PER_SECOND)
+#define REPLAY_JUMP_BACK_GRACE       (2*TICKS_PER_SECOND) // jumping back right after a keyframe skips it
+
+enum /* how the data in a flag block or keyframe is kept */
+{
+	_film_data_deflated,
+	_film_data_stored // deflate failed, so it's as it was
+};
+
 /* ---------- macros */
 
 #define INCREMENT_QUEUE_COUNTER(c) { (c)++; if ((c)>=MAXIMUM_QUEUE_SIZE) (c) = 0; }
@@ -131,6 +161,50 @@ static OpenedFile FilmFile;
 
 struct replay_private_data replay;
 
+struct film_keyframe_entry {
+	int32 tick;
+	int16 level;
+	int32 offset;
+};
+
+struct film_keyframe_header {
+	int32 tick;
+	int16 level;
+	int32 flag_position;
+	uint32 sync_checksum;
+	int32 length;
+	int16 encoding;
+};
+
+static struct seekable_film_data {
+	bool active; // the film being recorded or replayed is in the seekable format
+	int32 next_keyframe_tick;
+	int16 keyframe_level;
+	bool keyframe_pending; // being compressed on the save thread
+	size_t next_flag_block;
+	std::vector<int32> flag_block_offsets;
+	std::vector<film_keyframe_entry> keyframes;
+
+	// after a seek, the keyframe to check the replay against when it gets there;
+	// if that finds it out of sync, it starts over and plays to resync_tick
+	int32 check_keyframe;
+	int32 resync_tick;
+	bool keyframes_in_sync;
+} seekable_film;
+
+/* A keyframe on its way to the film */
+struct pending_film_keyframe {
+	int32 tick;
+	int16 level;
+	int16 encoding;
+	std::vector<uint8> payload;
+};
+
+static bool record_seekable_films = true;
+static int32 keyframe_interval = DEFAULT_KEYFRAME_INTERVAL;
+
+extern ModifiableActionQueues *GetGameQueue();
+
 #ifdef DEBUG
 ActionQueue *get_player_recording_queue(
 	short player_index)
@@ -155,6 +229,28 @@ static short get_recording_queue_size(short which_queue);
 static uint8 *unpack_recording_header(uint8 *Stream, recording_header *Objects, size_t Count);
 static uint8 *pack_recording_header(uint8 *Stream, recording_header *Objects, size_t Count);
 
+static void start_seekable_film(void);
+static void write_film_container_header(int32 index_offset);
+static void write_film_block(uint32 tag, std::vector<uint8>& payload);
+static bool read_film_block(int32 offset, uint32 tag, std::vector<uint8>& payload);
+static void save_recording_flag_block(void);
+static void save_recording_keyframe(void);
+static void compress_film_keyframe(void *data, int32 length, void *keyframe_data);
+static void write_film_keyframe(void *keyframe_data);
+static int32 save_recording_index(void);
+static bool open_seekable_film(void);
+static void scan_film_blocks(void);
+static void read_recording_flag_block(int32 skip);
+static bool read_keyframe_header(int32 offset, film_keyframe_header& header);
+static bool restore_replay_keyframe(size_t keyframe_index);
+static uint32 calculate_replay_sync_checksum(void);
+static void check_replay_sync(void);
+static bool restart_replay(void);
+static void play_replay_to(int32 tick, bool across_levels);
+static void resync_replay(void);
+static bool seek_replay_linearly(int32 tick);
+static void jump_replay(int direction);
+
 // #define DEBUG_REPLAY
 
 #ifdef DEBUG_REPLAY
@@ -163,6 +259,22 @@ static void debug_stream_of_flags(uint32 action_flag, short player_index);
 static void close_stream_file(void);
 #endif
 
+// "seek 40:00" or "seek 2400" jumps there in a seekable film
+struct seek_film_command
+{
+	void operator() (const std::string& arg) const {
+		int minutes= 0, seconds= 0;
+		if (sscanf(arg.c_str(), "%d:%d", &minutes, &seconds) != 2)
+		{
+			minutes= 0;
+			seconds= atoi(arg.c_str());
+		}
+
+		if (!seek_replay((minutes*60+seconds)*TICKS_PER_SECOND))
+			screen_printf("Can't seek in this film");
+	}
+};
+
 /* ---------- code */
 void initialize_keyboard_controller(
 	void)
@@ -199,6 +311,8 @@ void initialize_keyboard_controller(
 		if(!queue->buffer) alert_out_of_memory();
 	}
 	enter_mouse(0);
+
+	Console::instance()->register_command("seek", seek_film_command());
 }
 
 void set_keyboard_controller_status(
@@ -242,16 +356,19 @@ void sync_heartbeat_count(
 	heartbeat_count= dynamic_world->tick_count;
 }
 
+// Past full speed, skip ahead a keyframe; past a pause, step back one
 void increment_replay_speed(
 	void)
 {
 	if (replay.replay_speed < MAXIMUM_REPLAY_SPEED) replay.replay_speed++;
+	else jump_replay(1);
 }
 
 void decrement_replay_speed(
 	void)
 {
 	if (replay.replay_speed > MINIMUM_REPLAY_SPEED) replay.replay_speed--;
+	else jump_replay(-1);
 }
 
 void increment_heartbeat_count(int value)
@@ -281,6 +398,10 @@ bool input_controller(
 			{
 				static short phase= 0; /* When this gets to 0, update the world */
 
+				// a seek left the film out of sync; out here, it can be started over
+				if (seekable_film.active && seekable_film.resync_tick != NONE)
+					resync_replay();
+
 				/* Minimum replay speed is a pause. */
 				if(replay.replay_speed != MINIMUM_REPLAY_SPEED)
 				{
@@ -555,6 +676,7 @@ bool setup_for_replay_from_file(
 		FilmFile.Read(SIZEOF_recording_header,Header);
 		unpack_recording_header(Header,&replay.header,1);
 		replay.header.game_information.cheat_flags = _allow_crosshair | _allow_tunnel_vision | _allow_behindview | _allow_overlay_map;
+		seekable_film.active= open_seekable_film();
 	
 		/* Set to the mapfile this replay came from.. */
 		if(use_map_file(replay.header.map_checksum))
@@ -577,6 +699,7 @@ bool setup_for_replay_from_file(
 			alert_user(infoError, strERRORS, cantFindReplayMap, 0);
 			replay.valid= false;
 			replay.game_is_being_replayed= false;
+			seekable_film.active= false;
 			FilmFile.Close();
 		}
 	}
@@ -605,6 +728,10 @@ void start_recording(
 			byte Header[SIZEOF_recording_header];
 			pack_recording_header(Header,&replay.header,1);
 			FilmFile.Write(SIZEOF_recording_header,Header);
+
+			seekable_film.active= false;
+			if (record_seekable_films)
+				start_seekable_film();
 		}
 	}
 }
@@ -614,15 +741,38 @@ void stop_recording(
 {
 	if (replay.game_is_being_recorded)
 	{
+		// the last keyframe has to get into the film before the index does
+		if (seekable_film.keyframe_pending)
+			wait_for_pending_saves();
+
 		replay.game_is_being_recorded = false;
 		
 		short player_index;
 		int32 total_length;
 
 		assert(replay.valid);
-		for (player_index= 0; player_index<dynamic_world->player_count; player_index++)
+		int32 index_offset= 0;
+		if (seekable_film.active)
+		{
+			// every block but the last has a full chunk for each player
+			bool flags_left;
+			do {
+				save_recording_flag_block();
+
+				flags_left= false;
+				for (player_index= 0; player_index<dynamic_world->player_count; player_index++)
+				{
+					if (get_recording_queue_size(player_index)) flags_left= true;
+				}
+			} while (flags_left);
+			index_offset= save_recording_index();
+		}
+		else
 		{
-			save_recording_queue_chunk(player_index);
+			for (player_index= 0; player_index<dynamic_world->player_count; player_index++)
+			{
+				save_recording_queue_chunk(player_index);
+			}
 		}
 
 		/* Rewrite the header, since it has the new length */
@@ -635,11 +785,16 @@ void stop_recording(
 		// in 'normal operation' too, not just when we screwed something up in writing the program?
 		bool successfulWrite = FilmFile.Write(SIZEOF_recording_header,Header);
 		assert(successfulWrite);
+
+		/* ...and the container header, now that there is an index */
+		if (seekable_film.active)
+			write_film_container_header(index_offset);
 		
 		FilmFile.GetLength(total_length);
 		assert(total_length==replay.header.length);
 		
 		FilmFile.Close();
+		seekable_film.active= false;
 	}
 
 	replay.valid= false;
@@ -650,6 +805,9 @@ void rewind_recording(
 {
 	if(replay.game_is_being_recorded)
 	{
+		if (seekable_film.keyframe_pending)
+			wait_for_pending_saves();
+
 		/* This is unnecessary, because it is called from reset_player_queues, */
 		/* which is always called from revert_game */
 		/*
@@ -668,6 +826,8 @@ void rewind_recording(
 		
 		// Use the packed length here!!!
 		replay.header.length= SIZEOF_recording_header;
+		if (seekable_film.active)
+			start_seekable_film();
 	}
 }
 
@@ -679,6 +839,20 @@ void check_recording_replaying(
 	if (replay.game_is_being_recorded)
 	{
 		bool enough_data_to_save= true;
+
+		// every level starts with a keyframe, even if the last one has to be waited for;
+		// otherwise one that's due can wait until the last one is done
+		if (seekable_film.active && dynamic_world->current_level_number != seekable_film.keyframe_level)
+		{
+			if (seekable_film.keyframe_pending)
+				wait_for_pending_saves();
+			save_recording_keyframe();
+		}
+		else if (seekable_film.active && !seekable_film.keyframe_pending &&
+			dynamic_world->tick_count >= seekable_film.next_keyframe_tick)
+		{
+			save_recording_keyframe();
+		}
 	
 		// it's time to save the queues if all of them have >= RECORD_CHUNK_SIZE flags in them.
 		for (player_index= 0; enough_data_to_save && player_index<dynamic_world->player_count; player_index++)
@@ -698,9 +872,16 @@ void check_recording_replaying(
 			success= FilmFile_Check.GetFreeSpace(freespace);
 			if (success && freespace>(RECORD_CHUNK_SIZE*sizeof(int16)*sizeof(uint32)*dynamic_world->player_count))
 			{
-				for (player_index= 0; player_index<dynamic_world->player_count; player_index++)
+				if (seekable_film.active)
 				{
-					save_recording_queue_chunk(player_index);
+					save_recording_flag_block();
+				}
+				else
+				{
+					for (player_index= 0; player_index<dynamic_world->player_count; player_index++)
+					{
+						save_recording_queue_chunk(player_index);
+					}
 				}
 			}
 		}
@@ -708,6 +889,12 @@ void check_recording_replaying(
 	else if (replay.game_is_being_replayed)
 	{
 		bool load_new_data= true;
+
+		if (seekable_film.active && seekable_film.check_keyframe != NONE &&
+			dynamic_world->tick_count >= seekable_film.keyframes[seekable_film.check_keyframe].tick)
+		{
+			check_replay_sync();
+		}
 	
 		// it's time to refill the requeues if they all have < RECORD_CHUNK_SIZE flags in them.
 		for (player_index= 0; load_new_data && player_index<dynamic_world->player_count; player_index++)
@@ -744,6 +931,7 @@ void stop_replay(
 		assert(replay.valid);
 
 		replay.game_is_being_replayed= false;
+		seekable_film.active= false;
 		if (replay.resource_data)
 		{
 			delete []replay.resource_data;
@@ -769,6 +957,12 @@ static void read_recording_queue_chunks(
 {
 	logContext("reading recording queue chunks");
 
+	if (seekable_film.active)
+	{
+		read_recording_flag_block(0);
+		return;
+	}
+
 	int32 i, sizeof_read;
 	uint32 action_flags; 
 	int16 count, player_index, num_flags;
@@ -923,6 +1117,772 @@ static bool vblFSRead(
 	return status;
 }
 
+/* ---------- seekable films */
+
+static void start_seekable_film(
+	void)
+{
+	seekable_film.active= true;
+	seekable_film.next_keyframe_tick= 0;
+	seekable_film.keyframe_level= NONE;
+	seekable_film.keyframe_pending= false;
+	seekable_film.next_flag_block= 0;
+	seekable_film.flag_block_offsets.clear();
+	seekable_film.keyframes.clear();
+
+	write_film_container_header(0);
+	replay.header.length+= SIZEOF_film_container_header;
+}
+
+static void write_film_container_header(
+	int32 index_offset)
+{
+	uint8 buffer[SIZEOF_film_container_header];
+	uint8 *S= buffer;
+	ValueToStream(S,uint32(FILM_CONTAINER_MAGIC));
+	ValueToStream(S,int16(FILM_CONTAINER_VERSION));
+	ValueToStream(S,int16(0));
+	ValueToStream(S,index_offset);
+	assert(S - buffer == SIZEOF_film_container_header);
+
+	FilmFile.Write(SIZEOF_film_container_header,buffer);
+}
+
+/* Blocks are a tag and a length, then that many bytes */
+static void write_film_block(
+	uint32 tag,
+	std::vector<uint8>& payload)
+{
+	uint8 header[SIZEOF_film_block_header];
+	uint8 *S= header;
+	ValueToStream(S,tag);
+	ValueToStream(S,int32(payload.size()));
+
+	FilmFile.Write(SIZEOF_film_block_header,header);
+	FilmFile.Write(payload.size(),&payload[0]);
+	replay.header.length+= SIZEOF_film_block_header+payload.size();
+}
+
+static bool read_film_block(
+	int32 offset,
+	uint32 tag,
+	std::vector<uint8>& payload)
+{
+	uint8 header[SIZEOF_film_block_header];
+	if (!FilmFile.SetPosition(offset) || !FilmFile.Read(SIZEOF_film_block_header,header))
+		return false;
+
+	uint8 *S= header;
+	uint32 block_tag;
+	int32 length, file_length;
+	StreamToValue(S,block_tag);
+	StreamToValue(S,length);
+
+	FilmFile.GetLength(file_length);
+	if (block_tag != tag || length <= 0 || length > file_length-offset-SIZEOF_film_block_header)
+		return false;
+
+	payload.resize(length);
+	return FilmFile.Read(length,&payload[0]);
+}
+
+/* Appends the deflated data to out */
+static bool deflate_film_data(
+	uint8 *data,
+	int32 length,
+	std::vector<uint8>& out,
+	int level)
+{
+	uLongf compressed_length= compressBound(length);
+	size_t start= out.size();
+
+	out.resize(start+compressed_length);
+	if (compress2(&out[start], &compressed_length, data, length, level) != Z_OK)
+	{
+		out.resize(start);
+		return false;
+	}
+
+	out.resize(start+compressed_length);
+	return true;
+}
+
+static bool inflate_film_data(
+	uint8 *data,
+	int32 length,
+	uint8 *out,
+	int32 out_length)
+{
+	uLongf inflated_length= out_length;
+	return uncompress(out, &inflated_length, data, length) == Z_OK && inflated_length == uLongf(out_length);
+}
+
+/* Saves up to a chunk of each player's queue. Each flag is stored as its difference
+	(XOR) from the one before it, so held keys and idle players come out as runs of
+	zeros, which is what deflate is best at. The flags are gone from the queues by
+	then, so if deflate fails they go in as they are. */
+static void save_recording_flag_block(
+	void)
+{
+	short player_count= dynamic_world->player_count;
+	std::vector<uint8> payload(sizeof(int32)+(player_count+2)*sizeof(int16));
+	std::vector<uint8> deltas(player_count*RECORD_CHUNK_SIZE*sizeof(uint32));
+
+	uint8 *S= &payload[0];
+	uint8 *D= &deltas[0];
+	ValueToStream(S,int32(seekable_film.flag_block_offsets.size()*RECORD_CHUNK_SIZE));
+	ValueToStream(S,player_count);
+	for (short player_index= 0; player_index<player_count; player_index++)
+	{
+		ActionQueue *queue= get_player_recording_queue(player_index);
+		int16 count= MIN(RECORD_CHUNK_SIZE, get_recording_queue_size(player_index));
+		ValueToStream(S,count);
+
+		uint32 previous_flag= 0;
+		for (int16 i= 0; i<count; i++)
+		{
+			uint32 flag= queue->buffer[queue->read_index];
+			INCREMENT_QUEUE_COUNTER(queue->read_index);
+			ValueToStream(D,uint32(flag^previous_flag));
+			previous_flag= flag;
+		}
+	}
+
+	int16 encoding= _film_data_deflated;
+	if (!deflate_film_data(&deltas[0], D-&deltas[0], payload, Z_DEFAULT_COMPRESSION))
+	{
+		logWarning("unable to compress film flags; storing them as they are");
+		encoding= _film_data_stored;
+		payload.insert(payload.end(), deltas.begin(), deltas.begin()+(D-&deltas[0]));
+	}
+	S= &payload[sizeof(int32)+(player_count+1)*sizeof(int16)];
+	ValueToStream(S,encoding);
+
+	seekable_film.flag_block_offsets.push_back(replay.header.length);
+	write_film_block(FLAG_BLOCK_TAG, payload);
+}
+
+/* The whole game, as a saved game would have it, along with where in the flags it
+	is. Only packing the world happens here; the rest is done on the save thread,
+	and the keyframe gets written when it's done. */
+static void save_recording_keyframe(
+	void)
+{
+	seekable_film.keyframe_level= dynamic_world->current_level_number;
+	seekable_film.next_keyframe_tick= dynamic_world->tick_count+keyframe_interval;
+
+	// everything recorded so far, less what the world hasn't gotten to yet
+	int32 flag_position= seekable_film.flag_block_offsets.size()*RECORD_CHUNK_SIZE +
+		get_recording_queue_size(0) - GetRealActionQueues()->countActionFlags(0) -
+		GetGameQueue()->countActionFlags(0);
+
+	pending_film_keyframe *keyframe= new pending_film_keyframe;
+	keyframe->tick= dynamic_world->tick_count;
+	keyframe->level= dynamic_world->current_level_number;
+	keyframe->encoding= _film_data_deflated;
+	keyframe->payload.resize(SIZEOF_keyframe_block_header);
+
+	// the length and the encoding come later
+	uint8 *S= &keyframe->payload[0];
+	ValueToStream(S,keyframe->tick);
+	ValueToStream(S,keyframe->level);
+	ValueToStream(S,flag_position);
+	ValueToStream(S,calculate_replay_sync_checksum());
+
+	seekable_film.keyframe_pending= true;
+	if (!build_film_keyframe_in_background(compress_film_keyframe, write_film_keyframe, keyframe))
+	{
+		seekable_film.keyframe_pending= false;
+		delete keyframe;
+		logError("unable to build film keyframe");
+	}
+}
+
+/* On the save thread */
+static void compress_film_keyframe(
+	void *data,
+	int32 length,
+	void *keyframe_data)
+{
+	pending_film_keyframe *keyframe= static_cast<pending_film_keyframe *>(keyframe_data);
+	std::vector<uint8>& payload= keyframe->payload;
+
+	if (!data)
+	{
+		payload.clear();
+		return;
+	}
+
+	// this happens mid-game, so favor speed
+	if (!deflate_film_data(static_cast<uint8 *>(data), length, payload, Z_BEST_SPEED))
+	{
+		keyframe->encoding= _film_data_stored;
+		payload.insert(payload.end(), static_cast<uint8 *>(data), static_cast<uint8 *>(data)+length);
+	}
+	free(data);
+
+	uint8 *S= &payload[SIZEOF_keyframe_block_header-sizeof(int32)-sizeof(int16)];
+	ValueToStream(S,length);
+	ValueToStream(S,keyframe->encoding);
+	assert(S - &payload[0] == SIZEOF_keyframe_block_header);
+}
+
+static void write_film_keyframe(
+	void *keyframe_data)
+{
+	pending_film_keyframe *keyframe= static_cast<pending_film_keyframe *>(keyframe_data);
+
+	seekable_film.keyframe_pending= false;
+	if (keyframe->payload.empty())
+	{
+		logError("unable to build film keyframe");
+	}
+	else if (replay.game_is_being_recorded && seekable_film.active)
+	{
+		if (keyframe->encoding == _film_data_stored)
+			logWarning("unable to compress film keyframe; storing it as it is");
+
+		film_keyframe_entry entry= { keyframe->tick, keyframe->level, replay.header.length };
+		seekable_film.keyframes.push_back(entry);
+		write_film_block(KEYFRAME_BLOCK_TAG, keyframe->payload);
+	}
+
+	delete keyframe;
+}
+
+static int32 save_recording_index(
+	void)
+{
+	int32 index_offset= replay.header.length;
+	int32 block_count= seekable_film.flag_block_offsets.size();
+	int32 keyframe_count= seekable_film.keyframes.size();
+
+	std::vector<uint8> payload((2+block_count)*sizeof(int32) + keyframe_count*(2*sizeof(int32)+sizeof(int16)));
+	uint8 *S= &payload[0];
+	ValueToStream(S,block_count);
+	ListToStream(S,&seekable_film.flag_block_offsets[0],block_count);
+	ValueToStream(S,keyframe_count);
+	for (int32 i= 0; i<keyframe_count; i++)
+	{
+		ValueToStream(S,seekable_film.keyframes[i].tick);
+		ValueToStream(S,seekable_film.keyframes[i].level);
+		ValueToStream(S,seekable_film.keyframes[i].offset);
+	}
+	assert(S - &payload[0] == int32(payload.size()));
+
+	write_film_block(INDEX_BLOCK_TAG, payload);
+	return index_offset;
+}
+
+/* Called with the film just past the recording header; leaves it there if the
+	film turns out to be a legacy one */
+static bool open_seekable_film(
+	void)
+{
+	uint8 buffer[SIZEOF_film_container_header];
+	uint32 magic= 0;
+	int16 version, unused;
+	int32 index_offset= 0;
+
+	if (FilmFile.Read(SIZEOF_film_container_header,buffer))
+	{
+		uint8 *S= buffer;
+		StreamToValue(S,magic);
+		StreamToValue(S,version);
+		StreamToValue(S,unused);
+		StreamToValue(S,index_offset);
+	}
+
+	if (magic != FILM_CONTAINER_MAGIC)
+	{
+		FilmFile.SetPosition(SIZEOF_recording_header);
+		return false;
+	}
+
+	seekable_film.next_flag_block= 0;
+	seekable_film.flag_block_offsets.clear();
+	seekable_film.keyframes.clear();
+	seekable_film.check_keyframe= NONE;
+	seekable_film.resync_tick= NONE;
+	seekable_film.keyframes_in_sync= true;
+
+	// a later version than this one knows; there's nothing here it can play
+	if (version != FILM_CONTAINER_VERSION)
+	{
+		logError("film container version %d is unknown", int(version));
+		return true;
+	}
+
+	std::vector<uint8> payload;
+	bool indexed= false;
+	if (index_offset > 0 && read_film_block(index_offset, INDEX_BLOCK_TAG, payload) &&
+		payload.size() >= 2*sizeof(int32))
+	{
+		const size_t keyframe_entry_size= 2*sizeof(int32)+sizeof(int16);
+		uint8 *S= &payload[0];
+		int32 block_count, keyframe_count;
+
+		StreamToValue(S,block_count);
+		if (block_count >= 0 && size_t(block_count) <= payload.size()/sizeof(int32)-2)
+		{
+			seekable_film.flag_block_offsets.resize(block_count);
+			StreamToList(S,&seekable_film.flag_block_offsets[0],block_count);
+			StreamToValue(S,keyframe_count);
+
+			size_t remaining= payload.size()-(S-&payload[0]);
+			if (keyframe_count >= 0 && size_t(keyframe_count) == remaining/keyframe_entry_size &&
+				remaining%keyframe_entry_size == 0)
+			{
+				seekable_film.keyframes.resize(keyframe_count);
+				for (int32 i= 0; i<keyframe_count; i++)
+				{
+					StreamToValue(S,seekable_film.keyframes[i].tick);
+					StreamToValue(S,seekable_film.keyframes[i].level);
+					StreamToValue(S,seekable_film.keyframes[i].offset);
+				}
+				indexed= true;
+			}
+		}
+	}
+
+	// the game quit before it could write the index; find the blocks the slow way
+	if (!indexed)
+		scan_film_blocks();
+
+	return true;
+}
+
+static void scan_film_blocks(
+	void)
+{
+	int32 file_length;
+	int32 offset= SIZEOF_recording_header+SIZEOF_film_container_header;
+
+	seekable_film.flag_block_offsets.clear();
+	seekable_film.keyframes.clear();
+
+	FilmFile.GetLength(file_length);
+	while (offset+SIZEOF_film_block_header <= file_length)
+	{
+		uint8 buffer[SIZEOF_film_block_header];
+		if (!FilmFile.SetPosition(offset) || !FilmFile.Read(SIZEOF_film_block_header,buffer))
+			break;
+
+		uint8 *S= buffer;
+		uint32 tag;
+		int32 length;
+		StreamToValue(S,tag);
+		StreamToValue(S,length);
+
+		// a block cut off by a crash ends the film
+		if (length <= 0 || length > file_length-offset-SIZEOF_film_block_header)
+			break;
+
+		if (tag == FLAG_BLOCK_TAG)
+		{
+			seekable_film.flag_block_offsets.push_back(offset);
+		}
+		else if (tag == KEYFRAME_BLOCK_TAG && length >= SIZEOF_keyframe_block_header)
+		{
+			film_keyframe_header header;
+			if (read_keyframe_header(offset, header))
+			{
+				film_keyframe_entry entry= { header.tick, header.level, offset };
+				seekable_film.keyframes.push_back(entry);
+			}
+		}
+
+		offset+= SIZEOF_film_block_header+length;
+	}
+}
+
+/* Fills the recording queues from the next flag block, leaving out the first skip flags */
+static void read_recording_flag_block(
+	int32 skip)
+{
+	size_t block_index= seekable_film.next_flag_block++;
+	short player_count= dynamic_world->player_count;
+	std::vector<uint8> payload;
+	bool success= false;
+
+	if (block_index < seekable_film.flag_block_offsets.size() &&
+		read_film_block(seekable_film.flag_block_offsets[block_index], FLAG_BLOCK_TAG, payload) &&
+		payload.size() >= sizeof(int32)+(player_count+2)*sizeof(int16))
+	{
+		uint8 *S= &payload[0];
+		int32 first_flag, total_count= 0;
+		int16 block_player_count, counts[MAXIMUM_NUMBER_OF_PLAYERS], encoding= NONE;
+
+		StreamToValue(S,first_flag);
+		StreamToValue(S,block_player_count);
+		success= (block_player_count == player_count);
+		for (short player_index= 0; success && player_index<player_count; player_index++)
+		{
+			StreamToValue(S,counts[player_index]);
+			if (counts[player_index] < 0 || counts[player_index] > RECORD_CHUNK_SIZE) success= false;
+			total_count+= counts[player_index];
+		}
+		if (success) StreamToValue(S,encoding);
+
+		std::vector<uint8> deltas(total_count*sizeof(uint32));
+		size_t data_length= payload.size()-(S-&payload[0]);
+		if (success && encoding == _film_data_stored)
+		{
+			success= (data_length == deltas.size());
+			if (success && total_count) memcpy(&deltas[0], S, deltas.size());
+		}
+		else if (success && encoding == _film_data_deflated)
+		{
+			if (total_count) success= inflate_film_data(S, data_length, &deltas[0], deltas.size());
+		}
+		else
+		{
+			success= false;
+		}
+
+		uint8 *D= deltas.data();
+		for (short player_index= 0; success && player_index<player_count; player_index++)
+		{
+			ActionQueue *queue= get_player_recording_queue(player_index);
+			uint32 flag= 0;
+			for (int16 i= 0; i<counts[player_index]; i++)
+			{
+				uint32 delta;
+				StreamToValue(D,delta);
+				flag^= delta;
+				if (i < skip) continue;
+
+				*(queue->buffer + queue->write_index) = flag;
+				INCREMENT_QUEUE_COUNTER(queue->write_index);
+				assert(queue->read_index != queue->write_index);
+			}
+		}
+
+		if (!success)
+			logError("film flag block %d is damaged", int(block_index));
+	}
+
+	if (!success || seekable_film.next_flag_block >= seekable_film.flag_block_offsets.size())
+		replay.have_read_last_chunk= true;
+}
+
+static bool read_keyframe_header(
+	int32 offset,
+	film_keyframe_header& header)
+{
+	uint8 buffer[SIZEOF_keyframe_block_header];
+	if (!FilmFile.SetPosition(offset+SIZEOF_film_block_header) || !FilmFile.Read(SIZEOF_keyframe_block_header,buffer))
+		return false;
+
+	uint8 *S= buffer;
+	StreamToValue(S,header.tick);
+	StreamToValue(S,header.level);
+	StreamToValue(S,header.flag_position);
+	StreamToValue(S,header.sync_checksum);
+	StreamToValue(S,header.length);
+	StreamToValue(S,header.encoding);
+	assert(S - buffer == SIZEOF_keyframe_block_header);
+
+	return true;
+}
+
+/* Throws away the running game; if that much works but the keyframe doesn't, the replay ends */
+static bool restore_replay_keyframe(
+	size_t keyframe_index)
+{
+	std::vector<uint8> payload;
+	film_keyframe_header header;
+	int32 offset= seekable_film.keyframes[keyframe_index].offset;
+	if (!read_film_block(offset, KEYFRAME_BLOCK_TAG, payload) ||
+		payload.size() <= SIZEOF_keyframe_block_header || !read_keyframe_header(offset, header))
+	{
+		logError("film keyframe %d is damaged", int(keyframe_index));
+		return false;
+	}
+
+	uint8 *S= &payload[SIZEOF_keyframe_block_header];
+	int32 data_length= payload.size()-SIZEOF_keyframe_block_header;
+	uint8 *data= (header.flag_position >= 0 && header.length > 0) ? (uint8 *) malloc(header.length) : NULL;
+	bool success= false;
+	if (data && header.encoding == _film_data_stored)
+	{
+		success= (data_length == header.length);
+		if (success) memcpy(data, S, header.length);
+	}
+	else if (data && header.encoding == _film_data_deflated)
+	{
+		success= inflate_film_data(S, data_length, data, header.length);
+	}
+	if (!success)
+	{
+		free(data);
+		logError("film keyframe %d is damaged", int(keyframe_index));
+		return false;
+	}
+
+	if (!restore_film_keyframe(data))
+	{
+		logError("unable to restore film keyframe %d", int(keyframe_index));
+		set_game_state(_switch_demo);
+		return false;
+	}
+
+	// restoring emptied the queues; pick the flags up where the keyframe left off
+	seekable_film.next_flag_block= header.flag_position/RECORD_CHUNK_SIZE;
+	replay.have_read_last_chunk= false;
+	read_recording_flag_block(header.flag_position%RECORD_CHUNK_SIZE);
+
+	// the next keyframe on this level tells whether this one brought the game back exactly
+	size_t next_index= keyframe_index+1;
+	seekable_film.check_keyframe= (next_index < seekable_film.keyframes.size() &&
+		seekable_film.keyframes[next_index].level == header.level) ? int32(next_index) : NONE;
+
+	return true;
+}
+
+static inline void add_to_sync_checksum(
+	uint32& checksum,
+	int32 value)
+{
+	// FNV-1a, a value at a time
+	checksum= (checksum ^ uint32(value)) * 16777619;
+}
+
+/* Not the whole world, just enough to tell: anything out of sync soon shows up in
+	the random seed, or in where the players and monsters are */
+static uint32 calculate_replay_sync_checksum(
+	void)
+{
+	uint32 checksum= 2166136261U;
+
+	add_to_sync_checksum(checksum, get_random_seed());
+	add_to_sync_checksum(checksum, dynamic_world->tick_count);
+	for (short player_index= 0; player_index<dynamic_world->player_count; player_index++)
+	{
+		struct player_data *player= get_player_data(player_index);
+		add_to_sync_checksum(checksum, player->location.x);
+		add_to_sync_checksum(checksum, player->location.y);
+		add_to_sync_checksum(checksum, player->location.z);
+		add_to_sync_checksum(checksum, player->facing);
+		add_to_sync_checksum(checksum, player->elevation);
+		add_to_sync_checksum(checksum, player->suit_energy);
+	}
+
+	struct monster_data *monster;
+	short monster_index;
+	for (monster_index= 0, monster= monsters; monster_index<MAXIMUM_MONSTERS_PER_MAP; ++monster_index, ++monster)
+	{
+		if (!SLOT_IS_USED(monster)) continue;
+
+		add_to_sync_checksum(checksum, monster_index);
+		add_to_sync_checksum(checksum, monster->type);
+		add_to_sync_checksum(checksum, monster->vitality);
+		add_to_sync_checksum(checksum, monster->mode);
+		add_to_sync_checksum(checksum, monster->action);
+		if (monster->object_index != NONE)
+		{
+			struct object_data *object= get_object_data(monster->object_index);
+			add_to_sync_checksum(checksum, object->location.x);
+			add_to_sync_checksum(checksum, object->location.y);
+			add_to_sync_checksum(checksum, object->location.z);
+		}
+	}
+
+	return checksum;
+}
+
+/* The replay just got to the keyframe after the one a seek started from. If the
+	world doesn't match what was recorded there, keyframes don't bring this film
+	back exactly, so it starts over and plays to here (from input_controller(),
+	since this is in the middle of update_world()), and from now on seeks do the same. */
+static void check_replay_sync(
+	void)
+{
+	const film_keyframe_entry keyframe= seekable_film.keyframes[seekable_film.check_keyframe];
+	seekable_film.check_keyframe= NONE;
+
+	// update_world() stops at the keyframe's tick; past it, there's nothing to compare
+	film_keyframe_header header;
+	if (dynamic_world->tick_count != keyframe.tick || dynamic_world->current_level_number != keyframe.level ||
+		!read_keyframe_header(keyframe.offset, header))
+	{
+		return;
+	}
+
+	if (header.sync_checksum != calculate_replay_sync_checksum())
+	{
+		logWarning("film is out of sync after seeking; replaying it from the start");
+		seekable_film.keyframes_in_sync= false;
+		seekable_film.resync_tick= dynamic_world->tick_count;
+	}
+}
+
+int32 get_replay_check_tick(
+	void)
+{
+	if (replay.game_is_being_replayed && seekable_film.active && seekable_film.check_keyframe != NONE)
+		return seekable_film.keyframes[seekable_film.check_keyframe].tick;
+
+	return NONE;
+}
+
+/* Back to the film's first tick, the slow and sure way */
+static bool restart_replay(
+	void)
+{
+	struct entry_point entry;
+	struct game_data game_information;
+	short viewed_player_index= current_player_index;
+
+	obj_clear(entry);
+	entry.level_number= replay.header.level_number;
+	obj_copy(game_information, replay.header.game_information);
+	game_information.game_options |= _overhead_map_is_omniscient; // as begin_game() has it for films
+
+	if (!restart_film_game(replay.header.num_players, &game_information, replay.header.starts, &entry))
+	{
+		logError("unable to start the film over");
+		set_game_state(_switch_demo);
+		return false;
+	}
+	if (viewed_player_index >= 0 && viewed_player_index < dynamic_world->player_count)
+		set_current_player_index(viewed_player_index);
+
+	seekable_film.next_flag_block= 0;
+	seekable_film.check_keyframe= NONE;
+	replay.have_read_last_chunk= false;
+	read_recording_flag_block(0);
+
+	return true;
+}
+
+/* Plays up to the tick without drawing */
+static void play_replay_to(
+	int32 tick,
+	bool across_levels)
+{
+	short level= dynamic_world->current_level_number;
+	while (dynamic_world->tick_count < tick && (across_levels || dynamic_world->current_level_number == level) &&
+		get_game_state() == _game_in_progress)
+	{
+		check_recording_replaying();
+		if (!pull_flags_from_recording(1))
+			break;
+
+		heartbeat_count++;
+		update_world();
+	}
+	SoundManager::instance()->StopAllSounds();
+}
+
+static void resync_replay(
+	void)
+{
+	int32 tick= seekable_film.resync_tick;
+	seekable_film.resync_tick= NONE;
+
+	if (restart_replay())
+		play_replay_to(tick, true);
+}
+
+static bool tick_before_keyframe(
+	int32 tick,
+	const film_keyframe_entry& keyframe)
+{
+	return tick < keyframe.tick;
+}
+
+static bool can_seek_replay(
+	void)
+{
+	return replay.game_is_being_replayed && seekable_film.active && !seekable_film.keyframes.empty() &&
+		!Movie::instance()->IsRecording();
+}
+
+static void print_replay_time(
+	void)
+{
+	int32 seconds= dynamic_world->tick_count/TICKS_PER_SECOND;
+	screen_printf("%d:%02d", int(seconds/60), int(seconds%60));
+}
+
+/* Without keyframes to trust, a seek is the film played (from the start, if it's backward) */
+static bool seek_replay_linearly(
+	int32 tick)
+{
+	if (tick < dynamic_world->tick_count && !restart_replay())
+		return false;
+
+	play_replay_to(tick, true);
+	return true;
+}
+
+static void jump_replay(
+	int direction)
+{
+	if (!can_seek_replay())
+		return;
+
+	std::vector<film_keyframe_entry>& keyframes= seekable_film.keyframes;
+	std::vector<film_keyframe_entry>::iterator it;
+	if (direction > 0)
+	{
+		it= std::upper_bound(keyframes.begin(), keyframes.end(), dynamic_world->tick_count, tick_before_keyframe);
+		if (it == keyframes.end())
+			return;
+	}
+	else
+	{
+		it= std::upper_bound(keyframes.begin(), keyframes.end(),
+			dynamic_world->tick_count-REPLAY_JUMP_BACK_GRACE-1, tick_before_keyframe);
+		if (it == keyframes.begin())
+			return;
+		--it;
+	}
+
+	bool success= seekable_film.keyframes_in_sync ?
+		restore_replay_keyframe(it-keyframes.begin()) : seek_replay_linearly(it->tick);
+	if (success)
+		print_replay_time();
+}
+
+bool seek_replay(
+	int32 tick)
+{
+	if (!can_seek_replay())
+		return false;
+
+	if (!seekable_film.keyframes_in_sync)
+	{
+		if (!seek_replay_linearly(tick))
+			return false;
+
+		print_replay_time();
+		return true;
+	}
+
+	// the last keyframe at or before the tick
+	std::vector<film_keyframe_entry>& keyframes= seekable_film.keyframes;
+	size_t index= std::upper_bound(keyframes.begin(), keyframes.end(), tick, tick_before_keyframe) - keyframes.begin();
+	if (index) --index;
+
+	if (!restore_replay_keyframe(index))
+		return false;
+
+	// every level starts with a keyframe, so anything past a level change is past
+	// the end of the film or the level
+	play_replay_to(tick, false);
+
+	print_replay_time();
+	return true;
+}
+
+bool recording_seekable_films(
+	void)
+{
+	return record_seekable_films;
+}
+
 static void remove_input_controller(
 	void)
 {
@@ -950,6 +1910,21 @@ static void remove_input_controller(
 }
 
 
+void reset_mml_film()
+{
+	record_seekable_films= true;
+	keyframe_interval= DEFAULT_KEYFRAME_INTERVAL;
+}
+
+void parse_mml_film(const InfoTree& root)
+{
+	root.read_attr("seekable", record_seekable_films);
+
+	int16 seconds;
+	if (root.read_attr_bounded<int16>("keyframe_interval", seconds, 1, 3600))
+		keyframe_interval= seconds*TICKS_PER_SECOND;
+}
+
 void reset_mml_keyboard()
 {
 	// no reset
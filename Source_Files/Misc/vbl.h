@@ -75,5 +75,7 @@ static void close_stream_file(void);
 class InfoTree;
 void parse_mml_keyboard(const InfoTree& root);
 void reset_mml_keyboard();
+void parse_mml_film(const InfoTree& root);
+void reset_mml_film();
 
 #endif
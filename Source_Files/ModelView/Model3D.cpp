@@ -25,6 +25,10 @@
 #include <string.h>
 #include <math.h>
 
+#ifdef __SSE__
+#include <xmmintrin.h>
+#endif
+
 #include "VecOps.h"
 #include "cseries.h"
 #include "world.h"
@@ -66,6 +70,83 @@ inline void TransformVector(GLfloat *Dest, GLfloat *Src, Model3D_Transform& T)
 	}
 }
 
+#ifdef __SSE__
+
+// A transform's columns, for transforming a point with three multiply-adds:
+// T*P = C0*P.x + C1*P.y + C2*P.z + C3 (same order of operations as TransformPoint).
+// Plain floats, loaded unaligned, since vectors of these get no 16-byte alignment in C++11
+struct TransformColumns
+{
+	GLfloat C[4][4];
+};
+
+static inline void LoadColumns(TransformColumns& TC, Model3D_Transform& T)
+{
+	for (int ic=0; ic<4; ic++)
+	{
+		TC.C[ic][0] = T.M[0][ic];
+		TC.C[ic][1] = T.M[1][ic];
+		TC.C[ic][2] = T.M[2][ic];
+		TC.C[ic][3] = 0;
+	}
+}
+
+static inline __m128 ColumnsTimesVector(const TransformColumns& TC, const GLfloat *Src)
+{
+	__m128 Res = _mm_mul_ps(_mm_loadu_ps(TC.C[0]),_mm_set1_ps(Src[0]));
+	Res = _mm_add_ps(Res,_mm_mul_ps(_mm_loadu_ps(TC.C[1]),_mm_set1_ps(Src[1])));
+	return _mm_add_ps(Res,_mm_mul_ps(_mm_loadu_ps(TC.C[2]),_mm_set1_ps(Src[2])));
+}
+
+static inline __m128 ColumnsTimesPoint(const TransformColumns& TC, const GLfloat *Src)
+{
+	return _mm_add_ps(ColumnsTimesVector(TC,Src),_mm_loadu_ps(TC.C[3]));
+}
+
+// Writes only the first three members; the arrays are packed xyz triples
+static inline void StoreTriple(GLfloat *Dest, __m128 V)
+{
+	_mm_storel_pi((__m64 *)Dest,V);
+	_mm_store_ss(Dest+2,_mm_movehl_ps(V,V));
+}
+
+#endif
+
+// Transform a packed array of points or vectors in place
+static void TransformPoints(GLfloat *Points, size_t NumPoints, Model3D_Transform& T)
+{
+#ifdef __SSE__
+	TransformColumns TC;
+	LoadColumns(TC,T);
+	for (size_t k=0; k<NumPoints; k++, Points+=3)
+		StoreTriple(Points,ColumnsTimesPoint(TC,Points));
+#else
+	for (size_t k=0; k<NumPoints; k++, Points+=3)
+	{
+		GLfloat Position[3];
+		TransformPoint(Position,Points,T);
+		VecCopy(Position,Points);
+	}
+#endif
+}
+
+static void TransformVectors(GLfloat *Vectors, size_t NumVectors, Model3D_Transform& T)
+{
+#ifdef __SSE__
+	TransformColumns TC;
+	LoadColumns(TC,T);
+	for (size_t k=0; k<NumVectors; k++, Vectors+=3)
+		StoreTriple(Vectors,ColumnsTimesVector(TC,Vectors));
+#else
+	for (size_t k=0; k<NumVectors; k++, Vectors+=3)
+	{
+		GLfloat Vector[3];
+		TransformVector(Vector,Vectors,T);
+		VecCopy(Vector,Vectors);
+	}
+#endif
+}
+
 // Bone and Frame (positions, angles) -> Transform Matrix
 static void FindFrameTransform(Model3D_Transform& T,
 	Model3D_Frame& Frame, GLfloat MixFrac, Model3D_Frame& AddlFrame);
@@ -98,6 +179,7 @@ void Model3D::Clear()
 	SeqFrames.clear();
 	SeqFrmPointers.clear();
 	FindBoundingBox();
+	InvalidatePoses();
 }
 
 // Normalize an individual normal; return whether the normal had a nonzero length
@@ -702,6 +784,8 @@ bool Model3D::FindPositions_Neutral(bool UseModelTransform)
 	// Positions already there
 	if (VtxSrcIndices.empty()) return false;
 	
+	CurrentPoseEntry = NONE;
+	
 	// Straight copy of the vertices:
 	
 	size_t NumVertices = VtxSrcIndices.size();
@@ -772,9 +856,67 @@ bool Model3D::FindPositions_Neutral(bool UseModelTransform)
 	return true;
 }
 
+bool Model3D::LoadCachedPose(const Model3D_PoseKey& Key)
+{
+	for (size_t k=0; k<PoseCache.size(); k++)
+	{
+		PoseCacheEntry& Entry = PoseCache[k];
+		if (!(Entry.Key == Key)) continue;
+		
+		if (CurrentPoseEntry != int(k))
+		{
+			Positions = Entry.Positions;
+			Normals = Entry.Normals;
+			CurrentPoseEntry = int(k);
+		}
+		return true;
+	}
+	return false;
+}
+
+void Model3D::CachePose(const Model3D_PoseKey& Key)
+{
+	// Replace the oldest entry once they are all in use
+	size_t Indx;
+	if (PoseCache.size() < MaxCachedPoses)
+	{
+		Indx = PoseCache.size();
+		PoseCache.resize(Indx+1);
+	}
+	else
+	{
+		Indx = NextPoseEntry;
+		NextPoseEntry = (NextPoseEntry + 1) % MaxCachedPoses;
+	}
+	
+	PoseCacheEntry& Entry = PoseCache[Indx];
+	Entry.Key = Key;
+	Entry.Positions = Positions;
+	Entry.Normals = Normals;
+	CurrentPoseEntry = int(Indx);
+}
+
 // Frame case
 bool Model3D::FindPositions_Frame(bool UseModelTransform,
 	GLshort FrameIndex, GLfloat MixFrac, GLshort AddlFrameIndex)
+{
+	// Mixing a frame with itself gives that frame
+	if (MixFrac == 0 || AddlFrameIndex == FrameIndex)
+	{
+		MixFrac = 0;
+		AddlFrameIndex = FrameIndex;
+	}
+	
+	Model3D_PoseKey Key = {NONE, FrameIndex, AddlFrameIndex, MixFrac, UseModelTransform};
+	if (LoadCachedPose(Key)) return true;
+	
+	if (!SkinFrame(UseModelTransform,FrameIndex,MixFrac,AddlFrameIndex)) return false;
+	CachePose(Key);
+	return true;
+}
+
+bool Model3D::SkinFrame(bool UseModelTransform,
+	GLshort FrameIndex, GLfloat MixFrac, GLshort AddlFrameIndex)
 {
 	// Bad inputs: do nothing and return false
 	
@@ -783,6 +925,8 @@ bool Model3D::FindPositions_Frame(bool UseModelTransform,
 	size_t NumBones = Bones.size();
 	if (FrameIndex < 0 || NumBones*FrameIndex >= Frames.size()) return false;
 	
+	CurrentPoseEntry = NONE;
+	
 	if (InverseVSIndices.empty()) BuildInverseVSIndices();
 	
 	size_t NumVertices = VtxSrcIndices.size();
@@ -838,6 +982,69 @@ bool Model3D::FindPositions_Frame(bool UseModelTransform,
 	bool NormalsPresent = !NormSources.empty();
 	if (NormalsPresent) Normals.resize(NormSources.size());
 	
+#ifdef __SSE__
+	// Do the bones' column forms once, rather than once per vertex source
+	static vector<TransformColumns> BoneColumns;
+	BoneColumns.resize(NumBones);
+	for (size_t ib=0; ib<NumBones; ib++)
+		LoadColumns(BoneColumns[ib],BoneMatrices[ib]);
+	
+	for (unsigned ivs=0; ivs<VtxSources.size(); ivs++)
+	{
+		Model3D_VertexSource& VS = VtxSources[ivs];
+		GLfloat Position[4];
+		int IVBegin = InvVSIPointers[ivs], IVEnd = InvVSIPointers[ivs+1];
+		
+		if (VS.Bone0 >= 0)
+		{
+			TransformColumns& TC0 = BoneColumns[VS.Bone0];
+			__m128 Pos = ColumnsTimesPoint(TC0,VS.Position);
+			
+			GLfloat Blend = VS.Blend;
+			bool Blended = (VS.Bone1 >= 0 && Blend != 0);
+			__m128 BlendV = _mm_set1_ps(Blend);
+			if (Blended)
+			{
+				// Pos + Blend*(Pos1 - Pos), as in the scalar version
+				__m128 PosExtra = ColumnsTimesPoint(BoneColumns[VS.Bone1],VS.Position);
+				Pos = _mm_add_ps(Pos,_mm_mul_ps(_mm_sub_ps(PosExtra,Pos),BlendV));
+			}
+			_mm_storeu_ps(Position,Pos);
+			
+			if (NormalsPresent)
+			{
+				for (int iv=IVBegin; iv<IVEnd; iv++)
+				{
+					int Indx = 3*InverseVSIndices[iv];
+					GLfloat *OrigNorm = NormSrcBase() + Indx;
+					__m128 Norm = ColumnsTimesVector(TC0,OrigNorm);
+					if (Blended)
+					{
+						__m128 NormExtra = ColumnsTimesVector(BoneColumns[VS.Bone1],OrigNorm);
+						Norm = _mm_add_ps(Norm,_mm_mul_ps(_mm_sub_ps(NormExtra,Norm),BlendV));
+					}
+					StoreTriple(NormBase() + Indx,Norm);
+				}
+			}
+		}
+		else	// The assumed root bone (identity transformation)
+		{
+			VecCopy(VS.Position,Position);
+			if (NormalsPresent)
+			{
+				for (int iv=IVBegin; iv<IVEnd; iv++)
+				{
+					int Indx = 3*InverseVSIndices[iv];
+					VecCopy(NormSrcBase() + Indx, NormBase() + Indx);
+				}
+			}
+		}
+		
+		// Copy found position into vertex array!
+		for (int iv=IVBegin; iv<IVEnd; iv++)
+			VecCopy(Position,PosBase() + 3*InverseVSIndices[iv]);
+	}
+#else
 	for (unsigned ivs=0; ivs<VtxSources.size(); ivs++)
 	{
 		Model3D_VertexSource& VS = VtxSources[ivs];
@@ -902,23 +1109,12 @@ bool Model3D::FindPositions_Frame(bool UseModelTransform,
 		for (int iv=InvVSIPointers[ivs]; iv<InvVSIPointers[ivs+1]; iv++)
 			VecCopy(Position,PosBase() + 3*InverseVSIndices[iv]);
 	}
+#endif
 	
 	if (UseModelTransform)
 	{
-		GLfloat *PP = PosBase();
-		for (size_t k=0; k<Positions.size()/3; k++, PP+=3)
-		{
-			GLfloat Position[3];
-			TransformPoint(Position,PP,TransformPos);
-			VecCopy(Position,PP);
-		}
-		GLfloat *NP = NormBase();
-		for (size_t k=0; k<Normals.size()/3; k++, NP+=3)
-		{
-			GLfloat Normal[3];
-			TransformVector(Normal,NP,TransformNorm);
-			VecCopy(Normal,NP);
-		}
+		TransformPoints(PosBase(),Positions.size()/3,TransformPos);
+		TransformVectors(NormBase(),Normals.size()/3,TransformNorm);
 	}
 	
 	return true;
@@ -943,22 +1139,34 @@ bool Model3D::FindPositions_Sequence(bool UseModelTransform, GLshort SeqIndex,
 	
 	if (FrameIndex < 0 || FrameIndex >= NumSF) return false;
 	
+	bool Mixed = (MixFrac != 0 && AddlFrameIndex != FrameIndex);
+	if (Mixed)
+	{
+		if (AddlFrameIndex < 0 || AddlFrameIndex >= NumSF) return false;
+	}
+	else
+	{
+		MixFrac = 0;
+		AddlFrameIndex = FrameIndex;
+	}
+	
+	Model3D_PoseKey Key = {SeqIndex, FrameIndex, AddlFrameIndex, MixFrac, UseModelTransform};
+	if (LoadCachedPose(Key)) return true;
+	
 	Model3D_Transform TSF;
 	
 	Model3D_SeqFrame& SF = SeqFrames[SeqFrmPointers[SeqIndex] + FrameIndex];
 	
-	if (MixFrac != 0 && AddlFrameIndex != FrameIndex)
+	if (Mixed)
 	{
-		if (AddlFrameIndex < 0 || AddlFrameIndex >= NumSF) return false;
-		
 		Model3D_SeqFrame& ASF = SeqFrames[SeqFrmPointers[SeqIndex] + AddlFrameIndex];
 		FindFrameTransform(TSF,SF,MixFrac,ASF);
 		
-		if (!FindPositions_Frame(false,SF.Frame,MixFrac,ASF.Frame)) return false;
+		if (!SkinFrame(false,SF.Frame,MixFrac,ASF.Frame)) return false;
 	}
 	else
 	{
-		if (!FindPositions_Frame(false,SF.Frame)) return false;
+		if (!SkinFrame(false,SF.Frame,0,0)) return false;
 		FindFrameTransform(TSF,SF,0,SF);
 	}
 	
@@ -969,14 +1177,7 @@ bool Model3D::FindPositions_Sequence(bool UseModelTransform, GLshort SeqIndex,
 		obj_copy(TTot,TSF);
 	
 	size_t NumVerts = Positions.size()/3;
-	GLfloat *Pos = PosBase();
-	for (size_t iv=0; iv<NumVerts; iv++)
-	{
-		GLfloat NewPos[3];
-		TransformPoint(NewPos,Pos,TTot);
-		VecCopy(NewPos,Pos);
-		Pos += 3;
-	}
+	TransformPoints(PosBase(),NumVerts,TTot);
 	
 	bool NormalsPresent = !NormSources.empty();
 	if (NormalsPresent)
@@ -987,16 +1188,10 @@ bool Model3D::FindPositions_Sequence(bool UseModelTransform, GLshort SeqIndex,
 		else
 			obj_copy(TTot,TSF);
 				
-		GLfloat *Norm = NormBase();
-		for (size_t iv=0; iv<NumVerts; iv++)
-		{
-			GLfloat NewNorm[3];
-			TransformVector(NewNorm,Norm,TTot);
-			VecCopy(NewNorm,Norm);
-			Norm += 3;
-		}
+		TransformVectors(NormBase(),NumVerts,TTot);
 	}
 	
+	CachePose(Key);
 	return true;
 }
 
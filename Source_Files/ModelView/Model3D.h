@@ -97,6 +97,23 @@ struct Model3D_Transform
 };
 
 
+// Identifies an animation state, for reusing the vertex positions and normals found for it
+struct Model3D_PoseKey
+{
+	GLshort SeqIndex;		// NONE for a plain frame
+	GLshort FrameIndex, AddlFrameIndex;
+	GLfloat MixFrac;
+	bool UseModelTransform;
+	
+	bool operator==(const Model3D_PoseKey& Key) const
+	{
+		return SeqIndex == Key.SeqIndex && FrameIndex == Key.FrameIndex &&
+			AddlFrameIndex == Key.AddlFrameIndex && MixFrac == Key.MixFrac &&
+			UseModelTransform == Key.UseModelTransform;
+	}
+};
+
+
 struct Model3D
 {
 	// Assumed dimensions:
@@ -251,8 +268,34 @@ struct Model3D
 	bool FindPositions_Sequence(bool UseModelTransform, GLshort SeqIndex,
 		GLshort FrameIndex, GLfloat MixFrac = 0, GLshort AddlFrameIndex = 0);
 	
+	// Forget all remembered poses; do this after changing the vertex sources,
+	// the normals, or the add-on transforms
+	void InvalidatePoses() {PoseCache.clear(); NextPoseEntry = 0; CurrentPoseEntry = NONE;}
+	
 	// Constructor
-	Model3D() {FindBoundingBox(); TransformPos.Identity(); TransformNorm.Identity();}
+	Model3D() {FindBoundingBox(); TransformPos.Identity(); TransformNorm.Identity(); InvalidatePoses();}
+
+private:
+	// Recently found poses; many instances of a model on screen tend to share a few
+	// animation states, and those states last for several rendered frames
+	enum {MaxCachedPoses = 8};
+	struct PoseCacheEntry
+	{
+		Model3D_PoseKey Key;
+		vector<GLfloat> Positions, Normals;
+	};
+	vector<PoseCacheEntry> PoseCache;
+	size_t NextPoseEntry;
+	// Which entry the position and normal arrays currently hold; NONE if none of them
+	int CurrentPoseEntry;
+	
+	// Makes the position and normal arrays hold that pose if it had been cached
+	bool LoadCachedPose(const Model3D_PoseKey& Key);
+	void CachePose(const Model3D_PoseKey& Key);
+	
+	// Does the work of FindPositions_Frame()
+	bool SkinFrame(bool UseModelTransform,
+		GLshort FrameIndex, GLfloat MixFrac, GLshort AddlFrameIndex);
 };
 
 #endif
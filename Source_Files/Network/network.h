@@ -79,6 +79,7 @@ typedef struct game_info
 	bool   allow_mic;
 
         int16 cheat_flags;
+	int16  monster_think_budget; // the gatherer's, so every player schedules monsters alike
 	
 	// where the game takes place
 	int16  level_number;
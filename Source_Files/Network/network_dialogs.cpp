@@ -76,6 +76,7 @@ Apr 10, 2003 (Woody Zenfell):
 #include	"network_dialogs.h"
 #include	"network_games.h"
 #include	"player.h" // ZZZ: for MAXIMUM_NUMBER_OF_PLAYERS, for reassign_player_colors
+#include	"monsters.h" // for get_monster_think_budget
 #include	"metaserver_dialogs.h" // GameAvailableMetaserverAnnouncer
 #include	"wad.h" // jkvw: for read_wad_file_checksum 
 #include "game_wad.h" // get_map_file
@@ -1293,6 +1294,8 @@ bool SetupNetgameDialog::SetupNetworkGameByRunning (
 		}
 	
 		game_information->cheat_flags = active_network_preferences->cheat_flags;
+		game_information->monster_think_budget = resuming_game ?
+			dynamic_world->game_information.parameters[_monster_think_budget_parameter] : get_monster_think_budget();
 
 		outAdvertiseGameOnMetaserver = active_network_preferences->advertise_on_metaserver;
 
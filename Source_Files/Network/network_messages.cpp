@@ -309,6 +309,7 @@ void TopologyMessage::reallyDeflateTo(AOStream& outputStream) const {
   outputStream << mTopology.game_data.server_is_playing;
   outputStream << mTopology.game_data.allow_mic;
   outputStream << mTopology.game_data.cheat_flags;
+  outputStream << mTopology.game_data.monster_think_budget;
   outputStream << mTopology.game_data.level_number;
   write_string(outputStream, mTopology.game_data.level_name);
   outputStream << mTopology.game_data.parent_checksum;
@@ -334,6 +335,7 @@ bool TopologyMessage::reallyInflateFrom(AIStream& inputStream) {
   inputStream >> mTopology.game_data.server_is_playing;
   inputStream >> mTopology.game_data.allow_mic;
   inputStream >> mTopology.game_data.cheat_flags;
+  inputStream >> mTopology.game_data.monster_think_budget;
   inputStream >> mTopology.game_data.level_number;
   read_string(inputStream, mTopology.game_data.level_name, MAX_LEVEL_NAME_LENGTH - 1);
   inputStream >> mTopology.game_data.parent_checksum;
@@ -0,0 +1,105 @@
+/*
+	Copyright (C) 2026 and beyond by the "Aleph One" developers.
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This license is contained in the file "COPYING",
+	which is included with this source code; it is available online at
+	http://www.gnu.org/licenses/gpl.html
+
+	Dynamic resolution
+*/
+
+#include "cseries.h"
+#include "DynamicResolution.h"
+
+#include "preferences.h"
+
+#include <algorithm>
+#include <math.h>
+
+enum {
+	// the scale is 1 - step/kStepsPerUnit, down to half size
+	kStepsPerUnit = 16,
+	kMaximumStep = kStepsPerUnit / 2,
+
+	// frames measured before deciding, and ignored after a change; the
+	// shader renderer's timings arrive a few frames late
+	kSampleFrames = 8,
+	kSettleFrames = 4
+};
+
+// grow only when the next step up should still leave this much to spare
+static const float kGrowthMargin = 0.85f;
+
+DynamicResolution* DynamicResolution::instance()
+{
+	static DynamicResolution* m_instance = nullptr;
+	if (!m_instance) {
+		m_instance = new DynamicResolution;
+	}
+
+	return m_instance;
+}
+
+void DynamicResolution::reset()
+{
+	m_step = 0;
+	m_scale = 1.0f;
+	m_average = 0;
+	m_samples = 0;
+	m_settle = kSettleFrames;
+}
+
+void DynamicResolution::report_frame_time(float milliseconds)
+{
+	short target = graphics_preferences->screen_mode.frame_time_target;
+	if (target != m_target)
+	{
+		reset();
+		m_target = target;
+	}
+	if (target <= 0)
+		return;
+
+	if (m_settle > 0)
+	{
+		--m_settle;
+		return;
+	}
+
+	m_average = m_samples ? m_average + (milliseconds - m_average) / kSampleFrames : milliseconds;
+	if (++m_samples < kSampleFrames)
+		return;
+
+	// the view's cost goes roughly with its pixel count
+	int step = m_step;
+	if (m_average > target)
+	{
+		float wanted = m_scale * sqrtf(target / m_average);
+		step = std::max(step + 1, static_cast<int>(ceilf((1.0f - wanted) * kStepsPerUnit)));
+	}
+	else if (step > 0)
+	{
+		float larger = 1.0f - (step - 1) / float(kStepsPerUnit);
+		if (m_average * (larger * larger) / (m_scale * m_scale) < target * kGrowthMargin)
+			--step;
+	}
+	step = std::min<int>(step, kMaximumStep);
+
+	if (step != m_step)
+	{
+		m_step = step;
+		m_scale = 1.0f - step / float(kStepsPerUnit);
+		m_samples = 0;
+		m_settle = kSettleFrames;
+	}
+}
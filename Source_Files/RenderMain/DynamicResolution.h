@@ -0,0 +1,59 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+/*
+	Copyright (C) 2026 and beyond by the "Aleph One" developers.
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This license is contained in the file "COPYING",
+	which is included with this source code; it is available online at
+	http://www.gnu.org/licenses/gpl.html
+
+	Dynamic resolution
+
+	With a frame-time target set in the graphics preferences, the 3D view is
+	drawn into a smaller buffer when it takes too long, and stretched back
+	over the view when presented; the HUD is still drawn at full size.
+
+	The renderers report how long each view took to draw: the software
+	renderer its CPU time, the shader renderer its GPU time. The scale moves
+	in steps, so buffers are only reallocated once in a while, and only grows
+	again once the view is comfortably under the target.
+*/
+
+#include "cstypes.h"
+
+class DynamicResolution {
+public:
+	static DynamicResolution* instance();
+
+	// the fraction of the view's width and height to draw; 1 when off
+	float scale() const { return m_scale; }
+
+	// how long the view took to draw at the current scale
+	void report_frame_time(float milliseconds);
+
+	// back to full resolution, e.g. when the view changes size
+	void reset();
+
+private:
+	DynamicResolution() : m_target(0) { reset(); }
+
+	short m_target;
+	int m_step;
+	float m_scale;
+	float m_average;
+	int m_samples;
+	int m_settle;
+};
+
+#endif
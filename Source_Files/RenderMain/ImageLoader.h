@@ -91,6 +91,12 @@ public:
 	void PremultiplyAlpha();
 	bool PremultipliedAlpha; // public so find silhouette version can unset
 
+	// For the processed-texture cache; pixels are stored in native byte order,
+	// since the cache never leaves the machine that wrote it
+	int32 GetCacheSize() const;
+	void WriteToCache(uint8* &S) const;
+	bool ReadFromCache(uint8* &S, const uint8 *End);
+
 	// Clearing
 	void Clear()
 		{Width = Height = Size = 0; delete []Pixels; Pixels = NULL;}
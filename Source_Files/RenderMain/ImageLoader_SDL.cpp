@@ -86,6 +86,7 @@ bool ImageDescriptor::LoadFromFile(FileSpecifier& File, int ImgMode, int flags,
 			VScale = ((double) OriginalWidth / (double) Width);
 			UScale = ((double) OriginalHeight / (double) Height);
 			MipMapCount = 0;
+			Format = RGBA8;
 			break;
 
 		case ImageLoader_Opacity:
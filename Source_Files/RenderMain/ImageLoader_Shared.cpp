@@ -35,6 +35,7 @@
 #include "SDL.h"
 #include "SDL_endian.h"
 #include "Logging.h"
+#include "Packing.h"
 
 
 #ifdef HAVE_OPENGL
@@ -201,6 +202,75 @@ ImageDescriptor::ImageDescriptor(int _Width, int _Height, uint32 *_Pixels) :
 	Size = _Width * _Height * 4;
 }
 
+// present flag, format, width, height, mipmap count, premultiplied, size, and the two scales
+#define SIZEOF_cached_image_header (2*7 + 4 + 2*8)
+
+int32 ImageDescriptor::GetCacheSize() const
+{
+	return SIZEOF_cached_image_header + (IsPresent() ? Size : 0);
+}
+
+void ImageDescriptor::WriteToCache(uint8* &S) const
+{
+	ValueToStream(S, static_cast<int16>(IsPresent()));
+	ValueToStream(S, static_cast<int16>(Format));
+	ValueToStream(S, static_cast<int16>(Width));
+	ValueToStream(S, static_cast<int16>(Height));
+	ValueToStream(S, static_cast<int16>(MipMapCount));
+	ValueToStream(S, static_cast<int16>(PremultipliedAlpha));
+	ValueToStream(S, static_cast<int16>(0));
+	ValueToStream(S, static_cast<int32>(IsPresent() ? Size : 0));
+	memcpy(S, &VScale, 8); S += 8;
+	memcpy(S, &UScale, 8); S += 8;
+
+	if (IsPresent())
+	{
+		memcpy(S, Pixels, Size);
+		S += Size;
+	}
+}
+
+bool ImageDescriptor::ReadFromCache(uint8* &S, const uint8 *End)
+{
+	if (End - S < SIZEOF_cached_image_header) return false;
+
+	int16 present, format, width, height, mipmap_count, premultiplied, unused;
+	int32 size;
+	StreamToValue(S, present);
+	StreamToValue(S, format);
+	StreamToValue(S, width);
+	StreamToValue(S, height);
+	StreamToValue(S, mipmap_count);
+	StreamToValue(S, premultiplied);
+	StreamToValue(S, unused);
+	StreamToValue(S, size);
+
+	double vscale, uscale;
+	memcpy(&vscale, S, 8); S += 8;
+	memcpy(&uscale, S, 8); S += 8;
+
+	if (!present)
+	{
+		Clear();
+		return true;
+	}
+
+	if (format < RGBA8 || format >= Unknown || width <= 0 || height <= 0 ||
+		mipmap_count < 0 || size <= 0 || End - S < size)
+		return false;
+
+	Resize(width, height, size);
+	memcpy(Pixels, S, size);
+	S += size;
+
+	Format = static_cast<ImageFormat>(format);
+	MipMapCount = mipmap_count;
+	PremultipliedAlpha = premultiplied != 0;
+	VScale = vscale;
+	UScale = uscale;
+	return true;
+}
+
 static inline int padfour(int x)
 {
 	return (x + 3) / 4 * 4;
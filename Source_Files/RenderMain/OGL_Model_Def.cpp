@@ -575,6 +575,9 @@ void OGL_ModelData::Load()
 	Model.AdjustNormals(NormalType,NormalSplit);
 	Model.CalculateTangents();
 	
+	// Poses found so far predate the transforms and normals set up here
+	Model.InvalidatePoses();
+	
 	// Don't forget the skins
 	OGL_SkinManager::Load();
 }
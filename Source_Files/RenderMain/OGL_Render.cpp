@@ -161,6 +161,7 @@ May 3, 2003 (Br'fin (Jeremy Parsons))
 #include "Logging.h"
 #include "screen.h"
 #include "OGL_Shader.h"
+#include "Profiler.h"
 
 #include <cmath>
 
@@ -2240,23 +2241,26 @@ bool RenderModelSetup(rectangle_definition& RenderRectangle)
 	if (RenderRectangle.clip_bottom <= RenderRectangle.y0) return false;
 	
 	// Find an animated model's vertex positions and normals:
-	short ModelSequence = RenderRectangle.ModelSequence;
-	if (ModelSequence >= 0)
 	{
-		int NumFrames = ModelPtr->Model.NumSeqFrames(ModelSequence);
-		if (NumFrames > 0)
+		PROFILE_ZONE("model_skinning");
+		short ModelSequence = RenderRectangle.ModelSequence;
+		if (ModelSequence >= 0)
 		{
-			short ModelFrame = PIN(RenderRectangle.ModelFrame,0,NumFrames-1);
-			short NextModelFrame = PIN(RenderRectangle.NextModelFrame,0,NumFrames-1);
-			float MixFrac = RenderRectangle.MixFrac;
-			ModelPtr->Model.FindPositions_Sequence(true,
-				ModelSequence,ModelFrame,MixFrac,NextModelFrame);
+			int NumFrames = ModelPtr->Model.NumSeqFrames(ModelSequence);
+			if (NumFrames > 0)
+			{
+				short ModelFrame = PIN(RenderRectangle.ModelFrame,0,NumFrames-1);
+				short NextModelFrame = PIN(RenderRectangle.NextModelFrame,0,NumFrames-1);
+				float MixFrac = RenderRectangle.MixFrac;
+				ModelPtr->Model.FindPositions_Sequence(true,
+					ModelSequence,ModelFrame,MixFrac,NextModelFrame);
+			}
+			else
+				ModelPtr->Model.FindPositions_Neutral(true);	// Fallback: neutral
 		}
 		else
-			ModelPtr->Model.FindPositions_Neutral(true);	// Fallback: neutral
+			ModelPtr->Model.FindPositions_Neutral(true);	// Fallback: neutral (will do nothing for static models)
 	}
-	else
-		ModelPtr->Model.FindPositions_Neutral(true);	// Fallback: neutral (will do nothing for static models)
 	
 	// For finding the clip planes: 0, 1, 2, 3, and 4
 	bool ClipLeft = false, ClipRight = false, ClipTop = false, ClipBottom = false, ClipLiquid = false;
@@ -86,6 +86,11 @@ Feb 5, 2002 (Br'fin (Jeremy Parsons)):
 #include "OGL_LoadScreen.h"
 #include "progress.h"
 #include "InfoTree.h"
+#include "crc.h"
+#include "Logging.h"
+#include "Packing.h"
+
+#include <algorithm>
 
 // Whether or not OpenGL is present and usable
 static bool _OGL_IsPresent = false;
@@ -244,6 +249,7 @@ void OGL_SetDefaults(OGL_ConfigureData& Data)
 
         Data.AnisotropyLevel = 0.0; // off
 	Data.Multisamples = 0; // off
+	Data.TextureBudget = 0; // no limit
 	
 	Data.VoidColor = rgb_black;			// Self-explanatory
 	for (int il=0; il<4; il++)
@@ -267,6 +273,180 @@ inline bool StringPresent(vector<char>& String)
 GLint glMaxTextureSize = 0;
 bool hasS3TC = false;
 
+/* ---------- processed texture cache */
+
+// Decoding, masking, resizing and compressing substitute textures takes most
+// of a level load with a large texture pack; the results are kept on disk,
+// keyed by the source files' contents and every option that affects them.
+
+// Bump this whenever loading changes what it produces
+#define TEXTURE_CACHE_VERSION 1
+#define TEXTURE_CACHE_HEADER_SIZE 16
+
+// When the cache outgrows this, the oldest entries go
+static const Sint64 kTextureCacheLimit = 1024 * 1024 * 1024;
+
+static bool texture_cache_enabled = true;
+
+static void AppendToTextureCacheKey(vector<uint8>& key, FileSpecifier& File)
+{
+	uint8 value[4];
+	uint8 *S = value;
+	if (File == FileSpecifier() || !File.Exists())
+	{
+		ValueToStream(S, static_cast<uint32>(0));
+		key.insert(key.end(), value, S);
+		return;
+	}
+
+	const char *path = File.GetPath();
+	key.insert(key.end(), path, path + strlen(path) + 1);
+	ValueToStream(S, calculate_crc_for_file(File));
+	key.insert(key.end(), value, S);
+}
+
+static void GetTextureCacheDirectory(FileSpecifier& Directory)
+{
+	Directory.SetToLocalDataDir();
+	Directory += "Texture Cache";
+}
+
+static void GetTextureCacheFile(FileSpecifier& File, const vector<uint8>& Key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%08x.tex", calculate_data_crc(const_cast<uint8 *>(Key.data()), static_cast<int32>(Key.size())));
+
+	GetTextureCacheDirectory(File);
+	File += name;
+}
+
+static bool LoadFromTextureCache(const vector<uint8>& Key, ImageDescriptor& NormalImg, ImageDescriptor& GlowImg, ImageDescriptor& OffsetImg)
+{
+	FileSpecifier File;
+	GetTextureCacheFile(File, Key);
+
+	OpenedFile cache;
+	if (!File.Open(cache)) return false;
+
+	int32 length;
+	if (!cache.GetLength(length) || length < TEXTURE_CACHE_HEADER_SIZE) return false;
+
+	vector<uint8> buffer(length);
+	if (!cache.Read(length, buffer.data())) return false;
+	cache.Close();
+
+	uint8 *S = buffer.data();
+	const uint8 *End = S + length;
+	int16 version, unused;
+	int32 key_length;
+	uint32 unused_long, unused_long2;
+	StreamToValue(S, version);
+	StreamToValue(S, unused);
+	StreamToValue(S, key_length);
+	StreamToValue(S, unused_long);
+	StreamToValue(S, unused_long2);
+
+	// the file name is only a hash; the whole key has to match
+	if (version != TEXTURE_CACHE_VERSION || key_length != static_cast<int32>(Key.size()) ||
+		End - S < key_length || !std::equal(Key.begin(), Key.end(), S))
+		return false;
+	S += key_length;
+
+	if (!NormalImg.ReadFromCache(S, End) || !GlowImg.ReadFromCache(S, End) || !OffsetImg.ReadFromCache(S, End) ||
+		S != End || !NormalImg.IsPresent())
+	{
+		logWarning("ignoring damaged texture cache %s", File.GetPath());
+		NormalImg.Clear();
+		GlowImg.Clear();
+		OffsetImg.Clear();
+		return false;
+	}
+
+	return true;
+}
+
+static void PruneTextureCache()
+{
+	FileSpecifier Directory;
+	GetTextureCacheDirectory(Directory);
+
+	vector<dir_entry> entries;
+	if (!Directory.ReadDirectory(entries)) return;
+
+	Sint64 total = 0;
+	for (vector<dir_entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+		total += it->size;
+	if (total <= kTextureCacheLimit) return;
+
+	struct older_first {
+		bool operator()(const dir_entry& a, const dir_entry& b) const { return a.date < b.date; }
+	};
+	std::sort(entries.begin(), entries.end(), older_first());
+
+	// leave some room, so that the next few saves don't prune again
+	for (vector<dir_entry>::const_iterator it = entries.begin(); it != entries.end() && total > kTextureCacheLimit * 3 / 4; ++it)
+	{
+		if (it->is_directory) continue;
+
+		FileSpecifier File = Directory;
+		File += it->name;
+		if (File.Delete())
+			total -= it->size;
+	}
+}
+
+static void SaveToTextureCache(const vector<uint8>& Key, const ImageDescriptor& NormalImg, const ImageDescriptor& GlowImg, const ImageDescriptor& OffsetImg)
+{
+	Sint64 length = TEXTURE_CACHE_HEADER_SIZE + Key.size() +
+		NormalImg.GetCacheSize() + GlowImg.GetCacheSize() + OffsetImg.GetCacheSize();
+	if (length > INT32_MAX) return;
+
+	vector<uint8> buffer(length);
+	uint8 *S = buffer.data();
+	ValueToStream(S, static_cast<int16>(TEXTURE_CACHE_VERSION));
+	ValueToStream(S, static_cast<int16>(0));
+	ValueToStream(S, static_cast<int32>(Key.size()));
+	ValueToStream(S, static_cast<uint32>(0));
+	ValueToStream(S, static_cast<uint32>(0));
+	memcpy(S, Key.data(), Key.size());
+	S += Key.size();
+	NormalImg.WriteToCache(S);
+	GlowImg.WriteToCache(S);
+	OffsetImg.WriteToCache(S);
+	assert(S - buffer.data() == length);
+
+	static bool pruned = false;
+	if (!pruned)
+	{
+		PruneTextureCache();
+		pruned = true;
+	}
+
+	FileSpecifier Directory;
+	GetTextureCacheDirectory(Directory);
+	Directory.CreateDirectory();
+
+	// write to a temporary file first, so a half-written entry is never picked up
+	FileSpecifier File, TemporaryFile;
+	GetTextureCacheFile(File, Key);
+	TemporaryFile.SetTempName(File);
+
+	OpenedFile cache;
+	if (!TemporaryFile.Create(_typecode_unknown) || !TemporaryFile.Open(cache, true))
+	{
+		logWarning("unable to write texture cache %s", File.GetPath());
+		return;
+	}
+
+	bool written = cache.Write(static_cast<int32>(length), buffer.data());
+	cache.Close();
+	if (!written || !TemporaryFile.Rename(File))
+	{
+		logWarning("unable to write texture cache %s", File.GetPath());
+		TemporaryFile.Delete();
+	}
+}
+
 void OGL_TextureOptionsBase::Load()
 {
 	FileSpecifier File;
@@ -301,6 +481,33 @@ void OGL_TextureOptionsBase::Load()
 	if (NormalImg.IsPresent()) return;
 
 	NormalImg.Clear();
+
+	// Only a texture loaded from scratch can come from or go into the cache
+	bool use_cache = texture_cache_enabled && !GlowImg.IsPresent() && !OffsetImg.IsPresent() &&
+		NormalColors != FileSpecifier() && NormalColors.Exists();
+	vector<uint8> cache_key;
+	if (use_cache)
+	{
+		uint8 value[4 * 8];
+		uint8 *S = value;
+		ValueToStream(S, static_cast<int16>(TEXTURE_CACHE_VERSION));
+		ValueToStream(S, static_cast<int16>(PlatformIsLittleEndian()));
+		ValueToStream(S, static_cast<int32>(flags));
+		ValueToStream(S, static_cast<int32>(maxTextureSize));
+		ValueToStream(S, actual_width);
+		ValueToStream(S, actual_height);
+		ValueToStream(S, static_cast<int16>(NormalIsPremultiplied));
+		ValueToStream(S, static_cast<int16>(GlowIsPremultiplied));
+		cache_key.insert(cache_key.end(), value, S);
+
+		AppendToTextureCacheKey(cache_key, NormalColors);
+		AppendToTextureCacheKey(cache_key, NormalMask);
+		AppendToTextureCacheKey(cache_key, OffsetMap);
+		AppendToTextureCacheKey(cache_key, GlowColors);
+		AppendToTextureCacheKey(cache_key, GlowMask);
+
+		if (LoadFromTextureCache(cache_key, NormalImg, GlowImg, OffsetImg)) return;
+	}
 	
 	// Load the normal image if it has a filename specified for it
 	if (NormalColors != FileSpecifier() && NormalColors.Exists())
@@ -390,6 +597,10 @@ void OGL_TextureOptionsBase::Load()
 		GlowImg.Clear();
 	}
 
+	if (use_cache && NormalImg.IsPresent())
+	{
+		SaveToTextureCache(cache_key, NormalImg, GlowImg, OffsetImg);
+	}
 }
 
 void OGL_TextureOptionsBase::Unload()
@@ -471,6 +682,9 @@ OGL_FogData *OriginalFogData = NULL;
 
 void reset_mml_opengl()
 {
+#ifdef HAVE_OPENGL
+	texture_cache_enabled = true;
+#endif
 	reset_mml_opengl_texture();
 	reset_mml_opengl_model();
 	reset_mml_opengl_shader();
@@ -485,6 +699,10 @@ void reset_mml_opengl()
 
 void parse_mml_opengl(const InfoTree& root)
 {
+#ifdef HAVE_OPENGL
+	root.read_attr("texture_cache", texture_cache_enabled);
+#endif
+
 	// back up old values first
 	if (!OriginalFogData) {
 		OriginalFogData = (OGL_FogData *) malloc(sizeof(OGL_FogData) * OGL_NUMBER_OF_FOG_TYPES);
@@ -252,6 +252,9 @@ struct OGL_ConfigureData
 
 	bool GeForceFix;
 	bool WaitForVSync;
+	
+	// Megabytes of wall and sprite textures to keep loaded; 0 for no limit
+	int16 TextureBudget;
   bool Use_sRGB;
 	bool Use_NPOT;
 };
@@ -26,6 +26,7 @@
 #include "FileHandler.h"
 #include "OGL_Setup.h"
 #include "InfoTree.h"
+#include "ShaderCache.h"
 
 
 static std::map<std::string, std::string> defaultVertexPrograms;
@@ -155,21 +156,31 @@ void parseFile(FileSpecifier& fileSpec, std::string& s) {
 }
 
 
-GLhandleARB parseShader(const GLcharARB* str, GLenum shaderType) {
-
-	GLint status;
-	GLhandleARB shader = glCreateShaderObjectARB(shaderType);
+// prepended to every shader
+static std::string shaderDefines() {
 
-	std::vector<const GLcharARB*> source;
+	std::string defines;
 
 	if (Wanting_sRGB)
 	{
-		source.push_back("#define GAMMA_CORRECTED_BLENDING\n");
+		defines += "#define GAMMA_CORRECTED_BLENDING\n";
 	}
 	if (Bloom_sRGB)
 	{
-		source.push_back("#define BLOOM_SRGB_FRAMEBUFFER\n");
+		defines += "#define BLOOM_SRGB_FRAMEBUFFER\n";
 	}
+	return defines;
+}
+
+GLhandleARB parseShader(const GLcharARB* str, GLenum shaderType) {
+
+	GLint status;
+	GLhandleARB shader = glCreateShaderObjectARB(shaderType);
+
+	std::string defines = shaderDefines();
+	std::vector<const GLcharARB*> source;
+
+	source.push_back(defines.c_str());
 	source.push_back(str);
 
 	glShaderSourceARB(shader, source.size(), &source[0], NULL);
@@ -230,6 +241,55 @@ Shader::Shader(const std::string& name, FileSpecifier& vert, FileSpecifier& frag
 	}
 }
 
+// the program binary calls take the program's name, not its handle
+static GLuint programName(GLhandleARB programObj) {
+	return (GLuint)(uintptr_t)programObj;
+}
+
+// loads the program this source linked to before; if the driver refuses it,
+// leaves a fresh program to link from source instead
+static bool loadProgramBinary(GLhandleARB& programObj, Uint64 key) {
+
+	uint32 format;
+	std::vector<uint8> binary;
+	if (!ShaderCache::instance()->find(key, format, binary))
+		return false;
+
+	GLint status = GL_FALSE;
+	glProgramBinary(programName(programObj), format, &binary[0], binary.size());
+	glGetObjectParameterivARB(programObj, GL_OBJECT_LINK_STATUS_ARB, &status);
+	if (status)
+		return true;
+
+	// an unknown format also raises an error; the link status says it all
+	while (glGetError() != GL_NO_ERROR);
+	ShaderCache::instance()->drop(key);
+
+	glDeleteObjectARB(programObj);
+	programObj = glCreateProgramObjectARB();
+	return false;
+}
+
+static void saveProgramBinary(GLhandleARB programObj, Uint64 key) {
+
+	GLint status = GL_FALSE;
+	GLint length = 0;
+	glGetObjectParameterivARB(programObj, GL_OBJECT_LINK_STATUS_ARB, &status);
+	glGetProgramiv(programName(programObj), GL_PROGRAM_BINARY_LENGTH, &length);
+	if (!status || length <= 0)
+		return;
+
+	GLenum format;
+	GLsizei written = 0;
+	std::vector<uint8> binary(length);
+	glGetProgramBinary(programName(programObj), length, &written, &format, &binary[0]);
+	if (written <= 0)
+		return;
+
+	binary.resize(written);
+	ShaderCache::instance()->store(key, format, binary);
+}
+
 void Shader::init() {
 
 	std::fill_n(_uniform_locations, static_cast<int>(NUMBER_OF_UNIFORM_LOCATIONS), -1);
@@ -240,18 +300,42 @@ void Shader::init() {
 	_programObj = glCreateProgramObjectARB();
 
 	assert(!_vert.empty());
-	GLhandleARB vertexShader = parseShader(_vert.c_str(), GL_VERTEX_SHADER_ARB);
-	assert(vertexShader);
-	glAttachObjectARB(_programObj, vertexShader);
-	glDeleteObjectARB(vertexShader);
-
 	assert(!_frag.empty());
-	GLhandleARB fragmentShader = parseShader(_frag.c_str(), GL_FRAGMENT_SHADER_ARB);
-	assert(fragmentShader);
-	glAttachObjectARB(_programObj, fragmentShader);
-	glDeleteObjectARB(fragmentShader);
-	
-	glLinkProgramARB(_programObj);
+
+	bool cached = ShaderCache::instance()->available();
+	Uint64 key = 0;
+	if (cached)
+	{
+		key = ShaderCache::hash(shaderDefines());
+		key = ShaderCache::hash(_vert, key);
+		key = ShaderCache::hash(std::string(1, '\0'), key);
+		key = ShaderCache::hash(_frag, key);
+	}
+
+	if (!cached || !loadProgramBinary(_programObj, key))
+	{
+		GLhandleARB vertexShader = parseShader(_vert.c_str(), GL_VERTEX_SHADER_ARB);
+		assert(vertexShader);
+		glAttachObjectARB(_programObj, vertexShader);
+		glDeleteObjectARB(vertexShader);
+
+		GLhandleARB fragmentShader = parseShader(_frag.c_str(), GL_FRAGMENT_SHADER_ARB);
+		assert(fragmentShader);
+		glAttachObjectARB(_programObj, fragmentShader);
+		glDeleteObjectARB(fragmentShader);
+
+		if (cached)
+		{
+			glProgramParameteri(programName(_programObj), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+
+		glLinkProgramARB(_programObj);
+
+		if (cached)
+		{
+			saveProgramBinary(_programObj, key);
+		}
+	}
 
 	assert(_programObj);
 
@@ -79,7 +79,9 @@ May 3, 2003 (Br'fin (Jeremy Parsons))
 #include <stdlib.h>
 #include <stdarg.h>
 #include <math.h>
+#include <algorithm>
 #include <list>
+#include <set>
 
 #include "cseries.h"
 
@@ -104,7 +106,7 @@ May 3, 2003 (Br'fin (Jeremy Parsons))
 using std::min;
 using std::max;
 
-OGL_TexturesStats gGLTxStats = {0,0,0,500000,0,0, 0};
+OGL_TexturesStats gGLTxStats = {0,0,0,500000,0,0,0,0, 0,0,0,0};
 
 // Texture mapping
 struct TxtrTypeInfoData
@@ -170,8 +172,15 @@ struct InfravisionData IVDataList[NUMBER_OF_COLLECTIONS] =
 // Is infravision currently active?
 static bool InfravisionActive = false;
 
+// Loaded texture sets, most recently used first
 static std::list<TextureState*> sgActiveTextureStates;
 
+// Counts the frames, for telling what was drawn in the current one
+static uint32 sgTextureFrame = 0;
+
+// Wall textures waiting to be loaded ahead of time
+static std::vector<shape_descriptor> sgPrefetchQueue;
+
 
 // Allocate some textures and indicate whether an allocation had happened.
 bool TextureState::Allocate(short txType)
@@ -180,10 +189,11 @@ bool TextureState::Allocate(short txType)
 	if (!IsUsed)
 	{
 		sgActiveTextureStates.push_front(this);
+		Position = sgActiveTextureStates.begin();
 		gGLTxStats.inUse++;
 		glGenTextures(NUMBER_OF_TEXTURES,IDs);
 		IsUsed = true;
-		unusedFrames=0;
+		LastUsedFrame = sgTextureFrame;
 		return true;
 	}
 	return false;
@@ -196,54 +206,35 @@ bool TextureState::Use(int Which)
 	bool result = !TexGened[Which];
 	TexGened[Which] = true;
 	IDUsage[Which]++;
+	
+	// Move to the front of the list, so the least recently used are at the back
+	if (Position != sgActiveTextureStates.begin())
+		sgActiveTextureStates.splice(sgActiveTextureStates.begin(), sgActiveTextureStates, Position);
+	LastUsedFrame = sgTextureFrame;
 	return result;
 }
 
+void TextureState::Loaded(int32 NewBytes)
+{
+	Bytes += NewBytes;
+	gGLTxStats.residentBytes += NewBytes;
+}
+
 
 // Resets the object's texture state
 void TextureState::Reset()
 {
 	if (IsUsed)
 	{
-		sgActiveTextureStates.remove(this);
+		sgActiveTextureStates.erase(Position);
 		gGLTxStats.inUse--;
+		gGLTxStats.residentBytes -= Bytes;
 		glDeleteTextures(NUMBER_OF_TEXTURES,IDs);
 	}
 	IsUsed = IsGlowing = IsBumped = TexGened[Normal] = TexGened[Glowing] = TexGened[Bump] = false;
-	IDUsage[Normal] = IDUsage[Glowing] = IDUsage[Bump] = unusedFrames = 0;
-}
-
-void TextureState::FrameTick() {
-	if (!IsUsed) return;
-	
-	gGLTxStats.totalAge += (TextureType!=OGL_Txtr_Landscape)?unusedFrames:0;
-	
-	bool used  = false;
-	
-	for (int i=0 ; i<NUMBER_OF_TEXTURES ; i++)
-		if (IDUsage[i] != 0) used = true;
-	
-	if (used) {
-		IDUsage[Normal] = IDUsage[Glowing] = unusedFrames = 0;
-		
-	} else {
-		unusedFrames++;
-		assert(TextureType != NONE);
-		switch (TextureType) {
-		case OGL_Txtr_Wall:
-				if (unusedFrames > 300) Reset(); // at least 10 seconds till wall textures are released
-				break;
-		case OGL_Txtr_Landscape:
-				// never release landscapes
-				break;
-		case OGL_Txtr_Inhabitant:
-				if (unusedFrames > 450) Reset(); // release unused sprites in 15 seconds
-				break;
-		case OGL_Txtr_WeaponsInHand:
-				if (unusedFrames > 600) Reset(); // release weapons in hand in 20 seconds
-				break;
-		}
-	}
+	IDUsage[Normal] = IDUsage[Glowing] = IDUsage[Bump] = 0;
+	Bytes = 0;
+	LastUsedFrame = 0;
 }
 
 // Will distinguish by texture type as well as by collection;
@@ -392,15 +383,119 @@ void OGL_StopTextures()
     
     // clear leftover infravision
     InfravisionActive = false;
+	
+	sgPrefetchQueue.clear();
+}
+
+// How long to spend loading prefetched textures in each frame
+const float PrefetchMillisecondsPerFrame = 2;
+
+static bool IsPrefetchedTransferMode(short TransferMode)
+{
+	// Landscapes stay loaded anyway, and static is drawn without the texture
+	return TransferMode != _xfer_landscape && TransferMode != _xfer_big_landscape &&
+		TransferMode != _xfer_static;
+}
+
+static void QueuePrefetch(std::set<shape_descriptor>& Queued, short TransferMode, shape_descriptor Texture)
+{
+	if (Texture != UNONE && IsPrefetchedTransferMode(TransferMode) && Queued.insert(Texture).second)
+		sgPrefetchQueue.push_back(Texture);
+}
+
+void OGL_PrefetchTextures(const std::vector<short>& Polygons)
+{
+	sgPrefetchQueue.clear();
+	
+	std::set<shape_descriptor> Queued;
+	
+	for (size_t i=0; i<Polygons.size(); i++)
+	{
+		polygon_data *Polygon = get_polygon_data(Polygons[i]);
+		QueuePrefetch(Queued, Polygon->floor_transfer_mode, Polygon->floor_texture);
+		QueuePrefetch(Queued, Polygon->ceiling_transfer_mode, Polygon->ceiling_texture);
+		
+		for (int j=0; j<Polygon->vertex_count; j++)
+		{
+			if (Polygon->side_indexes[j] == NONE) continue;
+			side_data *Side = get_side_data(Polygon->side_indexes[j]);
+			QueuePrefetch(Queued, Side->primary_transfer_mode, Side->primary_texture.texture);
+			QueuePrefetch(Queued, Side->secondary_transfer_mode, Side->secondary_texture.texture);
+			QueuePrefetch(Queued, Side->transparent_transfer_mode, Side->transparent_texture.texture);
+		}
+	}
+	
+	// The queue is taken from the back, and the polygons come nearest first
+	std::reverse(sgPrefetchQueue.begin(), sgPrefetchQueue.end());
+	gGLTxStats.prefetchesQueued += sgPrefetchQueue.size();
+}
+
+// Sets up a wall texture as the shader renderer would, loading it if it isn't already;
+// returns whether it had to be loaded
+static bool PrefetchTexture(shape_descriptor Texture)
+{
+	TextureManager TMgr;
+	TMgr.ShapeDesc = Texture;
+	get_shape_bitmap_and_shading_table(Texture, &TMgr.Texture, &TMgr.ShadingTables,
+		InfravisionActive ? _shading_infravision : _shading_normal);
+	if (!TMgr.Texture) return false;
+	
+	TMgr.TransferMode = _textured_transfer;
+	TMgr.IsShadeless = InfravisionActive;
+	TMgr.TextureType = OGL_Txtr_Wall;
+	if (!TMgr.Setup()) return false;
+	
+	int InUse = gGLTxStats.inUse;
+	TMgr.RenderNormal();
+	if (TMgr.IsGlowMapped())
+		TMgr.RenderGlowing();
+	if (TEST_FLAG(Get_OGL_ConfigureData().Flags, OGL_Flag_BumpMap))
+	{
+		glActiveTextureARB(GL_TEXTURE1_ARB);
+		TMgr.RenderBump();
+		glActiveTextureARB(GL_TEXTURE0_ARB);
+	}
+	return gGLTxStats.inUse != InUse;
 }
 
 void OGL_FrameTickTextures()
 {
-	std::list<TextureState*>::iterator i;
+	// Load what's near the viewer a little at a time, so that no one frame takes the hit;
+	// anything that comes into view before its turn is loaded when it's drawn, as before
+	if (!sgPrefetchQueue.empty())
+	{
+		Uint64 Start = SDL_GetPerformanceCounter();
+		Uint64 Budget = static_cast<Uint64>(SDL_GetPerformanceFrequency() * (PrefetchMillisecondsPerFrame / 1000));
+		while (!sgPrefetchQueue.empty() && SDL_GetPerformanceCounter() - Start < Budget)
+		{
+			if (PrefetchTexture(sgPrefetchQueue.back()))
+				gGLTxStats.prefetches++;
+			sgPrefetchQueue.pop_back();
+		}
+	}
 	
-	for (i=sgActiveTextureStates.begin() ; i!= sgActiveTextureStates.end() ; i++) {
-		(*i)->FrameTick();
+	// Unload the least recently used texture sets while over the budget;
+	// never those used in this frame, or landscapes
+	Sint64 Budget = Sint64(Get_OGL_ConfigureData().TextureBudget) << 20;
+	if (Budget > 0)
+	{
+		std::list<TextureState*>::iterator i = sgActiveTextureStates.end();
+		while (gGLTxStats.residentBytes > Budget && i != sgActiveTextureStates.begin())
+		{
+			TextureState *State = *(--i);
+			if (State->LastUsedFrame == sgTextureFrame) break;
+			if (State->TextureType == OGL_Txtr_Landscape) continue;
+			
+			// Resetting removes the state from the list
+			std::list<TextureState*>::iterator Next = i;
+			++Next;
+			State->Reset();
+			i = Next;
+			gGLTxStats.evictions++;
+		}
 	}
+	
+	sgTextureFrame++;
 }
 
 // Find an OpenGL-friendly color table from a Marathon shading table
@@ -1365,6 +1460,11 @@ void TextureManager::PlaceTexture(const ImageDescriptor *Image, bool normal_map)
 #endif
 	}
 	
+	// Count it against the texture budget; mipmaps add about a third
+	int32 Bytes = Image->GetMipMapSize(0);
+	if (mipmapsLoaded) Bytes += Bytes / 3;
+	TxtrStatePtr->Loaded(Bytes);
+	
 	// Set texture-mapping features
 	glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, TxtrTypeInfo.NearFilter);
@@ -1601,6 +1701,8 @@ void OGL_ResetTextures()
 
 	glDeleteTextures(1, &flatBumpTextureID);
 	flatBumpTextureID = 0;
+	
+	sgPrefetchQueue.clear();
 }
 
 
@@ -38,15 +38,24 @@ May 3, 2003 (Br'fin (Jeremy Parsons))
 #include "OGL_Subst_Texture_Def.h"
 #include "scottish_textures.h"
 
+#include <list>
+#include <vector>
+
 // Initialize the texture accounting
 void OGL_StartTextures();
 
 // Done with the texture accounting
 void OGL_StopTextures();
 
-// Call this after every frame for housekeeping stuff
+// Call this after every frame for housekeeping stuff: loads some of the
+// prefetched textures, and unloads the least recently used ones while
+// over the texture budget
 void OGL_FrameTickTextures();
 
+// Queues the wall textures of these polygons to be loaded over the next few
+// frames, ahead of their coming into view; replaces any earlier queue
+void OGL_PrefetchTextures(const std::vector<short>& Polygons);
+
 // State of an individual texture set:
 struct TextureState
 {
@@ -63,8 +72,10 @@ struct TextureState
 	bool IsGlowing;						// Does the texture have a glow map?
 	bool IsBumped;						// Does the texture have a bump map?
 	bool TexGened[NUMBER_OF_TEXTURES];	// Which ID's have had their textures generated?
-	int IDUsage[NUMBER_OF_TEXTURES];	// Which ID's are being used?  Reset every frame.
-	int unusedFrames;					// How many frames have passed since we were last used.
+	int IDUsage[NUMBER_OF_TEXTURES];	// Which ID's are being used?
+	int32 Bytes;						// Roughly how much texture memory the ID's take up
+	uint32 LastUsedFrame;				// The frame in which they were last bound
+	std::list<TextureState*>::iterator Position;	// In the most-recently-used-first list
 	short TextureType;
     
     GLdouble U_Scale;
@@ -84,7 +95,8 @@ struct TextureState
 	bool UseGlowing() {return Use(Glowing);}
 	bool UseBump() {return Use(Bump);}
 	
-	void FrameTick();
+	// Counts a texture placed in one of the ID's
+	void Loaded(int32 NewBytes);
 	
 	// Reset the texture to unused and force a reload if necessary
 	void Reset();
@@ -356,7 +368,13 @@ struct OGL_TexturesStats {
 	int inUse;
 	int binds, totalBind, minBind, maxBind;
 	int longNormalSetups, longGlowSetups, longBumpSetups;
-	int totalAge;
+	
+	// Texture memory: how much is loaded, how many texture sets were
+	// unloaded to stay within the budget, and how many were loaded ahead
+	// of time out of how many were queued
+	Sint64 residentBytes;
+	int evictions;
+	int prefetches, prefetchesQueued;
 };
 
 extern OGL_TexturesStats gGLTxStats;
@@ -8,6 +8,7 @@
 
 #include "OGL_Headers.h"
 
+#include <algorithm>
 #include <iostream>
 
 #include "Rasterizer_Shader.h"
@@ -21,7 +22,9 @@
 #include "OGL_FBO.h"
 #include "OGL_Textures.h"
 #include "OGL_Shader.h"
+#include "OGL_Setup.h"
 #include "ChaseCam.h"
+#include "DynamicResolution.h"
 #include "preferences.h"
 #include "fades.h"
 #include "screen.h"
@@ -44,17 +47,51 @@ const GLdouble kViewBaseMatrixInverse[16] = {
 	0,	0,	0,	1
 };
 
-Rasterizer_Shader_Class::Rasterizer_Shader_Class() = default;
-Rasterizer_Shader_Class::~Rasterizer_Shader_Class() = default;
+Rasterizer_Shader_Class::Rasterizer_Shader_Class() :
+	current_timer_query(0),
+	use_timer_queries(false),
+	timing_view(false)
+{
+}
+
+Rasterizer_Shader_Class::~Rasterizer_Shader_Class()
+{
+	// this is static, and may outlive the context
+	if (SDL_GL_GetCurrentContext())
+		delete_timer_queries();
+}
+
+// ends a query that a Begin() left running, and frees them all
+void Rasterizer_Shader_Class::delete_timer_queries()
+{
+	if (!use_timer_queries)
+		return;
+
+	GLint running = 0;
+	glGetQueryivARB(GL_TIME_ELAPSED_EXT, GL_CURRENT_QUERY_ARB, &running);
+	if (running)
+		glEndQueryARB(GL_TIME_ELAPSED_EXT);
+
+	glDeleteQueriesARB(kTimerQueries, timer_queries);
+	use_timer_queries = false;
+	timing_view = false;
+}
 
 void Rasterizer_Shader_Class::SetView(view_data& view) {
 	OGL_SetView(view);
 	
-	if (view.screen_width != view_width || view.screen_height != view_height) {
+	// dynamic resolution draws into smaller buffers, which End() stretches over the view
+	float scale = DynamicResolution::instance()->scale();
+	short width = std::max(1, static_cast<int>(view.screen_width * MainScreenPixelScale() * scale));
+	short height = std::max(1, static_cast<int>(view.screen_height * MainScreenPixelScale() * scale));
+	if (view.screen_width != view_width || view.screen_height != view_height ||
+		width != pixel_width || height != pixel_height) {
 		view_width = view.screen_width;
 		view_height = view.screen_height;
+		pixel_width = width;
+		pixel_height = height;
 		swapper.reset();
-		swapper.reset(new FBOSwapper(view_width * MainScreenPixelScale(), view_height * MainScreenPixelScale(), false));
+		swapper.reset(new FBOSwapper(pixel_width, pixel_height, false));
 	}
 	
 	float aspect = view.screen_width / float(view.screen_height);
@@ -131,7 +168,20 @@ void Rasterizer_Shader_Class::setupGL()
 {
 	view_width = 0;
 	view_height = 0;
+	pixel_width = 0;
+	pixel_height = 0;
 	swapper.reset();
+
+	// if the context was replaced, its queries went with it, and deleting
+	// their names does nothing
+	delete_timer_queries();
+	use_timer_queries = OGL_CheckExtension("GL_EXT_timer_query") || OGL_CheckExtension("GL_ARB_timer_query");
+	if (use_timer_queries)
+		glGenQueriesARB(kTimerQueries, timer_queries);
+	for (int i = 0; i < kTimerQueries; ++i)
+		timer_query_pending[i] = false;
+	current_timer_query = 0;
+	timing_view = false;
 	
 	smear_the_void = false;
 	OGL_ConfigureData& ConfigureData = Get_OGL_ConfigureData();
@@ -142,6 +192,22 @@ void Rasterizer_Shader_Class::setupGL()
 void Rasterizer_Shader_Class::Begin()
 {
 	Rasterizer_OGL_Class::Begin();
+	timing_view = use_timer_queries && graphics_preferences->screen_mode.frame_time_target > 0;
+	if (timing_view) {
+		GLuint query = timer_queries[current_timer_query];
+		if (timer_query_pending[current_timer_query]) {
+			// a result that isn't in yet is dropped, rather than waited for
+			GLint available = 0;
+			glGetQueryObjectivARB(query, GL_QUERY_RESULT_AVAILABLE_ARB, &available);
+			if (available) {
+				GLuint64EXT elapsed = 0;
+				glGetQueryObjectui64vEXT(query, GL_QUERY_RESULT_ARB, &elapsed);
+				DynamicResolution::instance()->report_frame_time(elapsed / 1000000.0f);
+			}
+		}
+		glBeginQueryARB(GL_TIME_ELAPSED_EXT, query);
+		timer_query_pending[current_timer_query] = true;
+	}
 	swapper->activate();
 	if (smear_the_void)
 		swapper->current_contents().draw_full();
@@ -165,6 +231,11 @@ void Rasterizer_Shader_Class::End()
 	glColor3f(0, 0, 0);
 	OGL_RenderFrame(0, 0, view_width, view_height, 1);
 	
+	if (timing_view) {
+		glEndQueryARB(GL_TIME_ELAPSED_EXT);
+		current_timer_query = (current_timer_query + 1) % kTimerQueries;
+	}
+	
 	Rasterizer_OGL_Class::End();
 }
 
@@ -12,6 +12,7 @@
 
 #include "cseries.h"
 #include "map.h"
+#include "OGL_Headers.h"
 #include "Rasterizer_OGL.h"
 #include <memory>
 
@@ -25,6 +26,22 @@ protected:
 	short view_width;
 	short view_height;
 
+	// the size of the buffers the view is drawn into, smaller than the
+	// view's when dynamic resolution is cutting it down
+	short pixel_width;
+	short pixel_height;
+
+	// GPU time taken by the view, for dynamic resolution; results are
+	// collected when their query comes round again
+	enum { kTimerQueries = 4 };
+	GLuint timer_queries[kTimerQueries];
+	bool timer_query_pending[kTimerQueries];
+	int current_timer_query;
+	bool use_timer_queries;
+	bool timing_view;
+
+	void delete_timer_queries();
+
 public:
 
 	Rasterizer_Shader_Class();
@@ -63,7 +63,6 @@ May 3, 2003 (Br'fin (Jeremy Parsons))
 
 
 // LP: "recommended" sizes of stuff in growable lists
-#define MAXIMUM_RENDER_OBJECTS 72
 #define MAXIMUM_OBJECT_BASE_NODES 6
 
 // For finding the 2D projection of the bounding box;
@@ -87,7 +86,7 @@ RenderPlaceObjsClass::RenderPlaceObjsClass():
 	view(NULL),	// Idiot-proofing
 	RVPtr(NULL),
 	RSPtr(NULL)
-{RenderObjects.reserve(MAXIMUM_RENDER_OBJECTS);}
+{}
 
 
 /* ---------- initializing, building and sorting the object list */
@@ -155,8 +154,6 @@ render_object_data *RenderPlaceObjsClass::build_render_object(
 {
 	render_object_data *render_object= NULL;
 	object_data *object= get_object_data(object_index);
-	// LP: reference to simplify the code
-	vector<sorted_node_data>& SortedNodes = RSPtr->SortedNodes;
 	
 	// LP change: removed upper limit on number (restored it later)
 	if (!OBJECT_IS_INVISIBLE(object) && int(RenderObjects.size())<get_dynamic_limit(_dynamic_limit_rendered))
@@ -271,35 +268,9 @@ render_object_data *RenderPlaceObjsClass::build_render_object(
 			}
 			if (x0<x1 && y0<y1)
 			{
-				// LP Change:
-				size_t Length = RenderObjects.size();
-				POINTER_DATA OldROPointer = POINTER_CAST(RenderObjects.data());
-				
-				// Add a dummy object and check if the pointer got changed
-				render_object_data Dummy;
-				Dummy.node = NULL;				// Fake initialization to shut up CW
-				RenderObjects.push_back(Dummy);
-				POINTER_DATA NewROPointer = POINTER_CAST(RenderObjects.data());
-				
-				if (NewROPointer != OldROPointer)
-				{
-					// Get the render objects and sorted nodes into sync
-					for (size_t k=0; k<Length; k++)
-					{
-						render_object_data &RenderObject = RenderObjects[k];
-						if (RenderObject.next_object != NULL)
-							RenderObject.next_object = (render_object_data *)(NewROPointer + (POINTER_CAST(RenderObject.next_object) - OldROPointer));
-					}
-					for (size_t k=0; k<SortedNodes.size(); k++)
-					{
-						sorted_node_data &SortedNode = SortedNodes[k];
-						if (SortedNode.interior_objects != NULL)
-							SortedNode.interior_objects = (render_object_data *)(NewROPointer + (POINTER_CAST(SortedNode.interior_objects) - OldROPointer));
-						if (SortedNode.exterior_objects != NULL)
-							SortedNode.exterior_objects = (render_object_data *)(NewROPointer + (POINTER_CAST(SortedNode.exterior_objects) - OldROPointer));
-					}
-				}
-				render_object= &RenderObjects[Length];
+				render_object= &RenderObjects.push_back();
+				render_object->node= NULL;
+				render_object->clipping_windows= NULL;
 				
 				render_object->rectangle.flags= 0;
 				
@@ -456,8 +427,10 @@ void RenderPlaceObjsClass::sort_render_object_into_tree(
 		;
 
 	/* find the two objects we must be lie between */
-	for (render_object = &RenderObjects.front(); render_object <= &RenderObjects.back(); ++render_object)
+	for (size_t k = 0; k < RenderObjects.size(); ++k)
 	{
+		render_object = &RenderObjects[k];
+
 		/* if these two objects intersect... */
 		if (render_object->rectangle.x1>new_render_object->rectangle.x0 && render_object->rectangle.x0<new_render_object->rectangle.x1 &&
 			render_object->rectangle.y1>new_render_object->rectangle.y0 && render_object->rectangle.y0<new_render_object->rectangle.y1)
@@ -53,6 +53,31 @@ struct render_object_data
 	int16 ymedia;
 };
 
+// Render objects, kept in fixed-size blocks so that adding one never moves the others
+// that the sorted nodes already point to; the blocks are reused from frame to frame
+class render_object_arena
+{
+public:
+	render_object_arena(): count(0) {}
+	
+	size_t size() const {return count;}
+	render_object_data& operator[](size_t index) {return blocks[index/BLOCK_SIZE][index%BLOCK_SIZE];}
+	
+	render_object_data& push_back()
+	{
+		if (count == blocks.size()*BLOCK_SIZE)
+			blocks.push_back(vector<render_object_data>(BLOCK_SIZE));
+		return (*this)[count++];
+	}
+	
+	void clear() {count = 0;}
+
+private:
+	enum {BLOCK_SIZE = 128};
+	
+	vector<vector<render_object_data> > blocks;
+	size_t count;
+};
 
 class RenderPlaceObjsClass
 {
@@ -82,8 +107,7 @@ public:
 
 	// LP additions: growable list of render objects; these are all the inhabitants
 	// Length changed in build_render_object()
-	// keep SortedNodes in sync
-	vector<render_object_data> RenderObjects;
+	render_object_arena RenderObjects;
 	
 	// Pointers to view and calculated visibility tree and sorted polygons
 	view_data *view;
@@ -23,6 +23,10 @@
 #include "ChaseCam.h"
 #include "preferences.h"
 #include "screen.h"
+#include "Profiler.h"
+#include "vec3.h"
+
+#include <vector>
 
 #define MAXIMUM_VERTICES_PER_WORLD_POLYGON (MAXIMUM_VERTICES_PER_POLYGON+4)
 
@@ -88,7 +92,40 @@ public:
 };
 
 
-RenderRasterize_Shader::RenderRasterize_Shader() = default;
+// Surfaces drawn since the last state change, as triangles. Everything the
+// shader reads per surface is either part of the state compared here or
+// carried per vertex (the normal and tangent), so drawing the batch in one
+// call gives the same picture as drawing its surfaces one at a time.
+class WallBatch {
+public:
+	WallBatch() : active(false), surface_count(0) {}
+
+	bool matches(clipping_window_data *window, const shape_descriptor& texture, short transferMode,
+				 float pulsate, float wobble, float intensity, float offset, RenderStep renderStep) const {
+		return active && !glowing &&
+			this->window == window && this->texture == texture && this->transferMode == transferMode &&
+			this->pulsate == pulsate && this->wobble == wobble && this->intensity == intensity &&
+			this->offset == offset && this->renderStep == renderStep;
+	}
+
+	bool active;
+	bool glowing;
+	int surface_count;
+
+	clipping_window_data *window;
+	shape_descriptor texture;
+	short transferMode;
+	float pulsate, wobble, glowWobble, intensity, offset;
+	RenderStep renderStep;
+	TextureManager TMgr;
+
+	std::vector<GLfloat> vertices;
+	std::vector<GLfloat> texcoords;
+	std::vector<GLfloat> normals;
+	std::vector<GLfloat> tangents;
+};
+
+RenderRasterize_Shader::RenderRasterize_Shader() : wallBatch(new WallBatch) {}
 RenderRasterize_Shader::~RenderRasterize_Shader() = default;
 
 /*
@@ -134,8 +171,8 @@ void RenderRasterize_Shader::render_tree() {
 	s->setFloat(Shader::U_Time, view->tick_count);
 	s->setFloat(Shader::U_LogicalWidth, view->screen_width);
 	s->setFloat(Shader::U_LogicalHeight, view->screen_height);
-	s->setFloat(Shader::U_PixelWidth, view->screen_width * MainScreenPixelScale());
-	s->setFloat(Shader::U_PixelHeight, view->screen_height * MainScreenPixelScale());
+	s->setFloat(Shader::U_PixelWidth, RasPtr->pixel_width);
+	s->setFloat(Shader::U_PixelHeight, RasPtr->pixel_height);
 	if (blur.get()) {
 		s = Shader::get(Shader::S_InvincibleBloom);
 		s->enable();
@@ -209,6 +246,7 @@ void RenderRasterize_Shader::render_node(sorted_node_data *node, bool SeeThruLiq
     objectY = 0;
 
     RenderRasterizerClass::render_node(node, SeeThruLiquids, renderStep);
+	flush_wall_batch();
 
 	// turn off clipping planes
 	glDisable(GL_CLIP_PLANE0);
@@ -554,18 +592,17 @@ bool setupGlow(struct view_data *view, TextureManager &TMgr, float wobble, float
 	return false;
 }
 
-void RenderRasterize_Shader::render_node_floor_or_ceiling(clipping_window_data *window,
-	polygon_data *polygon, horizontal_surface_data *surface, bool void_present, bool ceil, RenderStep renderStep) {
+bool RenderRasterize_Shader::begin_wall_surface(clipping_window_data *window, const shape_descriptor& texture, short transferMode, float pulsate, float wobble, float glowWobble, float intensity, float offset, RenderStep renderStep) {
 
-	float offset = 0;
+	WallBatch& batch = *wallBatch;
+	if (batch.matches(window, texture, transferMode, pulsate, wobble, intensity, offset, renderStep)) {
+		return true;
+	}
 
-	const shape_descriptor& texture = AnimTxtr_Translate(surface->texture);
-	float intensity = get_light_intensity(surface->lightsource_index) / float(FIXED_ONE - 1);
-	float wobble = calcWobble(surface->transfer_mode, view->tick_count);
-	// note: wobble and pulsate behave the same way on floors and ceilings
-	// note 2: stronger wobble looks more like classic with default shaders
-	TextureManager TMgr = setupWallTexture(texture, surface->transfer_mode, wobble * 4.0, 0, intensity, offset, renderStep);
-	if(TMgr.ShapeDesc == UNONE) { return; }
+	flush_wall_batch();
+
+	TextureManager TMgr = setupWallTexture(texture, transferMode, pulsate, wobble, intensity, offset, renderStep);
+	if(TMgr.ShapeDesc == UNONE) { return false; }
 
 	if (TMgr.IsBlended()) {
 		glEnable(GL_BLEND);
@@ -583,70 +620,154 @@ void RenderRasterize_Shader::render_node_floor_or_ceiling(clipping_window_data *
 //		glDisable(GL_ALPHA_TEST);
 //	}
 
-	short vertex_count = polygon->vertex_count;
+	clip_to_window(window);
+
+	batch.active = true;
+	// the glow pass is a second draw with other state; keep it right after its own surface
+	batch.glowing = TMgr.TransferMode == _textured_transfer && TMgr.IsGlowMapped();
+	batch.window = window;
+	batch.texture = texture;
+	batch.transferMode = transferMode;
+	batch.pulsate = pulsate;
+	batch.wobble = wobble;
+	batch.glowWobble = glowWobble;
+	batch.intensity = intensity;
+	batch.offset = offset;
+	batch.renderStep = renderStep;
+	batch.TMgr = TMgr;
+	return true;
+}
+
+// the polygon is convex, so a fan from its first vertex covers it
+void RenderRasterize_Shader::add_wall_polygon(const GLfloat *vertices, const GLfloat *texcoords, int vertex_count, const vec4& normal, const vec4& tangent) {
+
+	WallBatch& batch = *wallBatch;
+	for (int i = 2; i < vertex_count; ++i) {
+		const int corners[3] = { 0, i - 1, i };
+		for (int j = 0; j < 3; ++j) {
+			const int k = corners[j];
+			batch.vertices.insert(batch.vertices.end(), vertices + 3*k, vertices + 3*k + 3);
+			batch.texcoords.insert(batch.texcoords.end(), texcoords + 2*k, texcoords + 2*k + 2);
+			batch.normals.insert(batch.normals.end(), normal.p(), normal.p() + 3);
+			batch.tangents.insert(batch.tangents.end(), tangent.p(), tangent.p() + 4);
+		}
+	}
+	++batch.surface_count;
 
-	if (vertex_count) {
-        clip_to_window(window);
+	if (batch.glowing) {
+		flush_wall_batch();
+	}
+}
 
-		world_distance x = 0.0, y = 0.0;
-		instantiate_transfer_mode(view, surface->transfer_mode, x, y);
+void RenderRasterize_Shader::flush_wall_batch() {
 
-		vec3 N;
-		vec3 T;
-		float sign;
-		if(ceil) {
-			N = vec3(0,0,-1);
-			T = vec3(0,1,0);
-			sign = 1;
-		} else {
-			N = vec3(0,0,1);
-			T = vec3(0,1,0);
-			sign = -1;
-		}
-		glNormal3f(N[0], N[1], N[2]);
-		glMultiTexCoord4fARB(GL_TEXTURE1_ARB, T[0], T[1], T[2], sign);
+	WallBatch& batch = *wallBatch;
+	if (!batch.active) {
+		return;
+	}
+	batch.active = false;
 
-		GLfloat vertex_array[MAXIMUM_VERTICES_PER_POLYGON * 3];
-		GLfloat texcoord_array[MAXIMUM_VERTICES_PER_POLYGON * 2];
+	if (!batch.vertices.empty()) {
+		const GLsizei vertex_count = static_cast<GLsizei>(batch.vertices.size() / 3);
 
-		GLfloat* vp = vertex_array;
-		GLfloat* tp = texcoord_array;
-		if (ceil)
-		{
-			for(short i = 0; i < vertex_count; ++i) {
-				world_point2d vertex = get_endpoint_data(polygon->endpoint_indexes[vertex_count - 1 - i])->vertex;
-				*vp++ = vertex.x;
-				*vp++ = vertex.y;
-				*vp++ = surface->height;
-				*tp++ = (vertex.x + surface->origin.x + x) / float(WORLD_ONE);
-				*tp++ = (vertex.y + surface->origin.y + y) / float(WORLD_ONE);
-			}
-		}
-		else
-		{
-			for(short i=0; i<vertex_count; ++i) {
-				world_point2d vertex = get_endpoint_data(polygon->endpoint_indexes[i])->vertex;
-				*vp++ = vertex.x;
-				*vp++ = vertex.y;
-				*vp++ = surface->height;
-				*tp++ = (vertex.x + surface->origin.x + x) / float(WORLD_ONE);
-				*tp++ = (vertex.y + surface->origin.y + y) / float(WORLD_ONE);
-			}
-		}
-		glVertexPointer(3, GL_FLOAT, 0, vertex_array);
-		glTexCoordPointer(2, GL_FLOAT, 0, texcoord_array);
+		glVertexPointer(3, GL_FLOAT, 0, &batch.vertices.front());
+		glTexCoordPointer(2, GL_FLOAT, 0, &batch.texcoords.front());
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glNormalPointer(GL_FLOAT, 0, &batch.normals.front());
+		glClientActiveTextureARB(GL_TEXTURE1_ARB);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glTexCoordPointer(4, GL_FLOAT, 0, &batch.tangents.front());
+		glClientActiveTextureARB(GL_TEXTURE0_ARB);
 
-		glDrawArrays(GL_POLYGON, 0, vertex_count);
+		glDrawArrays(GL_TRIANGLES, 0, vertex_count);
+		int draw_calls = 1;
 
-		if (setupGlow(view, TMgr, wobble, intensity, weaponFlare, selfLuminosity, offset, renderStep)) {
-			glDrawArrays(GL_POLYGON, 0, vertex_count);
+		if (setupGlow(view, batch.TMgr, batch.glowWobble, batch.intensity, weaponFlare, selfLuminosity, batch.offset, batch.renderStep)) {
+			glDrawArrays(GL_TRIANGLES, 0, vertex_count);
+			++draw_calls;
 		}
 
-		Shader::disable();
-		glMatrixMode(GL_TEXTURE);
-		glLoadIdentity();
-		glMatrixMode(GL_MODELVIEW);
+		glDisableClientState(GL_NORMAL_ARRAY);
+		glClientActiveTextureARB(GL_TEXTURE1_ARB);
+		glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		glClientActiveTextureARB(GL_TEXTURE0_ARB);
+
+		PROFILE_COUNT("wall_draw_calls", draw_calls);
+		PROFILE_COUNT("wall_surfaces", batch.surface_count);
+	}
+
+	batch.vertices.clear();
+	batch.texcoords.clear();
+	batch.normals.clear();
+	batch.tangents.clear();
+	batch.surface_count = 0;
+
+	Shader::disable();
+	glMatrixMode(GL_TEXTURE);
+	glLoadIdentity();
+	glMatrixMode(GL_MODELVIEW);
+}
+
+void RenderRasterize_Shader::render_node_floor_or_ceiling(clipping_window_data *window,
+	polygon_data *polygon, horizontal_surface_data *surface, bool void_present, bool ceil, RenderStep renderStep) {
+
+	float offset = 0;
+
+	short vertex_count = polygon->vertex_count;
+	if (!vertex_count) { return; }
+
+	const shape_descriptor& texture = AnimTxtr_Translate(surface->texture);
+	float intensity = get_light_intensity(surface->lightsource_index) / float(FIXED_ONE - 1);
+	float wobble = calcWobble(surface->transfer_mode, view->tick_count);
+	// note: wobble and pulsate behave the same way on floors and ceilings
+	// note 2: stronger wobble looks more like classic with default shaders
+	if (!begin_wall_surface(window, texture, surface->transfer_mode, wobble * 4.0, 0, wobble, intensity, offset, renderStep)) { return; }
+
+	world_distance x = 0.0, y = 0.0;
+	instantiate_transfer_mode(view, surface->transfer_mode, x, y);
+
+	vec3 N;
+	vec3 T;
+	float sign;
+	if(ceil) {
+		N = vec3(0,0,-1);
+		T = vec3(0,1,0);
+		sign = 1;
+	} else {
+		N = vec3(0,0,1);
+		T = vec3(0,1,0);
+		sign = -1;
 	}
+
+	GLfloat vertex_array[MAXIMUM_VERTICES_PER_POLYGON * 3];
+	GLfloat texcoord_array[MAXIMUM_VERTICES_PER_POLYGON * 2];
+
+	GLfloat* vp = vertex_array;
+	GLfloat* tp = texcoord_array;
+	if (ceil)
+	{
+		for(short i = 0; i < vertex_count; ++i) {
+			world_point2d vertex = get_endpoint_data(polygon->endpoint_indexes[vertex_count - 1 - i])->vertex;
+			*vp++ = vertex.x;
+			*vp++ = vertex.y;
+			*vp++ = surface->height;
+			*tp++ = (vertex.x + surface->origin.x + x) / float(WORLD_ONE);
+			*tp++ = (vertex.y + surface->origin.y + y) / float(WORLD_ONE);
+		}
+	}
+	else
+	{
+		for(short i=0; i<vertex_count; ++i) {
+			world_point2d vertex = get_endpoint_data(polygon->endpoint_indexes[i])->vertex;
+			*vp++ = vertex.x;
+			*vp++ = vertex.y;
+			*vp++ = surface->height;
+			*tp++ = (vertex.x + surface->origin.x + x) / float(WORLD_ONE);
+			*tp++ = (vertex.y + surface->origin.y + y) / float(WORLD_ONE);
+		}
+	}
+
+	add_wall_polygon(vertex_array, texcoord_array, vertex_count, N, vec4(T[0], T[1], T[2], sign));
 }
 
 void RenderRasterize_Shader::render_node_side(clipping_window_data *window, vertical_surface_data *surface, bool void_present, RenderStep renderStep) {
@@ -656,6 +777,9 @@ void RenderRasterize_Shader::render_node_side(clipping_window_data *window, vert
 		offset = -2.0;
 	}
 
+	world_distance h= MIN(surface->h1, surface->hmax);
+	if (h <= surface->h0) { return; }
+
 	const shape_descriptor& texture = AnimTxtr_Translate(surface->texture_definition->texture);
 	float intensity = (get_light_intensity(surface->lightsource_index) + surface->ambient_delta) / float(FIXED_ONE - 1);
 	float wobble = calcWobble(surface->transfer_mode, view->tick_count);
@@ -664,102 +788,62 @@ void RenderRasterize_Shader::render_node_side(clipping_window_data *window, vert
 		pulsate = wobble;
 		wobble = 0;
 	}
-	TextureManager TMgr = setupWallTexture(texture, surface->transfer_mode, pulsate, wobble, intensity, offset, renderStep);
-	if(TMgr.ShapeDesc == UNONE) { return; }
-
-	if (TMgr.IsBlended()) {
-		glEnable(GL_BLEND);
-		setupBlendFunc(TMgr.NormalBlend());
-		glEnable(GL_ALPHA_TEST);
-		glAlphaFunc(GL_GREATER, 0.001);
-	} else {
-		glDisable(GL_BLEND);
-		glEnable(GL_ALPHA_TEST);
-		glAlphaFunc(GL_GREATER, 0.5);
-	}
+	if (!begin_wall_surface(window, texture, surface->transfer_mode, pulsate, wobble, wobble, intensity, offset, renderStep)) { return; }
 
-//	if (void_present) {
-//		glDisable(GL_BLEND);
-//		glDisable(GL_ALPHA_TEST);
-//	}
-
-	world_distance h= MIN(surface->h1, surface->hmax);
+	world_point2d vertex[2];
+	uint16 flags;
+	flagged_world_point3d vertices[MAXIMUM_VERTICES_PER_WORLD_POLYGON];
+	short vertex_count;
 
-	if (h>surface->h0) {
+	/* initialize the two posts of our trapezoid */
+	long_to_overflow_short_2d(surface->p0, vertex[0], flags);
+	long_to_overflow_short_2d(surface->p1, vertex[1], flags);
 
-		world_point2d vertex[2];
-		uint16 flags;
-		flagged_world_point3d vertices[MAXIMUM_VERTICES_PER_WORLD_POLYGON];
-		short vertex_count;
+	vertex_count= 4;
+	vertices[0].z= vertices[1].z= h + view->origin.z;
+	vertices[2].z= vertices[3].z= surface->h0 + view->origin.z;
+	vertices[0].x= vertices[3].x= vertex[0].x, vertices[0].y= vertices[3].y= vertex[0].y;
+	vertices[1].x= vertices[2].x= vertex[1].x, vertices[1].y= vertices[2].y= vertex[1].y;
+	vertices[0].flags = vertices[3].flags = 0;
+	vertices[1].flags = vertices[2].flags = 0;
 
-		/* initialize the two posts of our trapezoid */
-		vertex_count= 2;
-		long_to_overflow_short_2d(surface->p0, vertex[0], flags);
-		long_to_overflow_short_2d(surface->p1, vertex[1], flags);
+	double div = WORLD_ONE;
+	double dx = (surface->p1.i - surface->p0.i) / double(surface->length);
+	double dy = (surface->p1.j - surface->p0.j) / double(surface->length);
 
-		if (vertex_count) {
-            clip_to_window(window);
+	world_distance x0 = WORLD_FRACTIONAL_PART(surface->texture_definition->x0);
+	world_distance y0 = WORLD_FRACTIONAL_PART(surface->texture_definition->y0);
 
-			vertex_count= 4;
-			vertices[0].z= vertices[1].z= h + view->origin.z;
-			vertices[2].z= vertices[3].z= surface->h0 + view->origin.z;
-			vertices[0].x= vertices[3].x= vertex[0].x, vertices[0].y= vertices[3].y= vertex[0].y;
-			vertices[1].x= vertices[2].x= vertex[1].x, vertices[1].y= vertices[2].y= vertex[1].y;
-			vertices[0].flags = vertices[3].flags = 0;
-			vertices[1].flags = vertices[2].flags = 0;
+	double tOffset = surface->h1 + view->origin.z + y0;
 
-			double div = WORLD_ONE;
-			double dx = (surface->p1.i - surface->p0.i) / double(surface->length);
-			double dy = (surface->p1.j - surface->p0.j) / double(surface->length);
+	vec3 N(-dy, dx, 0);
+	vec3 T(dx, dy, 0);
+	float sign = 1;
 
-			world_distance x0 = WORLD_FRACTIONAL_PART(surface->texture_definition->x0);
-			world_distance y0 = WORLD_FRACTIONAL_PART(surface->texture_definition->y0);
+	world_distance x = 0.0, y = 0.0;
+	instantiate_transfer_mode(view, surface->transfer_mode, x, y);
 
-			double tOffset = surface->h1 + view->origin.z + y0;
+	x0 -= x;
+	tOffset -= y;
 
-			vec3 N(-dy, dx, 0);
-			vec3 T(dx, dy, 0);
-			float sign = 1;
-			glNormal3f(N[0], N[1], N[2]);
-			glMultiTexCoord4fARB(GL_TEXTURE1_ARB, T[0], T[1], T[2], sign);
+	GLfloat vertex_array[12];
+	GLfloat texcoord_array[8];
 
-			world_distance x = 0.0, y = 0.0;
-			instantiate_transfer_mode(view, surface->transfer_mode, x, y);
+	GLfloat* vp = vertex_array;
+	GLfloat* tp = texcoord_array;
 
-			x0 -= x;
-			tOffset -= y;
+	for(int i = 0; i < vertex_count; ++i) {
+		float p2 = 0;
+		if(i == 1 || i == 2) { p2 = surface->length; }
 
-			GLfloat vertex_array[12];
-			GLfloat texcoord_array[8];
-
-			GLfloat* vp = vertex_array;
-			GLfloat* tp = texcoord_array;
-
-			for(int i = 0; i < vertex_count; ++i) {
-				float p2 = 0;
-				if(i == 1 || i == 2) { p2 = surface->length; }
-
-				*vp++ = vertices[i].x;
-				*vp++ = vertices[i].y;
-				*vp++ = vertices[i].z;
-				*tp++ = (tOffset - vertices[i].z) / div;
-				*tp++ = (x0+p2) / div;
-			}
-			glVertexPointer(3, GL_FLOAT, 0, vertex_array);
-			glTexCoordPointer(2, GL_FLOAT, 0, texcoord_array);
-			
-			glDrawArrays(GL_QUADS, 0, vertex_count);
-
-			if (setupGlow(view, TMgr, wobble, intensity, weaponFlare, selfLuminosity, offset, renderStep)) {
-				glDrawArrays(GL_QUADS, 0, vertex_count);
-			}
-
-			Shader::disable();
-			glMatrixMode(GL_TEXTURE);
-			glLoadIdentity();
-			glMatrixMode(GL_MODELVIEW);
-		}
+		*vp++ = vertices[i].x;
+		*vp++ = vertices[i].y;
+		*vp++ = vertices[i].z;
+		*tp++ = (tOffset - vertices[i].z) / div;
+		*tp++ = (x0+p2) / div;
 	}
+
+	add_wall_polygon(vertex_array, texcoord_array, vertex_count, N, vec4(T[0], T[1], T[2], sign));
 }
 
 extern void FlatBumpTexture(); // from OGL_Textures.cpp
@@ -916,6 +1000,8 @@ bool RenderModel(rectangle_definition& RenderRectangle, short Collection, short
 
 void RenderRasterize_Shader::render_node_object(render_object_data *object, bool other_side_of_media, RenderStep renderStep) {
 
+	flush_wall_batch();
+
     if (!object->clipping_windows)
         return;
 
@@ -20,9 +20,12 @@
 #include <memory>
 
 class Blur;
+class WallBatch;
+struct vec4;
 class RenderRasterize_Shader : public RenderRasterizerClass {
 
 	std::unique_ptr<Blur> blur;
+	std::unique_ptr<WallBatch> wallBatch;
 	Rasterizer_Shader_Class *RasPtr;
 	
 	int objectCount;
@@ -50,6 +53,12 @@ protected:
 
     void render_viewer_sprite_layer(RenderStep renderStep);
     void render_viewer_sprite(rectangle_definition& RenderRectangle, RenderStep renderStep);
+
+	// consecutive wall, floor and ceiling polygons with the same texture and
+	// shader state are collected and drawn together
+	bool begin_wall_surface(clipping_window_data *window, const shape_descriptor& texture, short transferMode, float pulsate, float wobble, float glowWobble, float intensity, float offset, RenderStep renderStep);
+	void add_wall_polygon(const GLfloat *vertices, const GLfloat *texcoords, int vertex_count, const vec4& normal, const vec4& tangent);
+	void flush_wall_batch();
 	
 public:
 
@@ -37,6 +37,9 @@ Oct 13, 2000
 
 #include "map.h"
 #include "RenderVisTree.h"
+#include "Logging.h"
+
+#include <algorithm>
 
 
 // LP: "recommended" sizes of stuff in growable lists
@@ -83,7 +86,8 @@ inline void INITIALIZE_NODE(node_data *node, short node_polygon_index, uint16 no
 
 // Inits everything
 RenderVisTreeClass::RenderVisTreeClass():
-	view(NULL), mark_as_explored(false), add_to_automap(true)
+	cache_valid(false), view(NULL), mark_as_explored(false), add_to_automap(true),
+	reuse_previous_tree(false), validate_reuse(false)
 {
 	PolygonQueue.reserve(POLYGON_QUEUE_SIZE);
 	EndpointClips.reserve(MAXIMUM_ENDPOINT_CLIPS);
@@ -97,6 +101,7 @@ void RenderVisTreeClass::Resize(size_t NumEndpoints, size_t NumLines)
 {
 	endpoint_x_coordinates.resize(NumEndpoints);
 	line_clip_indexes.resize(NumLines);
+	Invalidate();
 }
 
 // Add a polygon to the polygon queue
@@ -120,6 +125,33 @@ void RenderVisTreeClass::PUSH_POLYGON_INDEX(short polygon_index)
 void RenderVisTreeClass::build_render_tree()
 {
 	assert(view);	// Idiot-proofing
+	
+	// The exploration pass changes polygon types as it goes, so it always builds afresh
+	if (!reuse_previous_tree || mark_as_explored)
+	{
+		Invalidate();
+		build_full_tree();
+		return;
+	}
+	
+	if (cached_tree_matches_view())
+	{
+		if (!validate_reuse)
+		{
+			restore_cached_tree();
+			return;
+		}
+		validate_cached_tree();
+	}
+	else
+		build_full_tree();
+	
+	cache_tree();
+}
+
+void RenderVisTreeClass::build_full_tree()
+{
+	VisitedEndpoints.clear();
 
 	/* initialize the queue where we remember polygons we need to fire at */
 	initialize_polygon_queue();
@@ -161,6 +193,7 @@ void RenderVisTreeClass::build_render_tree()
 				/* transform all visited endpoints */
 				endpoint->transformed= endpoint->vertex;
 				transform_overflow_point2d(&endpoint->transformed, (world_point2d *) &view->origin, view->yaw, &endpoint->flags);
+				VisitedEndpoints.push_back(endpoint_index);
 
 				/* calculate an outbound vector to this endpoint */
 				// LP: changed to do long distance correctly.	
@@ -829,3 +862,179 @@ void RenderVisTreeClass::ResetLineClips(void)
 	for (int k=0; k<NUMBER_OF_INITIAL_LINE_CLIPS; k++)
 		LineClips.push_back(Dummy);
 }
+
+
+/* ---------- reusing the previous frame's tree */
+
+// Render flags are only ever set for indexes below these counts
+static size_t render_flag_count()
+{
+	return MAX(MAX(dynamic_world->endpoint_count, dynamic_world->line_count),
+		MAX(dynamic_world->side_count, dynamic_world->polygon_count));
+}
+
+// Everything the ray casting read from the map, for every polygon the tree reached;
+// platforms and Lua change these, and any change means the tree has to be rebuilt
+void RenderVisTreeClass::calculate_geometry_signature(vector<int16>& Signature)
+{
+	Signature.clear();
+	
+	for (NodeList::iterator node = Nodes.begin(); node != Nodes.end(); ++node)
+	{
+		polygon_data *polygon= get_polygon_data(node->polygon_index);
+		
+		Signature.push_back(node->polygon_index);
+		Signature.push_back(polygon->floor_height);
+		Signature.push_back(polygon->ceiling_height);
+		
+		for (short i= 0; i<polygon->vertex_count; ++i)
+		{
+			// the transform overflow bits in endpoint flags change with the view, so leave them out
+			endpoint_data *endpoint= get_endpoint_data(polygon->endpoint_indexes[i]);
+			Signature.push_back(static_cast<int16>(ENDPOINT_IS_SOLID(endpoint) | ENDPOINT_IS_ELEVATION(endpoint) | ENDPOINT_IS_TRANSPARENT(endpoint)));
+			
+			short line_index= polygon->line_indexes[i];
+			if (line_index == NONE) continue;
+			line_data *line= get_line_data(line_index);
+			Signature.push_back(static_cast<int16>(line->flags));
+			Signature.push_back(line->highest_adjacent_floor);
+			Signature.push_back(line->lowest_adjacent_ceiling);
+		}
+	}
+}
+
+bool RenderVisTreeClass::cached_tree_matches_view()
+{
+	if (!cache_valid) return false;
+	
+	const view_data& Cached = CachedView;
+	if (view->origin.x != Cached.origin.x ||
+		view->origin.y != Cached.origin.y ||
+		view->origin.z != Cached.origin.z ||
+		view->origin_polygon_index != Cached.origin_polygon_index ||
+		view->yaw != Cached.yaw ||
+		view->pitch != Cached.pitch ||
+		view->dtanpitch != Cached.dtanpitch ||
+		view->screen_width != Cached.screen_width ||
+		view->screen_height != Cached.screen_height ||
+		view->half_screen_width != Cached.half_screen_width ||
+		view->half_screen_height != Cached.half_screen_height ||
+		view->world_to_screen_x != Cached.world_to_screen_x ||
+		view->world_to_screen_y != Cached.world_to_screen_y)
+		return false;
+	
+	const world_vector2d *Edges[] = {&view->left_edge, &view->right_edge, &view->top_edge, &view->bottom_edge,
+		&view->untransformed_left_edge, &view->untransformed_right_edge};
+	const world_vector2d *CachedEdges[] = {&Cached.left_edge, &Cached.right_edge, &Cached.top_edge, &Cached.bottom_edge,
+		&Cached.untransformed_left_edge, &Cached.untransformed_right_edge};
+	for (unsigned k = 0; k < sizeof(Edges)/sizeof(Edges[0]); k++)
+	{
+		if (Edges[k]->i != CachedEdges[k]->i || Edges[k]->j != CachedEdges[k]->j)
+			return false;
+	}
+	
+	calculate_geometry_signature(SignatureScratch);
+	return SignatureScratch == GeometrySignature;
+}
+
+void RenderVisTreeClass::cache_tree()
+{
+	CachedView = *view;
+	calculate_geometry_signature(GeometrySignature);
+	
+	CachedRenderFlags.assign(render_flags, render_flags + render_flag_count());
+	
+	CachedLinks.resize(Nodes.size());
+	for (size_t k = 0; k < Nodes.size(); k++)
+	{
+		node_data& Node = Nodes[k];
+		CachedLinks[k].children = Node.children;
+		CachedLinks[k].siblings = Node.siblings;
+		CachedLinks[k].reference = Node.reference;
+	}
+	
+	cache_valid = true;
+}
+
+void RenderVisTreeClass::restore_cached_tree()
+{
+	// sort_render_tree() unlinks nodes as it consumes them
+	for (size_t k = 0; k < Nodes.size(); k++)
+	{
+		node_data& Node = Nodes[k];
+		Node.children = CachedLinks[k].children;
+		Node.siblings = CachedLinks[k].siblings;
+		Node.reference = CachedLinks[k].reference;
+	}
+	
+	// render_view() cleared these
+	std::copy(CachedRenderFlags.begin(), CachedRenderFlags.end(), render_flags);
+	
+	// The sorter and object placer append windows of their own
+	ClippingWindows.clear();
+	
+	// The exploration pass transforms endpoints for other players' views
+	// into the same map data, so put ours back
+	for (vector<short>::iterator it = VisitedEndpoints.begin(); it != VisitedEndpoints.end(); ++it)
+	{
+		endpoint_data *endpoint= get_endpoint_data(*it);
+		endpoint->transformed= endpoint->vertex;
+		transform_overflow_point2d(&endpoint->transformed, (world_point2d *) &view->origin, view->yaw, &endpoint->flags);
+	}
+}
+
+static bool nodes_match(const node_data& A, const node_data& B)
+{
+	if (A.flags != B.flags || A.polygon_index != B.polygon_index ||
+		A.clipping_endpoint_count != B.clipping_endpoint_count ||
+		A.clipping_line_count != B.clipping_line_count)
+		return false;
+	
+	return std::equal(A.clipping_endpoints, A.clipping_endpoints + A.clipping_endpoint_count, B.clipping_endpoints) &&
+		std::equal(A.clipping_lines, A.clipping_lines + A.clipping_line_count, B.clipping_lines);
+}
+
+static bool endpoint_clips_match(const endpoint_clip_data& A, const endpoint_clip_data& B)
+{
+	return A.flags == B.flags && A.x == B.x &&
+		A.vector.i == B.vector.i && A.vector.j == B.vector.j;
+}
+
+static bool line_clips_match(const line_clip_data& A, const line_clip_data& B)
+{
+	if (A.flags != B.flags) return false;
+	// the rest is left unset for lines behind the viewer
+	if (!A.flags) return true;
+	
+	return A.x0 == B.x0 && A.x1 == B.x1 &&
+		A.top_y == B.top_y && A.bottom_y == B.bottom_y &&
+		A.top_vector.i == B.top_vector.i && A.top_vector.j == B.top_vector.j &&
+		A.bottom_vector.i == B.bottom_vector.i && A.bottom_vector.j == B.bottom_vector.j;
+}
+
+// Debug mode: rebuild and check that reuse would have given the same result
+void RenderVisTreeClass::validate_cached_tree()
+{
+	NodeList CachedNodes(Nodes);
+	vector<endpoint_clip_data> CachedEndpointClips(EndpointClips);
+	vector<line_clip_data> CachedLineClips(LineClips);
+	
+	build_full_tree();
+	
+	const char *Difference = NULL;
+	if (Nodes.size() != CachedNodes.size())
+		Difference = "node count";
+	else if (!std::equal(Nodes.begin(), Nodes.end(), CachedNodes.begin(), nodes_match))
+		Difference = "nodes";
+	else if (EndpointClips.size() != CachedEndpointClips.size() ||
+			 !std::equal(EndpointClips.begin(), EndpointClips.end(), CachedEndpointClips.begin(), endpoint_clips_match))
+		Difference = "endpoint clips";
+	else if (LineClips.size() != CachedLineClips.size() ||
+			 !std::equal(LineClips.begin(), LineClips.end(), CachedLineClips.begin(), line_clips_match))
+		Difference = "line clips";
+	else if (!std::equal(CachedRenderFlags.begin(), CachedRenderFlags.end(), render_flags))
+		Difference = "render flags";
+	
+	if (Difference)
+		logWarning("reused visibility tree differs from a full rebuild (%s) in polygon %d", Difference, view->origin_polygon_index);
+}
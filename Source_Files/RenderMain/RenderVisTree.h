@@ -188,6 +188,28 @@ class RenderVisTreeClass
 	
 	void ResetLineClips();
 	
+	// Frame-coherent reuse: the tree, clip data and render flags from the last build
+	// are kept as long as the view and the geometry the tree passed through are unchanged
+	struct node_links
+	{
+		node_data *children, *siblings;
+		node_data **reference;
+	};
+	bool cache_valid;
+	view_data CachedView;
+	vector<uint16> CachedRenderFlags;
+	vector<node_links> CachedLinks;
+	// Endpoints transformed by the last build
+	vector<short> VisitedEndpoints;
+	vector<int16> GeometrySignature, SignatureScratch;
+	
+	void calculate_geometry_signature(vector<int16>& Signature);
+	bool cached_tree_matches_view();
+	void cache_tree();
+	void restore_cached_tree();
+	void validate_cached_tree();
+	void build_full_tree();
+	
 public:
 
 	/* gives screen x-coordinates for a map endpoint (only valid if _endpoint_is_visible) */
@@ -227,10 +249,21 @@ public:
 	// the automap.
 	bool add_to_automap;
 	
+	// If true, a tree built for an identical view over unchanged
+	// geometry is reused instead of being rebuilt.
+	bool reuse_previous_tree;
+	
+	// If true, every reuse is checked against a full rebuild
+	// and any difference is logged.
+	bool validate_reuse;
+	
 	// Resizes all the objects defined inside;
-	// the resizing is lazy
+	// the resizing is lazy; this also drops any tree kept for reuse
 	void Resize(size_t NumEndpoints, size_t NumLines);
 	
+	// Forces the next build to be a full one
+	void Invalidate() {cache_valid = false;}
+	
 	// Builds the visibility tree
  	void build_render_tree();
  	
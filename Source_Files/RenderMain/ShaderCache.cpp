@@ -0,0 +1,252 @@
+/*
+ *  ShaderCache.cpp - a persistent cache of linked shader programs
+
+	Copyright (C) 2026 and beyond by the "Aleph One" developers.
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This license is contained in the file "COPYING",
+	which is included with this source code; it is available online at
+	http://www.gnu.org/licenses/gpl.html
+
+ */
+
+#include "cseries.h"
+#include "ShaderCache.h"
+
+#ifdef HAVE_OPENGL
+
+#include "FileHandler.h"
+#include "Logging.h"
+#include "OGL_Headers.h"
+#include "OGL_Setup.h"
+
+// The cache file is a version, the driver the binaries came from, an entry
+// count and the entries, big-endian: key (as two halves), format, binary.
+enum {
+	SHADER_CACHE_VERSION = 1
+};
+
+static const char *shader_cache_name = "Shader Cache";
+
+/* ---------- stream helpers */
+
+static void put_uint32(std::vector<uint8>& out, uint32 value)
+{
+	out.push_back(static_cast<uint8>(value >> 24));
+	out.push_back(static_cast<uint8>(value >> 16));
+	out.push_back(static_cast<uint8>(value >> 8));
+	out.push_back(static_cast<uint8>(value));
+}
+
+static void put_bytes(std::vector<uint8>& out, const uint8* data, size_t length)
+{
+	put_uint32(out, static_cast<uint32>(length));
+	out.insert(out.end(), data, data + length);
+}
+
+// reads fail, rather than overrun, on a short or damaged file
+class cache_reader {
+public:
+	cache_reader(const std::vector<uint8>& data) : m_data(data), m_pos(0) { }
+
+	bool get_uint32(uint32& value)
+	{
+		if (m_data.size() - m_pos < 4)
+			return false;
+		value = (uint32(m_data[m_pos]) << 24) | (uint32(m_data[m_pos + 1]) << 16) |
+			(uint32(m_data[m_pos + 2]) << 8) | uint32(m_data[m_pos + 3]);
+		m_pos += 4;
+		return true;
+	}
+
+	template <typename T>
+	bool get_bytes(T& value)
+	{
+		uint32 length;
+		if (!get_uint32(length) || m_data.size() - m_pos < length)
+			return false;
+		value.assign(m_data.begin() + m_pos, m_data.begin() + m_pos + length);
+		m_pos += length;
+		return true;
+	}
+
+	bool at_end() const { return m_pos == m_data.size(); }
+
+private:
+	const std::vector<uint8>& m_data;
+	size_t m_pos;
+};
+
+static std::string gl_string(GLenum name)
+{
+	const char *value = reinterpret_cast<const char *>(glGetString(name));
+	return value ? value : "";
+}
+
+/* ---------- ShaderCache */
+
+ShaderCache* ShaderCache::instance()
+{
+	static ShaderCache* m_instance = nullptr;
+	if (!m_instance) {
+		m_instance = new ShaderCache;
+	}
+
+	return m_instance;
+}
+
+Uint64 ShaderCache::hash(const std::string& data, Uint64 seed)
+{
+	// FNV-1a
+	Uint64 hash = seed;
+	for (size_t i = 0; i < data.size(); ++i)
+		hash = (hash ^ static_cast<uint8>(data[i])) * 1099511628211ULL;
+	return hash;
+}
+
+void ShaderCache::initialize_cache()
+{
+	FileSpecifier file;
+	file.SetToLocalDataDir();
+	file += shader_cache_name;
+
+	OpenedFile cache;
+	if (!file.Open(cache))
+		return;
+
+	int32 length;
+	if (!cache.GetLength(length))
+		return;
+	std::vector<uint8> data(length);
+	if (length > 0 && !cache.Read(length, &data[0]))
+		return;
+
+	cache_reader reader(data);
+	uint32 version, count;
+	std::string driver;
+	if (!reader.get_uint32(version) || version != SHADER_CACHE_VERSION ||
+		!reader.get_bytes(driver) || !reader.get_uint32(count))
+		return;
+
+	std::map<Uint64, entry> entries;
+	for (uint32 i = 0; i < count; ++i)
+	{
+		uint32 key_high, key_low;
+		entry e;
+		if (!reader.get_uint32(key_high) || !reader.get_uint32(key_low) ||
+			!reader.get_uint32(e.format) || !reader.get_bytes(e.binary))
+		{
+			logWarning("ignoring damaged shader cache %s", file.GetPath());
+			return;
+		}
+
+		entries[(Uint64(key_high) << 32) | key_low] = e;
+	}
+
+	if (reader.at_end())
+	{
+		m_driver.swap(driver);
+		m_entries.swap(entries);
+	}
+}
+
+bool ShaderCache::available()
+{
+	if (!OGL_CheckExtension("GL_ARB_get_program_binary"))
+		return false;
+
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	if (formats <= 0)
+		return false;
+
+	// a new driver won't load the old one's binaries
+	std::string driver = gl_string(GL_VENDOR) + "\n" + gl_string(GL_RENDERER) + "\n" + gl_string(GL_VERSION);
+	if (driver != m_driver)
+	{
+		m_driver = driver;
+		m_entries.clear();
+		m_cache_dirty = true;
+	}
+
+	return true;
+}
+
+bool ShaderCache::find(Uint64 key, uint32& format, std::vector<uint8>& binary)
+{
+	std::map<Uint64, entry>::const_iterator it = m_entries.find(key);
+	if (it == m_entries.end() || it->second.binary.empty())
+		return false;
+
+	format = it->second.format;
+	binary = it->second.binary;
+	return true;
+}
+
+void ShaderCache::store(Uint64 key, uint32 format, const std::vector<uint8>& binary)
+{
+	entry& e = m_entries[key];
+	e.format = format;
+	e.binary = binary;
+	m_cache_dirty = true;
+}
+
+void ShaderCache::drop(Uint64 key)
+{
+	if (m_entries.erase(key))
+		m_cache_dirty = true;
+}
+
+void ShaderCache::save_cache()
+{
+	if (!m_cache_dirty)
+		return;
+
+	std::vector<uint8> data;
+	put_uint32(data, SHADER_CACHE_VERSION);
+	put_bytes(data, reinterpret_cast<const uint8 *>(m_driver.data()), m_driver.size());
+	put_uint32(data, static_cast<uint32>(m_entries.size()));
+	for (std::map<Uint64, entry>::const_iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+	{
+		const entry& e = it->second;
+		put_uint32(data, static_cast<uint32>(it->first >> 32));
+		put_uint32(data, static_cast<uint32>(it->first));
+		put_uint32(data, e.format);
+		put_bytes(data, e.binary.empty() ? NULL : &e.binary[0], e.binary.size());
+	}
+
+	// write to a temporary file first, so a half-written cache is never picked up
+	FileSpecifier file, temporary_file;
+	file.SetToLocalDataDir();
+	file += shader_cache_name;
+	temporary_file.SetTempName(file);
+
+	OpenedFile cache;
+	if (!temporary_file.Create(_typecode_unknown) || !temporary_file.Open(cache, true))
+	{
+		logWarning("unable to write shader cache %s", file.GetPath());
+		return;
+	}
+
+	bool written = cache.Write(static_cast<int32>(data.size()), &data[0]);
+	cache.Close();
+	if (!written || !temporary_file.Rename(file))
+	{
+		logWarning("unable to write shader cache %s", file.GetPath());
+		temporary_file.Delete();
+		return;
+	}
+
+	m_cache_dirty = false;
+}
+
+#endif
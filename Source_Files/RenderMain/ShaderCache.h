@@ -0,0 +1,73 @@
+/*
+ *  ShaderCache.h - a persistent cache of linked shader programs
+
+	Copyright (C) 2026 and beyond by the "Aleph One" developers.
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This license is contained in the file "COPYING",
+	which is included with this source code; it is available online at
+	http://www.gnu.org/licenses/gpl.html
+
+	Every shader is compiled and linked again on each launch and each
+	context reset. Where the driver can hand back the linked program
+	(GL_ARB_get_program_binary), this keeps it, keyed by a hash of the
+	program's source and defines, so the next link is a single upload.
+	Binaries only make sense to the driver that produced them, so the cache
+	is emptied whenever the vendor, renderer or version string changes.
+ */
+
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include "cstypes.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+class ShaderCache {
+public:
+	static ShaderCache* instance();
+
+	// Call this at startup, before any other calls.
+	void initialize_cache();
+
+	// Whether the current context can load program binaries; call with a
+	// context current, before the calls below
+	bool available();
+
+	// A hash of a program's source, to key it by
+	static Uint64 hash(const std::string& data, Uint64 seed = 14695981039346656037ULL);
+
+	// The program linked from this source before, if any
+	bool find(Uint64 key, uint32& format, std::vector<uint8>& binary);
+	void store(Uint64 key, uint32 format, const std::vector<uint8>& binary);
+
+	// Forgets a program the driver would no longer load
+	void drop(Uint64 key);
+
+	void save_cache();
+
+private:
+	ShaderCache() { }
+
+	struct entry {
+		uint32 format;
+		std::vector<uint8> binary;
+	};
+
+	std::string m_driver;
+	std::map<Uint64, entry> m_entries;
+	bool m_cache_dirty = false;
+};
+
+#endif
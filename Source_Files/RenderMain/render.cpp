@@ -238,9 +238,12 @@ extern WindowPtr screen_window;
 #include "Rasterizer_OGL.h"
 #include "RenderRasterize_Shader.h"
 #include "Rasterizer_Shader.h"
+#include "OGL_Textures.h"
 #endif
 #include "preferences.h"
 #include "screen.h"
+#include "ViewControl.h"
+#include "Profiler.h"
 
 /* use native alignment */
 #if defined (powerc) || defined (__powerc)
@@ -322,6 +325,9 @@ static void update_render_effect(struct view_data *view);
 static void shake_view_origin(struct view_data *view, world_distance delta);
 
 static void render_viewer_sprite_layer(view_data *view, RasterizerClass *RasPtr);
+#ifdef HAVE_OPENGL
+static void prefetch_nearby_textures(view_data *view);
+#endif
 void position_sprite_axis(short *x0, short *x1, short scale_width, short screen_width,
 	short positioning_mode, _fixed position, bool flip, world_distance world_left, world_distance world_right);
 
@@ -424,6 +430,7 @@ void render_view(
 	struct view_data *view,
 	struct bitmap_definition *destination)
 {
+	PROFILE_ZONE("render_view");
 	update_view_data(view);
 
 	/* clear the render flags */
@@ -450,7 +457,12 @@ void render_view(
 		// LP: now from the visibility-tree class
 		/* build the render tree, regardless of map mode, so the automap updates while active */
 		RenderVisTree.view = view;
-		RenderVisTree.build_render_tree();
+		RenderVisTree.reuse_previous_tree = View_ReuseVisTree();
+		RenderVisTree.validate_reuse = View_ValidateVisTree();
+		{
+			PROFILE_ZONE("vis_tree");
+			RenderVisTree.build_render_tree();
+		}
 		
 		/* do something complicated and difficult to explain */
 		if (!view->overhead_map_active || map_is_translucent())
@@ -459,12 +471,18 @@ void render_view(
 			/* sort the render tree (so we have a depth-ordering of polygons) and accumulate
 				clipping information for each polygon */
 			RenderSortPoly.view = view;
-			RenderSortPoly.sort_render_tree();
+			{
+				PROFILE_ZONE("sort");
+				RenderSortPoly.sort_render_tree();
+			}
 			
 			// LP: now from the object-placement class
 			/* build the render object list by looking at the sorted render tree */
 			RenderPlaceObjs.view = view;
-			RenderPlaceObjs.build_render_object_list();
+			{
+				PROFILE_ZONE("place_objects");
+				RenderPlaceObjs.build_render_object_list();
+			}
 			
 			// LP addition: set the current rasterizer to whichever is appropriate here
 			RasterizerClass *RasPtr;
@@ -497,7 +515,10 @@ void render_view(
 				it to the texture-mapping code */
 			RenPtr->view = view;
 			RenPtr->RasPtr = RasPtr;
-			RenPtr->render_tree();
+			{
+				PROFILE_ZONE("rasterize");
+				RenPtr->render_tree();
+			}
 			
 			// LP: won't put this into a separate class
 			/* render the players weapons, etc. */
@@ -511,6 +532,7 @@ void render_view(
 
 		if (view->overhead_map_active)
 		{
+			PROFILE_ZONE("overhead_map");
 			/* if the overhead map is active, render it */
 			render_overhead_map(view);
 		}
@@ -933,6 +955,55 @@ void instantiate_polygon_transfer_mode(
 	}
 }
 
+/* load the textures queued for nearby polygons, and unload any over the budget; called once the
+	whole frame has been drawn, since this changes the texture bindings */
+void tick_view_textures(
+	struct view_data *view)
+{
+#ifdef HAVE_OPENGL
+	/* only when the main view was drawn, which is what marks polygons visible */
+	if (OGL_IsActive() && !view->terminal_mode_active && (!view->overhead_map_active || map_is_translucent()))
+	{
+		PROFILE_ZONE("texture_residency");
+		prefetch_nearby_textures(view);
+		OGL_FrameTickTextures();
+	}
+#endif
+}
+
+#ifdef HAVE_OPENGL
+/* ---------- texture prefetch */
+
+enum {
+	TEXTURE_PREFETCH_RADIUS= 8*WORLD_ONE /* how far around the viewer to load wall textures ahead of time */
+};
+
+/* queue the textures of the polygons around the viewer which the visibility tree didn't reach,
+	so they're loaded before the viewer turns towards them */
+static void prefetch_nearby_textures(
+	struct view_data *view)
+{
+	static short last_polygon_index= NONE;
+	static vector<short> nearby_polygons;
+
+	if (view->origin_polygon_index==NONE || view->origin_polygon_index==last_polygon_index) return;
+	last_polygon_index= view->origin_polygon_index;
+
+	world_point2d origin= {view->origin.x, view->origin.y};
+	find_polygons_within_radius(view->origin_polygon_index, &origin, TEXTURE_PREFETCH_RADIUS, nearby_polygons);
+
+	/* the visible ones were just drawn */
+	size_t count= 0;
+	for (size_t i= 0; i<nearby_polygons.size(); ++i)
+	{
+		if (!TEST_RENDER_FLAG(nearby_polygons[i], _polygon_is_visible)) nearby_polygons[count++]= nearby_polygons[i];
+	}
+	nearby_polygons.resize(count);
+
+	OGL_PrefetchTextures(nearby_polygons);
+}
+#endif
+
 /* ---------- viewer sprite layer (i.e., weapons) */
 
 static void render_viewer_sprite_layer(view_data *view, RasterizerClass *RasPtr)
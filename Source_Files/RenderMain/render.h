@@ -183,6 +183,7 @@ void allocate_render_memory(void);
 
 void initialize_view_data(struct view_data *view, bool ignore_preferences = false);
 void render_view(struct view_data *view, struct bitmap_definition *destination);
+void tick_view_textures(struct view_data *view);
 
 void start_render_effect(struct view_data *view, short effect);
 
@@ -49,6 +49,9 @@ struct view_settings_definition {
 	bool DoStaticEffect;
 	bool DoInterlevelTeleportInEffects;
 	bool DoInterlevelTeleportOutEffects;
+	bool ReuseVisTree;
+	bool ValidateVisTree;
+	bool InterpolateWorld;
 };
 
 // Defaults:
@@ -57,7 +60,10 @@ struct view_settings_definition view_settings = {
 	true, // do the view folding effect (stretch horizontally, squeeze vertically) when teleporting,
 	true,  // also do the static effect / folding effect on viewed teleported objects
 	true, // do all effects (and sounds) teleporting into the level
-	true  // do all effects (and sounds) teleporting out of the level
+	true, // do all effects (and sounds) teleporting out of the level
+	true, // reuse the visibility tree while the view stays put
+	false, // don't check reused visibility trees against a rebuild
+	false // draw only once per world tick
 };
 
 // Accessors:
@@ -66,6 +72,9 @@ bool View_DoFoldEffect() {return view_settings.DoFoldEffect;}
 bool View_DoStaticEffect() {return view_settings.DoStaticEffect;}
 bool View_DoInterlevelTeleportInEffects() { return view_settings.DoInterlevelTeleportInEffects; }
 bool View_DoInterlevelTeleportOutEffects() { return view_settings.DoInterlevelTeleportOutEffects; }
+bool View_ReuseVisTree() { return view_settings.ReuseVisTree; }
+bool View_ValidateVisTree() { return view_settings.ValidateVisTree; }
+bool View_InterpolateWorld() { return view_settings.InterpolateWorld; }
 
 
 // This frame value means that a landscape option will be applied to any frame in a collection:
@@ -255,6 +264,9 @@ void parse_mml_view(const InfoTree& root)
 	root.read_attr("static_effect", view_settings.DoStaticEffect);
 	root.read_attr("interlevel_in_effects", view_settings.DoInterlevelTeleportInEffects);
 	root.read_attr("interlevel_out_effects", view_settings.DoInterlevelTeleportOutEffects);
+	root.read_attr("reuse_vis_tree", view_settings.ReuseVisTree);
+	root.read_attr("validate_vis_tree", view_settings.ValidateVisTree);
+	root.read_attr("interpolate_world", view_settings.InterpolateWorld);
 	
 	BOOST_FOREACH(InfoTree font, root.children_named("font"))
 	{
@@ -73,6 +73,15 @@ bool View_DoInterlevelTeleportInEffects();
 // Indicates whether to skip all teleport effects teleporting out of a level
 bool View_DoInterlevelTeleportOutEffects();
 
+// Indicates whether to reuse the last frame's visibility tree when nothing it depends on has changed
+bool View_ReuseVisTree();
+
+// Indicates whether to check each reused visibility tree against a full rebuild (for debugging)
+bool View_ValidateVisTree();
+
+// Indicates whether to draw frames between world ticks, with the world interpolated
+bool View_InterpolateWorld();
+
 // Gets the on-screen-display font
 FontSpecifier& GetOnScreenFont();
 
@@ -53,6 +53,7 @@
 #include "preferences.h"
 #include "computer_interface.h"
 #include "Crosshairs.h"
+#include "DynamicResolution.h"
 #include "OGL_Render.h"
 #include "ViewControl.h"
 #include "screen_drawing.h"
@@ -70,6 +71,11 @@
 #include "Movie.h"
 
 #include <algorithm>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #if defined(__WIN32__) || (defined(__MACH__) && defined(__APPLE__))
 #define MUST_RELOAD_VIEW_CONTEXT
@@ -80,6 +86,7 @@ static SDL_Surface *main_surface;	// Main (display) surface
 static SDL_Window *main_screen;
 static SDL_Renderer *main_render;
 static SDL_Texture *main_texture;
+static bool main_texture_is_stale = true;	// its contents predate main_surface's
 
 // Rendering buffer for the main view, the overhead map, and the terminals.
 // The HUD has a separate buffer.
@@ -138,6 +145,7 @@ static void apply_gamma(SDL_Surface *src, SDL_Surface *dst);
 static void update_screen(SDL_Rect &source, SDL_Rect &destination, bool hi_rez);
 static void update_fps_display(SDL_Surface *s);
 static void DisplayPosition(SDL_Surface *s);
+static void DisplayProfile(SDL_Surface *s);
 static void DisplayMessages(SDL_Surface *s);
 static void DisplayNetMicStatus(SDL_Surface *s);
 static void DrawSurface(SDL_Surface *s, SDL_Rect &dest_rect, SDL_Rect &src_rect);
@@ -1046,12 +1054,15 @@ static void change_screen_mode(int width, int height, int depth, bool nogl, bool
 			SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
 			SDL_RenderSetLogicalSize(main_render, vmode_width, vmode_height);
 			main_texture = SDL_CreateTexture(main_render, pixel_format_32.format, SDL_TEXTUREACCESS_STREAMING, vmode_width, vmode_height);
+			main_texture_is_stale = true;
 		} else if (!main_texture) {
 			main_texture = SDL_CreateTexture(main_render, pixel_format_32.format, SDL_TEXTUREACCESS_STREAMING, vmode_width, vmode_height);
+			main_texture_is_stale = true;
 		}
 	}
 	if (!main_surface) {
 		main_surface = SDL_CreateRGBSurface(SDL_SWSURFACE, vmode_width, vmode_height, 32, pixel_format_32.Rmask, pixel_format_32.Gmask, pixel_format_32.Bmask, 0);
+		main_texture_is_stale = true;
 	}
 #ifdef MUST_RELOAD_VIEW_CONTEXT
 	if (!nogl && screen_mode.acceleration != _no_acceleration) 
@@ -1327,6 +1338,16 @@ void render_screen(short ticks_elapsed)
 		BufferRect.h >>= 1;
 	}
 
+	// Dynamic resolution shrinks it further when the view is slow to draw;
+	// the shader renderer does the same with its own buffers
+	if (ViewChangedSize)
+		DynamicResolution::instance()->reset();
+	if (screen_mode.acceleration == _no_acceleration && bit_depth > 8) {
+		float scale = DynamicResolution::instance()->scale();
+		BufferRect.w = std::max(1, static_cast<int>(BufferRect.w * scale));
+		BufferRect.h = std::max(1, static_cast<int>(BufferRect.h * scale));
+	}
+
 	// Set up view data appropriately
 	world_view->screen_width = BufferRect.w;
 	world_view->screen_height = BufferRect.h;
@@ -1358,6 +1379,10 @@ void render_screen(short ticks_elapsed)
 		clear_next_screen = false;
 	}
 
+	// A new scale only needs a new buffer
+	if (!ViewChangedSize && (world_pixels->w != BufferRect.w || world_pixels->h != BufferRect.h))
+		reallocate_world_pixels(BufferRect.w, BufferRect.h);
+
 	switch (screen_mode.acceleration) {
 		case _opengl_acceleration:
 			// If we're using the overhead map, fall through to no acceleration
@@ -1410,6 +1435,7 @@ void render_screen(short ticks_elapsed)
         clear_screen_margin();
     
 	// Render world view
+	Uint64 view_start = SDL_GetPerformanceCounter();
 	render_view(world_view, world_pixels_structure);
 
     // clear Lua drawing from previous frame
@@ -1440,6 +1466,7 @@ void render_screen(short ticks_elapsed)
 	  DisplayPosition(disp_pixels);
 	  DisplayNetMicStatus(disp_pixels);
 	  DisplayScores(disp_pixels);
+	  DisplayProfile(disp_pixels);
 	}
 	DisplayMessages(disp_pixels);
 	DisplayInputLine(disp_pixels);
@@ -1456,6 +1483,7 @@ void render_screen(short ticks_elapsed)
 	if (screen_mode.acceleration != _no_acceleration) {
 #ifdef HAVE_OPENGL
 		if (Screen::instance()->hud()) {
+			PROFILE_ZONE("hud");
 			if (Screen::instance()->lua_hud())
 				Lua_DrawHUD(ticks_elapsed);
 			else {
@@ -1477,26 +1505,42 @@ void render_screen(short ticks_elapsed)
 
 #endif
 	} else {
+		// Only what was drawn this frame goes to the screen; an unchanged
+		// HUD or terminal stays in the screen texture from earlier frames
+		SDL_Rect dirty_rects[4];
+		size_t dirty_rect_count = 0;
+
 		// Update world window
 		if (!world_view->terminal_mode_active &&
 			(!world_view->overhead_map_active || MapIsTranslucent))
+		{
 			update_screen(BufferRect, ViewRect, HighResolution);
+			dirty_rects[dirty_rect_count++] = ViewRect;
+
+			if (!world_view->overhead_map_active)
+				DynamicResolution::instance()->report_frame_time(
+					(SDL_GetPerformanceCounter() - view_start) * 1000.0f / SDL_GetPerformanceFrequency());
+		}
 		
 		// Update map
 		if (world_view->overhead_map_active) {
 			SDL_Rect src_rect = { 0, 0, MapRect.w, MapRect.h };
 			DrawSurface(Map_Buffer, MapRect, src_rect);
+			dirty_rects[dirty_rect_count++] = MapRect;
 		}
 		
 		// Update HUD
 		if (Screen::instance()->lua_hud())
 		{
+			PROFILE_ZONE("hud");
 			Lua_DrawHUD(ticks_elapsed);
 		}
 		else if (HUD_RenderRequest) {
+			PROFILE_ZONE("hud");
 			SDL_Rect src_rect = { 0, 320, 640, 160 };
 			DrawSurface(HUD_Buffer, HUD_DestRect, src_rect);
 			HUD_RenderRequest = false;
+			dirty_rects[dirty_rect_count++] = HUD_DestRect;
 		}
 
 		// Update terminal
@@ -1505,6 +1549,7 @@ void render_screen(short ticks_elapsed)
 				SDL_Rect src_rect = { 0, 0, Term_Buffer->w, Term_Buffer->h };
 				DrawSurface(Term_Buffer, TermRect, src_rect);
 				Term_RenderRequest = false;
+				dirty_rects[dirty_rect_count++] = TermRect;
 			}
 		}
 
@@ -1512,17 +1557,21 @@ void render_screen(short ticks_elapsed)
 		{
 			MainScreenUpdateRect(0, 0, 0, 0);
 		}
-		else if ((!world_view->overhead_map_active || MapIsTranslucent) &&
-				 !world_view->terminal_mode_active)
+		else if (dirty_rect_count)
 		{
-			MainScreenUpdateRects(1, &ViewRect);
+			MainScreenUpdateRects(dirty_rect_count, dirty_rects);
 		}
 	}
 
 #ifdef HAVE_OPENGL
-	// Swap OpenGL double-buffers
 	if (screen_mode.acceleration != _no_acceleration)
+	{
+		// Texture loading and unloading waits until the view and HUD are drawn
+		tick_view_textures(world_view);
+		
+		// Swap OpenGL double-buffers
 		OGL_SwapBuffers();
+	}
 #endif
 	
 	Movie::instance()->AddFrame(Movie::FRAME_NORMAL);
@@ -1618,10 +1667,227 @@ static inline bool pixel_formats_equal(SDL_PixelFormat* a, SDL_PixelFormat* b)
 		a->Bmask == b->Bmask);
 }
 
+/*
+ *  Gamma correction, pixel doubling and conversion to the screen's format in
+ *  one pass from the world view straight to the screen, for 16- and 32-bit
+ *  views; the screen surface is always 32-bit
+ */
+
+struct present_tables
+{
+	// a source channel's raw value to the destination's bits for it
+	uint32 r[256], g[256], b[256];
+	uint32 rmask, gmask, bmask;
+	uint32 rshift, gshift, bshift;
+};
+
+static void build_present_channel(uint32 *table, int loss, uint32 dst_loss, uint32 dst_shift, uint32 dst_mask,
+	const uint16 *gamma)
+{
+	int max = 255 >> loss;
+	for (int v = 0; v <= max; ++v)
+	{
+		// expand as SDL's blitter does, or index the gamma table as apply_gamma() does
+		uint8 c = gamma ? (gamma[(v << loss) & 0xff] >> 8) : static_cast<uint8>((v * 255 + max / 2) / max);
+		table[v] = ((c >> dst_loss) << dst_shift) & dst_mask;
+	}
+}
+
+static void build_present_tables(const SDL_PixelFormat *src, const SDL_PixelFormat *dst, bool gamma, present_tables &tables)
+{
+	build_present_channel(tables.r, src->Rloss, dst->Rloss, dst->Rshift, dst->Rmask, gamma ? current_gamma_r : NULL);
+	build_present_channel(tables.g, src->Gloss, dst->Gloss, dst->Gshift, dst->Gmask, gamma ? current_gamma_g : NULL);
+	build_present_channel(tables.b, src->Bloss, dst->Bloss, dst->Bshift, dst->Bmask, gamma ? current_gamma_b : NULL);
+	tables.rmask = src->Rmask; tables.gmask = src->Gmask; tables.bmask = src->Bmask;
+	tables.rshift = src->Rshift; tables.gshift = src->Gshift; tables.bshift = src->Bshift;
+}
+
+template <class T>
+static inline uint32 present_pixel(T px, const present_tables &tables)
+{
+	return tables.r[(px & tables.rmask) >> tables.rshift] |
+		tables.g[(px & tables.gmask) >> tables.gshift] |
+		tables.b[(px & tables.bmask) >> tables.bshift];
+}
+
+// identity is set when the source is already in the screen's format and needs no gamma
+template <class T, bool identity>
+static void present_rows(const SDL_Surface *src, SDL_Surface *dst, int x0, int y0, int width, int height, int scale,
+	const present_tables &tables)
+{
+	for (int y = 0; y < height; ++y)
+	{
+		const T *s = reinterpret_cast<const T *>(static_cast<const uint8 *>(src->pixels) + y * src->pitch);
+		uint32 *d = reinterpret_cast<uint32 *>(static_cast<uint8 *>(dst->pixels) + (y0 + y * scale) * dst->pitch) + x0;
+
+		if (scale == 1)
+		{
+			if (identity)
+				memcpy(d, s, width * sizeof(uint32));
+			else
+				for (int x = 0; x < width; ++x)
+					d[x] = present_pixel(s[x], tables);
+			continue;
+		}
+
+		uint32 *d2 = d + dst->pitch / sizeof(uint32);
+		int x = 0;
+#ifdef __SSE2__
+		for (; x + 4 <= width; x += 4)
+		{
+			__m128i p;
+			if (identity)
+				p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + x));
+			else
+				p = _mm_set_epi32(present_pixel(s[x + 3], tables), present_pixel(s[x + 2], tables),
+					present_pixel(s[x + 1], tables), present_pixel(s[x], tables));
+			__m128i lo = _mm_unpacklo_epi32(p, p);
+			__m128i hi = _mm_unpackhi_epi32(p, p);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(d + 2 * x), lo);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(d + 2 * x + 4), hi);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(d2 + 2 * x), lo);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(d2 + 2 * x + 4), hi);
+		}
+#endif
+		for (; x < width; ++x)
+		{
+			uint32 p = identity ? static_cast<uint32>(s[x]) : present_pixel(s[x], tables);
+			d[x * 2] = d[x * 2 + 1] = p;
+			d2[x * 2] = d2[x * 2 + 1] = p;
+		}
+	}
+}
+
+// false if the fused path can't handle these surfaces
+static bool present_world_pixels(SDL_Surface *src, SDL_Surface *dst, const SDL_Rect &destination, int scale, bool gamma)
+{
+	int sbpp = src->format->BytesPerPixel;
+	if ((sbpp != 2 && sbpp != 4) || dst->format->BytesPerPixel != 4 ||
+		destination.x < 0 || destination.y < 0)
+		return false;
+
+	int width = (scale == 1) ? src->w : destination.w / 2;
+	int height = (scale == 1) ? src->h : destination.h / 2;
+	width = std::min(std::min(width, src->w), (dst->w - destination.x) / scale);
+	height = std::min(std::min(height, src->h), (dst->h - destination.y) / scale);
+	if (width <= 0 || height <= 0)
+		return true;
+
+	if (SDL_MUSTLOCK(dst) && SDL_LockSurface(dst) < 0)
+		return true;
+
+	present_tables tables;
+	bool identity = !gamma && pixel_formats_equal(src->format, dst->format);
+	if (!identity)
+		build_present_tables(src->format, dst->format, gamma, tables);
+
+	if (sbpp == 2)
+		present_rows<uint16, false>(src, dst, destination.x, destination.y, width, height, scale, tables);
+	else if (identity)
+		present_rows<uint32, true>(src, dst, destination.x, destination.y, width, height, scale, tables);
+	else
+		present_rows<uint32, false>(src, dst, destination.x, destination.y, width, height, scale, tables);
+
+	if (SDL_MUSTLOCK(dst))
+		SDL_UnlockSurface(dst);
+	return true;
+}
+
+/*
+ *  The same for a view drawn at a fractional scale by dynamic resolution,
+ *  stretched over the destination by nearest neighbour
+ */
+
+template <class T, bool identity>
+static void stretch_rows(const SDL_Surface *src, SDL_Surface *dst, int x0, int y0, int width, int height,
+	const SDL_Rect &destination, const std::vector<int> &columns, const present_tables &tables)
+{
+	const T *previous_s = NULL;
+	const uint32 *previous_d = NULL;
+	for (int y = 0; y < height; ++y)
+	{
+		int sy = ((2 * y + 1) * src->h) / (2 * destination.h);
+		const T *s = reinterpret_cast<const T *>(static_cast<const uint8 *>(src->pixels) + sy * src->pitch);
+		uint32 *d = reinterpret_cast<uint32 *>(static_cast<uint8 *>(dst->pixels) + (y0 + y) * dst->pitch) + x0;
+
+		// rows stretched from the same source row are copies of the first
+		if (s == previous_s)
+		{
+			memcpy(d, previous_d, width * sizeof(uint32));
+			continue;
+		}
+
+		for (int x = 0; x < width; ++x)
+			d[x] = identity ? static_cast<uint32>(s[columns[x]]) : present_pixel(s[columns[x]], tables);
+		previous_s = s;
+		previous_d = d;
+	}
+}
+
+// false if the fused path can't handle these surfaces
+static bool stretch_world_pixels(SDL_Surface *src, SDL_Surface *dst, const SDL_Rect &destination, bool gamma)
+{
+	int sbpp = src->format->BytesPerPixel;
+	if ((sbpp != 2 && sbpp != 4) || dst->format->BytesPerPixel != 4 ||
+		destination.x < 0 || destination.y < 0)
+		return false;
+
+	int width = std::min<int>(destination.w, dst->w - destination.x);
+	int height = std::min<int>(destination.h, dst->h - destination.y);
+	if (width <= 0 || height <= 0)
+		return true;
+
+	static std::vector<int> columns;
+	columns.resize(width);
+	for (int x = 0; x < width; ++x)
+		columns[x] = ((2 * x + 1) * src->w) / (2 * destination.w);
+
+	if (SDL_MUSTLOCK(dst) && SDL_LockSurface(dst) < 0)
+		return true;
+
+	present_tables tables;
+	bool identity = !gamma && pixel_formats_equal(src->format, dst->format);
+	if (!identity)
+		build_present_tables(src->format, dst->format, gamma, tables);
+
+	if (sbpp == 2)
+		stretch_rows<uint16, false>(src, dst, destination.x, destination.y, width, height, destination, columns, tables);
+	else if (identity)
+		stretch_rows<uint32, true>(src, dst, destination.x, destination.y, width, height, destination, columns, tables);
+	else
+		stretch_rows<uint32, false>(src, dst, destination.x, destination.y, width, height, destination, columns, tables);
+
+	if (SDL_MUSTLOCK(dst))
+		SDL_UnlockSurface(dst);
+	return true;
+}
+
 static void update_screen(SDL_Rect &source, SDL_Rect &destination, bool hi_rez)
 {
+	bool gamma = !using_default_gamma && bit_depth > 8;
+	int scale = hi_rez ? 1 : 2;
+	if (source.w != destination.w / scale || source.h != destination.h / scale)
+	{
+		// only views of more than 8 bits are drawn at other scales
+		if (!stretch_world_pixels(world_pixels, main_surface, destination, gamma))
+		{
+			SDL_Surface *s = world_pixels;
+			if (gamma) {
+				apply_gamma(world_pixels, world_pixels_corrected);
+				s = world_pixels_corrected;
+			}
+			SDL_Rect stretched = destination;
+			SDL_BlitScaled(s, NULL, main_surface, &stretched);
+		}
+		return;
+	}
+
+	if (present_world_pixels(world_pixels, main_surface, destination, scale, gamma))
+		return;
+
+	// 8-bit views still go through SDL's palette conversion
 	SDL_Surface *s = world_pixels;
-	if (!using_default_gamma && bit_depth > 8) {
+	if (gamma) {
 		apply_gamma(world_pixels, world_pixels_corrected);
 		s = world_pixels_corrected;
 	}
@@ -2177,7 +2443,31 @@ void MainScreenUpdateRect(int x, int y, int w, int h)
 }
 void MainScreenUpdateRects(size_t count, const SDL_Rect *rects)
 {
-	SDL_UpdateTexture(main_texture, NULL, main_surface->pixels, main_surface->pitch);
+	// upload only the changed parts; the streaming texture keeps the rest.
+	// As with SDL 1.2's SDL_UpdateRect(), an empty rect means everything
+	bool full = main_texture_is_stale;
+	for (size_t i = 0; i < count && !full; ++i)
+		full = rects[i].w == 0 && rects[i].h == 0;
+
+	if (full)
+	{
+		SDL_UpdateTexture(main_texture, NULL, main_surface->pixels, main_surface->pitch);
+		main_texture_is_stale = false;
+	}
+	else
+	{
+		SDL_Rect bounds = { 0, 0, main_surface->w, main_surface->h };
+		for (size_t i = 0; i < count; ++i)
+		{
+			SDL_Rect r;
+			if (!SDL_IntersectRect(&rects[i], &bounds, &r))
+				continue;
+			const uint8 *pixels = static_cast<const uint8 *>(main_surface->pixels) +
+				r.y * main_surface->pitch + r.x * main_surface->format->BytesPerPixel;
+			SDL_UpdateTexture(main_texture, &r, pixels, main_surface->pitch);
+		}
+	}
+
 	SDL_RenderClear(main_render);
 	SDL_RenderCopy(main_render, main_texture, NULL, NULL);
 //	for (size_t i = 0; i < count; ++i) {
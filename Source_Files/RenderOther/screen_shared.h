@@ -58,6 +58,7 @@ extern SDL_Surface *world_pixels;
 #include "screen_drawing.h"
 
 #include "network_games.h"
+#include "Profiler.h"
 #include "Image_Blitter.h"
 #include "OGL_Blitter.h"
 
@@ -571,6 +572,47 @@ static void DisplayPosition(SDL_Surface *s)
 	
 }
 
+static void DisplayProfile(SDL_Surface *s)
+{
+	if (!Profiler::instance()->OverlayVisible()) return;
+
+	static std::vector<Profiler::ReportLine> lines;
+	Profiler::instance()->Report(lines);
+
+	static std::vector<Profiler::CounterLine> counters;
+	Profiler::instance()->ReportCounters(counters);
+
+	FontSpecifier& Font = GetOnScreenFont();
+
+	DisplayTextDest = s;
+	DisplayTextFont = Font.Info;
+	DisplayTextStyle = Font.Style;
+
+	short LineSpacing = Font.LineSpacing;
+	short Indent = DisplayTextWidth("  ");
+	short NameWidth = DisplayTextWidth("place_objects      ");
+	short TimeWidth = DisplayTextWidth("000.00 ms");
+	short X = s->w - NameWidth - TimeWidth - LineSpacing/3 - 4*Indent;
+	short Y = LineSpacing;
+	for (size_t i = 0; i < lines.size(); ++i)
+	{
+		DisplayText(X + lines[i].depth * Indent, Y, lines[i].name);
+
+		sprintf(temporary, "%.2f ms", lines[i].milliseconds);
+		DisplayText(s->w - LineSpacing/3 - DisplayTextWidth(temporary), Y, temporary);
+		Y += LineSpacing;
+	}
+
+	for (size_t i = 0; i < counters.size(); ++i)
+	{
+		DisplayText(X, Y, counters[i].name);
+
+		sprintf(temporary, "%d", counters[i].count);
+		DisplayText(s->w - LineSpacing/3 - DisplayTextWidth(temporary), Y, temporary);
+		Y += LineSpacing;
+	}
+}
+
 static void DisplayInputLine(SDL_Surface *s)
 {
   if (Console::instance()->input_active() && 
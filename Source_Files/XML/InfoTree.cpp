@@ -123,7 +123,7 @@ void InfoTree::save_ini(std::ostringstream& stream) const
 									boost::property_tree::ptree(*this));
 }
 
-bool InfoTree::read_fixed(std::string path, _fixed& value, float min, float max) const
+bool InfoTree::read_fixed(const std::string& path, _fixed& value, float min, float max) const
 {
 	float temp;
 	if (read_attr_bounded(path, temp, min, max))
@@ -134,7 +134,7 @@ bool InfoTree::read_fixed(std::string path, _fixed& value, float min, float max)
 	return false;
 }
 
-bool InfoTree::read_wu(std::string path, short& value, float min, float max) const
+bool InfoTree::read_wu(const std::string& path, short& value, float min, float max) const
 {
 	float temp;
 	if (read_attr_bounded(path, temp, min, max))
@@ -145,7 +145,7 @@ bool InfoTree::read_wu(std::string path, short& value, float min, float max) con
 	return false;
 }
 
-bool InfoTree::read_angle(std::string path, angle& value) const
+bool InfoTree::read_angle(const std::string& path, angle& value) const
 {
 	float temp;
 	if (read_attr(path, temp))
@@ -161,7 +161,7 @@ bool InfoTree::read_angle(std::string path, angle& value) const
 	return false;
 }
 
-bool InfoTree::read_path(std::string key, FileSpecifier& file) const
+bool InfoTree::read_path(const std::string& key, FileSpecifier& file) const
 {
 	std::string path;
 	if (read_attr(key, path))
@@ -172,7 +172,7 @@ bool InfoTree::read_path(std::string key, FileSpecifier& file) const
 	return false;
 }
 
-bool InfoTree::read_path(std::string key, char *dest) const
+bool InfoTree::read_path(const std::string& key, char *dest) const
 {
 	std::string path;
 	if (read_attr(key, path))
@@ -190,7 +190,7 @@ void InfoTree::put_attr_path(std::string key, std::string filepath)
 	put_attr(key, tempstr);
 }
 
-bool InfoTree::read_cstr(std::string key, char *dest, int maxlen) const
+bool InfoTree::read_cstr(const std::string& key, char *dest, int maxlen) const
 {
 	std::string str;
 	if (read_attr(key, str))
@@ -345,7 +345,7 @@ bool InfoTree::read_font(FontSpecifier& font) const
 
 typedef boost::iterator_range<InfoTree::const_assoc_iterator> _match_range_type;
 
-InfoTree::const_child_range InfoTree::children_named(std::string key) const
+InfoTree::const_child_range InfoTree::children_named(const std::string& key) const
 {
 	std::pair<const_assoc_iterator, const_assoc_iterator> matches = equal_range(key);
 	_match_range_type match_range = boost::make_iterator_range(matches.first, matches.second);
@@ -60,21 +60,18 @@ public:
 	void save_ini(FileSpecifier filename) const;
 	void save_ini(std::ostringstream& stream) const;
 
-	template<typename T> bool read(std::string path, T& value) const
+	template<typename T> bool read(const std::string& path, T& value) const
 	{
-		try {
-			value = get_child(path).get_value<T>();
-			return true;
-		} catch (path_error ep) {} catch (data_error ed) {}
-		return false;
+		return read_value(*this, path, value);
 	}
 
-	template<typename T> bool read_attr(std::string path, T& value) const
+	template<typename T> bool read_attr(const std::string& path, T& value) const
 	{
-		return read(std::string("<xmlattr>.") + path, value);
+		const_assoc_iterator attributes = find(attributes_key());
+		return attributes != not_found() && read_value(attributes->second, path, value);
 	}
 
-	template<typename T> bool read_attr_bounded(std::string path, T& value, const T min, const T max) const
+	template<typename T> bool read_attr_bounded(const std::string& path, T& value, const T min, const T max) const
 	{
 		T temp;
 		if (read_attr(path, temp) && temp >= min && temp <= max)
@@ -85,7 +82,7 @@ public:
 		return false;
 	}
 	
-	bool read_indexed(std::string path, int16& value, int num_slots, bool allow_none = false) const
+	bool read_indexed(const std::string& path, int16& value, int num_slots, bool allow_none = false) const
 	{
 		return read_attr_bounded<int16>(path, value, (allow_none ? NONE : 0), num_slots - 1);
 	}
@@ -101,12 +98,12 @@ public:
 	bool read_damage(damage_definition& definition) const;
 	bool read_font(FontSpecifier& font) const;
 	
-	bool read_path(std::string key, FileSpecifier& file) const;
-	bool read_path(std::string key, char *dest) const;
-	bool read_cstr(std::string key, char *dest, int maxlen) const;
-	bool read_fixed(std::string key, _fixed& value, float min = -SHRT_MAX, float max = SHRT_MAX) const;
-	bool read_wu(std::string key, short& value, float min = -64, float max = 64) const;
-	bool read_angle(std::string key, angle& value) const;
+	bool read_path(const std::string& key, FileSpecifier& file) const;
+	bool read_path(const std::string& key, char *dest) const;
+	bool read_cstr(const std::string& key, char *dest, int maxlen) const;
+	bool read_fixed(const std::string& key, _fixed& value, float min = -SHRT_MAX, float max = SHRT_MAX) const;
+	bool read_wu(const std::string& key, short& value, float min = -64, float max = 64) const;
+	bool read_angle(const std::string& key, angle& value) const;
 	
 	void add_color(std::string path, const RGBColor& color);
 	void add_color(std::string path, const RGBColor& color, size_t index);
@@ -118,7 +115,29 @@ public:
 	void put_attr_cstr(std::string path, std::string cstr);
 	
 	typedef boost::any_range<const InfoTree, boost::forward_traversal_tag, const InfoTree, std::ptrdiff_t> const_child_range;
-	const_child_range children_named(std::string key) const;
+	const_child_range children_named(const std::string& key) const;
+
+private:
+	// Most elements leave out most of the attributes a parser asks for,
+	// so misses are looked up without throwing, and attributes by key
+	// rather than by a path built for each lookup
+	static const key_type& attributes_key()
+	{
+		static const key_type key("<xmlattr>");
+		return key;
+	}
+
+	template<typename T> static bool read_value(const boost::property_tree::ptree& tree, const std::string& path, T& value)
+	{
+		boost::optional<const boost::property_tree::ptree&> child = tree.get_child_optional(path);
+		if (!child)
+			return false;
+		boost::optional<T> result = child->get_value_optional<T>();
+		if (!result)
+			return false;
+		value = *result;
+		return true;
+	}
 };
 
 #endif
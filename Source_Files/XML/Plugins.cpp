@@ -32,6 +32,7 @@
 #include "preferences.h"
 #include "InfoTree.h"
 #include "XML_ParseTreeRoot.h"
+#include "XMLCache.h"
 #include "Scenario.h"
 
 #ifdef HAVE_ZZIP
@@ -44,11 +45,20 @@ namespace algo = boost::algorithm;
 
 class PluginLoader {
 public:
-	PluginLoader() { }
+	PluginLoader() : m_archive_names(NULL) { }
 	~PluginLoader() { }
 	
-	bool ParsePlugin(FileSpecifier& file);
+	// size and date are those of the file, or of the zip archive it's in
+	bool ParsePlugin(FileSpecifier& file, int32 size, TimeType date);
 	bool ParseDirectory(FileSpecifier& dir);
+
+private:
+	bool FileExists(const Plugin& Data, const std::string& Path);
+
+	// while parsing a zipped plugin: the archive's sorted file list, and
+	// where its contents appear to be
+	const std::vector<std::string>* m_archive_names;
+	std::string m_archive_root;
 };
 
 bool Plugin::compatible() const {
@@ -108,18 +118,20 @@ void Plugins::disable(const std::string& path) {
 static void load_mmls(const Plugin& plugin) 
 {
 	ScopedSearchPath ssp(plugin.directory);
+	std::vector<FileSpecifier> files;
 	for (std::vector<std::string>::const_iterator it = plugin.mmls.begin(); it != plugin.mmls.end(); ++it) 
 	{
 		FileSpecifier file;
 		if (file.SetNameWithPath(it->c_str()))
 		{
-			ParseMMLFromFile(file);
+			files.push_back(file);
 		}
 		else
 		{
 			logWarning("%s Plugin: %s not found; ignoring", plugin.name.c_str(), it->c_str());
 		}
 	}
+	ParseMMLFromFiles(files);
 }
 
 void Plugins::load_mml() {
@@ -229,23 +241,43 @@ const Plugin* Plugins::find_theme()
 	return 0;
 }
 
-static bool plugin_file_exists(const Plugin& Data, std::string Path)
+bool PluginLoader::FileExists(const Plugin& Data, const std::string& Path)
 {
 	FileSpecifier f = Data.directory + Path;
+
+	// looking inside a zip archive is slow; check its file list first
+	if (m_archive_names)
+	{
+		std::string path = f.GetPath();
+		if (path.size() > m_archive_root.size() + 1 && path.compare(0, m_archive_root.size(), m_archive_root) == 0)
+		{
+			std::string name = path.substr(m_archive_root.size() + 1);
+			std::replace(name.begin(), name.end(), '\\', '/');
+			if (std::binary_search(m_archive_names->begin(), m_archive_names->end(), name))
+				return true;
+		}
+	}
+	
 	return f.Exists();
 }
 
-bool PluginLoader::ParsePlugin(FileSpecifier& file_name)
+bool PluginLoader::ParsePlugin(FileSpecifier& file_name, int32 size, TimeType date)
 {
+	InfoTree manifest;
+	bool cached = XMLCache::instance()->find_tree(file_name.GetPath(), size, date, manifest);
+	
 	OpenedFile file;
-	if (file_name.Open(file)) 
+	if (cached || file_name.Open(file)) 
 	{
-		int32 data_size;
-		file.GetLength(data_size);
+		int32 data_size = 0;
 		std::vector<char> file_data;
-		file_data.resize(data_size);
+		if (!cached)
+		{
+			file.GetLength(data_size);
+			file_data.resize(data_size);
+		}
 
-		if (file.Read(data_size, &file_data[0]))
+		if (cached || file.Read(data_size, &file_data[0]))
 		{
 			DirectorySpecifier current_plugin_directory;
 			file_name.ToDirectory(current_plugin_directory);
@@ -253,10 +285,15 @@ bool PluginLoader::ParsePlugin(FileSpecifier& file_name)
 			char name[256];
 			current_plugin_directory.GetName(name);
 			
-			std::istringstream strm(std::string(file_data.begin(), file_data.end()));
 			try {
-				InfoTree root = InfoTree::load_xml(strm).get_child("plugin");
-				
+				if (!cached)
+				{
+					std::istringstream strm(std::string(file_data.begin(), file_data.end()));
+					manifest = InfoTree::load_xml(strm);
+					XMLCache::instance()->cache_tree(file_name.GetPath(), size, date, manifest);
+				}
+				InfoTree root = manifest.get_child("plugin");
+
 				Plugin Data = Plugin();
 				Data.directory = current_plugin_directory;
 				Data.enabled = true;
@@ -267,26 +304,26 @@ bool PluginLoader::ParsePlugin(FileSpecifier& file_name)
 				root.read_attr("minimum_version", Data.required_version);
 				
 				if (root.read_attr("hud_lua", Data.hud_lua) &&
-					!plugin_file_exists(Data, Data.hud_lua))
+					!FileExists(Data, Data.hud_lua))
 					Data.hud_lua = "";
 				
 				if (root.read_attr("solo_lua", Data.solo_lua) &&
-					!plugin_file_exists(Data, Data.solo_lua))
+					!FileExists(Data, Data.solo_lua))
 					Data.solo_lua = "";
 				
 				if (root.read_attr("stats_lua", Data.stats_lua) &&
-					!plugin_file_exists(Data, Data.stats_lua))
+					!FileExists(Data, Data.stats_lua))
 					Data.stats_lua = "";
 				
 				if (root.read_attr("theme_dir", Data.theme) &&
-					!plugin_file_exists(Data, Data.theme + "/theme2.mml"))
+					!FileExists(Data, Data.theme + "/theme2.mml"))
 					Data.theme = "";
 				
 				BOOST_FOREACH(InfoTree tree, root.children_named("mml"))
 				{
 					std::string mml_path;
 					if (tree.read_attr("file", mml_path) &&
-						plugin_file_exists(Data, mml_path))
+						FileExists(Data, mml_path))
 						Data.mmls.push_back(mml_path);
 				}
 
@@ -295,7 +332,7 @@ bool PluginLoader::ParsePlugin(FileSpecifier& file_name)
 					ShapesPatch patch;
 					tree.read_attr("file", patch.path);
 					tree.read_attr("requires_opengl", patch.requires_opengl);
-					if (plugin_file_exists(Data, patch.path))
+					if (FileExists(Data, patch.path))
 						Data.shapes_patches.push_back(patch);
 				}
 
@@ -354,7 +391,7 @@ bool PluginLoader::ParseDirectory(FileSpecifier& dir)
 		FileSpecifier file = dir + it->name;
 		if (it->name == "Plugin.xml")
 		{
-			ParsePlugin(file);
+			ParsePlugin(file, it->size, it->date);
 		}
 		else if (it->is_directory && it->name[0] != '.') 
 		{
@@ -363,22 +400,36 @@ bool PluginLoader::ParseDirectory(FileSpecifier& dir)
 #ifdef HAVE_ZZIP
 		else if (algo::ends_with(it->name, ".zip") || algo::ends_with(it->name, ".ZIP"))
 		{
-			// search it for a Plugin.xml file
-			ZZIP_DIR* zzipdir = zzip_dir_open(file.GetPath(), 0);
-			if (zzipdir)
+			// list its files, unless it hasn't changed since last time
+			std::vector<std::string> names;
+			if (!XMLCache::instance()->find_listing(file.GetPath(), it->size, it->date, names))
 			{
+				ZZIP_DIR* zzipdir = zzip_dir_open(file.GetPath(), 0);
+				if (!zzipdir)
+					continue;
+				
 				ZZIP_DIRENT dirent;
 				while (zzip_dir_read(zzipdir, &dirent))
+					names.push_back(dirent.d_name);
+				zzip_dir_close(zzipdir);
+				
+				std::sort(names.begin(), names.end());
+				XMLCache::instance()->cache_listing(file.GetPath(), it->size, it->date, names);
+			}
+			
+			// search it for a Plugin.xml file
+			std::string archive = file.GetPath();
+			m_archive_root = archive.substr(0, archive.find_last_of('.'));
+			m_archive_names = &names;
+			for (std::vector<std::string>::const_iterator name = names.begin(); name != names.end(); ++name)
+			{
+				if (*name == "Plugin.xml" || algo::ends_with(*name, "/Plugin.xml"))
 				{
-					if (strcmp(dirent.d_name, "Plugin.xml") == 0 || algo::ends_with(dirent.d_name, "/Plugin.xml"))
-					{
-						std::string archive = file.GetPath();
-						FileSpecifier file_name = FileSpecifier(archive.substr(0, archive.find_last_of('.'))) + dirent.d_name;
-						ParsePlugin(file_name);
-					}
+					FileSpecifier file_name = FileSpecifier(m_archive_root) + name->c_str();
+					ParsePlugin(file_name, it->size, it->date);
 				}
-				zzip_dir_close(zzipdir);
 			}
+			m_archive_names = NULL;
 		}
 #endif
 	}
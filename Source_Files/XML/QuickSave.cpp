@@ -499,12 +499,12 @@ bool load_quick_save_dialog(FileSpecifier& saved_game)
 extern SDL_Surface *draw_surface;
 extern bool OGL_MapActive;
 
-static bool build_map_preview(std::ostringstream& ostream)
+static SDL_Surface *render_map_preview()
 {
     SDL_Rect r = {0, 0, RENDER_WIDTH, RENDER_HEIGHT};
     SDL_Surface *surface = SDL_CreateRGBSurface(SDL_SWSURFACE, r.w, r.h, 32, 0xff0000, 0x00ff00, 0x0000ff, 0);
     if (!surface)
-        return false;
+        return NULL;
 	
     SDL_FillRect(surface, &r, SDL_MapRGB(surface->format, 0, 0, 0));
 	
@@ -526,6 +526,12 @@ static bool build_map_preview(std::ostringstream& ostream)
     OGL_MapActive = old_OGL_MapActive;
     _restore_port();
 	
+    return surface;
+}
+
+bool encode_save_preview(SDL_Surface *surface, std::string& imagedata)
+{
+    std::ostringstream ostream;
     SDL_RWops *rwops = SDL_RWFromOStream(ostream);
 //#if defined(HAVE_PNG) && defined(HAVE_SDL_IMAGE)
 //    int ret = aoIMG_SavePNG_RW(rwops, surface, IMG_COMPRESS_DEFAULT, NULL, 0);
@@ -534,9 +540,9 @@ static bool build_map_preview(std::ostringstream& ostream)
 #else
     int ret = SDL_SaveBMP_RW(surface, rwops, false);
 #endif
-    SDL_FreeSurface(surface);
     SDL_RWclose(rwops);
 	
+    imagedata = ostream.str();
     return (ret == 0);
 }
 
@@ -652,6 +658,17 @@ void create_updated_save(QuickSave& save)
 	}
 }
 
+static void quick_save_finished(FileSpecifier&, bool success, void *)
+{
+    if (success)
+    {
+        QuickSaves::instance()->delete_surplus_saves(environment_preferences->maximum_quick_saves);
+        screen_printf("Game saved");
+    }
+    else
+        screen_printf("Save failed");
+}
+
 bool create_quick_save(void)
 {
     QuickSave save;
@@ -687,13 +704,7 @@ bool create_quick_save(void)
     save.save_file.AddPart(base + ".sgaA");
 	
     std::string metadata = build_save_metadata(save);
-    std::ostringstream image_stream;
-    bool success = build_map_preview(image_stream);
-    success = save_game_file(save.save_file, metadata, image_stream.str());
-    
-    if (success)
-        QuickSaves::instance()->delete_surplus_saves(environment_preferences->maximum_quick_saves);
-    return success;
+    return save_game_file_in_background(save.save_file, metadata, render_map_preview(), quick_save_finished, NULL);
 }
 
 bool delete_quick_save(QuickSave& save)
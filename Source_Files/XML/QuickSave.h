@@ -63,7 +63,13 @@ private:
     std::vector<QuickSave> m_saves;
 };
 
+struct SDL_Surface;
+
+// Starts saving in the background; reports how it went on screen when done
 bool create_quick_save(void);
+
+// Encodes a save's preview image; safe to call from any thread
+bool encode_save_preview(SDL_Surface *surface, std::string& imagedata);
 bool delete_quick_save(QuickSave& save);
 bool load_quick_save_dialog(FileSpecifier& saved_game);
 size_t saved_game_was_networked(FileSpecifier& saved_game);
@@ -0,0 +1,316 @@
+/*
+ *  XMLCache.cpp - a persistent cache of parsed MML and plugin files
+
+	Copyright (C) 2026 and beyond by the "Aleph One" developers.
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This license is contained in the file "COPYING",
+	which is included with this source code; it is available online at
+	http://www.gnu.org/licenses/gpl.html
+
+ */
+
+#include "cseries.h"
+#include "XMLCache.h"
+
+#include "FileHandler.h"
+#include "Logging.h"
+
+// The cache file is a version, an entry count and the entries, big-endian:
+// path, size, date (as two halves), kind, then a tree or a list of names.
+// A tree is its data, its child count, and each child's key and tree.
+enum {
+	XML_CACHE_VERSION = 1,
+	_cached_tree = 0,
+	_cached_listing = 1,
+
+	// deeper trees than this aren't anything we'd have written
+	MAXIMUM_CACHED_TREE_DEPTH = 64
+};
+
+static const char *xml_cache_name = "XML Cache";
+
+/* ---------- stream helpers */
+
+static void put_uint32(std::vector<uint8>& out, uint32 value)
+{
+	out.push_back(static_cast<uint8>(value >> 24));
+	out.push_back(static_cast<uint8>(value >> 16));
+	out.push_back(static_cast<uint8>(value >> 8));
+	out.push_back(static_cast<uint8>(value));
+}
+
+static void put_string(std::vector<uint8>& out, const std::string& value)
+{
+	put_uint32(out, static_cast<uint32>(value.size()));
+	out.insert(out.end(), value.begin(), value.end());
+}
+
+static void put_tree(std::vector<uint8>& out, const InfoTree& tree)
+{
+	put_string(out, tree.data());
+	put_uint32(out, static_cast<uint32>(tree.size()));
+	for (InfoTree::const_iterator it = tree.begin(); it != tree.end(); ++it)
+	{
+		put_string(out, it->first);
+		put_tree(out, it->second);
+	}
+}
+
+// reads fail, rather than overrun, on a short or damaged file
+class cache_reader {
+public:
+	cache_reader(const std::vector<uint8>& data) : m_data(data), m_pos(0) { }
+
+	bool get_uint32(uint32& value)
+	{
+		if (m_data.size() - m_pos < 4)
+			return false;
+		value = (uint32(m_data[m_pos]) << 24) | (uint32(m_data[m_pos + 1]) << 16) |
+			(uint32(m_data[m_pos + 2]) << 8) | uint32(m_data[m_pos + 3]);
+		m_pos += 4;
+		return true;
+	}
+
+	bool get_string(std::string& value)
+	{
+		uint32 length;
+		if (!get_uint32(length) || m_data.size() - m_pos < length)
+			return false;
+		value.assign(m_data.begin() + m_pos, m_data.begin() + m_pos + length);
+		m_pos += length;
+		return true;
+	}
+
+	bool get_tree(InfoTree& tree, int depth = 0)
+	{
+		std::string data;
+		uint32 count;
+		if (depth > MAXIMUM_CACHED_TREE_DEPTH || !get_string(data) || !get_uint32(count))
+			return false;
+		tree.data() = data;
+		for (uint32 i = 0; i < count; ++i)
+		{
+			std::string key;
+			InfoTree child;
+			if (!get_string(key) || !get_tree(child, depth + 1))
+				return false;
+			tree.push_back(std::make_pair(key, child));
+		}
+		return true;
+	}
+
+	bool at_end() const { return m_pos == m_data.size(); }
+
+private:
+	const std::vector<uint8>& m_data;
+	size_t m_pos;
+};
+
+/* ---------- XMLCache */
+
+XMLCache* XMLCache::instance()
+{
+	static XMLCache* m_instance = nullptr;
+	if (!m_instance) {
+		m_instance = new XMLCache;
+	}
+
+	return m_instance;
+}
+
+void XMLCache::initialize_cache()
+{
+	FileSpecifier file;
+	file.SetToLocalDataDir();
+	file += xml_cache_name;
+
+	OpenedFile cache;
+	if (!file.Open(cache))
+		return;
+
+	int32 length;
+	if (!cache.GetLength(length))
+		return;
+	std::vector<uint8> data(length);
+	if (length > 0 && !cache.Read(length, &data[0]))
+		return;
+
+	cache_reader reader(data);
+	uint32 version, count;
+	if (!reader.get_uint32(version) || version != XML_CACHE_VERSION || !reader.get_uint32(count))
+		return;
+
+	std::map<std::string, entry> entries;
+	for (uint32 i = 0; i < count; ++i)
+	{
+		std::string path;
+		uint32 size, date_high, date_low, kind;
+		if (!reader.get_string(path) || !reader.get_uint32(size) ||
+			!reader.get_uint32(date_high) || !reader.get_uint32(date_low) || !reader.get_uint32(kind))
+		{
+			logWarning("ignoring damaged XML cache %s", file.GetPath());
+			return;
+		}
+
+		entry& e = entries[path];
+		e.size = static_cast<int32>(size);
+		e.date = static_cast<TimeType>((Uint64(date_high) << 32) | date_low);
+		e.is_listing = (kind == _cached_listing);
+		e.used = false;
+
+		bool read = true;
+		if (e.is_listing)
+		{
+			uint32 name_count;
+			read = reader.get_uint32(name_count);
+			for (uint32 j = 0; read && j < name_count; ++j)
+			{
+				std::string name;
+				read = reader.get_string(name);
+				e.names.push_back(name);
+			}
+		}
+		else
+		{
+			read = reader.get_tree(e.tree);
+		}
+
+		if (!read)
+		{
+			logWarning("ignoring damaged XML cache %s", file.GetPath());
+			return;
+		}
+	}
+
+	if (reader.at_end())
+		m_entries.swap(entries);
+}
+
+XMLCache::entry* XMLCache::find(const std::string& path, int32 size, TimeType date, bool is_listing)
+{
+	std::map<std::string, entry>::iterator it = m_entries.find(path);
+	if (it == m_entries.end() || it->second.size != size || it->second.date != date ||
+		it->second.is_listing != is_listing)
+		return NULL;
+
+	it->second.used = true;
+	return &it->second;
+}
+
+bool XMLCache::find_tree(const std::string& path, int32 size, TimeType date, InfoTree& tree)
+{
+	entry *e = find(path, size, date, false);
+	if (!e)
+		return false;
+
+	tree = e->tree;
+	return true;
+}
+
+void XMLCache::cache_tree(const std::string& path, int32 size, TimeType date, const InfoTree& tree)
+{
+	entry& e = m_entries[path];
+	e.size = size;
+	e.date = date;
+	e.is_listing = false;
+	e.tree = tree;
+	e.names.clear();
+	e.used = true;
+	m_cache_dirty = true;
+}
+
+bool XMLCache::find_listing(const std::string& path, int32 size, TimeType date, std::vector<std::string>& names)
+{
+	entry *e = find(path, size, date, true);
+	if (!e)
+		return false;
+
+	names = e->names;
+	return true;
+}
+
+void XMLCache::cache_listing(const std::string& path, int32 size, TimeType date, const std::vector<std::string>& names)
+{
+	entry& e = m_entries[path];
+	e.size = size;
+	e.date = date;
+	e.is_listing = true;
+	e.tree = InfoTree();
+	e.names = names;
+	e.used = true;
+	m_cache_dirty = true;
+}
+
+void XMLCache::save_cache()
+{
+	if (!m_cache_dirty)
+		return;
+
+	std::vector<uint8> data;
+	uint32 count = 0;
+	for (std::map<std::string, entry>::const_iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+	{
+		if (it->second.used)
+			++count;
+	}
+
+	put_uint32(data, XML_CACHE_VERSION);
+	put_uint32(data, count);
+	for (std::map<std::string, entry>::const_iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+	{
+		const entry& e = it->second;
+		if (!e.used)
+			continue;
+
+		Uint64 date = static_cast<Uint64>(e.date);
+		put_string(data, it->first);
+		put_uint32(data, static_cast<uint32>(e.size));
+		put_uint32(data, static_cast<uint32>(date >> 32));
+		put_uint32(data, static_cast<uint32>(date));
+		put_uint32(data, e.is_listing ? _cached_listing : _cached_tree);
+		if (e.is_listing)
+		{
+			put_uint32(data, static_cast<uint32>(e.names.size()));
+			for (size_t i = 0; i < e.names.size(); ++i)
+				put_string(data, e.names[i]);
+		}
+		else
+		{
+			put_tree(data, e.tree);
+		}
+	}
+
+	// write to a temporary file first, so a half-written cache is never picked up
+	FileSpecifier file, temporary_file;
+	file.SetToLocalDataDir();
+	file += xml_cache_name;
+	temporary_file.SetTempName(file);
+
+	OpenedFile cache;
+	if (!temporary_file.Create(_typecode_unknown) || !temporary_file.Open(cache, true))
+	{
+		logWarning("unable to write XML cache %s", file.GetPath());
+		return;
+	}
+
+	bool written = cache.Write(static_cast<int32>(data.size()), &data[0]);
+	cache.Close();
+	if (!written || !temporary_file.Rename(file))
+	{
+		logWarning("unable to write XML cache %s", file.GetPath());
+		temporary_file.Delete();
+		return;
+	}
+
+	m_cache_dirty = false;
+}
@@ -0,0 +1,71 @@
+/*
+ *  XMLCache.h - a persistent cache of parsed MML and plugin files
+
+	Copyright (C) 2026 and beyond by the "Aleph One" developers.
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 3 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	This license is contained in the file "COPYING",
+	which is included with this source code; it is available online at
+	http://www.gnu.org/licenses/gpl.html
+
+	Every launch (and every level) reads the same MML files and plugin
+	manifests, and looks inside the same zipped plugins. This remembers the
+	parsed trees and the archives' file lists, keyed by path, size and
+	modification date, so unchanged files needn't be read or parsed again.
+ */
+
+#ifndef XML_CACHE_H
+#define XML_CACHE_H
+
+#include "InfoTree.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+class XMLCache {
+public:
+	static XMLCache* instance();
+
+	// Call this at startup, before any other calls.
+	void initialize_cache();
+
+	// The parsed contents of an XML file, if cached for this size and date
+	bool find_tree(const std::string& path, int32 size, TimeType date, InfoTree& tree);
+	void cache_tree(const std::string& path, int32 size, TimeType date, const InfoTree& tree);
+
+	// The names of the files in a zip archive, if cached for this size and date
+	bool find_listing(const std::string& path, int32 size, TimeType date, std::vector<std::string>& names);
+	void cache_listing(const std::string& path, int32 size, TimeType date, const std::vector<std::string>& names);
+
+	// Writes the entries used this run, dropping those for files that have gone
+	void save_cache();
+
+private:
+	XMLCache() { }
+
+	struct entry {
+		int32 size;
+		TimeType date;
+		bool is_listing;
+		InfoTree tree;
+		std::vector<std::string> names;
+		bool used;
+	};
+
+	entry* find(const std::string& path, int32 size, TimeType date, bool is_listing);
+
+	std::map<std::string, entry> m_entries;
+	bool m_cache_dirty = false;
+};
+
+#endif
@@ -54,8 +54,16 @@
 #include "Scenario.h"
 #include "SW_Texture_Extras.h"
 #include "Console.h"
+#include "Profiler.h"
 #include "XML_LevelScript.h"
 #include "InfoTree.h"
+#include "XMLCache.h"
+
+#include <atomic>
+#include <SDL_thread.h>
+
+// Most of the time, every file is unchanged and comes from the cache
+#define MAXIMUM_MML_PARSING_THREADS 8
 
 // This will reset all values changed by MML scripts which implement ResetValues() method
 // and are part of the master MarathonParser tree.
@@ -87,9 +95,11 @@ void ResetAllMMLValues()
 	reset_mml_player_name();
 	reset_mml_scenario();
 	reset_mml_keyboard();
+	reset_mml_film();
 	reset_mml_cheats();
 	reset_mml_logging();
 	reset_mml_console();
+	reset_mml_profiler();
 	reset_mml_default_levels();
 }
 
@@ -149,12 +159,16 @@ void _ParseAllMML(const InfoTree& fileroot)
 			parse_mml_scenario(child);
 		BOOST_FOREACH(InfoTree child, root.children_named("keyboard"))
 			parse_mml_keyboard(child);
+		BOOST_FOREACH(InfoTree child, root.children_named("film"))
+			parse_mml_film(child);
 		BOOST_FOREACH(InfoTree child, root.children_named("cheats"))
 			parse_mml_cheats(child);
 		BOOST_FOREACH(InfoTree child, root.children_named("logging"))
 			parse_mml_logging(child);
 		BOOST_FOREACH(InfoTree child, root.children_named("console"))
 			parse_mml_console(child);
+		BOOST_FOREACH(InfoTree child, root.children_named("profiler"))
+			parse_mml_profiler(child);
 		BOOST_FOREACH(InfoTree child, root.children_named("default_levels"))
 			parse_mml_default_levels(child);
 	}
@@ -182,6 +196,137 @@ bool ParseMMLFromFile(const FileSpecifier& FileSpec)
 	return !parse_error;
 }
 
+static bool _ParseMMLTree(const InfoTree& fileroot, const FileSpecifier& FileSpec)
+{
+	bool parse_error = false;
+	try {
+		_ParseAllMML(fileroot);
+	} catch (InfoTree::path_error ep) {
+		logError("Path error parsing MML file (%s): %s", FileSpec.GetPath(), ep.what());
+		parse_error = true;
+	} catch (InfoTree::data_error ed) {
+		logError("Data error parsing MML file (%s): %s", FileSpec.GetPath(), ed.what());
+		parse_error = true;
+	} catch (InfoTree::unexpected_error ee) {
+		logError("Unexpected error parsing MML file (%s): %s", FileSpec.GetPath(), ee.what());
+		parse_error = true;
+	}
+	return !parse_error;
+}
+
+struct mml_parsing_task
+{
+	bool cacheable, cached, readable;
+	int32 size;
+	TimeType date;
+	std::string data;
+	InfoTree tree;
+	std::string error;	// from parsing, if it failed
+};
+
+struct mml_parsing_job
+{
+	std::vector<mml_parsing_task> tasks;
+	std::atomic<int> next_task;
+};
+
+// parsing needs nothing but the file's contents, so it can happen on any thread;
+// errors are kept for the main thread to log in order
+static int mml_parsing_thread(void *data)
+{
+	mml_parsing_job *job = static_cast<mml_parsing_job *>(data);
+	for (int i = job->next_task++; i < static_cast<int>(job->tasks.size()); i = job->next_task++)
+	{
+		mml_parsing_task& task = job->tasks[i];
+		if (task.cached || !task.readable)
+			continue;
+
+		try {
+			std::istringstream strm(task.data);
+			task.tree = InfoTree::load_xml(strm);
+		} catch (InfoTree::parse_error ex) {
+			task.error = ex.what();
+		} catch (InfoTree::unexpected_error ee) {
+			task.error = ee.what();
+		}
+		task.data.clear();
+	}
+	return 0;
+}
+
+bool ParseMMLFromFiles(const std::vector<FileSpecifier>& files)
+{
+	mml_parsing_job job;
+	job.tasks.resize(files.size());
+	job.next_task = 0;
+
+	int uncached = 0;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		FileSpecifier file = files[i];
+		mml_parsing_task& task = job.tasks[i];
+		task.cacheable = file.GetSizeAndDate(task.size, task.date);
+		task.cached = task.cacheable && XMLCache::instance()->find_tree(file.GetPath(), task.size, task.date, task.tree);
+		task.readable = false;
+		if (task.cached)
+			continue;
+
+		// files in zip archives and the like are read here, on the main thread
+		OpenedFile opened;
+		int32 length;
+		if (file.Open(opened) && opened.GetLength(length))
+		{
+			task.data.resize(length);
+			task.readable = length == 0 || opened.Read(length, &task.data[0]);
+		}
+		if (task.readable)
+			++uncached;
+	}
+
+	if (uncached > 1)
+	{
+		int thread_count = PIN(SDL_GetCPUCount(), 1, MAXIMUM_MML_PARSING_THREADS);
+		thread_count = MIN(thread_count, uncached);
+
+		std::vector<SDL_Thread *> threads;
+		for (int i = 1; i < thread_count; ++i)
+		{
+			SDL_Thread *thread = SDL_CreateThread(mml_parsing_thread, "ParseMMLFromFiles", &job);
+			if (thread) threads.push_back(thread);
+		}
+		mml_parsing_thread(&job);
+		for (size_t i = 0; i < threads.size(); ++i)
+			SDL_WaitThread(threads[i], NULL);
+	}
+	else
+	{
+		mml_parsing_thread(&job);
+	}
+
+	bool parsed = true;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		mml_parsing_task& task = job.tasks[i];
+		if (!task.cached && !task.readable)
+		{
+			// let the usual path report why it couldn't be read
+			parsed = ParseMMLFromFile(files[i]) && parsed;
+		}
+		else if (!task.error.empty())
+		{
+			logError("Error parsing MML file (%s): %s", files[i].GetPath(), task.error.c_str());
+			parsed = false;
+		}
+		else
+		{
+			if (!task.cached && task.cacheable)
+				XMLCache::instance()->cache_tree(files[i].GetPath(), task.size, task.date, task.tree);
+			parsed = _ParseMMLTree(task.tree, files[i]) && parsed;
+		}
+	}
+	return parsed;
+}
+
 bool ParseMMLFromData(const char *buffer, size_t buflen)
 {
 	bool parse_error = false;
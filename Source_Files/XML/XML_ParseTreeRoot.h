@@ -29,11 +29,15 @@
 */
 
 #include <stddef.h>
+#include <vector>
 
 extern void ResetAllMMLValues(); // reset everything that's been changed to hard-coded defaults
 
 class FileSpecifier;
 extern bool ParseMMLFromFile(const FileSpecifier& filespec);
+// Applies the files in order; unchanged ones come from the XML cache,
+// and the rest are parsed in parallel first
+extern bool ParseMMLFromFiles(const std::vector<FileSpecifier>& files);
 extern bool ParseMMLFromData(const char *buffer, size_t buflen);
 
 #endif
@@ -58,6 +58,9 @@
 #include "XML_ParseTreeRoot.h"
 #include "FileHandler.h"
 #include "Plugins.h"
+#include "XMLCache.h"
+#include "ShaderCache.h"
+#include "Profiler.h"
 #include "FilmProfile.h"
 
 #include "mytm.h"	// mytm_initialize(), for platform-specific shell_*.h
@@ -142,6 +145,8 @@ DirectorySpecifier screenshots_dir;   // Directory for screenshots
 DirectorySpecifier log_dir;           // Directory for Aleph One Log.txt
 std::string arg_directory;
 std::vector<std::string> arg_files;
+static std::string arg_export_file;   // Movie to export the film to, then quit
+static std::string arg_timedemo_file; // Film to time with the profiler, then quit
 
 // Command-line options
 bool option_nogl = false;             // Disable OpenGL
@@ -196,6 +201,10 @@ static void usage(const char *prg_name)
 	  "\t[-s | --nosound]       Do not access the sound card\n"
 	  "\t[-m | --nogamma]       Disable gamma table effects (menu fades)\n"
           "\t[-j | --nojoystick]    Do not initialize joysticks\n"
+	  "\t[-x | --export movie]  Export the film to play to a movie file,\n"
+	  "\t                       as fast as possible, then quit\n"
+	  "\t[-t | --timedemo film] Play a film with the profiler on, print each\n"
+	  "\t                       zone's mean time per frame, then quit\n"
 	  // Documenting this might be a bad idea?
 	  // "\t[-i | --insecure_lua]  Allow Lua netscripts to take over your computer\n"
 	  "\tdirectory              Directory containing scenario data files\n"
@@ -252,7 +261,12 @@ bool handle_open_document(const std::string& filename)
 }
 
 
+// tools/alephbench links the game in and runs it through alephone_main()
+#ifdef A1_NO_MAIN
+int alephone_main(int argc, char **argv)
+#else
 int main(int argc, char **argv)
+#endif
 {
 	// Print banner (don't bother if this doesn't appear when started from a GUI)
 	char app_name_version[256];
@@ -310,6 +324,22 @@ int main(int argc, char **argv)
 			insecure_lua = true;
 		} else if (strcmp(*argv, "-d") == 0 || strcmp(*argv, "--debug") == 0) {
 		  option_debug = true;
+		} else if (strcmp(*argv, "-x") == 0 || strcmp(*argv, "--export") == 0) {
+			if (argc < 2) {
+				printf("Missing movie file for '%s'.\n", *argv);
+				usage(prg_name);
+			}
+			argc--;
+			argv++;
+			arg_export_file = *argv;
+		} else if (strcmp(*argv, "-t") == 0 || strcmp(*argv, "--timedemo") == 0) {
+			if (argc < 2) {
+				printf("Missing film file for '%s'.\n", *argv);
+				usage(prg_name);
+			}
+			argc--;
+			argv++;
+			arg_timedemo_file = *argv;
 		} else if (*argv[0] != '-') {
 			// if it's a directory, make it the default data dir
 			// otherwise push it and handle it later
@@ -335,14 +365,42 @@ int main(int argc, char **argv)
 		// Initialize everything
 		initialize_application();
 
+		// exporting a film just records its replay, which then runs unpaced
+		if (!arg_export_file.empty())
+			Movie::instance()->StartRecording(arg_export_file);
+
+		bool replaying = false;
 		for (std::vector<std::string>::iterator it = arg_files.begin(); it != arg_files.end(); ++it)
 		{
 			if (handle_open_document(*it))
 			{
+				replaying = (FileSpecifier(*it).GetType() == _typecode_film);
 				break;
 			}
 		}
 
+		if (!arg_export_file.empty() && !replaying)
+		{
+			logError("No film to export to %s", arg_export_file.c_str());
+			fprintf(stderr, "No film to export to %s\n", arg_export_file.c_str());
+			Movie::instance()->StopRecording();
+			exit(1);
+		}
+
+		if (!arg_timedemo_file.empty())
+		{
+			if (replaying || FileSpecifier(arg_timedemo_file).GetType() != _typecode_film || !handle_open_document(arg_timedemo_file))
+			{
+				logError("Unable to play %s as a timedemo", arg_timedemo_file.c_str());
+				fprintf(stderr, "Unable to play %s as a timedemo\n", arg_timedemo_file.c_str());
+				exit(1);
+			}
+
+			// the level is loaded by now, so only playback is timed
+			Profiler::instance()->Enable(true);
+			Profiler::instance()->ShowOverlay(false);
+		}
+
 		// Run the main loop
 		main_event_loop();
 
@@ -494,6 +552,9 @@ static void initialize_application(void)
 	init_physics_wad_data();
 	initialize_fonts(false);
 
+	// before anything parses MML
+	XMLCache::instance()->initialize_cache();
+
 	load_film_profile(FILM_PROFILE_DEFAULT, false);
 
 	// Parse MML files
@@ -550,6 +611,9 @@ static void initialize_application(void)
 	screenshots_dir.CreateDirectory();
 	
 	WadImageCache::instance()->initialize_cache();
+#ifdef HAVE_OPENGL
+	ShaderCache::instance()->initialize_cache();
+#endif
 
 #ifndef HAVE_OPENGL
 	graphics_preferences->screen_mode.acceleration = _no_acceleration;
@@ -561,6 +625,7 @@ static void initialize_application(void)
 	write_preferences();
 
 	Plugins::instance()->load_mml();
+	XMLCache::instance()->save_cache();
 
 //	SDL_WM_SetCaption(application_name, application_name);
 
@@ -601,6 +666,7 @@ static void initialize_application(void)
 	initialize_images_manager();
 	load_environment_from_preferences();
 	initialize_game_state();
+	Profiler::instance()->RegisterConsoleCommands();
 }
 
 void shutdown_application(void)
@@ -612,7 +678,12 @@ void shutdown_application(void)
 
         already_shutting_down = true;
         
+	wait_for_pending_saves();
 	WadImageCache::instance()->save_cache();
+	XMLCache::instance()->save_cache();
+#ifdef HAVE_OPENGL
+	ShaderCache::instance()->save_cache();
+#endif
 	close_external_resources();
         
 #if defined(HAVE_SDL_IMAGE) && (SDL_IMAGE_PATCHLEVEL >= 8)
@@ -733,6 +804,21 @@ short get_level_number_from_user(void)
 	return level;
 }
 
+static void print_timedemo_results(void)
+{
+	Profiler* profiler = Profiler::instance();
+	int frames = profiler->Frames();
+	float seconds = profiler->Seconds();
+	printf("%s: %d frames in %.2f s, %.1f fps\n", arg_timedemo_file.c_str(), frames, seconds,
+	       seconds > 0 ? frames / seconds : 0.0f);
+
+	std::vector<Profiler::ReportLine> lines;
+	profiler->Summarize(lines);
+	printf("%-32s %10s\n", "zone", "ms/frame");
+	for (size_t i = 0; i < lines.size(); ++i)
+		printf("%*s%-*s %10.3f\n", 2 * lines[i].depth, "", 32 - 2 * lines[i].depth, lines[i].name, lines[i].milliseconds);
+}
+
 const uint32 TICKS_BETWEEN_EVENT_POLL = 16; // 60 Hz
 static void main_event_loop(void)
 {
@@ -804,8 +890,21 @@ static void main_event_loop(void)
 
 		execute_timer_tasks(SDL_GetTicks());
 		idle_game_state(SDL_GetTicks());
+		process_finished_saves();
 
-		if (game_state == _game_in_progress && !graphics_preferences->hog_the_cpu && (TICKS_PER_SECOND - (SDL_GetTicks() - cur_time)) > 10)
+		// an exported film is done when its movie is
+		if (!arg_export_file.empty() && !Movie::instance()->IsRecording())
+			break;
+
+		// and a timed one when its replay is
+		if (!arg_timedemo_file.empty() && get_game_state() != _game_in_progress && get_game_state() != _change_level)
+		{
+			print_timedemo_results();
+			break;
+		}
+
+		// while recording, the game runs as fast as frames can be encoded
+		if (game_state == _game_in_progress && !graphics_preferences->hog_the_cpu && !Movie::instance()->IsRecording() && (TICKS_PER_SECOND - (SDL_GetTicks() - cur_time)) > 10)
 		{
 			SDL_Delay(1);
 		}
@@ -1614,7 +1713,7 @@ void dump_screen(void)
 #endif
 }
 
-static bool _ParseMMLDirectory(DirectorySpecifier& dir)
+static bool _FindMMLFiles(DirectorySpecifier& dir, vector<FileSpecifier>& files)
 {
 	// Get sorted list of files in directory
 	vector<dir_entry> de;
@@ -1634,10 +1733,7 @@ static bool _ParseMMLDirectory(DirectorySpecifier& dir)
 			continue;
 		
 		// Construct full path name
-		FileSpecifier file_name = dir + i->name;
-		
-		// Parse file
-		ParseMMLFromFile(file_name);
+		files.push_back(dir + i->name);
 	}
 	
 	return true;
@@ -1645,14 +1741,18 @@ static bool _ParseMMLDirectory(DirectorySpecifier& dir)
 
 void LoadBaseMMLScripts()
 {
+	vector<FileSpecifier> files;
 	vector <DirectorySpecifier>::const_iterator i = data_search_path.begin(), end = data_search_path.end();
 	while (i != end) {
 		DirectorySpecifier path = *i + "MML";
-		_ParseMMLDirectory(path);
+		_FindMMLFiles(path, files);
 		path = *i + "Scripts";
-		_ParseMMLDirectory(path);
+		_FindMMLFiles(path, files);
 		i++;
 	}
+	
+	// Parse files, in order
+	ParseMMLFromFiles(files);
 }
 			   
 bool expand_symbolic_paths_helper(char *dest, const char *src, int maxlen, const char *symbol, DirectorySpecifier& dir)
@@ -81,6 +81,7 @@ struct screen_mode_data
 	bool fix_h_not_v;
 	bool translucent_map;
 	bool camera_bob;
+	short frame_time_target;  // in milliseconds; 0 always draws the view at full size
 	
 };
 
@@ -46,6 +46,7 @@ bool chat_input_mode = false;
 #include "network_sound.h"
 #include "TextStrings.h"
 #include "InfoTree.h"
+#include "Profiler.h"
 
 #include <ctype.h>
 
@@ -298,6 +299,7 @@ void handle_keyword(int tag)
 
 void global_idle_proc(void)
 {
+	PROFILE_ZONE("sound");
 	Music::instance()->Idle();
 	network_speaker_idle_proc();
 	network_microphone_idle_proc();
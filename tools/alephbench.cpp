@@ -0,0 +1,750 @@
+/*
+ *  alephbench.cpp - Round-trip checks and benchmarks for the engine
+ *
+ *  Copyright (C) 2026 and beyond by the "Aleph One" developers.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  This license is contained in the file "COPYING",
+ *  which is included with this source code; it is available online at
+ *  http://www.gnu.org/licenses/gpl.html
+ *
+ *  This is linked against the game's libraries, with shell.cpp built as
+ *  alephone_main(). "make check" in tools/ builds it twice, the second time
+ *  with the packing routines' SSE2 paths compiled out (alephbench_nosse2),
+ *  and runs the checks in both.
+ *
+ *  alephbench                 run every check
+ *  alephbench packing         round-trip every record that has a packing schema
+ *  alephbench lua             time saving and restoring Lua data in versions 1
+ *                             and 2, and check that version 2 round-trips,
+ *                             rejects truncated data and handles deep nesting
+ *  alephbench film [options] [directory] film
+ *                             play a film as a timedemo (alephone --timedemo):
+ *                             the profiler's mean time per frame of each zone,
+ *                             and the frame rate; options are alephone's
+ *  alephbench models [instances]
+ *                             time skinning a boned model for that many
+ *                             instances a frame (default 64), each in its own
+ *                             pose, and sharing four poses as a crowd of one
+ *                             monster type tends to
+ *  alephbench mml [directory] [preferences directory]
+ *                             time parsing the MML in a directory (default
+ *                             "MML Scripts") and applying it again from the
+ *                             XML cache, then loading the preferences file
+ *                             (default: the user's)
+ */
+
+#include "cseries.h"
+#include "map.h"
+#include "effects.h"
+#include "monsters.h"
+#include "player.h"
+#include "projectiles.h"
+#include "cspaths.h"
+#include "FileHandler.h"
+#include "interface.h"
+#include "preferences.h"
+#include "TextStrings.h"
+#include "XML_ParseTreeRoot.h"
+
+#ifdef HAVE_OPENGL
+#include "Model3D.h"
+#endif
+
+#ifdef HAVE_LUA
+#include "lua_serialize.h"
+#include "BStream.h"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// milliseconds since start
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Record packing
+
+// Packs of the same records must give the same stream, and every byte that
+// isn't padding must come back from a round trip through the records.
+template<class Record>
+static bool check_round_trip(const char *name, size_t packed_size,
+	uint8 *(*unpack)(uint8 *, Record *, size_t), uint8 *(*pack)(uint8 *, Record *, size_t),
+	int32 (*first_field)(const Record&))
+{
+	// enough records for the bulk swaps to run past their vector loops
+	static const size_t counts[] = { 1, 3, 17 };
+
+	for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c)
+	{
+		const size_t count = counts[c];
+		const size_t size = count * packed_size;
+		std::vector<uint8> stream(size), packed(size), repacked(size), data_bytes(size);
+		std::vector<Record> records(count), unpacked(count);
+
+		// which stream bytes are data rather than padding
+		std::vector<uint8> ones(size, 0xff);
+		memset(records.data(), 0, count * sizeof(Record));
+		unpack(ones.data(), records.data(), count);
+		pack(data_bytes.data(), records.data(), count);
+
+		uint32 seed = 0x2545f491 + count;
+		for (size_t i = 0; i < size; ++i)
+		{
+			seed = seed * 1103515245 + 12345;
+			stream[i] = uint8(seed >> 16);
+		}
+
+		memset(records.data(), 0, count * sizeof(Record));
+		if (unpack(stream.data(), records.data(), count) != stream.data() + size ||
+			pack(packed.data(), records.data(), count) != packed.data() + size)
+		{
+			fprintf(stderr, "%s: %u records didn't take %u bytes\n", name, unsigned(count), unsigned(size));
+			return false;
+		}
+
+		if (first_field(records[0]) != int16((stream[0] << 8) | stream[1]))
+		{
+			fprintf(stderr, "%s: first field unpacked as %d from %02x %02x\n", name,
+				first_field(records[0]), stream[0], stream[1]);
+			return false;
+		}
+
+		size_t padding = 0;
+		for (size_t i = 0; i < size; ++i)
+		{
+			if (data_bytes[i] == 0)
+				++padding;
+			else if (packed[i] != stream[i])
+			{
+				fprintf(stderr, "%s: stream byte %u of %u records changed from %02x to %02x\n", name,
+					unsigned(i), unsigned(count), stream[i], packed[i]);
+				return false;
+			}
+		}
+		if (padding == size)
+		{
+			fprintf(stderr, "%s: nothing was packed\n", name);
+			return false;
+		}
+
+		memset(unpacked.data(), 0, count * sizeof(Record));
+		unpack(packed.data(), unpacked.data(), count);
+		pack(repacked.data(), unpacked.data(), count);
+		if (memcmp(records.data(), unpacked.data(), count * sizeof(Record)) != 0 ||
+			memcmp(packed.data(), repacked.data(), size) != 0)
+		{
+			fprintf(stderr, "%s: %u records didn't survive a second round trip\n", name, unsigned(count));
+			return false;
+		}
+	}
+
+	printf("%-12s ok\n", name);
+	return true;
+}
+
+static int check_packing(int, char **)
+{
+	bool ok = true;
+
+	ok &= check_round_trip<endpoint_data>("endpoint", SIZEOF_endpoint_data,
+		unpack_endpoint_data, pack_endpoint_data,
+		[](const endpoint_data& r) -> int32 { return int16(r.flags); });
+	ok &= check_round_trip<line_data>("line", SIZEOF_line_data,
+		unpack_line_data, pack_line_data,
+		[](const line_data& r) -> int32 { return r.endpoint_indexes[0]; });
+	ok &= check_round_trip<side_data>("side", SIZEOF_side_data,
+		unpack_side_data, pack_side_data,
+		[](const side_data& r) -> int32 { return r.type; });
+	ok &= check_round_trip<polygon_data>("polygon", SIZEOF_polygon_data,
+		unpack_polygon_data, pack_polygon_data,
+		[](const polygon_data& r) -> int32 { return r.type; });
+	ok &= check_round_trip<map_object>("map object", SIZEOF_map_object,
+		unpack_map_object, pack_map_object,
+		[](const map_object& r) -> int32 { return r.type; });
+	ok &= check_round_trip<object_data>("object", SIZEOF_object_data,
+		unpack_object_data, pack_object_data,
+		[](const object_data& r) -> int32 { return r.location.x; });
+	ok &= check_round_trip<projectile_data>("projectile", SIZEOF_projectile_data,
+		unpack_projectile_data, pack_projectile_data,
+		[](const projectile_data& r) -> int32 { return r.type; });
+	ok &= check_round_trip<effect_data>("effect", SIZEOF_effect_data,
+		unpack_effect_data, pack_effect_data,
+		[](const effect_data& r) -> int32 { return r.type; });
+	ok &= check_round_trip<monster_data>("monster", SIZEOF_monster_data,
+		unpack_monster_data, pack_monster_data,
+		[](const monster_data& r) -> int32 { return r.type; });
+	ok &= check_round_trip<player_data>("player", SIZEOF_player_data,
+		unpack_player_data, pack_player_data,
+		[](const player_data& r) -> int32 { return r.identifier; });
+
+	return ok ? 0 : 1;
+}
+
+// Lua serialization
+
+#ifdef HAVE_LUA
+
+// The version 1 writer, as lua_save() was before version 2, so that there is
+// version 1 data to time lua_restore() on; lua_restore() still reads it
+static void save_v1(lua_State *L, BOStreamBE& s, uint32& counter)
+{
+	lua_pushvalue(L, -1);
+	lua_rawget(L, 1);
+	if (!lua_isnil(L, -1))
+	{
+		s << static_cast<int8>(-2)
+		  << static_cast<uint32>(lua_tonumber(L, -1));
+		lua_pop(L, 1);
+		return;
+	}
+	lua_pop(L, 1);
+
+	s << static_cast<int8>(lua_type(L, -1));
+	switch (lua_type(L, -1))
+	{
+		case LUA_TNIL:
+			break;
+		case LUA_TNUMBER:
+			s << static_cast<double>(lua_tonumber(L, -1));
+			break;
+		case LUA_TBOOLEAN:
+			s << static_cast<uint8>(lua_toboolean(L, -1) ? 1 : 0);
+			break;
+		case LUA_TSTRING:
+			s << static_cast<uint32>(lua_rawlen(L, -1));
+			s.write(lua_tostring(L, -1), lua_rawlen(L, -1));
+			break;
+		case LUA_TTABLE:
+			lua_pushvalue(L, -1);
+			lua_pushnumber(L, static_cast<lua_Number>(++counter));
+			lua_rawset(L, 1);
+			s << counter;
+
+			lua_pushnil(L);
+			while (lua_next(L, -2))
+			{
+				int key_type = lua_type(L, -2);
+				if (key_type == LUA_TNUMBER || key_type == LUA_TBOOLEAN || key_type == LUA_TSTRING ||
+					key_type == LUA_TTABLE || key_type == LUA_TUSERDATA)
+				{
+					lua_pushvalue(L, -2);
+					save_v1(L, s, counter);
+					lua_pop(L, 1);
+					save_v1(L, s, counter);
+				}
+				lua_pop(L, 1);
+			}
+
+			lua_pushnil(L);
+			save_v1(L, s, counter);
+			lua_pop(L, 1);
+			break;
+		default:
+			break;
+	}
+}
+
+static bool lua_save_v1(lua_State *L, std::streambuf* sb)
+{
+	lua_newtable(L);
+	lua_insert(L, 1);
+
+	uint32 counter = 0;
+	BOStreamBE s(sb);
+	try
+	{
+		s << static_cast<uint16>(1);
+		save_v1(L, s, counter);
+	}
+	catch (const basic_bstream::failure&)
+	{
+		lua_settop(L, 0);
+		return false;
+	}
+
+	lua_remove(L, 1);
+	return true;
+}
+
+// A big scenario's persistent table: 50,000 entries with repeated strings, a
+// shared table, a cycle, table keys, and numbers that are easy to get wrong
+static const char *lua_test_data =
+	"local shared = { x = 1 }\n"
+	"local t = { shared = shared, again = shared, flags = { [true] = 1, [false] = 2 },\n"
+	"  numbers = { 0.5, -3, 2^40, -0.0, 1e300, 0/0, 2^53, -2^53, 2^60 } }\n"
+	"t.self = t\n"
+	"t[{ k = 1 }] = 'table key'\n"
+	"for i = 1, 50000 do\n"
+	"  t[i] = { name = 'monster', kind = 'item' .. (i % 10), x = i * 1.5, y = -i, z = i,\n"
+	"    alive = (i % 2 == 0), long = string.rep('abc', 30) }\n"
+	"end\n"
+	"return t\n";
+
+// Whether two values are the same, down through their tables, with the same
+// sharing; NaN matches NaN, and -0 only -0
+static const char *lua_same =
+	"local seen = {}\n"
+	"local function same(a, b)\n"
+	"  if type(a) ~= type(b) then return false end\n"
+	"  if type(a) ~= 'table' then\n"
+	"    if a ~= a and b ~= b then return true end\n"
+	"    if a == 0 and b == 0 then return 1/a == 1/b end\n"
+	"    return a == b\n"
+	"  end\n"
+	"  if seen[a] then return seen[a] == b end\n"
+	"  seen[a] = b\n"
+	"  local n = 0\n"
+	"  for k, v in pairs(a) do\n"
+	"    n = n + 1\n"
+	"    if type(k) == 'table' then\n"
+	"      local found = false\n"
+	"      for k2, v2 in pairs(b) do\n"
+	"        if type(k2) == 'table' and same(k, k2) and same(v, v2) then found = true end\n"
+	"      end\n"
+	"      if not found then return false end\n"
+	"    elseif not same(v, b[k]) then return false end\n"
+	"  end\n"
+	"  for k in pairs(b) do n = n - 1 end\n"
+	"  return n == 0\n"
+	"end\n"
+	"return same(...)\n";
+
+static bool lua_run(lua_State *L, const char *chunk, int arguments, int results)
+{
+	if (luaL_loadstring(L, chunk) != LUA_OK)
+	{
+		fprintf(stderr, "lua: %s\n", lua_tostring(L, -1));
+		return false;
+	}
+	lua_insert(L, -(arguments + 1));
+	if (lua_pcall(L, arguments, results, 0) != LUA_OK)
+	{
+		fprintf(stderr, "lua: %s\n", lua_tostring(L, -1));
+		return false;
+	}
+	return true;
+}
+
+typedef bool (*lua_saver)(lua_State *L, std::streambuf* sb);
+
+// saves the registry value at reference, the best of a few runs
+static bool time_lua_save(lua_State *L, int reference, lua_saver save, std::string& data, double& ms)
+{
+	ms = 0;
+	for (int run = 0; run < 5; ++run)
+	{
+		lua_settop(L, 0);
+		lua_rawgeti(L, LUA_REGISTRYINDEX, reference);
+		std::stringbuf sb;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if (!save(L, &sb))
+			return false;
+		double run_ms = elapsed_ms(start);
+		if (run == 0 || run_ms < ms)
+			ms = run_ms;
+		data = sb.str();
+	}
+	lua_settop(L, 0);
+	return true;
+}
+
+// leaves the restored value on the stack
+static bool time_lua_restore(lua_State *L, const std::string& data, double& ms)
+{
+	ms = 0;
+	for (int run = 0; run < 5; ++run)
+	{
+		lua_settop(L, 0);
+		std::stringbuf sb(data);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if (!lua_restore(L, &sb))
+			return false;
+		double run_ms = elapsed_ms(start);
+		if (run == 0 || run_ms < ms)
+			ms = run_ms;
+	}
+	return true;
+}
+
+static int time_lua(int, char **)
+{
+	lua_State *L = luaL_newstate();
+	luaL_openlibs(L);
+
+	bool ok = lua_run(L, lua_test_data, 0, 1);
+	int reference = ok ? luaL_ref(L, LUA_REGISTRYINDEX) : LUA_NOREF;
+
+	static const struct { const char *name; lua_saver save; } versions[] = {
+		{ "v1", lua_save_v1 },
+		{ "v2", lua_save }
+	};
+
+	std::string v2_data;
+	for (int v = 0; ok && v < 2; ++v)
+	{
+		std::string data;
+		double save_ms, restore_ms;
+		if (!time_lua_save(L, reference, versions[v].save, data, save_ms) ||
+			!time_lua_restore(L, data, restore_ms))
+		{
+			fprintf(stderr, "lua: %s didn't round-trip\n", versions[v].name);
+			ok = false;
+			break;
+		}
+
+		lua_rawgeti(L, LUA_REGISTRYINDEX, reference);
+		if (!lua_run(L, lua_same, 2, 1) || !lua_toboolean(L, -1))
+		{
+			fprintf(stderr, "lua: %s restored different data\n", versions[v].name);
+			ok = false;
+			break;
+		}
+
+		printf("%s: %5.1f MB, save %6.1f ms, restore %6.1f ms\n", versions[v].name,
+			data.size() / 1000000.0, save_ms, restore_ms);
+		if (v == 1)
+			v2_data = data;
+	}
+
+	// data cut anywhere has to be refused, not misread; try every cut in the
+	// header and the first values, then cuts further and further from the end
+	std::vector<size_t> cuts;
+	for (size_t length = 0; length < 64 && length < v2_data.size(); ++length)
+		cuts.push_back(length);
+	for (size_t step = 1; step < v2_data.size(); step *= 2)
+		cuts.push_back(v2_data.size() - step);
+
+	for (size_t i = 0; ok && i < cuts.size(); ++i)
+	{
+		size_t length = cuts[i];
+		lua_settop(L, 0);
+		std::stringbuf sb(v2_data.substr(0, length));
+		if (lua_restore(L, &sb))
+		{
+			fprintf(stderr, "lua: data cut to %u of %u bytes was restored\n",
+				unsigned(length), unsigned(v2_data.size()));
+			ok = false;
+		}
+	}
+	if (ok)
+		printf("truncated data: refused\n");
+
+	// deep enough to overflow the C stack if saving or restoring recursed
+	static const int depth = 100000;
+	if (ok)
+	{
+		lua_settop(L, 0);
+		lua_pushinteger(L, depth);
+		ok = lua_run(L,
+			"local t = {} local c = t\n"
+			"for i = 1, ... do c.next = { level = i } c = c.next end\n"
+			"return t\n", 1, 1);
+
+		std::stringbuf out;
+		ok = ok && lua_save(L, &out);
+		lua_settop(L, 0);
+		std::stringbuf in(out.str());
+		ok = ok && lua_restore(L, &in);
+		ok = ok && lua_run(L,
+			"local c, n = ..., 0\n"
+			"while c.next do c = c.next n = n + 1 assert(c.level == n) end\n"
+			"return n\n", 1, 1);
+		if (!ok || lua_tointeger(L, -1) != depth)
+		{
+			fprintf(stderr, "lua: %d nested tables didn't round-trip\n", depth);
+			ok = false;
+		}
+		else
+			printf("%d nested tables: ok\n", depth);
+	}
+
+	lua_close(L);
+	return ok ? 0 : 1;
+}
+
+#endif
+
+#ifdef HAVE_OPENGL
+
+// Model skinning
+
+// A boned model the size of a detailed monster: 24 bones, 16 frames and
+// 1500 vertices, each on one bone or blended between two
+static void make_skinned_model(Model3D& model)
+{
+	const int bones = 24, frames = 16, sources = 1500;
+	srand(29);
+
+	model.Bones.resize(bones);
+	for (int ib = 0; ib < bones; ++ib)
+	{
+		Model3D_Bone& bone = model.Bones[ib];
+		for (int c = 0; c < 3; ++c)
+			bone.Position[c] = float(rand() % 2048 - 1024);
+		// limbs of four bones each, branching off the bones before them
+		bone.Flags = (ib > 0 && ib % 4 == 0) ? (Model3D_Bone::Pop | Model3D_Bone::Push) : Model3D_Bone::Push;
+	}
+
+	model.Frames.resize(frames * bones);
+	for (size_t i = 0; i < model.Frames.size(); ++i)
+	{
+		Model3D_Frame& frame = model.Frames[i];
+		for (int c = 0; c < 3; ++c)
+		{
+			frame.Offset[c] = float(rand() % 64 - 32);
+			frame.Angles[c] = int16(rand() % FULL_CIRCLE);
+		}
+	}
+
+	model.VtxSources.resize(sources);
+	for (int is = 0; is < sources; ++is)
+	{
+		Model3D_VertexSource& source = model.VtxSources[is];
+		for (int c = 0; c < 3; ++c)
+			source.Position[c] = float(rand() % 2048 - 1024);
+		source.Bone0 = GLshort(rand() % bones);
+		source.Bone1 = (is % 3 == 0) ? GLshort(NONE) : GLshort(rand() % bones);
+		source.Blend = (source.Bone1 == NONE) ? 0 : float(rand() % 256) / 256;
+	}
+
+	// triangles share vertex sources, so some sources have several vertices
+	model.VtxSrcIndices.resize(2 * sources);
+	for (size_t i = 0; i < model.VtxSrcIndices.size(); ++i)
+		model.VtxSrcIndices[i] = GLushort(i < size_t(sources) ? i : rand() % sources);
+
+	model.NormSources.resize(3 * model.VtxSrcIndices.size());
+	for (size_t i = 0; i < model.NormSources.size(); i += 3)
+	{
+		model.NormSources[i] = 0;
+		model.NormSources[i + 1] = 0;
+		model.NormSources[i + 2] = 1;
+	}
+}
+
+// Mean milliseconds a frame to skin every instance, over enough frames to
+// cycle through the animation
+static double time_skinning(Model3D& model, int instances, int poses)
+{
+	const int frames = 200;
+	const GLshort animation_frames = GLshort(model.TrueNumFrames());
+
+	model.InvalidatePoses();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int f = 0; f < frames; ++f)
+	{
+		for (int i = 0; i < instances; ++i)
+		{
+			// poses == 0: every instance is somewhere different in the animation
+			int pose = poses > 0 ? i % poses : i;
+			GLshort frame = GLshort((f / 4 + pose) % animation_frames);
+			GLshort next_frame = GLshort((frame + 1) % animation_frames);
+			float mix = float((f + pose) % 4) / 4 + (poses > 0 ? 0 : float(i) / (4 * instances));
+			model.FindPositions_Frame(true, frame, mix, next_frame);
+		}
+	}
+	return elapsed_ms(start) / frames;
+}
+
+static int time_models(int argc, char **argv)
+{
+	int instances = argc > 0 ? atoi(argv[0]) : 64;
+	if (instances <= 0)
+	{
+		fprintf(stderr, "models: the number of instances must be positive\n");
+		return 1;
+	}
+
+	Model3D::BuildTrigTables();
+	Model3D model;
+	make_skinned_model(model);
+
+	printf("models: %d instances of %u vertices on %u bones\n", instances,
+		   static_cast<unsigned>(model.VtxSrcIndices.size()), static_cast<unsigned>(model.Bones.size()));
+	printf("  every instance in its own pose: %.3f ms/frame\n", time_skinning(model, instances, 0));
+	printf("  instances sharing 4 poses:      %.3f ms/frame\n", time_skinning(model, instances, 4));
+	return 0;
+}
+
+#endif
+
+// Films
+
+extern int alephone_main(int argc, char **argv);
+
+static int time_film(int argc, char **argv)
+{
+	if (argc < 1)
+	{
+		fprintf(stderr, "film: no film given\n");
+		return 1;
+	}
+
+	// alephone [options] [directory] --timedemo film
+	std::vector<char *> args;
+	args.push_back(const_cast<char *>("alephone"));
+	for (int i = 0; i < argc - 1; ++i)
+		args.push_back(argv[i]);
+	args.push_back(const_cast<char *>("--timedemo"));
+	args.push_back(argv[argc - 1]);
+	args.push_back(NULL);
+
+	return alephone_main(static_cast<int>(args.size() - 1), args.data());
+}
+
+// MML and preferences loading
+
+extern DirectorySpecifier preferences_dir;
+
+// The MML files the game would read from a Scripts directory
+static void find_mml_files(DirectorySpecifier& dir, std::vector<FileSpecifier>& files)
+{
+	std::vector<dir_entry> de;
+	if (!dir.ReadDirectory(de))
+		return;
+	std::sort(de.begin(), de.end());
+
+	for (std::vector<dir_entry>::const_iterator i = de.begin(); i != de.end(); ++i)
+	{
+		if (i->is_directory || i->name[i->name.length() - 1] == '~')
+			continue;
+		if (i->name.length() >= 4 && i->name.compare(i->name.length() - 4, 4, ".lua") == 0)
+			continue;
+		files.push_back(dir + i->name);
+	}
+}
+
+static int time_mml(int argc, char **argv)
+{
+	DirectorySpecifier dir(argc > 0 ? argv[0] : "MML Scripts");
+	std::vector<FileSpecifier> files;
+	find_mml_files(dir, files);
+	if (files.empty())
+	{
+		fprintf(stderr, "mml: no MML files in %s\n", dir.GetPath());
+		return 1;
+	}
+
+	// The first parse fills the XML cache in memory; later ones only apply
+	// the cached trees, which is what a restart with a warm cache costs
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bool parsed = ParseMMLFromFiles(files);
+	double first = elapsed_ms(start);
+
+	double cached = 0;
+	for (int run = 0; run < 5; ++run)
+	{
+		ResetAllMMLValues();
+		start = std::chrono::steady_clock::now();
+		parsed = ParseMMLFromFiles(files) && parsed;
+		double ms = elapsed_ms(start);
+		if (run == 0 || ms < cached)
+			cached = ms;
+	}
+
+	printf("mml: %u files in %s: parse %.2f ms, cached %.2f ms (best of 5)\n",
+		   static_cast<unsigned>(files.size()), dir.GetPath(), first, cached);
+	if (!parsed)
+	{
+		fprintf(stderr, "mml: errors parsing %s\n", dir.GetPath());
+		return 1;
+	}
+
+	// The preferences file name comes from the MML's text strings
+	if (!TS_IsPresent(strFILENAMES))
+	{
+		printf("mml: no file names in the MML; not loading preferences\n");
+		return 0;
+	}
+
+	preferences_dir = argc > 1 ? std::string(argv[1]) : get_data_path(kPathPreferences);
+	FileSpecifier prefs = preferences_dir + getcstr(temporary, strFILENAMES, filenamePREFERENCES);
+	if (!prefs.Exists())
+	{
+		// read_preferences() would put up an alert
+		printf("mml: no preferences file %s; not loading preferences\n", prefs.GetPath());
+		return 0;
+	}
+
+	start = std::chrono::steady_clock::now();
+	initialize_preferences();
+	first = elapsed_ms(start);
+
+	double reread = 0;
+	for (int run = 0; run < 5; ++run)
+	{
+		start = std::chrono::steady_clock::now();
+		read_preferences();
+		double ms = elapsed_ms(start);
+		if (run == 0 || ms < reread)
+			reread = ms;
+	}
+
+	printf("mml: preferences %s: first load %.2f ms, reload %.2f ms (best of 5)\n",
+		   prefs.GetPath(), first, reread);
+	return 0;
+}
+
+struct command
+{
+	const char *name;
+	int (*run)(int argc, char **argv);
+	bool is_check; // run when no command is given
+	const char *usage;
+};
+
+static const command commands[] = {
+	{ "packing", check_packing, true, "packing" },
+#ifdef HAVE_LUA
+	{ "lua", time_lua, true, "lua" },
+#endif
+	{ "film", time_film, false, "film [options] [directory] film" },
+#ifdef HAVE_OPENGL
+	{ "models", time_models, false, "models [instances]" },
+#endif
+	{ "mml", time_mml, false, "mml [directory] [preferences directory]" },
+};
+
+static const size_t number_of_commands = sizeof(commands) / sizeof(commands[0]);
+
+int main(int argc, char **argv)
+{
+	if (argc < 2)
+	{
+		int result = 0;
+		for (size_t i = 0; i < number_of_commands; ++i)
+		{
+			if (commands[i].is_check && commands[i].run(0, NULL) != 0)
+				result = 1;
+		}
+		return result;
+	}
+
+	for (size_t i = 0; i < number_of_commands; ++i)
+	{
+		if (strcmp(argv[1], commands[i].name) == 0)
+			return commands[i].run(argc - 2, argv + 2);
+	}
+
+	fprintf(stderr, "Usage: %s [command]\nWith no command, runs every check. Commands:\n", argv[0]);
+	for (size_t i = 0; i < number_of_commands; ++i)
+		fprintf(stderr, "  %s\n", commands[i].usage);
+	return 1;
+}
@@ -0,0 +1,32 @@
+#!/bin/sh
+# Plays a film as a timedemo twice, with collision checks using each polygon's
+# cached list of solid objects and then walking the full object lists
+# (<monsters solid_object_cache="false">), and prints both profiles.
+# Compare the "update_world", "projectiles" and "monsters" zones.
+
+BENCH="$1"
+SCENARIO="$2"
+FILM="$3"
+
+if [ ! -x "$BENCH" ] || [ ! -d "$SCENARIO" ] || [ ! -f "$FILM" ]; then
+  echo "Usage: $0 <alephbench> <scenario-directory> <film>"
+  exit 1
+fi
+
+# ALEPHONE_DATA puts a directory's Scripts on the MML search path; both runs
+# set it, so that they search the same directories apart from that one file
+ON=`mktemp -d` || exit 1
+OFF=`mktemp -d` || exit 1
+trap 'rm -rf "$ON" "$OFF"' EXIT
+mkdir "$OFF/Scripts"
+cat > "$OFF/Scripts/solid_object_cache_off.mml" <<END
+<marathon>
+<monsters solid_object_cache="false"/>
+</marathon>
+END
+
+echo "==== solid_object_cache on"
+ALEPHONE_DATA="$ON" "$BENCH" film "$SCENARIO" "$FILM" || exit 1
+
+echo "==== solid_object_cache off"
+ALEPHONE_DATA="$OFF" "$BENCH" film "$SCENARIO" "$FILM" || exit 1